@@ -0,0 +1,235 @@
+/*
+ * File:   asyncgps.cpp
+ */
+
+#include "asyncgps.h"
+
+#ifdef ASYNCGPS_AVAILABLE
+
+static bool is_position_report(ReportType t) {
+    return t == RPT_FIX_POS_LLA_32 or t == RPT_FIX_POS_LLA_64 or
+           t == RPT_FIX_POS_XYZ_32 or t == RPT_FIX_POS_XYZ_64;
+}
+
+// the waiting list for a report type; NMEA sentences follow the TSIP IDs.
+static int wait_list(ReportType t) {
+    return (t >= RPT_NMEA) ? WAIT_LIST_NMEA + (t - RPT_NMEA) : (int)t;
+}
+
+/***************************
+ * awaiter                 *
+ ***************************/
+
+ReportAwaiter::ReportAwaiter(AsyncGPS *gps, int list, ReportType want, int spkt):
+        m_gps(gps),
+        m_list_id(list),
+        m_want(want),
+        m_spkt(spkt),
+        m_result(RPT_NONE),
+        m_list(NULL),
+        m_prev(NULL),
+        m_next(NULL) {}
+
+ReportAwaiter::~ReportAwaiter() {
+    // the coroutine was destroyed while waiting.
+    if (m_list != NULL) m_gps->unlink(this);
+}
+
+void ReportAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+    m_handle = h;
+    m_gps->link(m_list_id, this);
+}
+
+/***************************
+ * structors               *
+ ***************************/
+
+/**
+ * Construct a new `AsyncGPS` to process the reports of `gps`.
+ */
+AsyncGPS::AsyncGPS(CopernicusGPS *gps):
+        m_gps(gps),
+        m_ready(NULL),
+        m_n_waiting(0),
+        m_polling(false) {
+    for (int i = 0; i < WAIT_LISTS; i++) m_lists[i] = NULL;
+}
+
+/**
+ * Destroy the `AsyncGPS`. Coroutines still waiting are not resumed, and
+ * must not be; call `cancelAll()` first to let them finish.
+ */
+AsyncGPS::~AsyncGPS() {
+    for (int i = 0; i <= WAIT_LISTS; i++) {
+        ReportAwaiter **list = (i < WAIT_LISTS) ? &m_lists[i] : &m_ready;
+        while (*list != NULL) unlink(*list);
+    }
+}
+
+/***************************
+ * waiting                 *
+ ***************************/
+
+/**
+ * Wait for the next report of the given type. Reports passed on to packet
+ * processors (see `CopernicusGPS::addPacketProcessor()`) are included.
+ *
+ * @param type Report to wait for, or `RPT_NONE` for any report.
+ */
+ReportAwaiter AsyncGPS::nextReport(ReportType type) {
+    if (type == RPT_NONE) return ReportAwaiter(this, WAIT_LIST_ANY, RPT_NONE, -1);
+    return ReportAwaiter(this, wait_list(type), type, -1);
+}
+
+/**
+ * Wait for the next position fix, in any format: a TSIP position report, or
+ * any other report which changes the time of the position fix, such as a
+ * fix or timing superpacket, or an NMEA GGA or RMC sentence. The result is
+ * the report type, and the fix is available from
+ * `CopernicusGPS::getPositionFix()`.
+ */
+ReportAwaiter AsyncGPS::nextFix() {
+    return ReportAwaiter(this, WAIT_LIST_FIX, RPT_NONE, -1);
+}
+
+/**
+ * Wait for the next superpacket with the given sub-ID, such as the reply to
+ * a superpacket command.
+ */
+ReportAwaiter AsyncGPS::nextSuperpacket(SuperpacketID id) {
+    return ReportAwaiter(this, RPT_SUPERPACKET, RPT_SUPERPACKET, id);
+}
+
+/**
+ * Resume all waiting coroutines, with a result of `RPT_NONE`.
+ */
+void AsyncGPS::cancelAll() {
+    for (int i = 0; i < WAIT_LISTS; i++) {
+        while (m_lists[i] != NULL) {
+            ReportAwaiter *a = m_lists[i];
+            unlink(a);
+            a->m_result = RPT_NONE;
+            link(-1, a);
+        }
+    }
+    resumeReady();
+}
+
+// add an awaiter to the end of a waiting list, or the ready list if
+// `list_id` is negative.
+void AsyncGPS::link(int list_id, ReportAwaiter *a) {
+    ReportAwaiter **list = (list_id < 0) ? &m_ready : &m_lists[list_id];
+    ReportAwaiter *head = *list;
+    if (head == NULL) {
+        a->m_prev = a->m_next = a;
+        *list = a;
+    } else {
+        a->m_prev = head->m_prev;
+        a->m_next = head;
+        head->m_prev->m_next = a;
+        head->m_prev = a;
+    }
+    a->m_list = list;
+    m_n_waiting++;
+}
+
+void AsyncGPS::unlink(ReportAwaiter *a) {
+    ReportAwaiter **list = a->m_list;
+    if (a->m_next == a) {
+        *list = NULL;
+    } else {
+        a->m_prev->m_next = a->m_next;
+        a->m_next->m_prev = a->m_prev;
+        if (*list == a) *list = a->m_next;
+    }
+    a->m_list = NULL;
+    m_n_waiting--;
+}
+
+// move the awaiters of a list which want `type` to the ready list.
+void AsyncGPS::ready(int list_id, ReportType type, ReportType result) {
+    ReportAwaiter *a = m_lists[list_id];
+    if (a == NULL) return;
+    // walk one lap of the list, as it was before any were moved.
+    ReportAwaiter *end = a->m_prev;
+    while (true) {
+        ReportAwaiter *next = a->m_next;
+        bool last = (a == end);
+        bool match = list_id >= WAIT_LIST_FIX or (a->m_want == type and
+                (a->m_spkt < 0 or a->m_spkt == m_gps->getSuperpacketID()));
+        if (match) {
+            unlink(a);
+            a->m_result = result;
+            link(-1, a);
+        }
+        if (last) break;
+        a = next;
+    }
+}
+
+void AsyncGPS::resumeReady() {
+    // a resumed coroutine may destroy others which are ready; they
+    // remove themselves from the list.
+    while (m_ready != NULL) {
+        ReportAwaiter *a = m_ready;
+        unlink(a);
+        a->m_handle.resume();
+    }
+}
+
+/***************************
+ * processing              *
+ ***************************/
+
+/**
+ * Process the reports which have arrived, resuming the coroutines waiting
+ * for each. Call when the receiver's serial port is readable. Calls made
+ * from a resumed coroutine do nothing.
+ *
+ * @param max_packets Most packets to process, or 0 for no limit.
+ * @return Number of packets processed.
+ */
+int AsyncGPS::poll(int max_packets) {
+    if (m_polling) return 0;
+    m_polling = true;
+    int n = 0;
+    while (max_packets <= 0 or n < max_packets) {
+        uint32_t fixtime = m_gps->getPositionFix().getFixTime().bits;
+        ReportType rpt = m_gps->processOnePacket(false);
+        if (rpt == RPT_NONE) break;
+        n++;
+        if (rpt == RPT_ERROR) continue;
+        ready(wait_list(rpt), rpt, rpt);
+        // reports other than the position reports also replace the fix
+        // (superpackets, NMEA sentences); a new fix time gives them away.
+        if (is_position_report(rpt) or (rpt == RPT_SUPERPACKET and
+                m_gps->getSuperpacketID() == SPKT_FIX) or
+                m_gps->getPositionFix().getFixTime().bits != fixtime) {
+            ready(WAIT_LIST_FIX, rpt, rpt);
+        }
+        ready(WAIT_LIST_ANY, rpt, rpt);
+        resumeReady();
+    }
+    m_polling = false;
+    return n;
+}
+
+/***************************
+ * access                  *
+ ***************************/
+
+/**
+ * Get the receiver whose reports are processed.
+ */
+CopernicusGPS* AsyncGPS::getGPS() {
+    return m_gps;
+}
+
+/**
+ * Get the number of coroutines waiting.
+ */
+uint32_t AsyncGPS::getWaitingCount() const {
+    return m_n_waiting;
+}
+
+#endif
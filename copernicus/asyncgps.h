@@ -0,0 +1,150 @@
+/*
+ * File:   asyncgps.h
+ *
+ * Awaitable reports for C++20 coroutines. Available only if the compiler
+ * supports coroutines.
+ */
+
+#ifndef ASYNCGPS_H
+#define	ASYNCGPS_H
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define ASYNCGPS_AVAILABLE 1
+#endif
+#endif
+
+#ifdef ASYNCGPS_AVAILABLE
+
+#include <coroutine>
+
+#include "copernicus.h"
+
+/**
+ * @addtogroup monitor
+ * @{
+ */
+
+// waiting lists: one per TSIP report ID, one per NMEA sentence, then
+// fixes, then any report.
+#define WAIT_LIST_NMEA 256
+#define WAIT_LIST_FIX  (WAIT_LIST_NMEA + NMEA_REPORT_TYPES)
+#define WAIT_LIST_ANY  (WAIT_LIST_FIX + 1)
+#define WAIT_LISTS     (WAIT_LIST_FIX + 2)
+
+class AsyncGPS;
+
+/**
+ * @brief Suspends a coroutine until a report arrives.
+ *
+ * Obtained from `AsyncGPS`, and meant to be `co_await`ed at once. The result
+ * of the `co_await` is the type of the report which resumed the coroutine,
+ * or `RPT_NONE` if the wait was cancelled.
+ *
+ * The awaiter lives in the suspended coroutine's frame, and is linked into
+ * the waiting list of its `AsyncGPS` directly, so waiting allocates nothing.
+ * A coroutine destroyed while waiting is removed from the list.
+ */
+class ReportAwaiter {
+public:
+    ReportAwaiter(const ReportAwaiter&) = delete;
+    ReportAwaiter& operator=(const ReportAwaiter&) = delete;
+    ~ReportAwaiter();
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) noexcept;
+    ReportType await_resume() const noexcept { return m_result; }
+
+private:
+
+    ReportAwaiter(AsyncGPS *gps, int list, ReportType want, int spkt);
+
+    AsyncGPS      *m_gps;
+    int16_t        m_list_id;
+    ReportType     m_want;
+    int            m_spkt;     // superpacket ID wanted, or -1 for any
+    ReportType     m_result;
+    std::coroutine_handle<> m_handle;
+
+    // the list the awaiter is linked into (circular), or NULL
+    ReportAwaiter **m_list;
+    ReportAwaiter  *m_prev;
+    ReportAwaiter  *m_next;
+
+    friend class AsyncGPS;
+};
+
+/**
+ * @brief Lets coroutines wait for the reports of a `CopernicusGPS`.
+ *
+ * `AsyncGPS` owns the receiver's input. Call `poll()` whenever the serial
+ * port is readable (e.g. from an epoll or io_uring loop); each report is
+ * processed, and the coroutines waiting for it are resumed, one at a time,
+ * before the next report is processed, so that they see the receiver's
+ * data as of that report.
+ *
+ * Waiting coroutines cost only the memory of their frames; many receivers,
+ * and thousands of waiting coroutines, may be served by one thread. Waiters
+ * are kept in lists by report ID, so each report visits only the coroutines
+ * waiting for it.
+ *
+ * To wait for the reply to a command, send the command and then `co_await`
+ * its report; replies are only processed by `poll()`, so none can be missed.
+ *
+ * Note that `poll()` processes only whole packets without waiting, but
+ * once the start of a packet has arrived, it waits for the rest.
+ *
+ * Example:
+ *
+ *      Task track(AsyncGPS &agps) {
+ *          while (true) {
+ *              if (co_await agps.nextFix() == RPT_NONE) break;
+ *              store(agps.getGPS()->getPositionFix());
+ *          }
+ *      }
+ *
+ *      Task satellites(AsyncGPS &agps) {
+ *          agps.getGPS()->requestSatelliteStatus();
+ *          co_await agps.nextReport(RPT_SAT_TRACKING);
+ *          // ...
+ *      }
+ *
+ *      // in the event loop, when the serial port is readable:
+ *      agps.poll();
+ */
+class AsyncGPS {
+public:
+    AsyncGPS(CopernicusGPS *gps);
+    ~AsyncGPS();
+
+    ReportAwaiter nextReport(ReportType type=RPT_NONE);
+    ReportAwaiter nextFix();
+    ReportAwaiter nextSuperpacket(SuperpacketID id);
+
+    int  poll(int max_packets=0);
+    void cancelAll();
+
+    CopernicusGPS* getGPS();
+    uint32_t getWaitingCount() const;
+
+private:
+
+    void link(int list_id, ReportAwaiter *a);
+    void unlink(ReportAwaiter *a);
+    void ready(int list_id, ReportType type, ReportType result);
+    void resumeReady();
+
+    CopernicusGPS *m_gps;
+    ReportAwaiter *m_lists[WAIT_LISTS];
+    ReportAwaiter *m_ready;      // awaiters to be resumed
+    uint32_t       m_n_waiting;
+    bool           m_polling;
+
+    friend class ReportAwaiter;
+};
+
+/// @} // addtogroup monitor
+
+#endif
+
+#endif	/* ASYNCGPS_H */
@@ -59,5 +59,24 @@ inline void copy_network_order(Float64 *f, uint8_t bytes[8]) {
     copy_network_order(&f->bits, bytes);
 }
 
+////////// Writing //////////
+
+inline void put_network_order(uint8_t bytes[2], uint16_t i) {
+    bytes[0] = (uint8_t)(i >> 8);
+    bytes[1] = (uint8_t)(i);
+}
+
+inline void put_network_order(uint8_t bytes[4], uint32_t i) {
+    bytes[0] = (uint8_t)(i >> 24);
+    bytes[1] = (uint8_t)(i >> 16);
+    bytes[2] = (uint8_t)(i >>  8);
+    bytes[3] = (uint8_t)(i);
+}
+
+inline void put_network_order(uint8_t bytes[8], uint64_t i) {
+    put_network_order(bytes,     (uint32_t)(i >> 32));
+    put_network_order(bytes + 4, (uint32_t)(i));
+}
+
 #endif	/* CHUNK_H */
 
@@ -6,15 +6,37 @@
  */
 
 #include <algorithm>
+#include <string.h>
 
 #include "copernicus.h"
 #include "chunk.h"
+#include "nmea.h"
 #include "Arduino.h"
 
 #define SAVE_BYTES(dst, buf, n) \
         if (readDataBytes(buf, n) != (n)) return false; \
         copy_network_order(dst, buf);
 
+#define GPS_PI (3.14159265358979323846)
+#define RAD_TO_DEG_F (57.2957795f)
+
+// superpacket payload lengths, excluding the sub-ID.
+#define SPKT_FIX_LEN          55
+#define SPKT_TIMING_LEN       16
+#define SPKT_TIMING_SUPPL_LEN 67
+
+// states of the packet parser of poll()
+enum PollState {
+    POLL_SEEK,      // expecting the DLE of a packet header
+    POLL_HEADER,    // expecting the report ID
+    POLL_DATA,      // in the data bytes
+    POLL_DATA_DLE,  // after a DLE in the data bytes
+    POLL_READY,     // packet complete, not yet processed
+    POLL_SKIP,      // discarding the rest of a packet
+    POLL_SKIP_DLE,  // after a DLE in a discarded packet
+    POLL_NMEA,      // in an NMEA sentence
+};
+
 /***************************
  * structors               *
  ***************************/
@@ -27,7 +49,44 @@
  * `Serial1`, etc.
  */
 CopernicusGPS::CopernicusGPS(int serial_num):
-        m_n_listeners(0) {
+#if CPN_ENABLE_STATUS
+        m_raw_valid(0),
+        m_status_changes(0),
+        m_status_listener(NULL),
+#endif
+#if CPN_ENABLE_NMEA
+        m_frame_nmea(false),
+        m_nmea(false),
+        m_nmea_day(-1),
+        m_nmea_sod(0),
+#if CPN_ENABLE_SATELLITES
+        m_gsv_tracked(0),
+#endif
+#endif
+#if MAX_PKT_PROCESSORS > 0
+        m_n_listeners(0),
+#endif
+        m_io_valid(false),
+        m_io_dirty(false),
+        m_cfg_hold(false),
+        m_bcast_mask(BCAST_AUTO_REPORTS),
+        m_bcast_valid(false),
+        m_bcast_dirty(false),
+        m_subscribed(RPTFLAG_ALL),
+        m_spkt_id(SPKT_BCAST_MASK),
+        m_saved_fixes(RPTFLAG_FIX_POS_LLA_32 | RPTFLAG_FIX_VEL_ENU | RPTFLAG_GPSTIME),
+        m_capture(NULL),
+        m_capture_cap(0),
+        m_capture_len(0),
+        m_capture_done(false),
+        m_frame(NULL),
+        m_frame_cap(0),
+        m_frame_len(0),
+        m_frame_id(0),
+        m_poll_state(POLL_SEEK),
+        m_replay_pos(-1),
+        m_poll_wcet(0),
+        m_decode_wcet(0) {
     // ifdefs mirrored from HardwareSerial.h
     switch (serial_num) {
 #ifdef UBRR1H
@@ -81,6 +140,16 @@ void CopernicusGPS::endCommand() {
  * @return Number of bytes actually written to `dst`.
  */
 int CopernicusGPS::readDataBytes(uint8_t *dst, int n) {
+    if (m_replay_pos >= 0) {
+        // the packet was buffered by poll().
+        int i = 0;
+        for (; i < n and m_replay_pos < m_frame_len; i++) {
+            dst[i] = m_frame[m_replay_pos++];
+            capture(dst[i]);
+        }
+        if (i < n) m_capture_done = true;
+        return i;
+    }
     for (int i = 0; i < n; i++, dst++) {
         blockForData();
         int read = m_serial->read();
@@ -95,10 +164,12 @@ int CopernicusGPS::readDataBytes(uint8_t *dst, int n) {
             } else if (peek == CTRL_ETX) {
                 // end of packet.
                 m_serial->read(); // consume the ETX byte
+                m_capture_done = true;
                 return i;
             }
         }
         *dst = read;
+        capture(read);
     }
     return n;
 }
@@ -138,16 +209,28 @@ void CopernicusGPS::writeDataBytes(const uint8_t* bytes, int n) {
  * @return True if the current packet was completely consumed/flushed.
  */
 bool CopernicusGPS::flushToNextPacket(bool block) {
+    if (m_replay_pos >= 0) {
+        while (m_replay_pos < m_frame_len) capture(m_frame[m_replay_pos++]);
+        m_capture_done = true;
+        return true;
+    }
     while (true) {
         if (m_serial->available() <= 0) {
             if (block) blockForData();
             else return false;
         }
         int b = m_serial->read();
-        if (b != CTRL_DLE) continue;
+        if (b != CTRL_DLE) {
+            capture(b);
+            continue;
+        }
         if (m_serial->available() <= 0) blockForData();
         b = m_serial->read();
-        if (b == CTRL_ETX) return true;
+        if (b == CTRL_ETX) {
+            m_capture_done = true;
+            return true;
+        }
+        capture(b);
     }
 }
 
@@ -171,12 +254,16 @@ bool CopernicusGPS::flushToNextPacket(bool block) {
  *          }
  *      }
  * 
+ * NMEA 0183 sentences are recognized only once a poll buffer of at least 80 
+ * bytes has been provided with `setPollBuffer()`. Without one, only TSIP 
+ * packets are framed, and sentences are skipped over as noise between them.
+ * 
  * @param block If `true`, will always wait for a complete packet to arrive.
  * @return The report ID of the processed packet, or `RPT_NONE` if `block`
  * is `false` and no data was available.
  */
 ReportType CopernicusGPS::processOnePacket(bool block) {
-    implProcessOnePacket(block, RPT_NONE);
+    return implProcessOnePacket(block, RPT_NONE);
 }
 
 /**
@@ -190,16 +277,233 @@ void CopernicusGPS::waitForPacket(ReportType type) {
     while (implProcessOnePacket(false, type) != type) {}
 }
 
+/**
+ * Provide storage for the packet being assembled by `poll()`. Packets longer
+ * than `capacity` are discarded, and counted as errors. 72 bytes hold every
+ * report decoded by this class; reports handled by packet processors may be
+ * longer (satellite ephemerides, for instance, need 170).
+ * 
+ * Once a buffer is provided, `processOnePacket()` also frames each packet in
+ * it, and NMEA 0183 sentences are recognized alongside TSIP packets, so that
+ * a port may carry either protocol, or be switched from one to the other. 
+ * Sentences are decoded into the same position, velocity, time, status, and
+ * satellite data as the TSIP reports, and are reported as `RPT_NMEA_GGA`, 
+ * etc.; sentences of other types have their checksums checked, and are 
+ * reported as `RPT_NMEA`. A sentence needs 80 bytes of buffer. The times of
+ * NMEA fixes are GPS times of week once a date has been received (in an RMC
+ * or ZDA sentence); before then, they are UTC seconds of the day.
+ * 
+ * @param buf Buffer to hold one packet's data bytes.
+ * @param capacity Size of `buf`.
+ */
+void CopernicusGPS::setPollBuffer(uint8_t *buf, int capacity) {
+    m_frame      = buf;
+    m_frame_cap  = (buf == NULL) ? 0 : capacity;
+    m_frame_len  = 0;
+    m_poll_state = POLL_SEEK;
+}
+
+/**
+ * Process as much of the waiting input as a budget allows, without ever
+ * waiting for more. Unlike `processOnePacket()`, a packet which has only
+ * partly arrived is read into the poll buffer (see `setPollBuffer()`) as far
+ * as it goes, and the parser's state is saved, so that the next call carries
+ * on where this one stopped. Each packet is decoded from the buffer once it is
+ * complete, so decoding never waits for data.
+ * 
+ * The time budget is checked every `POLL_CHECK_BYTES` bytes and before each
+ * packet is decoded, so a call may overrun it by the time taken to read that
+ * many bytes and decode one packet; `getWorstDecodeTime()` measures the
+ * latter. A complete packet is left for the next call if the budget runs out
+ * before it is decoded.
+ * 
+ * Example, in a cooperative scheduler with 1 ms slots:
+ * 
+ *      uint8_t pollbuf[72];
+ *      gps.setPollBuffer(pollbuf, sizeof(pollbuf));
+ *      // ...
+ *      PollStatus st = gps.poll(64, 800);
+ *      if (st.reports & RPTFLAG_FIX_POS_LLA_32) {
+ *          // use the new fix
+ *      }
+ * 
+ * `processOnePacket()` may also be called; it first finishes and processes
+ * any packet which `poll()` has begun.
+ * 
+ * @param max_bytes Most bytes to read, or 0 for no limit.
+ * @param max_micros Time budget in microseconds, or 0 for no limit.
+ * @return The packets processed and the input left over.
+ */
+PollStatus CopernicusGPS::poll(int max_bytes, uint32_t max_micros) {
+    PollStatus st;
+    st.packets = 0;
+    st.errors  = 0;
+    st.reports = 0;
+    st.last    = RPT_NONE;
+    st.bytes   = 0;
+    
+    uint32_t t0 = micros();
+    int unchecked = 0;
+    m_replay_pos = -1;
+    while (m_frame != NULL) {
+        if (m_poll_state == POLL_READY) {
+            if (max_micros > 0 and micros() - t0 >= max_micros) break;
+            processFrame(&st);
+            continue;
+        }
+        if (max_bytes > 0 and st.bytes >= max_bytes) break;
+        if (max_micros > 0 and ++unchecked >= POLL_CHECK_BYTES) {
+            unchecked = 0;
+            if (micros() - t0 >= max_micros) break;
+        }
+        if (m_serial->available() <= 0) break;
+        pollByte(m_serial->read());
+        st.bytes++;
+    }
+    st.backlog = m_serial->available();
+    st.partial = m_poll_state != POLL_SEEK;
+    
+    uint32_t dt = micros() - t0;
+    if (dt > m_poll_wcet) m_poll_wcet = dt;
+    return st;
+}
+
+// advance the packet parser of poll() by one byte of input.
+void CopernicusGPS::pollByte(uint8_t b) {
+    switch (m_poll_state) {
+        case POLL_SEEK:
+            if (b == CTRL_DLE) {
+                m_poll_state = POLL_HEADER;
+#if CPN_ENABLE_NMEA
+            } else if (b == '$') {
+                beginSentence();
+            } else if (m_nmea) {
+                // between sentences; skip the line ending.
+#endif
+            } else {
+                // outside of a packet header, we're mid-packet; find the end.
+                m_poll_state = POLL_SKIP;
+            }
+            break;
+        case POLL_HEADER:
+            if (b == CTRL_DLE) {
+                // double-DLE; a literal, not a packet header.
+                m_poll_state = POLL_SKIP;
+            } else if (b == CTRL_ETX) {
+                // the apparent end of a packet; another should follow.
+                m_poll_state = POLL_SEEK;
+            } else {
+                m_frame_id   = b;
+                m_frame_len  = 0;
+                m_poll_state = POLL_DATA;
+#if CPN_ENABLE_NMEA
+                m_frame_nmea = false;
+#endif
+            }
+            break;
+        case POLL_DATA:
+            if (b == CTRL_DLE) m_poll_state = POLL_DATA_DLE;
+            else appendFrame(b);
+            break;
+        case POLL_DATA_DLE:
+            if (b == CTRL_ETX) {
+                m_poll_state = POLL_READY;
+            } else {
+                // as readDataBytes(), keep a lone DLE and the byte after it.
+                appendFrame(CTRL_DLE);
+                if (b != CTRL_DLE) appendFrame(b);
+                m_poll_state = POLL_DATA;
+            }
+            break;
+        case POLL_SKIP:
+            if (b == CTRL_DLE) m_poll_state = POLL_SKIP_DLE;
+#if CPN_ENABLE_NMEA
+            else if (b == '$') beginSentence();
+#endif
+            break;
+        case POLL_SKIP_DLE:
+            m_poll_state = (b == CTRL_ETX) ? POLL_SEEK : POLL_SKIP;
+            break;
+#if CPN_ENABLE_NMEA
+        case POLL_NMEA:
+            if (b == '\n') {
+                m_poll_state = POLL_READY;
+            } else if (b == '$') {
+                // the last sentence was cut short.
+                beginSentence();
+            } else if (b == CTRL_DLE) {
+                // a TSIP packet header.
+                m_poll_state = POLL_HEADER;
+            } else if (b < 0x20 or b > 0x7E) {
+                // not text, unless the end of the line. Binary data; resync.
+                if (b != '\r') m_poll_state = m_nmea ? POLL_SEEK : POLL_SKIP;
+            } else {
+                appendFrame(b);
+            }
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+#if CPN_ENABLE_NMEA
+// start framing an NMEA sentence, after its `$`.
+void CopernicusGPS::beginSentence() {
+    m_frame_len  = 0;
+    m_frame_nmea = true;
+    m_poll_state = POLL_NMEA;
+}
+#endif
+
+// prepare to process the packet completed by poll(), returning its type, or
+// RPT_ERROR if it was too long to buffer.
+ReportType CopernicusGPS::beginFrame() {
+    m_poll_state = POLL_SEEK;
+    if (m_frame_len > m_frame_cap) return RPT_ERROR;
+    m_replay_pos   = 0;
+    m_capture_len  = 0;
+    m_capture_done = false;
+#if CPN_ENABLE_NMEA
+    if (m_frame_nmea) {
+        return nmea_type(reinterpret_cast<const char*>(m_frame), m_frame_len);
+    }
+    m_nmea = false;
+#endif
+    capture(m_frame_id);
+    return static_cast<ReportType>(m_frame_id);
+}
+
+void CopernicusGPS::processFrame(PollStatus *st) {
+    uint32_t t0 = micros();
+    ReportType rpt = beginFrame();
+    if (rpt != RPT_ERROR and not processReport(rpt)) rpt = RPT_ERROR;
+    m_replay_pos = -1;
+    uint32_t dt = micros() - t0;
+    if (dt > m_decode_wcet) m_decode_wcet = dt;
+    
+    st->packets++;
+    st->last = rpt;
+    if (rpt == RPT_ERROR) st->errors++;
+    else st->reports |= reportFlag(rpt);
+}
+
 /**
  * Consume the two terminating bytes of a TSIP packet, which
  * should be `0x10 0x03`. Return false if the expected
  * bytes were not found.
  */
 bool CopernicusGPS::endReport() {
+    if (m_replay_pos >= 0) {
+        if (m_replay_pos < m_frame_len) return false;
+        m_capture_done = true;
+        return true;
+    }
     blockForData();
     if (m_serial->read() != CTRL_DLE) return false;
     blockForData();
     if (m_serial->read() != CTRL_ETX) return false;
+    m_capture_done = true;
     return true;
 }
 
@@ -214,6 +518,16 @@ bool CopernicusGPS::endReport() {
  * To leave a fix mode unchanged, pass `RPT_NONE`. Other mode settings
  * have `NOCHANGE` constants which will preserve the current settings.
  * 
+ * The new settings are composed against a shadow copy of the receiver's
+ * I/O options, which is kept current from any I/O settings report (0x55) 
+ * seen in the stream. Only if no such report has been seen yet will the 
+ * receiver be queried first. If called between `beginConfig()` and 
+ * `commitConfig()`, the change is only recorded, and is sent along with 
+ * any other pending changes by `commitConfig()`.
+ * 
+ * The position and velocity reports subscribed to (see 
+ * `getSubscribedReports()`) are changed to the formats selected.
+ * 
  * @param pos_fixmode New position fix format. Any of the `RPT_FIX_POS_*` constants, or `RPT_NONE`.
  * @param vel_fixmode New velocity fix format. Any of the `RPT_FIX_VEL_*` constants, or `RPT_NONE`.
  * @param alt New altitude format.
@@ -229,14 +543,11 @@ bool CopernicusGPS::setFixMode(ReportType pos_fixmode,
                                PPSMode pps,
                                GPSTimeMode time,
                                bool block) {
-    // request current IO settings
-    beginCommand(CMD_IO_OPTIONS);
-    endCommand();
-    waitForPacket(RPT_IO_SETTINGS);
+    if (not m_io_valid and not requestIOOptions()) return false;
     
-    uint8_t bytes[4];
-    if (readDataBytes(bytes, 4) != 4) return false;
-    if (not endReport()) return false;
+    uint8_t *bytes = m_io_options;
+    uint8_t old[4];
+    memcpy(old, bytes, 4);
     
     const uint8_t pos_mask = 0x13;
     const uint8_t vel_mask = 0x03;
@@ -269,18 +580,264 @@ bool CopernicusGPS::setFixMode(ReportType pos_fixmode,
     if (pps  != PPS_NOCHANGE) bytes[2] = (bytes[2] & ~pps_mask) | pps;
     if (time != TME_NOCHANGE) bytes[2] = (bytes[2] & ~tme_mask) | time;
     
-    beginCommand(CMD_IO_OPTIONS);
-    writeDataBytes(bytes, 4);
-    endCommand();
+    // the selected formats are the ones which will be decoded.
+    m_subscribed = (m_subscribed & ~(RPTFLAG_FIX_POS | RPTFLAG_FIX_VEL)) | ioReports();
+    if (memcmp(old, bytes, 4) != 0) m_io_dirty = true;
+    if (m_cfg_hold) return true;
+    
+    return commitConfig(block);
+}
+
+/**
+ * Begin a batch of configuration changes. Until `commitConfig()` is called, 
+ * configuration commands such as `setFixMode()` will only alter the local 
+ * shadow copy of the receiver's settings (see `commitConfig()`), and nothing
+ * will be sent. 
+ * 
+ * Example:
+ * 
+ *      gps.beginConfig();
+ *      gps.setFixMode(RPT_FIX_POS_LLA_64, RPT_NONE, ALT_MSL);
+ *      gps.setFixMode(RPT_NONE, RPT_FIX_VEL_ENU, ALT_NOCHANGE, PPS_FIX);
+ *      gps.commitConfig(); // one command is sent.
+ */
+void CopernicusGPS::beginConfig() {
+    m_cfg_hold = true;
+}
+
+/**
+ * Send all configuration changes made since `beginConfig()` to the receiver. 
+ * Two groups of settings are shadowed: the I/O options (0x35), altered by 
+ * `setFixMode()` and `subscribeReports()`, and the packet broadcast mask 
+ * (0x8E-A5), altered by `subscribeReports()`. Each altered group is sent as
+ * one command; a group which was not changed is not re-sent. No other 
+ * receiver settings are shadowed.
+ * 
+ * @param block Whether to wait for a confirmation from the receiver that the 
+ * settings have taken effect.
+ * @return `true` if the settings were sent successfully, `false` if an I/O 
+ * problem occurred, or if `block` and the receiver did not confirm them 
+ * within `CPN_CONFIG_TIMEOUT_MS`.
+ */
+bool CopernicusGPS::commitConfig(bool block) {
+    m_cfg_hold = false;
     
-    if (block) {
-        waitForPacket(RPT_IO_SETTINGS);
-        flushToNextPacket();
+    if (m_io_dirty) {
+        beginCommand(CMD_IO_OPTIONS);
+        writeDataBytes(m_io_options, 4);
+        endCommand();
+        m_io_dirty = false;
+        
+        // the receiver echoes its new settings, which
+        // will replace our shadow copy.
+        if (block and not waitForIOSettings()) return false;
+    }
+    
+    if (m_bcast_dirty) {
+        uint8_t bytes[4] = { 
+            SPKT_BCAST_MASK, 
+            (uint8_t)(m_bcast_mask >> 8), 
+            (uint8_t)(m_bcast_mask & 0xFF),
+            0x00 };
+        beginCommand(CMD_SUPERPACKET);
+        writeDataBytes(bytes, 4);
+        endCommand();
+        m_bcast_dirty = false;
+        
+        if (block and not waitForBcastMask()) return false;
     }
     
     return true;
 }
 
+/**
+ * Choose which auto-reports the receiver should send, and program the 
+ * receiver accordingly. Reports which are not subscribed to are turned off
+ * at the receiver where the TSIP protocol allows it, and are otherwise 
+ * discarded without being decoded.
+ * 
+ * Position and velocity reports are selected individually using the IO 
+ * options command (0x35). Superpackets are selected with the broadcast mask 
+ * command (0x8E-A5). The receiver sends every position report in the same
+ * precision, so if both a 32- and 64-bit position format are subscribed, 
+ * only 64-bit formats are sent, and the subscription is changed to match
+ * (see `getSubscribedReports()`). The remaining
+ * auto-reports (time, health, and status) can only be enabled or disabled 
+ * together with the broadcast mask command (0x8E-A5); they will be sent if any 
+ * auto-report is subscribed.
+ * 
+ * The receiver's current broadcast mask is read first, if it has not been 
+ * seen yet, so that its other settings are kept.
+ * 
+ * The receiver's output protocol is not changed, so NMEA sentences are not
+ * turned on or off here; but they are decoded only while `RPTFLAG_NMEA` is 
+ * subscribed. A subscription without it turns NMEA decoding off: sentences
+ * are still framed and returned by `processOnePacket()`, but neither checked
+ * nor decoded.
+ * 
+ * By default, all reports are subscribed. If called between `beginConfig()` and 
+ * `commitConfig()`, the new settings are sent with the other pending changes.
+ * 
+ * Example:
+ *      
+ *      // we only want 32-bit positions and GPS time:
+ *      gps.subscribeReports(RPTFLAG_FIX_POS_LLA_32 | RPTFLAG_GPSTIME);
+ * 
+ * @param reports Set of `ReportFlag` bits for each desired report.
+ * @param block Whether to wait for a confirmation from the receiver that the 
+ * settings have taken effect.
+ * @return `true` if the settings were sent successfully, `false` if an I/O 
+ * problem occurred.
+ */
+bool CopernicusGPS::subscribeReports(ReportSet reports, bool block) {
+    if (not m_io_valid and not requestIOOptions()) return false;
+    if (not m_bcast_valid and not requestBcastMask()) return false;
+    
+    uint8_t pos = 0;
+    uint8_t vel = 0;
+    if (reports & (RPTFLAG_FIX_POS_LLA_32 | RPTFLAG_FIX_POS_LLA_64)) pos |= 0x02;
+    if (reports & (RPTFLAG_FIX_POS_XYZ_32 | RPTFLAG_FIX_POS_XYZ_64)) pos |= 0x01;
+    if (reports & (RPTFLAG_FIX_POS_LLA_64 | RPTFLAG_FIX_POS_XYZ_64)) pos |= 0x10;
+    if (reports & RPTFLAG_FIX_VEL_XYZ) vel |= 0x01;
+    if (reports & RPTFLAG_FIX_VEL_ENU) vel |= 0x02;
+    
+    // a group is only re-sent if it has changed.
+    uint8_t io0 = (m_io_options[0] & ~0x13) | pos;
+    uint8_t io1 = (m_io_options[1] & ~0x03) | vel;
+    if (io0 != m_io_options[0] or io1 != m_io_options[1]) m_io_dirty = true;
+    m_io_options[0] = io0;
+    m_io_options[1] = io1;
+    m_subscribed = (reports & ~(RPTFLAG_FIX_POS | RPTFLAG_FIX_VEL)) | ioReports();
+    
+    uint16_t mask = m_bcast_mask & ~(BCAST_AUTO_REPORTS | BCAST_SPKT_FIX |
+                                     BCAST_SPKT_TIMING  | BCAST_SPKT_TIMING_SUPPL);
+    if (reports & RPTFLAG_AUTO)        mask |= BCAST_AUTO_REPORTS;
+    if (reports & RPTFLAG_SPKT_FIX)    mask |= BCAST_SPKT_FIX;
+    if (reports & RPTFLAG_SPKT_TIMING) mask |= BCAST_SPKT_TIMING | BCAST_SPKT_TIMING_SUPPL;
+    if (mask != m_bcast_mask) m_bcast_dirty = true;
+    m_bcast_mask = mask;
+    
+    if (m_cfg_hold) return true;
+    return commitConfig(block);
+}
+
+/**
+ * Discard the shadow copy of the receiver's configuration, so that it will be 
+ * re-read from the receiver before it is next altered. This should be called 
+ * if the receiver may have been reset or reconfigured by another party.
+ */
+void CopernicusGPS::invalidateConfig() {
+    m_io_valid    = false;
+    m_io_dirty    = false;
+    m_bcast_valid = false;
+    m_bcast_dirty = false;
+}
+
+/**
+ * Switch the receiver between superpacket output and the individual position,
+ * velocity, and time reports. 
+ * 
+ * Superpackets deliver an entire epoch of position, velocity, time, and 
+ * status in one packet, using fewer bytes on the wire than the equivalent 
+ * individual reports. Decoded superpackets update the position fix, velocity
+ * fix, GPS time, and status together, and are reported by `processOnePacket()` 
+ * as `RPT_SUPERPACKET`; use `getSuperpacketID()` to tell them apart.
+ * 
+ * Enabling superpackets will turn off the individual position, velocity, and 
+ * time reports; disabling them will turn those reports back on, in the 
+ * formats which were in use before superpackets were enabled (or 32-bit 
+ * LLA / ENU if there were none). Other subscriptions are unchanged.
+ * 
+ * @param enable Whether to use superpacket output.
+ * @param block Whether to wait for a confirmation from the receiver that the 
+ * settings have taken effect.
+ * @return `true` if the settings were sent successfully, `false` if an I/O 
+ * problem occurred.
+ */
+bool CopernicusGPS::setSuperpacketOutput(bool enable, bool block) {
+    if (not m_io_valid and not requestIOOptions()) return false;
+    
+    ReportSet fixes = RPTFLAG_FIX_POS | RPTFLAG_FIX_VEL | RPTFLAG_GPSTIME;
+    ReportSet reports = m_subscribed;
+    if (enable) {
+        // remember the fix formats the receiver is currently sending.
+        ReportSet saved = ioReports();
+        if (saved != 0) m_saved_fixes = saved | RPTFLAG_GPSTIME;
+        reports = (reports & ~fixes) | RPTFLAG_SPKT;
+    } else {
+        reports = (reports & ~RPTFLAG_SPKT) | m_saved_fixes;
+    }
+    return subscribeReports(reports, block);
+}
+
+#if CPN_ENABLE_SATELLITES
+/**
+ * Request a satellite tracking status report (0x5C) for one satellite, or 
+ * for all satellites. The replies will update the table returned by 
+ * `getSatellites()` as they are processed.
+ * 
+ * @param prn PRN of the satellite to report, or 0 for all satellites.
+ */
+void CopernicusGPS::requestSatelliteStatus(uint8_t prn) {
+    beginCommand(CMD_SAT_TRACKING);
+    writeDataBytes(&prn, 1);
+    endCommand();
+}
+#endif
+
+// query the receiver for its current IO settings and 
+// wait for the reply, which will populate the shadow copy.
+bool CopernicusGPS::requestIOOptions() {
+    beginCommand(CMD_IO_OPTIONS);
+    endCommand();
+    return waitForIOSettings();
+}
+
+// the settings are reported in an 0x55 report; other packets may arrive
+// first, so process until it's seen, or until CPN_CONFIG_TIMEOUT_MS passes.
+bool CopernicusGPS::waitForIOSettings() {
+    uint32_t t0 = millis();
+    while (true) {
+        if (millis() - t0 >= CPN_CONFIG_TIMEOUT_MS) return false;
+        ReportType rpt = implProcessOnePacket(false, RPT_IO_SETTINGS);
+        if (rpt == RPT_IO_SETTINGS) return process_io_settings();
+        if (rpt == RPT_ERROR) return false;
+    }
+}
+
+// query the receiver for its packet broadcast mask and wait for the
+// reply, which will populate the shadow copy.
+bool CopernicusGPS::requestBcastMask() {
+    uint8_t id = SPKT_BCAST_MASK;
+    beginCommand(CMD_SUPERPACKET);
+    writeDataBytes(&id, 1);
+    endCommand();
+    return waitForBcastMask();
+}
+
+// the mask is reported in an 0x8F superpacket; other packets may arrive
+// first, so process until it's seen, or until CPN_CONFIG_TIMEOUT_MS passes.
+bool CopernicusGPS::waitForBcastMask() {
+    m_bcast_valid = false;
+    uint32_t t0 = millis();
+    while (not m_bcast_valid) {
+        if (millis() - t0 >= CPN_CONFIG_TIMEOUT_MS) return false;
+        if (processOnePacket(false) == RPT_ERROR) return false;
+    }
+    return true;
+}
+
+// the position and velocity reports selected by the shadow IO options.
+ReportSet CopernicusGPS::ioReports() const {
+    ReportSet r = 0;
+    bool dbl = (m_io_options[0] & 0x10) != 0;
+    if (m_io_options[0] & 0x01) r |= dbl ? RPTFLAG_FIX_POS_XYZ_64 : RPTFLAG_FIX_POS_XYZ_32;
+    if (m_io_options[0] & 0x02) r |= dbl ? RPTFLAG_FIX_POS_LLA_64 : RPTFLAG_FIX_POS_LLA_32;
+    if (m_io_options[1] & 0x01) r |= RPTFLAG_FIX_VEL_XYZ;
+    if (m_io_options[1] & 0x02) r |= RPTFLAG_FIX_VEL_ENU;
+    return r;
+}
+
 /***********************
  * Report processing   *
  ***********************/
@@ -289,6 +846,25 @@ bool CopernicusGPS::setFixMode(ReportType pos_fixmode,
 // case the stream will be left with only the header consumed, ready for
 // the caller to process. Pass RPT_NONE to always consume.
 ReportType CopernicusGPS::implProcessOnePacket(bool block, ReportType haltAt) {
+    m_replay_pos = -1;
+    // a packet begun by poll() is finished first. if there is a poll buffer,
+    // every packet is framed into it, which also finds NMEA sentences.
+    while (m_poll_state != POLL_READY and 
+            (m_poll_state != POLL_SEEK or m_frame != NULL)) {
+        if (m_serial->available() <= 0) {
+            if (block) blockForData();
+            else return RPT_NONE;
+        }
+        pollByte(m_serial->read());
+    }
+    if (m_poll_state == POLL_READY) {
+        ReportType rpt = beginFrame();
+        if (rpt == RPT_ERROR) return rpt;
+        if (rpt == haltAt and haltAt != RPT_NONE) return rpt;
+        bool ok = processReport(rpt);
+        m_replay_pos = -1;
+        return ok ? rpt : RPT_ERROR;
+    }
     // packets are of the form:
     //   <DLE> <rpt-id> <data bytes ...> <DLE> <ETX>
     //   literal <DLE> bytes embedded in data are sent as <DLE> <DLE>.
@@ -316,6 +892,9 @@ ReportType CopernicusGPS::implProcessOnePacket(bool block, ReportType haltAt) {
             continue;
         } else {
             ReportType rpt = static_cast<ReportType>(b);
+            m_capture_len  = 0;
+            m_capture_done = false;
+            capture(b);
             if (rpt == haltAt and haltAt != RPT_NONE) return rpt;
             else if (not processReport(rpt)) return RPT_ERROR;
             else return rpt;
@@ -324,44 +903,101 @@ ReportType CopernicusGPS::implProcessOnePacket(bool block, ReportType haltAt) {
 }
 
 bool CopernicusGPS::processReport(ReportType type) {
+    ReportSet flag = reportFlag(type);
+    if (flag != 0 and (m_subscribed & flag) == 0) {
+        // nobody wants this report; don't bother decoding it.
+        flushToNextPacket(false);
+        return true;
+    }
+    
     bool ok = true;
     switch (type) {
+#if CPN_ENABLE_FIX_POS_LLA_32
         case RPT_FIX_POS_LLA_32:
             ok = process_p_LLA_32(); break;
+#endif
+#if CPN_ENABLE_FIX_POS_LLA_64
         case RPT_FIX_POS_LLA_64:
             ok = process_p_LLA_64(); break;
+#endif
+#if CPN_ENABLE_FIX_POS_XYZ_32
         case RPT_FIX_POS_XYZ_32:
             ok = process_p_XYZ_32(); break;
+#endif
+#if CPN_ENABLE_FIX_POS_XYZ_64
         case RPT_FIX_POS_XYZ_64:
             ok = process_p_XYZ_64(); break;
+#endif
+#if CPN_ENABLE_FIX_VEL_XYZ
         case RPT_FIX_VEL_XYZ:
             ok = process_v_XYZ(); break;
+#endif
+#if CPN_ENABLE_FIX_VEL_ENU
         case RPT_FIX_VEL_ENU:
             ok = process_v_ENU(); break;
+#endif
+#if CPN_ENABLE_GPSTIME
         case RPT_GPSTIME:
             ok = process_GPSTime(); break;
+#endif
+#if CPN_ENABLE_STATUS
         case RPT_HEALTH:
             ok = process_health(); break;
         case RPT_ADDL_STATUS:
             ok = process_addl_status(); break;
+        case RPT_SBAS_MODE:
+            ok = process_sbas_status(); break;
+#endif
+#if CPN_ENABLE_SATELLITES
+        case RPT_SATELLITES:
+            ok = process_satellites(); break;
+        case RPT_SAT_TRACKING:
+            ok = process_sat_tracking(); break;
+#endif
+        case RPT_IO_SETTINGS:
+            ok = process_io_settings(); break;
+        case RPT_SUPERPACKET:
+            ok = process_superpacket(); break;
+#if CPN_ENABLE_NMEA
+        case RPT_NMEA:
+        case RPT_NMEA_GGA:
+        case RPT_NMEA_RMC:
+        case RPT_NMEA_VTG:
+        case RPT_NMEA_GSA:
+        case RPT_NMEA_GSV:
+        case RPT_NMEA_ZDA:
+            ok = process_nmea(type); break;
+#endif
         default:
-            // give the user's packet processors a swipe
-            PacketStatus st = PKT_IGNORE;
-            for (int i = 0; i < m_n_listeners; i++) {
-                st = m_listeners[i]->gpsPacket(type, this);
-                if (st != PKT_IGNORE) {
-                    ok = (st != PKT_ERROR);
-                    break;
-                }
-            } 
-            if (st != PKT_CONSUMED) {
-                // consume the rest of this packet.
-                flushToNextPacket(false);
-            }
+            ok = notifyListeners(type);
     }
     return ok;
 }
 
+// give the user's packet processors a swipe at a packet
+// whose header has been consumed.
+bool CopernicusGPS::notifyListeners(ReportType type) {
+    bool ok = true;
+    PacketStatus st = PKT_IGNORE;
+#if MAX_PKT_PROCESSORS > 0
+    for (int i = 0; i < m_n_listeners; i++) {
+        st = m_listeners[i]->gpsPacket(type, this);
+        if (st != PKT_IGNORE) {
+            ok = (st != PKT_ERROR);
+            break;
+        }
+    } 
+#else
+    (void)type;
+#endif
+    if (st != PKT_CONSUMED) {
+        // consume the rest of this packet.
+        flushToNextPacket(false);
+    }
+    return ok;
+}
+
+#if CPN_ENABLE_FIX_POS_LLA_32
 bool CopernicusGPS::process_p_LLA_32() {
     m_pfix.type = RPT_FIX_POS_LLA_32;
     LLA_Fix<Float32> *fix = &m_pfix.lla_32;
@@ -377,7 +1013,9 @@ bool CopernicusGPS::process_p_LLA_32() {
     if (not ok) m_vfix.type = RPT_ERROR;
     return ok;
 }
+#endif
 
+#if CPN_ENABLE_FIX_POS_LLA_64
 bool CopernicusGPS::process_p_LLA_64() {
     m_pfix.type = RPT_FIX_POS_LLA_64;
     LLA_Fix<Float64> *fix = &m_pfix.lla_64;
@@ -393,7 +1031,9 @@ bool CopernicusGPS::process_p_LLA_64() {
     if (not ok) m_vfix.type = RPT_ERROR;
     return ok;
 }
+#endif
 
+#if CPN_ENABLE_FIX_POS_XYZ_32
 bool CopernicusGPS::process_p_XYZ_32() {
     m_pfix.type = RPT_FIX_POS_XYZ_32;
     XYZ_Fix<Float32> *fix = &m_pfix.xyz_32;
@@ -409,7 +1049,9 @@ bool CopernicusGPS::process_p_XYZ_32() {
     if (not ok) m_pfix.type = RPT_ERROR;
     return ok;
 }
+#endif
 
+#if CPN_ENABLE_FIX_POS_XYZ_64
 bool CopernicusGPS::process_p_XYZ_64() {
     m_pfix.type = RPT_FIX_POS_XYZ_64;
     XYZ_Fix<Float64> *fix = &m_pfix.xyz_64;
@@ -425,7 +1067,9 @@ bool CopernicusGPS::process_p_XYZ_64() {
     if (not ok) m_pfix.type = RPT_ERROR;
     return ok;
 }
+#endif
 
+#if CPN_ENABLE_FIX_VEL_XYZ
 bool CopernicusGPS::process_v_XYZ() {
     m_vfix.type = RPT_FIX_VEL_XYZ;
     XYZ_VFix *fix = &m_vfix.xyz;
@@ -441,7 +1085,9 @@ bool CopernicusGPS::process_v_XYZ() {
     if (not ok) m_vfix.type = RPT_ERROR;
     return ok;
 }
+#endif
 
+#if CPN_ENABLE_FIX_VEL_ENU
 bool CopernicusGPS::process_v_ENU() {
     m_vfix.type = RPT_FIX_VEL_ENU;
     ENU_VFix *fix = &m_vfix.enu;
@@ -457,7 +1103,9 @@ bool CopernicusGPS::process_v_ENU() {
     if (not ok) m_vfix.type = RPT_ERROR;
     return ok;
 }
+#endif
 
+#if CPN_ENABLE_GPSTIME
 bool CopernicusGPS::process_GPSTime() {
     uint8_t buf[4];
     
@@ -469,39 +1117,444 @@ bool CopernicusGPS::process_GPSTime() {
     if (not ok)  m_time.time_of_week.bits = 0xBF800000; // -1
     return ok;
 }
+#endif
+
+#if CPN_ENABLE_STATUS
+// status reports are repeated constantly, and rarely change; they are
+// decoded only if their payload differs from the last one received.
 
 bool CopernicusGPS::process_health() {
     uint8_t buf[2];
     if (readDataBytes(buf, 2) != 2) return false;
-    m_status.health = static_cast<GPSHealth>(buf[0]);
-    
     bool ok = endReport();
-    if (not ok) m_status.health = HLTH_UNKNOWN;
+    if (ok and not statusDiffers(RPTFLAG_HEALTH, m_raw_health, buf, 2)) return true;
+    
+    GPSStatus old = m_status;
+    if (ok) {
+        m_status.health = static_cast<GPSHealth>(buf[0]);
+    } else {
+        m_raw_valid &= ~RPTFLAG_HEALTH;
+        m_status.health = HLTH_UNKNOWN;
+    }
+    statusChanged(old);
     return ok;
 }
 
 bool CopernicusGPS::process_addl_status() {
     uint8_t buf[3];
-    if (readDataBytes(buf, 3) != 3) return false;
+    if (readDataBytes(buf, 3) != 3 or not endReport()) return false;
+    if (not statusDiffers(RPTFLAG_ADDL_STATUS, m_raw_addl_status, buf, 3)) return true;
+    
+    GPSStatus old = m_status;
     m_status.rtclock_unavailable = (buf[1] & 0x02) != 0;
     m_status.almanac_incomplete  = (buf[1] & 0x08) != 0;
-    
-    return endReport();
+    statusChanged(old);
+    return true;
 }
 
 bool CopernicusGPS::process_sbas_status() {
     uint8_t buf;
-    if (readDataBytes(&buf, 1) != 1) return false;
+    if (readDataBytes(&buf, 1) != 1 or not endReport()) return false;
+    if (not statusDiffers(RPTFLAG_SBAS_MODE, &m_raw_sbas, &buf, 1)) return true;
+    
+    GPSStatus old = m_status;
     m_status.sbas_corrected = (buf & 0x01) != 0;
     m_status.sbas_enabled   = (buf & 0x02) != 0;
+    statusChanged(old);
+    return true;
+}
+
+// compare a status payload with the last of its kind, and keep it.
+// true if it differs, or is the first.
+bool CopernicusGPS::statusDiffers(ReportFlag flag, uint8_t *last, 
+                                  const uint8_t *buf, int n) {
+    if ((m_raw_valid & flag) and memcmp(last, buf, n) == 0) return false;
+    memcpy(last, buf, n);
+    m_raw_valid |= flag;
+    return true;
+}
+
+// record the fields changed since `old`, and notify the listener.
+void CopernicusGPS::statusChanged(const GPSStatus &old) {
+    StatusSet changes = 0;
+    if (m_status.health != old.health)                           changes |= STATUS_HEALTH;
+    if (m_status.almanac_incomplete != old.almanac_incomplete)   changes |= STATUS_ALMANAC;
+    if (m_status.rtclock_unavailable != old.rtclock_unavailable) changes |= STATUS_RTCLOCK;
+    if (m_status.sbas_enabled != old.sbas_enabled)               changes |= STATUS_SBAS_ENABLED;
+    if (m_status.sbas_corrected != old.sbas_corrected)           changes |= STATUS_SBAS_CORRECTED;
+    if (m_status.leap_pending != old.leap_pending)               changes |= STATUS_LEAP;
+    if (changes == 0) return;
+    m_status_changes |= changes;
+    if (m_status_listener != NULL) {
+        m_status_listener->statusChanged(old, m_status, changes);
+    }
+}
+#endif
+
+#if CPN_ENABLE_SATELLITES
+// round to the nearest integer, halves away from zero.
+static inline long round_to_int(float x) {
+    return (long)(x < 0 ? x - 0.5f : x + 0.5f);
+}
+
+bool CopernicusGPS::process_satellites() {
+    uint8_t buf[16];
+    if (readDataBytes(buf, 1) != 1) return false;
+    uint8_t dim   = buf[0] & 0x07;
+    uint8_t n_svs = buf[0] >> 4;
+    
+    Float32 dops[4];
+    for (int i = 0; i < 4; i++) {
+        SAVE_BYTES(&dops[i].bits, buf, 4);
+    }
+    if (readDataBytes(buf, n_svs) != n_svs) return false;
+    if (not endReport()) return false;
+    
+    uint32_t in_use = 0;
+    for (int i = 0; i < n_svs; i++) {
+        // some firmware reports unused SVs with negative PRNs.
+        int prn = static_cast<int8_t>(buf[i]);
+        if (prn >= 1 and prn <= MAX_SATELLITES) in_use |= (uint32_t)1 << (prn - 1);
+    }
     
-    return endReport();
+    SatelliteView &sv = m_sats;
+    if (dim != sv.fix_dim or 
+            dops[0].bits != sv.pdop.bits or dops[1].bits != sv.hdop.bits or
+            dops[2].bits != sv.vdop.bits or dops[3].bits != sv.tdop.bits) {
+        sv.fix_dim = dim;
+        sv.pdop = dops[0];
+        sv.hdop = dops[1];
+        sv.vdop = dops[2];
+        sv.tdop = dops[3];
+        sv.dops_dirty = true;
+    }
+    sv.dirty |= sv.in_use ^ in_use;
+    sv.in_use = in_use;
+    m_status.n_satellites = n_svs;
+    return true;
+}
+
+bool CopernicusGPS::process_sat_tracking() {
+    uint8_t buf[24];
+    if (readDataBytes(buf, 24) != 24) return false;
+    if (not endReport()) return false;
+    
+    int prn = buf[0];
+    if (prn < 1 or prn > MAX_SATELLITES) return true; // not a GPS SV; ignore
+    int i = prn - 1;
+    uint32_t bit = (uint32_t)1 << i;
+    
+    Float32 level, elev, azim;
+    copy_network_order(&level, buf + 4);
+    copy_network_order(&elev,  buf + 12);
+    copy_network_order(&azim,  buf + 16);
+    
+    long snr = round_to_int(level.f);
+    long el  = round_to_int(elev.f * RAD_TO_DEG_F);
+    long az  = round_to_int(azim.f * RAD_TO_DEG_F);
+    if (snr < 0) snr = 0; else if (snr > 255) snr = 255;
+    if (az < 0) az += 360;
+    uint32_t tracked = (buf[2] != 0) ? bit : 0; // acquisition flag
+    
+    SatelliteView &sv = m_sats;
+    if (sv.snr[i] != snr or sv.elevation[i] != el or sv.azimuth[i] != az or
+            (sv.tracked & bit) != tracked) {
+        sv.snr[i]       = snr;
+        sv.elevation[i] = el;
+        sv.azimuth[i]   = az;
+        sv.tracked = (sv.tracked & ~bit) | tracked;
+        sv.dirty  |= bit;
+    }
+    return true;
+}
+#endif
+
+bool CopernicusGPS::process_io_settings() {
+    uint8_t buf[4];
+    if (readDataBytes(buf, 4) != 4 or not endReport()) {
+        m_io_valid = false;
+        return false;
+    }
+    // don't clobber changes which haven't been sent yet. the receiver's
+    // formats are the ones which will be decoded.
+    if (not m_io_dirty) {
+        memcpy(m_io_options, buf, 4);
+        m_io_valid = true;
+        m_subscribed = (m_subscribed & ~(RPTFLAG_FIX_POS | RPTFLAG_FIX_VEL)) | ioReports();
+    }
+    return true;
+}
+
+bool CopernicusGPS::process_superpacket() {
+    // peek at the sub-ID, so that unhandled superpackets can be
+    // passed on to listeners with only the header consumed.
+    int id;
+    if (m_replay_pos >= 0) {
+        id = (m_replay_pos < m_frame_len) ? m_frame[m_replay_pos] : -1;
+    } else {
+        blockForData();
+        id = m_serial->peek();
+    }
+    ReportSet flag = 0;
+    switch (id) {
+#if CPN_ENABLE_SUPERPACKETS
+        case SPKT_FIX:          flag = RPTFLAG_SPKT_FIX; break;
+        case SPKT_TIMING:       // fallthrough
+        case SPKT_TIMING_SUPPL: flag = RPTFLAG_SPKT_TIMING; break;
+#endif
+        case SPKT_BCAST_MASK:   break;
+        default:
+            return notifyListeners(RPT_SUPERPACKET);
+    }
+    capture(id);
+    if (m_replay_pos >= 0) m_replay_pos++;
+    else m_serial->read();
+    m_spkt_id = static_cast<SuperpacketID>(id);
+    if (flag != 0 and (m_subscribed & flag) == 0) {
+        flushToNextPacket(false);
+        return true;
+    }
+    switch (id) {
+#if CPN_ENABLE_SUPERPACKETS
+        case SPKT_FIX:          return process_spkt_fix();
+        case SPKT_TIMING:       return process_spkt_timing();
+        case SPKT_TIMING_SUPPL: return process_spkt_timing_suppl();
+#endif
+        default:                return process_bcast_mask();
+    }
+}
+
+#if CPN_ENABLE_SUPERPACKETS
+// 0x8F-20: last fix with extra information. Position and velocity
+// are sent in fixed point; all fields are applied together, and only
+// if the whole packet arrived intact.
+bool CopernicusGPS::process_spkt_fix() {
+    uint8_t buf[SPKT_FIX_LEN];
+    if (readDataBytes(buf, SPKT_FIX_LEN) != SPKT_FIX_LEN) return false;
+    if (not endReport()) return false;
+    
+    int16_t  v_e, v_n, v_u, week;
+    uint32_t tow_ms, lng;
+    int32_t  lat, alt;
+    copy_network_order(&v_e,    buf + 1);
+    copy_network_order(&v_n,    buf + 3);
+    copy_network_order(&v_u,    buf + 5);
+    copy_network_order(&tow_ms, buf + 7);
+    copy_network_order(&lat,    buf + 11);
+    copy_network_order(&lng,    buf + 15);
+    copy_network_order(&alt,    buf + 19);
+    copy_network_order(&week,   buf + 29);
+    uint8_t vscale = buf[23];
+    uint8_t flags  = buf[26];
+    uint8_t n_svs  = buf[27];
+    int8_t  utc    = static_cast<int8_t>(buf[28]);
+    
+    bool  valid   = (flags & 0x01) == 0;
+    float fixtime = valid ? tow_ms / 1000.0 : -1;
+    // lat/lng are in units of 2^-31 semicircles. 
+    // longitude is unsigned, i.e. in [0, 2pi).
+    const double semicircle = GPS_PI / 2147483648.0;
+    
+    PosFix pfix;
+#if CPN_SPKT_LLA_64
+    pfix.type = RPT_FIX_POS_LLA_64;
+    pfix.lla_64.lat.d  = lat * semicircle;
+    pfix.lla_64.lng.d  = lng * semicircle;
+    pfix.lla_64.alt.d  = alt / 1000.0;
+    pfix.lla_64.bias.d = 0;
+    pfix.lla_64.fixtime.f = fixtime;
+#else
+    pfix.type = RPT_FIX_POS_LLA_32;
+    pfix.lla_32.lat.f  = lat * semicircle;
+    pfix.lla_32.lng.f  = lng * semicircle;
+    pfix.lla_32.alt.f  = alt / 1000.0;
+    pfix.lla_32.bias.f = 0;
+    pfix.lla_32.fixtime.f = fixtime;
+#endif
+    
+    // velocities are in units of 5 mm/s, or 20 mm/s if scaled.
+    const float vunit = (vscale & 0x01) ? 0.020 : 0.005;
+    VelFix vfix;
+    vfix.type = RPT_FIX_VEL_ENU;
+    vfix.enu.e.f = v_e * vunit;
+    vfix.enu.n.f = v_n * vunit;
+    vfix.enu.u.f = v_u * vunit;
+    vfix.enu.bias.f = 0;
+    vfix.enu.fixtime.f = fixtime;
+    
+    m_pfix = pfix;
+    m_vfix = vfix;
+    m_time.time_of_week.f = tow_ms / 1000.0;
+    m_time.week_no        = week;
+    m_time.utc_offs.f     = utc;
+    
+#if CPN_ENABLE_STATUS
+    GPSStatus old = m_status;
+#endif
+    m_status.n_satellites = n_svs;
+    // an invalid fix with enough satellites says nothing more specific than
+    // the last health report did; keep that.
+    if (valid) {
+        m_status.health = HLTH_DOING_FIXES;
+    } else if (n_svs < 4) {
+        m_status.health = static_cast<GPSHealth>(HLTH_SATELLITES_NONE + n_svs);
+    }
+#if CPN_ENABLE_STATUS
+    // the next 0x46 must be decoded, even if unchanged since the last.
+    if (m_status.health != old.health) m_raw_valid &= ~RPTFLAG_HEALTH;
+    statusChanged(old);
+#endif
+    return true;
+}
+
+// 0x8F-AB: primary timing packet.
+bool CopernicusGPS::process_spkt_timing() {
+    uint8_t buf[SPKT_TIMING_LEN];
+    if (readDataBytes(buf, SPKT_TIMING_LEN) != SPKT_TIMING_LEN) return false;
+    if (not endReport()) return false;
+    
+    uint32_t tow;
+    int16_t  week, utc;
+    copy_network_order(&tow,  buf + 0);
+    copy_network_order(&week, buf + 4);
+    copy_network_order(&utc,  buf + 6);
+    
+    m_time.time_of_week.f = tow;
+    m_time.week_no        = week;
+    m_time.utc_offs.f     = utc;
+    return true;
+}
+
+// 0x8F-AC: supplemental timing packet. Carries the receiver status
+// and the (double precision) position of the timing solution.
+bool CopernicusGPS::process_spkt_timing_suppl() {
+    uint8_t buf[SPKT_TIMING_SUPPL_LEN];
+    if (readDataBytes(buf, SPKT_TIMING_SUPPL_LEN) != SPKT_TIMING_SUPPL_LEN) return false;
+    if (not endReport()) return false;
+    
+    uint16_t minor_alarms;
+    copy_network_order(&minor_alarms, buf + 9);
+    uint8_t decode_status = buf[11];
+    
+#if CPN_HAVE_LLA_64
+    PosFix pfix;
+    pfix.type = RPT_FIX_POS_LLA_64;
+    copy_network_order(&pfix.lla_64.lat, buf + 35);
+    copy_network_order(&pfix.lla_64.lng, buf + 43);
+    copy_network_order(&pfix.lla_64.alt, buf + 51);
+    pfix.lla_64.bias.bits = 0;
+    // the position is that of the preceding 0x8F-AB time report.
+    pfix.lla_64.fixtime = m_time.time_of_week;
+    if (decode_status != HLTH_DOING_FIXES) {
+        pfix.lla_64.fixtime.bits = 0xBF800000; // -1
+    }
+    
+    m_pfix = pfix;
+#endif
+#if CPN_ENABLE_STATUS
+    GPSStatus old = m_status;
+#endif
+    // decoding status codes coincide with those of the health report.
+    m_status.health = static_cast<GPSHealth>(decode_status);
+    m_status.almanac_incomplete = (minor_alarms & 0x0800) != 0;
+    m_status.leap_pending       = (minor_alarms & 0x0080) != 0;
+#if CPN_ENABLE_STATUS
+    m_raw_valid &= ~(RPTFLAG_HEALTH | RPTFLAG_ADDL_STATUS);
+    statusChanged(old);
+#endif
+    return true;
+}
+#endif
+
+bool CopernicusGPS::process_bcast_mask() {
+    uint8_t buf[2];
+    uint16_t mask;
+    SAVE_BYTES(&mask, buf, 2);
+    if (not flushToNextPacket()) return false; // mask 1 is reserved
+    if (not m_bcast_dirty) {
+        m_bcast_mask  = mask;
+        m_bcast_valid = true;
+    }
+    return true;
 }
 
 /***************************
  * access                  *
  ***************************/
 
+/**
+ * Get the set of auto-reports which have been subscribed to with 
+ * `subscribeReports()`. The position and velocity reports are those the 
+ * receiver has been programmed to send, which may differ from those asked
+ * for (see `subscribeReports()`), and follow any change made with 
+ * `setFixMode()`.
+ */
+ReportSet CopernicusGPS::getSubscribedReports() const {
+    return m_subscribed;
+}
+
+/**
+ * Capture the data of each incoming packet into the given buffer, for 
+ * forwarding or logging. Captured packets have their framing and escape 
+ * sequences removed; the first byte is the report ID. NMEA sentences are 
+ * captured from after the `$` up to the line ending. Packets longer than 
+ * `capacity` bytes are not captured. Pass `NULL` to stop capturing.
+ * 
+ * Bytes which a `GPSPacketProcessor` reads directly from `getSerial()`, 
+ * rather than with `readDataBytes()`, are not captured.
+ * 
+ * @param buf Buffer to hold the captured packet.
+ * @param capacity Size of `buf`.
+ */
+void CopernicusGPS::setPacketCapture(uint8_t *buf, int capacity) {
+    m_capture      = buf;
+    m_capture_cap  = (buf == NULL) ? 0 : capacity;
+    m_capture_len  = 0;
+    m_capture_done = false;
+}
+
+/**
+ * Get the most recently captured packet. The capture is available after
+ * `processOnePacket()` returns, until the next call to it.
+ * 
+ * @param len Set to the length of the captured packet.
+ * @return The captured packet, or `NULL` if capturing is off, or the last 
+ * packet was too long or has not been completely consumed.
+ */
+const uint8_t* CopernicusGPS::getCapturedPacket(int *len) const {
+    if (m_capture == NULL or not m_capture_done or m_capture_len > m_capture_cap) {
+        *len = 0;
+        return NULL;
+    }
+    *len = m_capture_len;
+    return m_capture;
+}
+
+/**
+ * Get the sub-ID of the most recently processed superpacket. If 
+ * `processOnePacket()` returns `RPT_SUPERPACKET`, this indicates which data 
+ * were updated.
+ */
+SuperpacketID CopernicusGPS::getSuperpacketID() const {
+    return m_spkt_id;
+}
+
+/**
+ * Get the longest time taken by any call to `poll()`, in microseconds.
+ */
+uint32_t CopernicusGPS::getWorstPollTime() const {
+    return m_poll_wcet;
+}
+
+/**
+ * Get the longest time taken by `poll()` to decode one packet, in
+ * microseconds. This is the most by which `poll()` may overrun its budget,
+ * apart from the time to read `POLL_CHECK_BYTES` bytes.
+ */
+uint32_t CopernicusGPS::getWorstDecodeTime() const {
+    return m_decode_wcet;
+}
+
 /**
  * Get the monitored Serial IO object.
  */
@@ -517,6 +1570,50 @@ const GPSStatus& CopernicusGPS::getStatus() const {
     return m_status;
 }
 
+#if CPN_ENABLE_STATUS
+/**
+ * Get the fields of the status which have changed since the last call to
+ * `clearStatusChanges()`, as a set of `StatusChange` bits.
+ */
+StatusSet CopernicusGPS::getStatusChanges() const {
+    return m_status_changes;
+}
+
+/**
+ * Clear the record of changes to the status; see `getStatusChanges()`.
+ */
+void CopernicusGPS::clearStatusChanges() {
+    m_status_changes = 0;
+}
+
+/**
+ * Set an object to be notified when the status of the receiver changes.
+ * 
+ * @param listener Listener to notify, or `NULL` for none.
+ */
+void CopernicusGPS::setStatusListener(GPSStatusListener *listener) {
+    m_status_listener = listener;
+}
+#endif
+
+#if CPN_ENABLE_SATELLITES
+/**
+ * Get the table of satellites in view of the receiver.
+ */
+const SatelliteView& CopernicusGPS::getSatellites() const {
+    return m_sats;
+}
+
+/**
+ * Clear the change flags in the table of satellites in view, i.e. 
+ * `getSatellites().dirty` and `getSatellites().dops_dirty`. 
+ */
+void CopernicusGPS::clearSatelliteChanges() {
+    m_sats.dirty      = 0;
+    m_sats.dops_dirty = false;
+}
+#endif
+
 /**
  * Get the most current position fix.
  */
@@ -546,12 +1643,17 @@ const GPSTime& CopernicusGPS::getGPSTime() const {
  * @return `false` if there was not enough space to add the processor, `true` otherwise.
  */
 bool CopernicusGPS::addPacketProcessor(GPSPacketProcessor *pcs) {
+#if MAX_PKT_PROCESSORS > 0
     for (int i = 0; i < m_n_listeners; i++) {
         if (m_listeners[i] == pcs) return true;
     }
     if (m_n_listeners >= MAX_PKT_PROCESSORS) return false;
     m_listeners[m_n_listeners++] = pcs;
     return true;
+#else
+    (void)pcs;
+    return false;
+#endif
 }
 
 /**
@@ -559,6 +1661,7 @@ bool CopernicusGPS::addPacketProcessor(GPSPacketProcessor *pcs) {
  * @param pcs Processor to remove.
  */
 void CopernicusGPS::removePacketProcessor(GPSPacketProcessor *pcs) {
+#if MAX_PKT_PROCESSORS > 0
     bool found = false;
     for (int i = 0; i < m_n_listeners; i++) {
         if (m_listeners[i] == pcs) {
@@ -571,10 +1674,16 @@ void CopernicusGPS::removePacketProcessor(GPSPacketProcessor *pcs) {
     if (found) {
         m_n_listeners = m_n_listeners - 1;
     }
+#else
+    (void)pcs;
+#endif
 }
 
 /****************************
  * gps listener             *
  ****************************/
 
-GPSPacketProcessor::~GPSPacketProcessor() {}
\ No newline at end of file
+GPSPacketProcessor::~GPSPacketProcessor() {}
+#if CPN_ENABLE_STATUS
+GPSStatusListener::~GPSStatusListener() {}
+#endif
\ No newline at end of file
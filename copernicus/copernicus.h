@@ -31,14 +31,30 @@
 
 // arduino doesn't support std::vector
 // so today we will be violating the zero/one/infinity rule.
+// may be defined as 0 to leave out packet processors entirely.
+#ifndef MAX_PKT_PROCESSORS
 #define MAX_PKT_PROCESSORS 8
+#endif
 
 #define TSIP_BAUD_RATE 38400
 
+// longest to wait for the receiver to report or echo its IO options or
+// broadcast mask, in ms.
+#ifndef CPN_CONFIG_TIMEOUT_MS
+#define CPN_CONFIG_TIMEOUT_MS 2000
+#endif
+
+// packet broadcast mask bits (cmd 0x8E-A5, mask 0)
+#define BCAST_SPKT_FIX       0x0001
+#define BCAST_SPKT_TIMING    0x0004
+#define BCAST_SPKT_TIMING_SUPPL 0x0008
+#define BCAST_AUTO_REPORTS   0x0040
+
 #include "gpstype.h"
 #include "Arduino.h"
 
 class CopernicusGPS; // fwd decl
+struct NMEAFields;    // fwd decl
 
 /***************************
  * Listener class          *
@@ -71,6 +87,71 @@ public:
     virtual PacketStatus gpsPacket(ReportType type, CopernicusGPS *gps) = 0;
 };
 
+#if CPN_ENABLE_STATUS
+/**
+ * @brief Class for receiving changes in the status of the receiver.
+ * 
+ * The receiver repeats its health (0x46), additional status (0x4B), and SBAS 
+ * (0x82) reports every few seconds, nearly always unchanged. Each report is 
+ * compared with the last of its kind as received, and is only decoded, and 
+ * the listener only notified, if it differs.
+ */
+class GPSStatusListener {
+public:
+    virtual ~GPSStatusListener();
+    
+    /**
+     * Called when a field of the receiver's status has changed.
+     * 
+     * Example:
+     * 
+     *      void statusChanged(const GPSStatus &old, const GPSStatus &status,
+     *                         StatusSet changes) {
+     *          if ((changes & STATUS_HEALTH) and status.health == HLTH_DOING_FIXES) {
+     *              // fix acquired
+     *          }
+     *          if ((changes & STATUS_ALMANAC) and not status.almanac_incomplete) {
+     *              // almanac complete
+     *          }
+     *      }
+     * 
+     * @param old Status before the change.
+     * @param status New status.
+     * @param changes Set of `StatusChange` bits for the fields which changed.
+     */
+    virtual void statusChanged(const GPSStatus &old, 
+                               const GPSStatus &status,
+                               StatusSet changes) = 0;
+};
+#endif
+
+/***************************
+ * polling                 *
+ ***************************/
+
+/// Bytes read between checks of the time budget of `CopernicusGPS::poll()`.
+#define POLL_CHECK_BYTES 8
+
+/**
+ * @brief Outcome of one call to `CopernicusGPS::poll()`.
+ */
+struct PollStatus {
+    /// Number of packets completed and processed.
+    uint16_t packets;
+    /// Number of those which could not be decoded, or were too long to buffer.
+    uint16_t errors;
+    /// `ReportFlag`s of the reports processed.
+    ReportSet reports;
+    /// Type of the last report processed, or `RPT_NONE`.
+    ReportType last;
+    /// Bytes read from the serial port.
+    int bytes;
+    /// Bytes still waiting in the serial port's buffer.
+    int backlog;
+    /// Whether a packet is in progress, to be continued by the next call.
+    bool partial;
+};
+
 /***************************
  * copernicus class        *
  ***************************/
@@ -93,6 +174,11 @@ public:
     ReportType processOnePacket(bool block=false);
     void waitForPacket(ReportType type);
     
+    void setPollBuffer(uint8_t *buf, int capacity);
+    PollStatus poll(int max_bytes, uint32_t max_micros=0);
+    uint32_t getWorstPollTime() const;
+    uint32_t getWorstDecodeTime() const;
+    
     void beginCommand(CommandID cmd);
     void writeDataBytes(const uint8_t *bytes, int n);
     int  readDataBytes(uint8_t *dst, int n);
@@ -105,11 +191,35 @@ public:
                     GPSTimeMode time=TME_NOCHANGE,
                     bool block=false);
     
+    void beginConfig();
+    bool commitConfig(bool block=false);
+    void invalidateConfig();
+    
+    bool subscribeReports(ReportSet reports, bool block=false);
+    ReportSet getSubscribedReports() const;
+    bool setSuperpacketOutput(bool enable, bool block=false);
+#if CPN_ENABLE_SATELLITES
+    void requestSatelliteStatus(uint8_t prn=0);
+#endif
+    SuperpacketID getSuperpacketID() const;
+    
     HardwareSerial  *getSerial();
     const PosFix&    getPositionFix() const;
     const VelFix&    getVelocityFix() const;
     const GPSTime&   getGPSTime() const;
     const GPSStatus& getStatus() const;
+#if CPN_ENABLE_STATUS
+    StatusSet getStatusChanges() const;
+    void clearStatusChanges();
+    void setStatusListener(GPSStatusListener *listener);
+#endif
+#if CPN_ENABLE_SATELLITES
+    const SatelliteView& getSatellites() const;
+    void clearSatelliteChanges();
+#endif
+    
+    void setPacketCapture(uint8_t *buf, int capacity);
+    const uint8_t* getCapturedPacket(int *len) const;
     
     bool addPacketProcessor(GPSPacketProcessor *pcs);
     void removePacketProcessor(GPSPacketProcessor *pcs);
@@ -117,32 +227,152 @@ public:
 private:
     
     ReportType implProcessOnePacket(bool block, ReportType haltAt);
+    void pollByte(uint8_t b);
+#if CPN_ENABLE_NMEA
+    void beginSentence();
+#endif
+    ReportType beginFrame();
+    void processFrame(PollStatus *st);
+    inline void appendFrame(uint8_t b) {
+        if (m_frame_len < m_frame_cap) m_frame[m_frame_len] = b;
+        if (m_frame_len <= m_frame_cap) m_frame_len++;
+    }
     
     bool processReport(ReportType type);
     
+#if CPN_ENABLE_FIX_POS_LLA_32
     bool process_p_LLA_32();
+#endif
+#if CPN_ENABLE_FIX_POS_LLA_64
     bool process_p_LLA_64();
+#endif
+#if CPN_ENABLE_FIX_POS_XYZ_32
     bool process_p_XYZ_32();
+#endif
+#if CPN_ENABLE_FIX_POS_XYZ_64
     bool process_p_XYZ_64();
+#endif
+#if CPN_ENABLE_FIX_VEL_XYZ
     bool process_v_XYZ();
+#endif
+#if CPN_ENABLE_FIX_VEL_ENU
     bool process_v_ENU();
+#endif
+#if CPN_ENABLE_GPSTIME
     bool process_GPSTime();
+#endif
+#if CPN_ENABLE_STATUS
     bool process_health();
     bool process_addl_status();
     bool process_sbas_status();
+    bool statusDiffers(ReportFlag flag, uint8_t *last, const uint8_t *buf, int n);
+    void statusChanged(const GPSStatus &old);
+#endif
+#if CPN_ENABLE_SATELLITES
+    bool process_satellites();
+    bool process_sat_tracking();
+#endif
+    bool process_io_settings();
+    bool process_superpacket();
+    bool process_bcast_mask();
+#if CPN_ENABLE_SUPERPACKETS
+    bool process_spkt_fix();
+    bool process_spkt_timing();
+    bool process_spkt_timing_suppl();
+#endif
+#if CPN_ENABLE_NMEA
+    bool process_nmea(ReportType type);
+    bool process_gga(const NMEAFields &f);
+    bool process_rmc(const NMEAFields &f);
+    bool process_vtg(const NMEAFields &f);
+    bool process_zda(const NMEAFields &f);
+#if CPN_ENABLE_SATELLITES
+    bool process_gsa(const NMEAFields &f);
+    bool process_gsv(const NMEAFields &f);
+#endif
+    void  setNMEAFix(double lat, double lng, float alt, float fixtime);
+    void  setNMEAVelocity(float speed, float course, float fixtime);
+    void  setNMEADate(int32_t day, float sec_of_day);
+    float nmeaTimeOfWeek(float sec_of_day);
+#endif
+    
+    bool notifyListeners(ReportType type);
+    
+    bool requestIOOptions();
+    bool requestBcastMask();
+    bool waitForBcastMask();
+    bool waitForIOSettings();
+    ReportSet ioReports() const;
     
     // todo: fix this busy wait.
     inline void blockForData() { while (m_serial->available() <= 0) {} }
     bool flushToNextPacket(bool block=true);
     bool endReport();
+    inline void capture(uint8_t b) {
+        if (m_capture_len < m_capture_cap) m_capture[m_capture_len] = b;
+        if (m_capture_len <= m_capture_cap) m_capture_len++;
+    }
     
     HardwareSerial *m_serial;
     PosFix    m_pfix;
     VelFix    m_vfix;
     GPSTime   m_time;
     GPSStatus m_status;
+#if CPN_ENABLE_STATUS
+    // last status payloads received, to skip unchanged reports
+    uint8_t   m_raw_health[2];
+    uint8_t   m_raw_addl_status[3];
+    uint8_t   m_raw_sbas;
+    ReportSet m_raw_valid;
+    StatusSet m_status_changes;
+    GPSStatusListener *m_status_listener;
+#endif
+#if CPN_ENABLE_NMEA
+    // NMEA framing, and the date the sentences' times of day fall on
+    bool     m_frame_nmea; // m_frame holds a sentence, not a TSIP packet
+    bool     m_nmea;       // the last packet received was a valid sentence
+    int32_t  m_nmea_day;   // UTC date last received, as days since 1970, or -1
+    float    m_nmea_sod;   // UTC second of day of the last sentence
+#if CPN_ENABLE_SATELLITES
+    uint32_t m_gsv_tracked; // satellites with a signal level in the GSV series so far
+#endif
+#endif
+#if CPN_ENABLE_SATELLITES
+    SatelliteView m_sats;
+#endif
+#if MAX_PKT_PROCESSORS > 0
     GPSPacketProcessor *m_listeners[MAX_PKT_PROCESSORS];
     uint8_t m_n_listeners;
+#endif
+    
+    // shadow copy of the receiver's IO options (cmd 0x35 / rpt 0x55)
+    uint8_t m_io_options[4];
+    bool    m_io_valid;
+    bool    m_io_dirty;
+    bool    m_cfg_hold;
+    // shadow copy of the packet broadcast mask (cmd 0x8E-A5 / rpt 0x8F-A5)
+    uint16_t  m_bcast_mask;
+    bool      m_bcast_valid;
+    bool      m_bcast_dirty;
+    ReportSet m_subscribed;
+    SuperpacketID m_spkt_id;
+    ReportSet m_saved_fixes; // fix reports to restore after superpacket output
+    
+    // capture of the current packet's data bytes
+    uint8_t *m_capture;
+    int      m_capture_cap;
+    int      m_capture_len; // exceeds m_capture_cap if truncated
+    bool     m_capture_done;
+    
+    // packet being assembled by poll(), kept between calls
+    uint8_t *m_frame;
+    int      m_frame_cap;
+    int      m_frame_len;  // exceeds m_frame_cap if too long
+    uint8_t  m_frame_id;
+    uint8_t  m_poll_state;
+    int      m_replay_pos; // read position in m_frame while processing it, or -1
+    uint32_t m_poll_wcet;  // microseconds
+    uint32_t m_decode_wcet;
 };
 
 /// @} // addtogroup monitor
@@ -0,0 +1,488 @@
+/*
+ * File:   fixlog.cpp
+ */
+
+#include <string.h>
+
+#include "fixlog.h"
+
+#define FIXLOG_VERSION 2
+
+// no window has been established
+#define NO_WINDOW 0
+
+// bytes per field of a fix type, or 0 if it isn't a fix type
+// formats which can't be stored in this build are not supported.
+static uint8_t field_width(ReportType t) {
+    switch (t) {
+#if CPN_HAVE_LLA_32
+        case RPT_FIX_POS_LLA_32:
+#endif
+#if CPN_HAVE_XYZ_32
+        case RPT_FIX_POS_XYZ_32:
+#endif
+#if CPN_HAVE_VEL_XYZ
+        case RPT_FIX_VEL_XYZ:
+#endif
+#if CPN_HAVE_VEL_ENU
+        case RPT_FIX_VEL_ENU:
+#endif
+            return 4;
+#if CPN_HAVE_LLA_64
+        case RPT_FIX_POS_LLA_64:
+#endif
+#if CPN_HAVE_XYZ_64
+        case RPT_FIX_POS_XYZ_64:
+#endif
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+static inline uint64_t width_mask(uint8_t width) {
+    return (width == 8) ? ~(uint64_t)0 : 0xFFFFFFFFULL;
+}
+
+// map a signed difference of `width` bytes to an unsigned one, small
+// magnitudes to small values: 0, -1, 1, -2, ... to 0, 1, 2, 3, ...
+static inline uint64_t zigzag(uint64_t x, uint8_t width) {
+    uint8_t  bits = 8 * width;
+    uint64_t sign = (x >> (bits - 1)) & 1;
+    return ((x << 1) ^ (0 - sign)) & width_mask(width);
+}
+
+static inline uint64_t unzigzag(uint64_t z, uint8_t width) {
+    return ((z >> 1) ^ (0 - (z & 1))) & width_mask(width);
+}
+
+// every fix type is four fields followed by a Float32 fix time.
+static inline uint64_t load_field(const uint8_t *rec, int i, uint8_t width) {
+    if (width == 4) {
+        uint32_t v;
+        memcpy(&v, rec + 4 * i, 4);
+        return v;
+    } else {
+        uint64_t v;
+        memcpy(&v, rec + 8 * i, 8);
+        return v;
+    }
+}
+
+static inline void store_field(uint8_t *rec, int i, uint8_t width, uint64_t v) {
+    if (width == 4) {
+        uint32_t v32 = (uint32_t)v;
+        memcpy(rec + 4 * i, &v32, 4);
+    } else {
+        memcpy(rec + 8 * i, &v, 8);
+    }
+}
+
+/***************************
+ * FixLogWriter            *
+ ***************************/
+
+FixLogWriter::FixLogWriter():
+        m_buf(NULL),
+        m_cap(0),
+        m_bit(0),
+        m_type(RPT_NONE),
+        m_width(0),
+        m_count(0) {}
+
+/**
+ * Begin a new, empty block.
+ *
+ * @param buf Memory to hold the block.
+ * @param size Size of `buf` in bytes.
+ * @param type Type of the fixes to be stored.
+ */
+void FixLogWriter::begin(uint8_t *buf, uint16_t size, ReportType type) {
+    m_width = field_width(type);
+    m_buf   = (m_width != 0 and size >= FIXLOG_HEADER_SIZE) ? buf : NULL;
+    m_cap   = size;
+    m_type  = type;
+    m_count = 0;
+    m_bit   = 8 * FIXLOG_HEADER_SIZE;
+    if (m_buf == NULL) return;
+    m_buf[0] = type;
+    m_buf[1] = FIXLOG_VERSION;
+    m_buf[2] = 0;
+    m_buf[3] = 0;
+}
+
+/**
+ * Add a position fix to the block.
+ *
+ * @return `false` if the fix is not of the block's type, or the block is full.
+ */
+bool FixLogWriter::append(const PosFix &pfix) {
+    if (pfix.type != m_type) return false;
+    const void *rec;
+    switch (pfix.type) {
+        case RPT_FIX_POS_LLA_32: rec = pfix.getLLA_32(); break;
+        case RPT_FIX_POS_LLA_64: rec = pfix.getLLA_64(); break;
+        case RPT_FIX_POS_XYZ_32: rec = pfix.getXYZ_32(); break;
+        case RPT_FIX_POS_XYZ_64: rec = pfix.getXYZ_64(); break;
+        default: return false;
+    }
+    return appendRecord(static_cast<const uint8_t*>(rec));
+}
+
+/**
+ * Add a velocity fix to the block.
+ *
+ * @return `false` if the fix is not of the block's type, or the block is full.
+ */
+bool FixLogWriter::append(const VelFix &vfix) {
+    if (vfix.type != m_type) return false;
+    const void *rec;
+    switch (vfix.type) {
+        case RPT_FIX_VEL_XYZ: rec = vfix.getXYZ(); break;
+        case RPT_FIX_VEL_ENU: rec = vfix.getENU(); break;
+        default: return false;
+    }
+    return appendRecord(static_cast<const uint8_t*>(rec));
+}
+
+bool FixLogWriter::appendRecord(const uint8_t *rec) {
+    if (m_buf == NULL or m_count == 0xFFFF) return false;
+    if (m_bit + 8 * FIXLOG_MAX_RECORD > 8 * (uint32_t)m_cap) return false;
+
+    uint32_t t;
+    memcpy(&t, rec + 4 * m_width, 4);
+    if (m_count == 0) {
+        putBits(t, 32);
+        for (int i = 0; i < 4; i++) {
+            uint64_t v = load_field(rec, i, m_width);
+            if (m_width == 8) putBits(v >> 32, 32);
+            putBits((uint32_t)v, 32);
+            m_fields[i].prev  = v;
+            m_fields[i].delta = 0;
+            m_fields[i].len   = NO_WINDOW;
+        }
+        m_time  = t;
+        m_delta = 0;
+    } else {
+        // delta of delta of the time bits, in the smallest of a few sizes.
+        uint32_t delta = t - m_time;
+        int32_t  dod   = (int32_t)(delta - m_delta);
+        if (dod == 0) {
+            putBits(0x0, 1);
+        } else if (dod >= -63 and dod <= 64) {
+            putBits(0x2, 2);
+            putBits(dod + 63, 7);
+        } else if (dod >= -255 and dod <= 256) {
+            putBits(0x6, 3);
+            putBits(dod + 255, 9);
+        } else if (dod >= -2047 and dod <= 2048) {
+            putBits(0xE, 4);
+            putBits(dod + 2047, 12);
+        } else {
+            putBits(0xF, 4);
+            putBits((uint32_t)dod, 32);
+        }
+        m_time  = t;
+        m_delta = delta;
+        for (int i = 0; i < 4; i++) {
+            putField(m_fields + i, load_field(rec, i, m_width));
+        }
+    }
+    m_count++;
+    m_buf[2] = m_count & 0xFF;
+    m_buf[3] = m_count >> 8;
+    return true;
+}
+
+// write the change in a field's delta from the previous fix, in the
+// previous window if it fits, and if a new one would not be smaller.
+void FixLogWriter::putField(FixLogField *f, uint64_t v) {
+    uint64_t delta = (v - f->prev) & width_mask(m_width);
+    uint64_t z     = zigzag(delta - f->delta, m_width);
+    f->prev  = v;
+    f->delta = delta;
+    if (z == 0) {
+        putBits(0x0, 1);
+        return;
+    }
+    uint8_t len_bits = (m_width == 8) ? 6 : 5;
+    uint8_t len      = 64 - (uint8_t)__builtin_clzll(z);
+    if (f->len != NO_WINDOW and len <= f->len and len + len_bits >= f->len) {
+        putBits(0x2, 2);
+        len = f->len;
+    } else {
+        putBits(0x3, 2);
+        putBits(len - 1, len_bits);
+        f->len = len;
+    }
+    if (len > 32) putBits(z >> 32, len - 32);
+    putBits((uint32_t)z, (len > 32) ? 32 : len);
+}
+
+// write the low n bits of v, most significant first.
+void FixLogWriter::putBits(uint32_t v, uint8_t n) {
+    while (n > 0) {
+        uint8_t *p    = m_buf + (m_bit >> 3);
+        uint8_t  free = 8 - (m_bit & 7);
+        uint8_t  k    = (n < free) ? n : free;
+        uint8_t  bits = (v >> (n - k)) & ((1 << k) - 1);
+        if (free == 8) *p = 0;
+        *p |= bits << (free - k);
+        m_bit += k;
+        n     -= k;
+    }
+}
+
+/**
+ * Get the type of the fixes in the block.
+ */
+ReportType FixLogWriter::getType() const {
+    return m_type;
+}
+
+/**
+ * Get the number of fixes in the block.
+ */
+uint16_t FixLogWriter::getCount() const {
+    return m_count;
+}
+
+/**
+ * Get the number of bytes of the block used so far.
+ */
+uint16_t FixLogWriter::size() const {
+    return (m_bit + 7) / 8;
+}
+
+/***************************
+ * FixLogReader            *
+ ***************************/
+
+FixLogReader::FixLogReader():
+        m_buf(NULL),
+        m_len_bits(0),
+        m_bit(0),
+        m_type(RPT_NONE),
+        m_width(0),
+        m_count(0),
+        m_read(0) {}
+
+/**
+ * Begin reading a block.
+ *
+ * @param buf The block.
+ * @param len Number of bytes of the block available, at least `size()` of
+ * the writer which wrote it.
+ * @return `false` if `buf` does not hold a block written by a compatible
+ * version of this library.
+ */
+bool FixLogReader::begin(const uint8_t *buf, uint16_t len) {
+    m_buf   = NULL;
+    m_count = 0;
+    m_read  = 0;
+    if (buf == NULL or len < FIXLOG_HEADER_SIZE) return false;
+    if (buf[1] != FIXLOG_VERSION or field_width((ReportType)buf[0]) == 0) return false;
+
+    m_buf      = buf;
+    m_len_bits = 8 * (uint32_t)len;
+    m_bit      = 8 * FIXLOG_HEADER_SIZE;
+    m_type     = (ReportType)buf[0];
+    m_width    = field_width(m_type);
+    m_count    = buf[2] | (buf[3] << 8);
+    return true;
+}
+
+/**
+ * Read the next fix, if the block holds position fixes.
+ *
+ * @return `false` if there are no more fixes, or the block does not hold
+ * position fixes.
+ */
+bool FixLogReader::next(PosFix *out) {
+    if (m_width == 0 or m_type == RPT_FIX_VEL_XYZ or m_type == RPT_FIX_VEL_ENU) return false;
+    uint64_t v[4];
+    uint32_t t;
+    if (not nextRecord(v, &t)) return false;
+    // all the fix types have the same layout, differing only in width.
+    uint8_t *rec = reinterpret_cast<uint8_t*>(out->words);
+    out->type = m_type;
+    for (int i = 0; i < 4; i++) store_field(rec, i, m_width, v[i]);
+    memcpy(rec + 4 * m_width, &t, 4);
+    return true;
+}
+
+/**
+ * Read the next fix, if the block holds velocity fixes.
+ *
+ * @return `false` if there are no more fixes, or the block does not hold
+ * velocity fixes.
+ */
+bool FixLogReader::next(VelFix *out) {
+    if (m_type != RPT_FIX_VEL_XYZ and m_type != RPT_FIX_VEL_ENU) return false;
+    uint64_t v[4];
+    uint32_t t;
+    if (not nextRecord(v, &t)) return false;
+    uint8_t *rec = reinterpret_cast<uint8_t*>(out->words);
+    out->type = m_type;
+    for (int i = 0; i < 4; i++) store_field(rec, i, 4, v[i]);
+    memcpy(rec + 16, &t, 4);
+    return true;
+}
+
+/**
+ * Read up to `max` fixes into a separate array for each field. The fields
+ * `a` through `d` are the four fields of the fix type, in order; e.g. `lat`,
+ * `lng`, `alt`, and `bias` for LLA fixes. Any array may be `NULL` if that
+ * field is not needed.
+ *
+ * This overload is for blocks of 32-bit fixes; it reads nothing from blocks
+ * of 64-bit fixes.
+ *
+ * @return The number of fixes read.
+ */
+uint16_t FixLogReader::readColumns(Float32 *fixtime, Float32 *a, Float32 *b,
+                                   Float32 *c, Float32 *d, uint16_t max) {
+    if (m_width != 4) return 0;
+    Float32 *cols[4] = { a, b, c, d };
+    uint64_t v[4];
+    uint32_t t;
+    uint16_t n = 0;
+    while (n < max and nextRecord(v, &t)) {
+        if (fixtime != NULL) fixtime[n].bits = t;
+        for (int i = 0; i < 4; i++) {
+            if (cols[i] != NULL) cols[i][n].bits = (uint32_t)v[i];
+        }
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Read up to `max` fixes into a separate array for each field. As above,
+ * for blocks of 64-bit fixes; it reads nothing from blocks of 32-bit fixes.
+ *
+ * @return The number of fixes read.
+ */
+uint16_t FixLogReader::readColumns(Float32 *fixtime, Float64 *a, Float64 *b,
+                                   Float64 *c, Float64 *d, uint16_t max) {
+    if (m_width != 8) return 0;
+    Float64 *cols[4] = { a, b, c, d };
+    uint64_t v[4];
+    uint32_t t;
+    uint16_t n = 0;
+    while (n < max and nextRecord(v, &t)) {
+        if (fixtime != NULL) fixtime[n].bits = t;
+        for (int i = 0; i < 4; i++) {
+            if (cols[i] != NULL) cols[i][n].bits = v[i];
+        }
+        n++;
+    }
+    return n;
+}
+
+bool FixLogReader::nextRecord(uint64_t v[4], uint32_t *time) {
+    if (m_buf == NULL or m_read >= m_count) return false;
+    if (m_read == 0) {
+        m_time  = getBits(32);
+        m_delta = 0;
+        for (int i = 0; i < 4; i++) {
+            uint64_t x = getBits(32);
+            if (m_width == 8) x = (x << 32) | getBits(32);
+            m_fields[i].prev  = x;
+            m_fields[i].delta = 0;
+            m_fields[i].len   = NO_WINDOW;
+            v[i] = x;
+        }
+    } else {
+        int32_t dod;
+        if (getBits(1) == 0) {
+            dod = 0;
+        } else if (getBits(1) == 0) {
+            dod = (int32_t)getBits(7) - 63;
+        } else if (getBits(1) == 0) {
+            dod = (int32_t)getBits(9) - 255;
+        } else if (getBits(1) == 0) {
+            dod = (int32_t)getBits(12) - 2047;
+        } else {
+            dod = (int32_t)getBits(32);
+        }
+        m_delta += dod;
+        m_time  += m_delta;
+        for (int i = 0; i < 4; i++) v[i] = getField(m_fields + i);
+    }
+    if (m_bit > m_len_bits) {
+        // truncated block
+        m_count = m_read;
+        return false;
+    }
+    *time = m_time;
+    m_read++;
+    return true;
+}
+
+uint64_t FixLogReader::getField(FixLogField *f) {
+    uint64_t mask = width_mask(m_width);
+    if (getBits(1) == 1) {
+        if (getBits(1) == 1) {
+            f->len = getBits((m_width == 8) ? 6 : 5) + 1;
+        } else if (f->len == NO_WINDOW) {
+            m_bit = m_len_bits + 1; // corrupt
+            return 0;
+        }
+        uint64_t z = 0;
+        if (f->len > 32) z = (uint64_t)getBits(f->len - 32) << 32;
+        z |= getBits((f->len > 32) ? 32 : f->len);
+        f->delta = (f->delta + unzigzag(z, m_width)) & mask;
+    }
+    f->prev = (f->prev + f->delta) & mask;
+    return f->prev;
+}
+
+// read n bits, most significant first. past the end, reads zeros.
+uint32_t FixLogReader::getBits(uint8_t n) {
+    if (n == 0) return 0;
+    if (m_bit + 64 <= m_len_bits) {
+        // fast path: take the bits from a whole 64-bit word.
+        const uint8_t *p = m_buf + (m_bit >> 3);
+        uint64_t w = 0;
+        for (int i = 0; i < 8; i++) w = (w << 8) | p[i];
+        uint32_t v = (uint32_t)((w << (m_bit & 7)) >> (64 - n));
+        m_bit += n;
+        return v;
+    }
+    uint32_t v = 0;
+    while (n > 0) {
+        if (m_bit >= m_len_bits) {
+            m_bit += n;
+            return (n < 32) ? v << n : 0;
+        }
+        uint8_t byte  = m_buf[m_bit >> 3];
+        uint8_t avail = 8 - (m_bit & 7);
+        uint8_t k     = (n < avail) ? n : avail;
+        v = (v << k) | ((byte >> (avail - k)) & ((1 << k) - 1));
+        m_bit += k;
+        n     -= k;
+    }
+    return v;
+}
+
+/**
+ * Get the type of the fixes in the block.
+ */
+ReportType FixLogReader::getType() const {
+    return m_type;
+}
+
+/**
+ * Get the number of fixes in the block.
+ */
+uint16_t FixLogReader::getCount() const {
+    return m_count;
+}
+
+/**
+ * Get the number of fixes not yet read.
+ */
+uint16_t FixLogReader::getRemaining() const {
+    return m_count - m_read;
+}
@@ -0,0 +1,135 @@
+/*
+ * File:   fixlog.h
+ */
+
+#ifndef FIXLOG_H
+#define	FIXLOG_H
+
+#include "gpstype.h"
+
+/**
+ * @addtogroup processing
+ * @{
+ */
+
+/// Size of the header at the start of each block.
+#define FIXLOG_HEADER_SIZE 4
+/// Greatest number of bytes one fix can add to a block.
+#define FIXLOG_MAX_RECORD  44
+
+// compression state of one field
+struct FixLogField {
+    uint64_t prev;
+    uint64_t delta; // previous difference of the bits
+    uint8_t  len;   // bits of the current window; 0 if none
+};
+
+/**
+ * @brief Compresses a stream of fixes into a block of memory.
+ *
+ * Each block holds fixes of a single report type, any of the position or
+ * velocity fix types. Every field is stored as the delta of the delta of its
+ * bits, taken as an integer, from the previous fixes. The bits of floats of
+ * one sign and exponent are in the order of their values, so a fix time
+ * which advances at a steady rate costs one bit, as does an unchanged field;
+ * a position moving at a steady speed costs little more than its noise. The
+ * fix time uses a few fixed sizes of delta; the other fields, the least
+ * number of bits which held their recent deltas. The format is adapted from
+ * Facebook's Gorilla time series database.
+ *
+ * Encoding works directly on the bits of the fix, needs no floating point
+ * arithmetic, and uses no memory besides the block. The block is valid after
+ * every call to `append()`, so it may be written to flash as it fills.
+ *
+ * Example:
+ *
+ *      uint8_t block[512];
+ *      FixLogWriter log;
+ *      log.begin(block, sizeof(block), RPT_FIX_POS_LLA_32);
+ *      // ...
+ *      if (gps.processOnePacket() == RPT_FIX_POS_LLA_32) {
+ *          if (not log.append(gps.getPositionFix())) {
+ *              // block is full; store log.size() bytes of it and begin again.
+ *          }
+ *      }
+ */
+class FixLogWriter {
+public:
+    FixLogWriter();
+
+    void begin(uint8_t *buf, uint16_t size, ReportType type);
+    bool append(const PosFix &pfix);
+    bool append(const VelFix &vfix);
+
+    ReportType getType()  const;
+    uint16_t   getCount() const;
+    uint16_t   size()     const;
+
+private:
+
+    bool appendRecord(const uint8_t *rec);
+    void putBits(uint32_t v, uint8_t n);
+    void putField(FixLogField *f, uint64_t v);
+
+    uint8_t    *m_buf;
+    uint16_t    m_cap;
+    uint32_t    m_bit;   // bits written, including the header
+    ReportType  m_type;
+    uint8_t     m_width; // bytes per field
+    uint16_t    m_count;
+    uint32_t    m_time;  // bits of the previous fix time
+    uint32_t    m_delta; // previous difference of fix time bits
+    FixLogField m_fields[4];
+};
+
+/**
+ * @brief Decompresses a block written by `FixLogWriter`.
+ *
+ * Fixes may be read one at a time, or expanded into separate arrays for each
+ * field, which is much faster for processing a large number of fixes.
+ *
+ * Example:
+ *
+ *      FixLogReader log;
+ *      log.begin(block, len);
+ *      Float32 t[N], lat[N], lng[N];
+ *      uint16_t n = log.readColumns(t, lat, lng, NULL, NULL, N);
+ */
+class FixLogReader {
+public:
+    FixLogReader();
+
+    bool begin(const uint8_t *buf, uint16_t len);
+    bool next(PosFix *out);
+    bool next(VelFix *out);
+
+    uint16_t readColumns(Float32 *fixtime, Float32 *a, Float32 *b,
+                         Float32 *c, Float32 *d, uint16_t max);
+    uint16_t readColumns(Float32 *fixtime, Float64 *a, Float64 *b,
+                         Float64 *c, Float64 *d, uint16_t max);
+
+    ReportType getType()      const;
+    uint16_t   getCount()     const;
+    uint16_t   getRemaining() const;
+
+private:
+
+    bool     nextRecord(uint64_t v[4], uint32_t *time);
+    uint32_t getBits(uint8_t n);
+    uint64_t getField(FixLogField *f);
+
+    const uint8_t *m_buf;
+    uint32_t    m_len_bits;
+    uint32_t    m_bit;
+    ReportType  m_type;
+    uint8_t     m_width;
+    uint16_t    m_count;
+    uint16_t    m_read;
+    uint32_t    m_time;
+    uint32_t    m_delta;
+    FixLogField m_fields[4];
+};
+
+/// @} // addtogroup processing
+
+#endif	/* FIXLOG_H */
@@ -0,0 +1,190 @@
+/*
+ * File:   fixp.h
+ *
+ * Code for converting IEEE 754 floats to fixed point, using only integer
+ * operations on their bits. This makes 64-bit fixes usable on boards whose
+ * `double` is not 64 bits.
+ */
+
+#ifndef FIXP_H
+#define	FIXP_H
+
+#include <math.h>
+
+#include "gpstype.h"
+
+#define FIXP_MAX ((int64_t)0x7FFFFFFFFFFFFFFFLL)
+
+// fixed point formats for converting fixes
+#define FIXP_ANGLE_BITS  40  // radians
+#define FIXP_LENGTH_BITS 24  // meters
+// 2pi in FIXP_ANGLE_BITS fixed point
+#define FIXP_ANGLE_2PI   ((int64_t)6908435304715LL)
+// scale of the fixed point formats, as floats
+#define FIXP_ANGLE_SCALE  (1.0f / 1099511627776.0f)  // 2^-40
+#define FIXP_LENGTH_SCALE (1.0f / 16777216.0f)       // 2^-24
+
+// WGS-84 ellipsoid
+#define WGS84_A   6378137.0f
+#define WGS84_B   6356752.3f
+#define WGS84_E2  6.69437999014e-3f
+#define WGS84_EP2 6.73949674228e-3f
+
+// value of mantissa * 2^(exp + frac_bits), rounded toward zero and saturated.
+inline int64_t fixp_scale(uint64_t mant, int exp, int frac_bits, bool neg) {
+    int shift = exp + frac_bits;
+    uint64_t v;
+    if (shift >= 0) {
+        if (shift >= 63 or (mant >> (63 - shift)) != 0) {
+            return neg ? -FIXP_MAX : FIXP_MAX;
+        }
+        v = mant << shift;
+    } else if (shift > -64) {
+        v = mant >> -shift;
+    } else {
+        v = 0;
+    }
+    return neg ? -(int64_t)v : (int64_t)v;
+}
+
+////////// Floats //////////
+
+/**
+ * Convert a 64-bit float to a fixed point integer with `frac_bits`
+ * fractional bits, i.e. `f * 2^frac_bits`, rounded toward zero.
+ * Out-of-range values, infinities, and NaNs saturate.
+ */
+inline int64_t to_fixed(Float64 f, int frac_bits) {
+    int exp = (int)((f.bits >> 52) & 0x7FF);
+    bool neg = (f.bits >> 63) != 0;
+    if (exp == 0)     return 0; // zero or denormal
+    if (exp == 0x7FF) return neg ? -FIXP_MAX : FIXP_MAX;
+    uint64_t mant = (f.bits & 0x000FFFFFFFFFFFFFULL) | 0x0010000000000000ULL;
+    return fixp_scale(mant, exp - 1075, frac_bits, neg);
+}
+
+/**
+ * Convert a 32-bit float to a fixed point integer with `frac_bits`
+ * fractional bits, i.e. `f * 2^frac_bits`, rounded toward zero.
+ * Out-of-range values, infinities, and NaNs saturate.
+ */
+inline int64_t to_fixed(Float32 f, int frac_bits) {
+    int exp = (int)((f.bits >> 23) & 0xFF);
+    bool neg = (f.bits >> 31) != 0;
+    if (exp == 0)    return 0; // zero or denormal
+    if (exp == 0xFF) return neg ? -FIXP_MAX : FIXP_MAX;
+    uint64_t mant = (f.bits & 0x007FFFFF) | 0x00800000;
+    return fixp_scale(mant, exp - 150, frac_bits, neg);
+}
+
+////////// Fixes //////////
+
+inline bool is_lla(ReportType t) {
+    return t == RPT_FIX_POS_LLA_32 or t == RPT_FIX_POS_LLA_64;
+}
+
+// convert a position fix to fixed point (lng, lat, alt) or (x, y, z),
+// returning false if there is no valid fix.
+inline bool fix_to_fixed(const PosFix &pfix, int64_t out[3]) {
+    Float32 fixtime;
+    switch (pfix.type) {
+        case RPT_FIX_POS_LLA_32: {
+            const LLA_Fix<Float32> *f = pfix.getLLA_32();
+            out[0] = to_fixed(f->lng, FIXP_ANGLE_BITS);
+            out[1] = to_fixed(f->lat, FIXP_ANGLE_BITS);
+            out[2] = to_fixed(f->alt, FIXP_LENGTH_BITS);
+            fixtime = f->fixtime;
+        } break;
+        case RPT_FIX_POS_LLA_64: {
+            const LLA_Fix<Float64> *f = pfix.getLLA_64();
+            out[0] = to_fixed(f->lng, FIXP_ANGLE_BITS);
+            out[1] = to_fixed(f->lat, FIXP_ANGLE_BITS);
+            out[2] = to_fixed(f->alt, FIXP_LENGTH_BITS);
+            fixtime = f->fixtime;
+        } break;
+        case RPT_FIX_POS_XYZ_32: {
+            const XYZ_Fix<Float32> *f = pfix.getXYZ_32();
+            out[0] = to_fixed(f->x, FIXP_LENGTH_BITS);
+            out[1] = to_fixed(f->y, FIXP_LENGTH_BITS);
+            out[2] = to_fixed(f->z, FIXP_LENGTH_BITS);
+            fixtime = f->fixtime;
+        } break;
+        case RPT_FIX_POS_XYZ_64: {
+            const XYZ_Fix<Float64> *f = pfix.getXYZ_64();
+            out[0] = to_fixed(f->x, FIXP_LENGTH_BITS);
+            out[1] = to_fixed(f->y, FIXP_LENGTH_BITS);
+            out[2] = to_fixed(f->z, FIXP_LENGTH_BITS);
+            fixtime = f->fixtime;
+        } break;
+        default:
+            return false;
+    }
+    // fix times are negative if the fix is invalid.
+    return (fixtime.bits & 0x80000000) == 0;
+}
+
+////////// Local frames //////////
+
+// horizontal plane at a point, for turning fixes into local offsets.
+struct LocalFrame {
+    float sin_lat, cos_lat;
+    float sin_lng, cos_lng;
+    float north, east; // meters per radian of lat, lng
+};
+
+// geodetic latitude and longitude of an ECEF position, in radians, by
+// Bowring's approximation; good to well under a meter near the surface.
+inline void ecef_to_lat_lng(float x, float y, float z, float *lat, float *lng) {
+    float p  = sqrt(x * x + y * y);
+    float th = atan2(z * WGS84_A, p * WGS84_B);
+    float st = sin(th);
+    float ct = cos(th);
+    *lat = atan2(z + WGS84_EP2 * WGS84_B * st * st * st,
+                 p - WGS84_E2  * WGS84_A * ct * ct * ct);
+    *lng = atan2(y, x);
+}
+
+// set up the local frame at a position converted by fix_to_fixed(). ECEF
+// positions are taken to be on the ellipsoid.
+inline void local_frame(const int64_t fixed[3], bool lla, LocalFrame *f) {
+    float lat, lng, alt;
+    if (lla) {
+        lng = fixed[0] * FIXP_ANGLE_SCALE;
+        lat = fixed[1] * FIXP_ANGLE_SCALE;
+        alt = fixed[2] * FIXP_LENGTH_SCALE;
+    } else {
+        // the geocentric latitude is up to 0.2 degrees off, which would tilt
+        // the plane visibly.
+        ecef_to_lat_lng(fixed[0] * FIXP_LENGTH_SCALE,
+                        fixed[1] * FIXP_LENGTH_SCALE,
+                        fixed[2] * FIXP_LENGTH_SCALE, &lat, &lng);
+        alt = 0;
+    }
+    f->sin_lat = sin(lat);
+    f->cos_lat = cos(lat);
+    f->sin_lng = sin(lng);
+    f->cos_lng = cos(lng);
+
+    float w  = 1 - WGS84_E2 * f->sin_lat * f->sin_lat;
+    float n  = WGS84_A / sqrt(w);
+    f->north = n * (1 - WGS84_E2) / w + alt;
+    f->east  = (n + alt) * f->cos_lat;
+}
+
+// rotate an ECEF vector to east, north and up in a local frame.
+inline void frame_to_enu(const LocalFrame &f, float x, float y, float z, float enu[3]) {
+    float t = f.cos_lng * x + f.sin_lng * y;
+    enu[0] = f.cos_lng * y - f.sin_lng * x;
+    enu[1] = f.cos_lat * z - f.sin_lat * t;
+    enu[2] = f.sin_lat * z + f.cos_lat * t;
+}
+
+// rotate an east, north and up vector in a local frame to ECEF.
+inline void frame_to_ecef(const LocalFrame &f, float e, float n, float u, float xyz[3]) {
+    float t = f.cos_lat * u - f.sin_lat * n;
+    xyz[0] = f.cos_lng * t - f.sin_lng * e;
+    xyz[1] = f.sin_lng * t + f.cos_lng * e;
+    xyz[2] = f.cos_lat * n + f.sin_lat * u;
+}
+
+#endif	/* FIXP_H */
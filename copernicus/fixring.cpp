@@ -0,0 +1,364 @@
+/*
+ * File:   fixring.cpp
+ */
+
+#include <string.h>
+
+#include "fixring.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FIXRING_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define FIXRING_MAGIC 0x47505352 // "GPSR"
+
+// readers retry this many times if the writer laps them mid-read.
+#define FIXRING_RETRIES 4
+
+#ifdef __AVR__
+
+#include <util/atomic.h>
+
+// 32-bit accesses are not atomic on AVR; guard them from interrupts.
+static inline uint32_t load_acquire(const uint32_t *p) {
+    uint32_t v;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { v = *(const volatile uint32_t*)p; }
+    return v;
+}
+static inline void store_release(uint32_t *p, uint32_t v) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { *(volatile uint32_t*)p = v; }
+}
+static inline void fence_release() { __asm__ __volatile__ ("" ::: "memory"); }
+static inline void fence_acquire() { __asm__ __volatile__ ("" ::: "memory"); }
+
+#else
+
+static inline uint32_t load_acquire(const uint32_t *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void store_release(uint32_t *p, uint32_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+static inline void fence_release() { __atomic_thread_fence(__ATOMIC_RELEASE); }
+static inline void fence_acquire() { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+
+#endif
+
+/***************************
+ * FixRing                 *
+ ***************************/
+
+FixRing::FixRing():
+        m_header(NULL),
+        m_slots(NULL),
+        m_mapped(0) {}
+
+FixRing::~FixRing() {
+    close();
+}
+
+/**
+ * Get the size of the memory block needed for a ring with the given number
+ * of slots.
+ */
+size_t FixRing::bytesNeeded(uint32_t n_slots) {
+    return sizeof(FixRingHeader) + n_slots * sizeof(FixRingSlot);
+}
+
+/**
+ * Initialize a new, empty ring in the given memory block, and publish into it.
+ *
+ * @param mem Memory block of at least `bytesNeeded(n_slots)` bytes, suitably
+ * aligned for a `uint32_t`. Must outlive the `FixRing`.
+ * @param n_slots Number of epochs the ring can hold.
+ * @return `false` if `mem` is `NULL` or `n_slots` is 0, `true` otherwise.
+ */
+bool FixRing::attach(void *mem, uint32_t n_slots) {
+    close();
+    if (mem == NULL or n_slots == 0) return false;
+
+    FixRingHeader *hdr = static_cast<FixRingHeader*>(mem);
+    FixRingSlot *slots = reinterpret_cast<FixRingSlot*>(hdr + 1);
+    hdr->epoch_size  = sizeof(GPSEpoch);
+    hdr->n_slots     = n_slots;
+    hdr->n_published = 0;
+    for (uint32_t i = 0; i < n_slots; i++) slots[i].seq = 0;
+    // readers won't trust the block until the magic number appears.
+    store_release(&hdr->magic, FIXRING_MAGIC);
+
+    m_header = hdr;
+    m_slots  = slots;
+    return true;
+}
+
+#ifdef FIXRING_POSIX
+
+/**
+ * Create (or replace) a named POSIX shared memory object holding a new,
+ * empty ring, and publish into it. Readers which had opened a previous ring
+ * of the same size will begin reading the new ring from its start.
+ *
+ * A previous ring of a different size is never resized, since readers may
+ * still have it mapped. It is instead marked as retired, so that those
+ * readers see `RING_INVALID` and can reopen the name, and the name is
+ * unlinked and created anew.
+ *
+ * @param name Name of the shared memory object, e.g. `"/gps0"`.
+ * @param n_slots Number of epochs the ring can hold.
+ * @return `false` if the object could not be created or mapped.
+ */
+bool FixRing::create(const char *name, uint32_t n_slots) {
+    close();
+    if (n_slots == 0) return false;
+    size_t size = bytesNeeded(n_slots);
+
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size != 0 and (size_t)st.st_size != size) {
+        if ((size_t)st.st_size >= sizeof(FixRingHeader)) {
+            void *old = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (old != MAP_FAILED) {
+                store_release(&static_cast<FixRingHeader*>(old)->magic, 0);
+                munmap(old, st.st_size);
+            }
+        }
+        ::close(fd);
+        shm_unlink(name);
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) return false;
+    }
+    void *mem = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mem == MAP_FAILED) return false;
+
+    attach(mem, n_slots);
+    m_mapped = size;
+    return true;
+}
+
+#endif
+
+/**
+ * Detach from the ring's memory, unmapping it if it was created by `create()`.
+ */
+void FixRing::close() {
+#ifdef FIXRING_POSIX
+    if (m_mapped != 0) munmap(m_header, m_mapped);
+#endif
+    m_header = NULL;
+    m_slots  = NULL;
+    m_mapped = 0;
+}
+
+/**
+ * Publish an epoch, overwriting the oldest epoch if the ring is full.
+ * Never blocks. Only one thread may publish into a ring.
+ */
+void FixRing::publish(const GPSEpoch &epoch) {
+    if (m_header == NULL) return;
+    uint32_t n = m_header->n_published;
+    FixRingSlot *slot = m_slots + (n % m_header->n_slots);
+
+    // an odd sequence number marks the slot as being written.
+    store_release(&slot->seq, 2 * n + 1);
+    fence_release();
+    memcpy(&slot->epoch, &epoch, sizeof(GPSEpoch));
+    store_release(&slot->seq, 2 * n + 2);
+    store_release(&m_header->n_published, n + 1);
+}
+
+/**
+ * Publish an epoch composed of the given data. Equivalent to filling a
+ * `GPSEpoch` and calling `publish()` with it.
+ */
+void FixRing::publish(const PosFix &pfix, const VelFix &vfix,
+                      const GPSTime &time, const GPSStatus &status) {
+    GPSEpoch epoch;
+    epoch.pfix   = pfix;
+    epoch.vfix   = vfix;
+    epoch.time   = time;
+    epoch.status = status;
+    publish(epoch);
+}
+
+/***************************
+ * FixRingReader           *
+ ***************************/
+
+FixRingReader::FixRingReader():
+        m_header(NULL),
+        m_slots(NULL),
+        m_mapped(0),
+        m_next(0) {}
+
+FixRingReader::~FixRingReader() {
+    close();
+}
+
+/**
+ * Read from a ring initialized by `FixRing::attach()`. Reading begins with
+ * the oldest epoch still in the ring.
+ *
+ * @param mem Memory block of the ring.
+ * @return `false` if `mem` does not hold a ring written by a compatible
+ * build of this library.
+ */
+bool FixRingReader::attach(const void *mem) {
+    close();
+    if (mem == NULL) return false;
+    const FixRingHeader *hdr = static_cast<const FixRingHeader*>(mem);
+    if (load_acquire(&hdr->magic) != FIXRING_MAGIC) return false;
+    if (hdr->epoch_size != sizeof(GPSEpoch) or hdr->n_slots == 0) return false;
+
+    m_header = hdr;
+    m_slots  = reinterpret_cast<const FixRingSlot*>(hdr + 1);
+    uint32_t pub = load_acquire(&hdr->n_published);
+    m_next = (pub > hdr->n_slots) ? pub - hdr->n_slots : 0;
+    return true;
+}
+
+#ifdef FIXRING_POSIX
+
+/**
+ * Map a ring created by `FixRing::create()` read-only, and read from it.
+ *
+ * @param name Name of the shared memory object.
+ * @return `false` if the object could not be mapped, or does not hold a ring
+ * written by a compatible build of this library.
+ */
+bool FixRingReader::open(const char *name) {
+    close();
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    void *mem = MAP_FAILED;
+    if (fstat(fd, &st) == 0 and (size_t)st.st_size >= sizeof(FixRingHeader)) {
+        mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mem == MAP_FAILED) return false;
+
+    const FixRingHeader *hdr = static_cast<const FixRingHeader*>(mem);
+    if ((size_t)st.st_size < FixRing::bytesNeeded(hdr->n_slots) or not attach(mem)) {
+        munmap(mem, st.st_size);
+        return false;
+    }
+    m_mapped = st.st_size;
+    return true;
+}
+
+#endif
+
+/**
+ * Detach from the ring's memory, unmapping it if it was mapped by `open()`.
+ */
+void FixRingReader::close() {
+#ifdef FIXRING_POSIX
+    if (m_mapped != 0) munmap(const_cast<FixRingHeader*>(m_header), m_mapped);
+#endif
+    m_header = NULL;
+    m_slots  = NULL;
+    m_mapped = 0;
+}
+
+// whether the ring is attached, and has not been retired by its writer.
+bool FixRingReader::valid() const {
+    return m_header != NULL and load_acquire(&m_header->magic) == FIXRING_MAGIC;
+}
+
+// copy epoch number `n` out of the ring, if it's intact.
+RingStatus FixRingReader::readEpoch(uint32_t n, GPSEpoch *out) const {
+    const FixRingSlot *slot = m_slots + (n % m_header->n_slots);
+    uint32_t want = 2 * n + 2;
+    uint32_t s0 = load_acquire(&slot->seq);
+    if (s0 != want) {
+        return ((int32_t)(s0 - want) > 0) ? RING_OVERRUN : RING_EMPTY;
+    }
+    memcpy(out, (const void*)&slot->epoch, sizeof(GPSEpoch));
+    fence_acquire();
+    uint32_t s1 = load_acquire(&slot->seq);
+    return (s1 == s0) ? RING_OK : RING_OVERRUN;
+}
+
+/**
+ * Read the oldest epoch which has not yet been read by this reader.
+ *
+ * @param out Destination of the epoch.
+ * @return `RING_OK` if the epoch was read; `RING_EMPTY` if there are no new
+ * epochs; `RING_OVERRUN` if the writer overwrote some unread epochs, in which
+ * case those were skipped and `out` holds the oldest epoch still available;
+ * `RING_INVALID` if no ring is open, or it was replaced by one of a
+ * different size (see `FixRing::create()`) and should be reopened.
+ */
+RingStatus FixRingReader::readNext(GPSEpoch *out) {
+    if (not valid()) return RING_INVALID;
+    uint32_t n_slots = m_header->n_slots;
+    bool skipped = false;
+    for (int i = 0; i < FIXRING_RETRIES; i++) {
+        uint32_t pub = load_acquire(&m_header->n_published);
+        if ((int32_t)(pub - m_next) < 0) m_next = 0; // the writer restarted
+        if (pub == m_next) return RING_EMPTY;
+        if (pub - m_next >= n_slots) {
+            // the oldest slot may be mid-write; skip it too.
+            m_next  = pub - n_slots + 1;
+            skipped = true;
+        }
+        RingStatus st = readEpoch(m_next, out);
+        if (st == RING_OK) {
+            m_next++;
+            return skipped ? RING_OVERRUN : RING_OK;
+        } else if (st == RING_OVERRUN) {
+            // lapped while reading; catch up and try again.
+            m_next  = pub + 1 - n_slots;
+            skipped = true;
+        } else {
+            return RING_EMPTY;
+        }
+    }
+    // the writer is lapping us faster than we can copy; nothing intact was
+    // read this time, but we've caught up to its position.
+    return RING_EMPTY;
+}
+
+/**
+ * Read the most recently published epoch, whether or not it has been read
+ * already. Subsequent calls to `readNext()` will return only epochs published
+ * after it.
+ *
+ * @param out Destination of the epoch.
+ * @return `RING_OK` if the epoch was read, `RING_EMPTY` if nothing has
+ * been published, or `RING_INVALID` as for `readNext()`.
+ */
+RingStatus FixRingReader::readLatest(GPSEpoch *out) {
+    if (not valid()) return RING_INVALID;
+    for (int i = 0; i < FIXRING_RETRIES; i++) {
+        uint32_t pub = load_acquire(&m_header->n_published);
+        if (pub == 0) return RING_EMPTY;
+        if (readEpoch(pub - 1, out) == RING_OK) {
+            m_next = pub;
+            return RING_OK;
+        }
+    }
+    return RING_EMPTY;
+}
+
+/**
+ * Get the number of epochs published but not yet read by this reader,
+ * including any which have since been overwritten.
+ */
+uint32_t FixRingReader::available() const {
+    if (m_header == NULL) return 0;
+    return load_acquire(&m_header->n_published) - m_next;
+}
@@ -0,0 +1,138 @@
+/*
+ * File:   fixring.h
+ */
+
+#ifndef FIXRING_H
+#define	FIXRING_H
+
+#include <stddef.h>
+
+#include "gpstype.h"
+
+/**
+ * @addtogroup processing
+ * @{
+ */
+
+/**
+ * @brief One epoch of decoded receiver data.
+ */
+struct GPSEpoch {
+    PosFix    pfix;
+    VelFix    vfix;
+    GPSTime   time;
+    GPSStatus status;
+};
+
+enum RingStatus {
+    /// An epoch was read.
+    RING_OK,
+    /// No new epoch has been published.
+    RING_EMPTY,
+    /// The writer overwrote epochs before they could be read; some were skipped.
+    RING_OVERRUN,
+    /// The ring is not attached to valid memory, or was replaced by its writer.
+    RING_INVALID,
+};
+
+// layout of the shared memory block
+struct FixRingSlot {
+    uint32_t seq;  // odd while being written
+    GPSEpoch epoch;
+};
+
+struct FixRingHeader {
+    uint32_t magic;
+    uint32_t epoch_size;
+    uint32_t n_slots;
+    uint32_t n_published;
+};
+
+/**
+ * @brief Publishes epochs into a ring buffer which any number of readers
+ * may read concurrently.
+ *
+ * Each slot of the ring is guarded by a sequence lock: the writer never
+ * waits for readers, and readers detect (rather than prevent) epochs being
+ * overwritten while they read them. Publishing costs one copy of the epoch,
+ * regardless of the number of readers.
+ *
+ * The ring may be placed in any memory block; for example, memory shared
+ * between an interrupt handler and the main loop. On POSIX systems, it may
+ * also be created in a named shared memory object, which reader processes
+ * can map read-only and read without system calls:
+ *
+ *      // writer process
+ *      FixRing ring;
+ *      ring.create("/gps0", 64);
+ *      // ...
+ *      ring.publish(gps.getPositionFix(), gps.getVelocityFix(),
+ *                   gps.getGPSTime(), gps.getStatus());
+ *
+ *      // reader process
+ *      FixRingReader reader;
+ *      reader.open("/gps0");
+ *      GPSEpoch epoch;
+ *      while (reader.readNext(&epoch) != RING_EMPTY) {
+ *          // ...
+ *      }
+ */
+class FixRing {
+public:
+    FixRing();
+    ~FixRing();
+
+    static size_t bytesNeeded(uint32_t n_slots);
+
+    bool attach(void *mem, uint32_t n_slots);
+#if defined(__unix__) || defined(__APPLE__)
+    bool create(const char *name, uint32_t n_slots);
+#endif
+    void close();
+
+    void publish(const GPSEpoch &epoch);
+    void publish(const PosFix &pfix, const VelFix &vfix,
+                 const GPSTime &time, const GPSStatus &status);
+
+private:
+
+    FixRingHeader *m_header;
+    FixRingSlot   *m_slots;
+    size_t         m_mapped; // bytes mapped by create(), if any
+};
+
+/**
+ * @brief Reads epochs from a `FixRing`.
+ *
+ * Each reader keeps its own position in the ring, and does not affect the
+ * writer or other readers.
+ */
+class FixRingReader {
+public:
+    FixRingReader();
+    ~FixRingReader();
+
+    bool attach(const void *mem);
+#if defined(__unix__) || defined(__APPLE__)
+    bool open(const char *name);
+#endif
+    void close();
+
+    RingStatus readNext(GPSEpoch *out);
+    RingStatus readLatest(GPSEpoch *out);
+    uint32_t   available() const;
+
+private:
+
+    bool       valid() const;
+    RingStatus readEpoch(uint32_t n, GPSEpoch *out) const;
+
+    const FixRingHeader *m_header;
+    const FixRingSlot   *m_slots;
+    size_t               m_mapped;
+    uint32_t             m_next; // number of the next epoch to read
+};
+
+/// @} // addtogroup processing
+
+#endif	/* FIXRING_H */
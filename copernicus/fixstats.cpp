@@ -0,0 +1,282 @@
+/*
+ * File:   fixstats.cpp
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "fixstats.h"
+#include "fixp.h"
+
+// the origin of the sums is moved to the mean when they drift this far (mm)
+#define RECENTER_DIST 4096
+
+// CEP of a bivariate normal distribution, per unit of (sigma_1 + sigma_2).
+// accurate to a few percent unless the error ellipse is very eccentric.
+#define CEP_FACTOR 0.5887f
+
+static inline int64_t round_to_int(float x) {
+    return (int64_t)(x < 0 ? x - 0.5f : x + 0.5f);
+}
+
+// (x * 1000) >> LENGTH_BITS, rounded; fixed point meters to mm.
+static inline int64_t length_to_mm(int64_t x) {
+    return (x * 1000 + (1 << (FIXP_LENGTH_BITS - 1))) >> FIXP_LENGTH_BITS;
+}
+
+static void add_sample(StatSums *s, const int32_t x[3], const int32_t origin[3], int sign) {
+    int64_t d[3];
+    for (int i = 0; i < 3; i++) d[i] = (int64_t)x[i] - origin[i];
+    s->n += sign;
+    for (int i = 0; i < 3; i++) s->sum[i] += sign * d[i];
+    s->prod[0] += sign * d[0] * d[0];
+    s->prod[1] += sign * d[1] * d[1];
+    s->prod[2] += sign * d[2] * d[2];
+    s->prod[3] += sign * d[0] * d[1];
+    s->prod[4] += sign * d[0] * d[2];
+    s->prod[5] += sign * d[1] * d[2];
+}
+
+// move the origin of the sums by c, exactly.
+static void shift_sums(StatSums *s, const int64_t c[3]) {
+    static const uint8_t pi[6] = { 0, 1, 2, 0, 0, 1 };
+    static const uint8_t pj[6] = { 0, 1, 2, 1, 2, 2 };
+    // sum((x_i - c_i)(x_j - c_j)) = P_ij - c_i S_j - c_j S_i + n c_i c_j
+    for (int k = 0; k < 6; k++) {
+        int i = pi[k];
+        int j = pj[k];
+        s->prod[k] -= c[i] * s->sum[j] + c[j] * (s->sum[i] - (int64_t)s->n * c[i]);
+    }
+    for (int i = 0; i < 3; i++) s->sum[i] -= (int64_t)s->n * c[i];
+}
+
+/***************************
+ * structors               *
+ ***************************/
+
+/**
+ * Construct a new `FixStats`, with no sliding window.
+ */
+FixStats::FixStats():
+        m_samples(NULL),
+        m_win_len(0) {
+    reset();
+}
+
+/**
+ * Discard all samples. The next fix will become the new reference point.
+ */
+void FixStats::reset() {
+    m_ref = PosFix();
+    memset(m_origin, 0, sizeof(m_origin));
+    memset(&m_all, 0, sizeof(StatSums));
+    memset(&m_win, 0, sizeof(StatSums));
+    m_win_head = 0;
+}
+
+/**
+ * Keep statistics over a sliding window of the most recent fixes, in
+ * addition to the cumulative statistics. The window is emptied.
+ *
+ * @param samples Storage for the samples of the window. Must outlive the
+ * `FixStats`, or be replaced by a call to `setWindow()`.
+ * @param len Number of samples in the window; 0 for no window.
+ */
+void FixStats::setWindow(int32_t (*samples)[3], uint16_t len) {
+    m_samples  = (len > 0) ? samples : NULL;
+    m_win_len  = (samples != NULL) ? len : 0;
+    m_win_head = 0;
+    memset(&m_win, 0, sizeof(StatSums));
+}
+
+/***************************
+ * accumulation            *
+ ***************************/
+
+/**
+ * Add a position fix to the statistics.
+ *
+ * If the fix is of a different frame (LLA vs. ECEF) than the reference
+ * point, the statistics are reset and the fix becomes the new reference point.
+ *
+ * @param pfix New position fix.
+ * @return `false` if `pfix` is not a valid fix, or is too far from the mean
+ * to be accepted; `true` otherwise.
+ */
+bool FixStats::update(const PosFix &pfix) {
+    int64_t fixed[3];
+    if (not fix_to_fixed(pfix, fixed)) return false;
+    if (m_ref.type == RPT_NONE or is_lla(pfix.type) != is_lla(m_ref.type)) {
+        reset();
+        setReference(pfix, fixed);
+    }
+
+    int64_t d[3];
+    for (int i = 0; i < 3; i++) d[i] = fixed[i] - m_ref_fixed[i];
+    if (is_lla(m_ref.type)) {
+        // longitude wraps around
+        if      (d[0] >  FIXP_ANGLE_2PI / 2) d[0] -= FIXP_ANGLE_2PI;
+        else if (d[0] < -FIXP_ANGLE_2PI / 2) d[0] += FIXP_ANGLE_2PI;
+        // small angles; float offsets are good to well under a millimeter.
+        d[0] = round_to_int(d[0] * (FIXP_ANGLE_SCALE * m_frame.east));
+        d[1] = round_to_int(d[1] * (FIXP_ANGLE_SCALE * m_frame.north));
+        d[2] = length_to_mm(d[2]);
+    } else {
+        for (int i = 0; i < 3; i++) d[i] = length_to_mm(d[i]);
+    }
+
+    int32_t x[3];
+    for (int i = 0; i < 3; i++) {
+        int64_t r = d[i] - m_origin[i];
+        if (r > STATS_MAX_RANGE or r < -STATS_MAX_RANGE) return false;
+        x[i] = (int32_t)d[i];
+    }
+
+    add_sample(&m_all, x, m_origin, 1);
+    if (m_samples != NULL) {
+        uint16_t slot;
+        if (m_win.n == m_win_len) {
+            add_sample(&m_win, m_samples[m_win_head], m_origin, -1);
+            slot = m_win_head;
+            m_win_head = (m_win_head + 1) % m_win_len;
+        } else {
+            slot = (m_win_head + m_win.n) % m_win_len;
+        }
+        memcpy(m_samples[slot], x, sizeof(x));
+        add_sample(&m_win, x, m_origin, 1);
+    }
+
+    // keep the sums small by following the mean.
+    int64_t lim = (int64_t)m_all.n * RECENTER_DIST;
+    for (int i = 0; i < 3; i++) {
+        if (m_all.sum[i] > lim or m_all.sum[i] < -lim) {
+            int32_t origin[3];
+            for (int j = 0; j < 3; j++) {
+                origin[j] = m_origin[j] + (int32_t)(m_all.sum[j] / (int64_t)m_all.n);
+            }
+            recenter(origin);
+            break;
+        }
+    }
+    return true;
+}
+
+void FixStats::recenter(const int32_t origin[3]) {
+    int64_t c[3];
+    for (int i = 0; i < 3; i++) {
+        c[i] = (int64_t)origin[i] - m_origin[i];
+        m_origin[i] = origin[i];
+    }
+    shift_sums(&m_all, c);
+    shift_sums(&m_win, c);
+}
+
+void FixStats::setReference(const PosFix &pfix, const int64_t fixed[3]) {
+    m_ref = pfix;
+    for (int i = 0; i < 3; i++) m_ref_fixed[i] = fixed[i];
+    local_frame(fixed, is_lla(pfix.type), &m_frame);
+    // offsets are taken in millimeters
+    m_frame.north *= 1000;
+    m_frame.east  *= 1000;
+}
+
+/***************************
+ * access                  *
+ ***************************/
+
+/**
+ * Compute the statistics of the cumulative or windowed samples. Takes
+ * constant time.
+ *
+ * @param out Destination of the statistics.
+ * @param span Which samples to compute the statistics of.
+ * @return `false` if there are no samples, in which case `out` is unaltered.
+ */
+bool FixStats::getStats(PositionStats *out, StatsSpan span) const {
+    const StatSums &s = (span == STATS_WINDOW) ? m_win : m_all;
+    if (s.n == 0) return false;
+    int64_t n = s.n;
+
+    // sums of squared deviations are found exactly about the truncated
+    // mean q, then corrected by the remainder r: sum = q*n + r, |r| < n.
+    int64_t q[3];
+    int64_t r[3];
+    for (int i = 0; i < 3; i++) {
+        q[i] = s.sum[i] / n;
+        r[i] = s.sum[i] - q[i] * n;
+        int32_t round = (2 * r[i] >= n) ? 1 : (2 * r[i] <= -n) ? -1 : 0;
+        out->mean[i] = m_origin[i] + (int32_t)q[i] + round;
+    }
+    static const uint8_t pi[6] = { 0, 1, 2, 0, 0, 1 };
+    static const uint8_t pj[6] = { 0, 1, 2, 1, 2, 2 };
+    float m2[6];
+    float dof = (n > 1) ? (float)(n - 1) : 1.0f;
+    for (int k = 0; k < 6; k++) {
+        int i = pi[k];
+        int j = pj[k];
+        int64_t m = s.prod[k] - q[i] * s.sum[j] - q[j] * r[i];
+        m2[k] = ((float)m - (float)r[i] * (float)r[j] / (float)n) / dof;
+    }
+    out->n = s.n;
+    for (int i = 0; i < 3; i++) {
+        out->var[i] = m2[i];
+        out->cov[i] = m2[i + 3];
+    }
+
+    // horizontal covariance
+    float ee, nn, en;
+    if (is_lla(m_ref.type)) {
+        ee = m2[0];
+        nn = m2[1];
+        en = m2[3];
+    } else {
+        // rotate the ECEF covariance to east and north
+        const LocalFrame &f = m_frame;
+        float e[3]  = { -f.sin_lng, f.cos_lng, 0 };
+        float no[3] = { -f.sin_lat * f.cos_lng, -f.sin_lat * f.sin_lng, f.cos_lat };
+        float c[3][3] = {
+            { m2[0], m2[3], m2[4] },
+            { m2[3], m2[1], m2[5] },
+            { m2[4], m2[5], m2[2] },
+        };
+        ee = nn = en = 0;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                ee += e[i] * c[i][j] * e[j];
+                nn += no[i] * c[i][j] * no[j];
+                en += e[i] * c[i][j] * no[j];
+            }
+        }
+    }
+    float mid  = (ee + nn) / 2;
+    float diff = (ee - nn) / 2;
+    float rad  = sqrt(diff * diff + en * en);
+    float l2   = mid - rad;
+    out->cep   = CEP_FACTOR * (sqrt(mid + rad) + sqrt(l2 > 0 ? l2 : 0));
+    out->drms2 = 2 * sqrt(ee + nn);
+    return true;
+}
+
+/**
+ * Get the number of samples in the cumulative statistics or the window.
+ */
+uint32_t FixStats::getCount(StatsSpan span) const {
+    return (span == STATS_WINDOW) ? m_win.n : m_all.n;
+}
+
+/**
+ * Get the type of position fix defining the local frame; either an LLA type
+ * (east/north/up axes) or an ECEF type (X/Y/Z axes). `RPT_NONE` if no fix
+ * has been added yet.
+ */
+ReportType FixStats::getFrame() const {
+    return m_ref.type;
+}
+
+/**
+ * Get the fix which defines the reference point of the local frame. The mean
+ * position is the reference point offset by `PositionStats::mean`.
+ */
+const PosFix& FixStats::getReference() const {
+    return m_ref;
+}
@@ -0,0 +1,128 @@
+/*
+ * File:   fixstats.h
+ */
+
+#ifndef FIXSTATS_H
+#define	FIXSTATS_H
+
+#include "gpstype.h"
+#include "fixp.h"
+
+/**
+ * @addtogroup processing
+ * @{
+ */
+
+/// Greatest distance (mm) from the mean at which fixes are accepted, on any axis.
+#define STATS_MAX_RANGE 16777216
+
+enum StatsSpan {
+    /// All samples since the statistics were reset.
+    STATS_CUMULATIVE,
+    /// The most recent samples, up to the length of the window.
+    STATS_WINDOW,
+};
+
+/**
+ * @brief Statistics of a set of position samples.
+ *
+ * All quantities are in millimeters (or square millimeters), along the axes of
+ * the local frame of the `FixStats` they were taken from.
+ */
+struct PositionStats {
+    /// Number of samples.
+    uint32_t n;
+    /// Mean offset from the reference point.
+    int32_t  mean[3];
+    /// Sample variance of each axis.
+    float    var[3];
+    /// Sample covariance of axes (0, 1), (0, 2), and (1, 2).
+    float    cov[3];
+    /// Circular error probable; radius containing 50% of the horizontal samples.
+    float    cep;
+    /// Twice the horizontal distance root mean square; radius containing ~95%.
+    float    drms2;
+};
+
+// exact integer sums of samples, relative to an origin.
+struct StatSums {
+    uint32_t n;
+    int64_t  sum[3];
+    int64_t  prod[6]; // xx, yy, zz, xy, xz, yz
+};
+
+/**
+ * @brief Accumulates statistics of position fixes, over all fixes and over
+ * a sliding window of recent fixes.
+ *
+ * Intended for averaging the position of a stationary receiver, e.g. for a
+ * survey or timing installation. Fixes are converted to integer millimeter
+ * offsets from a reference point (the first fix) in a local frame, whose
+ * axes are east, north, and up for LLA fixes, and the ECEF X, Y, and Z axes
+ * for ECEF fixes. Sums of the offsets and of their products are kept exactly
+ * in 64-bit integers, so that no precision is lost over any number of fixes,
+ * and no 64-bit `double` is needed for 64-bit fixes.
+ *
+ * Updates take constant time, as does reading the statistics, which may be
+ * done at any time. The sliding window stores each of its samples (12 bytes
+ * each) in memory provided by the caller; without it, only the cumulative
+ * statistics are kept.
+ *
+ * To keep the sums small, they are taken relative to an origin which follows
+ * the cumulative mean. Fixes further than `STATS_MAX_RANGE` from the origin
+ * are rejected as outliers; at that range, the sums could overflow after
+ * about 30,000 fixes, but at the spreads typical of a stationary receiver
+ * they would take centuries.
+ *
+ * Example:
+ *
+ *      int32_t window[600][3];
+ *      FixStats stats;
+ *      stats.setWindow(window, 600);
+ *      // ...
+ *      if (gps.processOnePacket() == RPT_FIX_POS_LLA_64) {
+ *          stats.update(gps.getPositionFix());
+ *      }
+ *      // ...
+ *      PositionStats s;
+ *      if (stats.getStats(&s, STATS_WINDOW)) {
+ *          // s.cep is the CEP of the last 600 fixes, in mm.
+ *      }
+ */
+class FixStats {
+public:
+    FixStats();
+
+    void setWindow(int32_t (*samples)[3], uint16_t len);
+    void reset();
+    bool update(const PosFix &pfix);
+
+    bool getStats(PositionStats *out, StatsSpan span=STATS_CUMULATIVE) const;
+    uint32_t      getCount(StatsSpan span=STATS_CUMULATIVE) const;
+    ReportType    getFrame() const;
+    const PosFix& getReference() const;
+
+private:
+
+    void setReference(const PosFix &pfix, const int64_t fixed[3]);
+    void recenter(const int32_t origin[3]);
+
+    // reference point of the local frame
+    PosFix  m_ref;
+    int64_t m_ref_fixed[3];
+    LocalFrame m_frame; // north, east in millimeters per radian
+
+    // origin of the sums, relative to the reference point
+    int32_t  m_origin[3];
+    StatSums m_all;
+    StatSums m_win;
+
+    // sliding window, relative to the reference point
+    int32_t (*m_samples)[3];
+    uint16_t  m_win_len;
+    uint16_t  m_win_head; // oldest sample
+};
+
+/// @} // addtogroup processing
+
+#endif	/* FIXSTATS_H */
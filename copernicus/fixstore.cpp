@@ -0,0 +1,458 @@
+/*
+ * File:   fixstore.cpp
+ */
+
+#include <string.h>
+
+#include "fixstore.h"
+#include "fixp.h"
+
+#define MS_PER_WEEK     604800000LL
+#define SECONDS_PER_WEEK 604800
+
+static inline size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+static inline uint32_t n_blocks(uint32_t rows) {
+    return (rows + STORE_BLOCK_ROWS - 1) / STORE_BLOCK_ROWS;
+}
+
+// bytes of column storage for one segment
+static size_t segment_bytes(uint32_t rows) {
+    return align8(rows * (4 * sizeof(int32_t) + sizeof(uint16_t)) +
+                  n_blocks(rows) * sizeof(StoreZone));
+}
+
+// spread the bits of x into the even bits of the result
+static inline uint32_t spread_bits(uint32_t x) {
+    x &= 0xFFFF;
+    x = (x | (x << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+// Z-order code of a position, from the top 16 bits of each coordinate.
+static inline uint32_t morton(int32_t lat, int32_t lng) {
+    uint32_t y = ((uint32_t)lat + 0x80000000u) >> 16;
+    uint32_t x = ((uint32_t)lng + 0x80000000u) >> 16;
+    return (spread_bits(y) << 1) | spread_bits(x);
+}
+
+static inline void zone_clear(StoreZone *z) {
+    z->t_min   = z->lat_min = z->lng_min = 0x7FFFFFFF;
+    z->t_max   = z->lat_max = z->lng_max = -0x7FFFFFFF - 1;
+}
+
+static inline void zone_add(StoreZone *z, int32_t t, int32_t lat, int32_t lng) {
+    if (t   < z->t_min)   z->t_min   = t;
+    if (t   > z->t_max)   z->t_max   = t;
+    if (lat < z->lat_min) z->lat_min = lat;
+    if (lat > z->lat_max) z->lat_max = lat;
+    if (lng < z->lng_min) z->lng_min = lng;
+    if (lng > z->lng_max) z->lng_max = lng;
+}
+
+// the query, with its times made relative to a segment
+struct SegmentQuery {
+    int32_t t0, t1;
+    int32_t lat_min, lat_max;
+    int32_t lng_min, lng_max;
+};
+
+static inline bool zone_overlaps(const StoreZone &z, const SegmentQuery &q) {
+    return z.t_min <= q.t1 and z.t_max >= q.t0 and
+           z.lat_min <= q.lat_max and z.lat_max >= q.lat_min and
+           z.lng_min <= q.lng_max and z.lng_max >= q.lng_min;
+}
+
+static inline bool zone_inside(const StoreZone &z, const SegmentQuery &q) {
+    return z.t_min >= q.t0 and z.t_max <= q.t1 and
+           z.lat_min >= q.lat_min and z.lat_max <= q.lat_max and
+           z.lng_min >= q.lng_min and z.lng_max <= q.lng_max;
+}
+
+/***************************
+ * structors               *
+ ***************************/
+
+/**
+ * Construct a new, empty `FixStore` in the given memory.
+ *
+ * @param mem Memory for the store, aligned for a `uint64_t`. Must outlive
+ * the store.
+ * @param size Size of `mem` in bytes. The store holds as many segments as fit;
+ * see `bytesNeeded()`.
+ * @param rows_per_segment Greatest number of fixes in each segment.
+ * @param partition_ms Length of the time partitions, in milliseconds.
+ */
+FixStore::FixStore(void *mem, size_t size, uint32_t rows_per_segment, uint32_t partition_ms):
+        m_segs(NULL),
+        m_n_segs(0),
+        m_head(0),
+        m_count(0),
+        m_rows_per_seg(rows_per_segment),
+        m_partition_ms(partition_ms > 0 ? partition_ms : 1),
+        m_n_rows(0),
+        m_scratch(NULL),
+        m_jump_t(0),
+        m_jump_count(0) {
+    if (mem == NULL or rows_per_segment == 0) return;
+    size_t scratch = 2 * sizeof(uint64_t) * (size_t)rows_per_segment;
+    size_t per     = align8(sizeof(StoreSegment)) + segment_bytes(rows_per_segment);
+    if (size < scratch + per) return;
+    m_n_segs = (size - scratch) / per;
+
+    // [scratch][segment headers][columns of each segment]
+    uint8_t *p = static_cast<uint8_t*>(mem);
+    m_scratch  = reinterpret_cast<uint64_t*>(p);
+    p += scratch;
+    m_segs = reinterpret_cast<StoreSegment*>(p);
+    p += align8(m_n_segs * sizeof(StoreSegment));
+    for (uint32_t i = 0; i < m_n_segs; i++) {
+        StoreSegment *s = m_segs + i;
+        uint32_t n = rows_per_segment;
+        s->time     = reinterpret_cast<int32_t*>(p);
+        s->lat      = s->time + n;
+        s->lng      = s->lat  + n;
+        s->alt      = s->lng  + n;
+        s->blocks   = reinterpret_cast<StoreZone*>(s->alt + n);
+        s->receiver = reinterpret_cast<uint16_t*>(s->blocks + n_blocks(n));
+        p += segment_bytes(n);
+    }
+}
+
+/**
+ * Get the number of bytes of memory needed for a store holding the given
+ * number of segments.
+ */
+size_t FixStore::bytesNeeded(uint32_t n_segments, uint32_t rows_per_segment) {
+    return 2 * sizeof(uint64_t) * (size_t)rows_per_segment +
+           align8(n_segments * sizeof(StoreSegment)) +
+           n_segments * segment_bytes(rows_per_segment);
+}
+
+/**
+ * Get the time of a fix, in milliseconds since the GPS epoch.
+ *
+ * @param week GPS week number.
+ * @param fixtime Time of week of the fix, in seconds.
+ * @return The time of the fix, or -1 if `fixtime` is negative (i.e. there
+ * is no valid fix).
+ */
+int64_t FixStore::fixTime(int16_t week, Float32 fixtime) {
+    if (fixtime.bits & 0x80000000) return -1;
+    int64_t t_1024 = to_fixed(fixtime, 10); // 1/1024ths of a second
+    return week * MS_PER_WEEK + ((t_1024 * 1000 + 512) >> 10);
+}
+
+/***************************
+ * ingest                  *
+ ***************************/
+
+/**
+ * Add the position fix of an epoch. The week of the fix is taken from the
+ * epoch's GPS time.
+ *
+ * @param receiver ID of the receiver which made the fix, less than
+ * `STORE_MAX_RECEIVERS`.
+ * @param epoch Epoch holding the fix.
+ * @return `false` if the fix is not a valid LLA fix, the receiver ID is
+ * out of range, or the fix's time is too far from the others' (see
+ * `FixStore`).
+ */
+bool FixStore::add(uint16_t receiver, const GPSEpoch &epoch) {
+    int16_t week = epoch.time.week_no;
+    // the fix may be from just before or after the time report's week turned.
+    int64_t fix_s = to_fixed(epoch.pfix.getFixTime(), 0);
+    int64_t rpt_s = to_fixed(epoch.time.time_of_week, 0);
+    if      (fix_s - rpt_s >  SECONDS_PER_WEEK / 2) week--;
+    else if (rpt_s - fix_s >  SECONDS_PER_WEEK / 2) week++;
+    return add(receiver, week, epoch.pfix);
+}
+
+/**
+ * Add a position fix.
+ *
+ * @param receiver ID of the receiver which made the fix, less than
+ * `STORE_MAX_RECEIVERS`.
+ * @param week GPS week in which the fix was made.
+ * @param pfix The fix.
+ * @return `false` if the fix is not a valid LLA fix, the receiver ID is
+ * out of range, or the fix's time is too far from the others' (see
+ * `FixStore`).
+ */
+bool FixStore::add(uint16_t receiver, int16_t week, const PosFix &pfix) {
+    if (m_n_segs == 0 or receiver >= STORE_MAX_RECEIVERS) return false;
+    int32_t lat, lng, alt;
+    Float32 fixtime;
+    if (pfix.type == RPT_FIX_POS_LLA_32) {
+        const LLA_Fix<Float32> *f = pfix.getLLA_32();
+        lat = (int32_t)to_fixed(f->lat, STORE_ANGLE_BITS);
+        lng = (int32_t)to_fixed(f->lng, STORE_ANGLE_BITS);
+        alt = (int32_t)((to_fixed(f->alt, 10) * 1000) >> 10);
+        fixtime = f->fixtime;
+    } else if (pfix.type == RPT_FIX_POS_LLA_64) {
+        const LLA_Fix<Float64> *f = pfix.getLLA_64();
+        lat = (int32_t)to_fixed(f->lat, STORE_ANGLE_BITS);
+        lng = (int32_t)to_fixed(f->lng, STORE_ANGLE_BITS);
+        alt = (int32_t)((to_fixed(f->alt, 10) * 1000) >> 10);
+        fixtime = f->fixtime;
+    } else {
+        return false;
+    }
+    int64_t t = fixTime(week, fixtime);
+    if (t < 0) return false;
+
+    StoreSegment *seg = (m_count > 0) ? m_segs + (m_head + m_count - 1) % m_n_segs : NULL;
+    if (seg != NULL) {
+        // a time far from the active segment's is more likely corrupt than
+        // real; don't let it begin a segment, and so discard the oldest.
+        if (t < seg->t_base - STORE_MAX_JUMP_MS) return false;
+        if (t >= seg->t_base + m_partition_ms + STORE_MAX_JUMP_MS) {
+            if (not confirmJump(t)) return false;
+        } else {
+            m_jump_count = 0;
+        }
+    }
+    if (seg == NULL or seg->sealed or seg->n_rows == m_rows_per_seg or
+            t >= seg->t_base + m_partition_ms) {
+        if (seg != NULL and not seg->sealed) sealSegment(seg);
+        seg = beginSegment(t - t % m_partition_ms);
+    }
+
+    uint32_t i  = seg->n_rows++;
+    int32_t  dt = (int32_t)(t - seg->t_base);
+    seg->receiver[i] = receiver;
+    seg->time[i]     = dt;
+    seg->lat[i]      = lat;
+    seg->lng[i]      = lng;
+    seg->alt[i]      = alt;
+    StoreZone *block = seg->blocks + i / STORE_BLOCK_ROWS;
+    if (i % STORE_BLOCK_ROWS == 0) zone_clear(block);
+    zone_add(block, dt, lat, lng);
+    zone_add(&seg->zone, dt, lat, lng);
+    m_n_rows++;
+    return true;
+}
+
+// whether a fix at time `t`, far ahead of the active segment, is borne out
+// by the suspect fixes before it.
+bool FixStore::confirmJump(int64_t t) {
+    if (m_jump_count > 0 and (t - m_jump_t > STORE_MAX_JUMP_MS or
+                              m_jump_t - t > STORE_MAX_JUMP_MS)) {
+        m_jump_count = 0;
+    }
+    m_jump_t = t;
+    if (++m_jump_count < STORE_JUMP_CONFIRM) return false;
+    m_jump_count = 0;
+    return true;
+}
+
+/**
+ * Seal the segment being filled, so that it may be searched most quickly.
+ * Later fixes will begin a new segment. Segments are sealed automatically
+ * when they fill or their partition ends, so this is needed only when fixes
+ * stop arriving.
+ */
+void FixStore::seal() {
+    if (m_count == 0) return;
+    StoreSegment *seg = m_segs + (m_head + m_count - 1) % m_n_segs;
+    if (not seg->sealed) sealSegment(seg);
+}
+
+StoreSegment* FixStore::beginSegment(int64_t t_base) {
+    if (m_count == m_n_segs) {
+        // discard the oldest
+        m_n_rows -= m_segs[m_head].n_rows;
+        m_head = (m_head + 1) % m_n_segs;
+        m_count--;
+    }
+    StoreSegment *seg = m_segs + (m_head + m_count) % m_n_segs;
+    m_count++;
+    seg->t_base = t_base;
+    seg->n_rows = 0;
+    seg->sealed = false;
+    zone_clear(&seg->zone);
+    return seg;
+}
+
+// sort a segment's rows into Z-order, and rebuild its block zones.
+void FixStore::sealSegment(StoreSegment *seg) {
+    uint32_t n = seg->n_rows;
+    uint64_t *keys = m_scratch;
+    uint64_t *tmp  = m_scratch + m_rows_per_seg;
+    for (uint32_t i = 0; i < n; i++) {
+        keys[i] = ((uint64_t)morton(seg->lat[i], seg->lng[i]) << 32) | i;
+    }
+    // LSD radix sort on the 32 key bits, one byte per pass.
+    for (int shift = 32; shift < 64; shift += 8) {
+        uint32_t count[257];
+        memset(count, 0, sizeof(count));
+        for (uint32_t i = 0; i < n; i++) count[((keys[i] >> shift) & 0xFF) + 1]++;
+        for (int b = 0; b < 256; b++) count[b + 1] += count[b];
+        for (uint32_t i = 0; i < n; i++) tmp[count[(keys[i] >> shift) & 0xFF]++] = keys[i];
+        uint64_t *swap = keys;
+        keys = tmp;
+        tmp  = swap;
+    }
+
+    // permute each column into sorted order, through the spare buffer.
+    int32_t *cols[4] = { seg->time, seg->lat, seg->lng, seg->alt };
+    int32_t *col_tmp = reinterpret_cast<int32_t*>(tmp);
+    for (int c = 0; c < 4; c++) {
+        for (uint32_t i = 0; i < n; i++) col_tmp[i] = cols[c][(uint32_t)keys[i]];
+        memcpy(cols[c], col_tmp, n * sizeof(int32_t));
+    }
+    uint16_t *rcv_tmp = reinterpret_cast<uint16_t*>(tmp);
+    for (uint32_t i = 0; i < n; i++) rcv_tmp[i] = seg->receiver[(uint32_t)keys[i]];
+    memcpy(seg->receiver, rcv_tmp, n * sizeof(uint16_t));
+
+    for (uint32_t i = 0; i < n; i++) {
+        StoreZone *block = seg->blocks + i / STORE_BLOCK_ROWS;
+        if (i % STORE_BLOCK_ROWS == 0) zone_clear(block);
+        zone_add(block, seg->time[i], seg->lat[i], seg->lng[i]);
+    }
+    seg->sealed = true;
+}
+
+/***************************
+ * queries                 *
+ ***************************/
+
+template <typename Visit>
+uint32_t FixStore::search(const StoreQuery &q, uint32_t first_seg, uint32_t n_segs,
+                          Visit &visit) const {
+    uint32_t found = 0;
+    if (first_seg >= m_count) return 0;
+    if (n_segs > m_count - first_seg) n_segs = m_count - first_seg;
+    for (uint32_t s = first_seg; s < first_seg + n_segs; s++) {
+        const StoreSegment *seg = segment(s);
+        // times relative to the segment, clamped to the range of its columns
+        int64_t t0 = q.t0 - seg->t_base;
+        int64_t t1 = q.t1 - seg->t_base;
+        if (t1 < -0x7FFFFFFFLL or t0 > 0x7FFFFFFFLL) continue;
+        SegmentQuery sq;
+        sq.t0 = (t0 < -0x7FFFFFFFLL) ? -0x7FFFFFFF : (int32_t)t0;
+        sq.t1 = (t1 >  0x7FFFFFFFLL) ?  0x7FFFFFFF : (int32_t)t1;
+        sq.lat_min = q.lat_min;
+        sq.lat_max = q.lat_max;
+        sq.lng_min = q.lng_min;
+        sq.lng_max = q.lng_max;
+        if (seg->n_rows == 0 or not zone_overlaps(seg->zone, sq)) continue;
+
+        for (uint32_t b = 0; b * STORE_BLOCK_ROWS < seg->n_rows; b++) {
+            const StoreZone &zone = seg->blocks[b];
+            if (not zone_overlaps(zone, sq)) continue;
+            uint32_t i0 = b * STORE_BLOCK_ROWS;
+            uint32_t i1 = i0 + STORE_BLOCK_ROWS;
+            if (i1 > seg->n_rows) i1 = seg->n_rows;
+            if (zone_inside(zone, sq)) {
+                // every row matches
+                for (uint32_t i = i0; i < i1; i++) visit(seg, i);
+                found += i1 - i0;
+                continue;
+            }
+            for (uint32_t i = i0; i < i1; i++) {
+                int32_t t   = seg->time[i];
+                int32_t lat = seg->lat[i];
+                int32_t lng = seg->lng[i];
+                if (t < sq.t0 or t > sq.t1) continue;
+                if (lat < sq.lat_min or lat > sq.lat_max) continue;
+                if (lng < sq.lng_min or lng > sq.lng_max) continue;
+                visit(seg, i);
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+struct RowVisit {
+    StoreVisitor fn;
+    void *ctx;
+    void operator()(const StoreSegment *seg, uint32_t i) {
+        StoreRow row;
+        row.receiver = seg->receiver[i];
+        row.time_ms  = seg->t_base + seg->time[i];
+        row.lat      = seg->lat[i];
+        row.lng      = seg->lng[i];
+        row.alt_mm   = seg->alt[i];
+        fn(ctx, row);
+    }
+};
+
+struct ReceiverVisit {
+    uint8_t *bits;
+    void operator()(const StoreSegment *seg, uint32_t i) {
+        uint16_t r = seg->receiver[i];
+        bits[r / 8] |= 1 << (r % 8);
+    }
+};
+
+/**
+ * Find the fixes within a box during a range of time.
+ *
+ * @param q The box and the range of time.
+ * @param visit Function to call with each matching fix, in no particular order.
+ * @param ctx Argument passed to `visit`.
+ * @param first_seg Index of the first segment to search; 0 is the oldest.
+ * @param n_segs Number of segments to search.
+ * @return The number of matching fixes.
+ */
+uint32_t FixStore::query(const StoreQuery &q, StoreVisitor visit, void *ctx,
+                         uint32_t first_seg, uint32_t n_segs) const {
+    RowVisit v;
+    v.fn  = visit;
+    v.ctx = ctx;
+    return search(q, first_seg, n_segs, v);
+}
+
+/**
+ * Find which receivers were within a box during a range of time.
+ *
+ * @param q The box and the range of time.
+ * @param receivers Bitset of `STORE_MAX_RECEIVERS` bits; bit `id % 8` of byte
+ * `id / 8` is set for each receiver with a matching fix. Bits are only set,
+ * so the results of queries over different segments may be accumulated.
+ * @param first_seg Index of the first segment to search; 0 is the oldest.
+ * @param n_segs Number of segments to search.
+ * @return The number of matching fixes.
+ */
+uint32_t FixStore::queryReceivers(const StoreQuery &q, uint8_t *receivers,
+                                  uint32_t first_seg, uint32_t n_segs) const {
+    ReceiverVisit v;
+    v.bits = receivers;
+    return search(q, first_seg, n_segs, v);
+}
+
+/***************************
+ * access                  *
+ ***************************/
+
+const StoreSegment* FixStore::segment(uint32_t i) const {
+    return m_segs + (m_head + i) % m_n_segs;
+}
+
+/**
+ * Get the number of segments holding fixes.
+ */
+uint32_t FixStore::getSegmentCount() const {
+    return m_count;
+}
+
+/**
+ * Get the number of segments the store can hold.
+ */
+uint32_t FixStore::getSegmentLimit() const {
+    return m_n_segs;
+}
+
+/**
+ * Get the number of fixes in the store.
+ */
+uint64_t FixStore::getRowCount() const {
+    return m_n_rows;
+}
@@ -0,0 +1,173 @@
+/*
+ * File:   fixstore.h
+ */
+
+#ifndef FIXSTORE_H
+#define	FIXSTORE_H
+
+#include <stddef.h>
+
+#include "gpstype.h"
+#include "fixring.h"
+
+/**
+ * @addtogroup processing
+ * @{
+ */
+
+/// Fractional bits of the stored angles; one unit is 2^-29 radians, about 1.2 cm.
+#define STORE_ANGLE_BITS   29
+/// Rows summarized by each zone map within a segment.
+#define STORE_BLOCK_ROWS   256
+/// Receiver IDs must be less than this.
+#define STORE_MAX_RECEIVERS 1024
+
+#ifndef STORE_MAX_JUMP_MS
+/// Fixes further than this before the active segment's partition, or after its end, are suspect.
+#define STORE_MAX_JUMP_MS   86400000
+#endif
+#ifndef STORE_JUMP_CONFIRM
+/// Suspect fixes needed in a row, close together in time, before their time is believed.
+#define STORE_JUMP_CONFIRM  16
+#endif
+
+/// Stored angle for a latitude or longitude in radians.
+#define STORE_ANGLE(rad) ((int32_t)((rad) * 536870912.0))
+
+/**
+ * @brief One stored fix.
+ */
+struct StoreRow {
+    /// ID of the receiver, given when the fix was added.
+    uint16_t receiver;
+    /// Time of the fix, in milliseconds since the GPS epoch.
+    int64_t  time_ms;
+    /// Latitude and longitude, in units of 2^-`STORE_ANGLE_BITS` radians.
+    int32_t  lat, lng;
+    /// Altitude, in millimeters.
+    int32_t  alt_mm;
+};
+
+/**
+ * @brief A region of space and time to search for fixes.
+ */
+struct StoreQuery {
+    /// Bounds of the time range, in milliseconds since the GPS epoch, inclusive.
+    int64_t t0, t1;
+    /// Bounds of the box, in units of 2^-`STORE_ANGLE_BITS` radians, inclusive.
+    int32_t lat_min, lat_max;
+    int32_t lng_min, lng_max;
+};
+
+// bounds of a set of rows
+struct StoreZone {
+    int32_t  t_min, t_max; // ms since the start of the segment's partition
+    int32_t  lat_min, lat_max;
+    int32_t  lng_min, lng_max;
+};
+
+// a run of rows from a single time partition, stored by column.
+struct StoreSegment {
+    int64_t   t_base;   // ms since the GPS epoch at which the partition starts
+    uint32_t  n_rows;
+    bool      sealed;   // full or finished, and sorted in Z-order
+    StoreZone zone;
+    uint16_t  *receiver;
+    int32_t   *time;
+    int32_t   *lat;
+    int32_t   *lng;
+    int32_t   *alt;
+    StoreZone *blocks;
+};
+
+/**
+ * Function called for each row matching a query.
+ */
+typedef void (*StoreVisitor)(void *ctx, const StoreRow &row);
+
+/**
+ * @brief Stores fixes from many receivers, for searching by time and place.
+ *
+ * Fixes are stored by column, in segments which each cover a single
+ * partition of GPS time (one hour, by default); fixes arriving late are kept
+ * with the segment being filled. Each segment keeps the bounds in time and
+ * space of its rows, and of each block of `STORE_BLOCK_ROWS` rows within it,
+ * so that queries can skip segments and blocks which cannot match. When a
+ * segment is sealed (because it is full, or its partition has ended), its
+ * rows are sorted by the Z-order (Morton) code of their positions, which
+ * gathers nearby fixes into the same blocks and makes their bounds tight.
+ *
+ * All memory is provided by the caller, and divided into segments of equal
+ * capacity. When all are in use, the oldest is discarded.
+ *
+ * So that one corrupt timestamp cannot discard history, a fix from more
+ * than `STORE_MAX_JUMP_MS` before the partition of the segment being filled
+ * is refused, as is a fix from more than `STORE_MAX_JUMP_MS` after it. A
+ * jump ahead is only believed once `STORE_JUMP_CONFIRM` such fixes in a row,
+ * each within `STORE_MAX_JUMP_MS` of the last, bear it out (as after the
+ * store is restarted following an outage); the fix which confirms it is
+ * stored, those before it are not.
+ *
+ * Queries may be restricted to a range of segments, so that searching the
+ * store may be divided among threads; each segment is searched independently.
+ * Queries must not be made concurrently with `add()`.
+ *
+ * Only LLA fixes are stored.
+ *
+ * Example:
+ *
+ *      FixStore store(mem, mem_size, 65536);
+ *      store.add(receiver_id, epoch);
+ *      // ...
+ *      StoreQuery q;
+ *      q.t0 = t0; q.t1 = t1;
+ *      q.lat_min = STORE_ANGLE(0.65); // ...
+ *      uint8_t who[STORE_MAX_RECEIVERS / 8];
+ *      store.queryReceivers(q, who);
+ */
+class FixStore {
+public:
+    FixStore(void *mem, size_t size, uint32_t rows_per_segment,
+             uint32_t partition_ms=3600000);
+
+    static size_t bytesNeeded(uint32_t n_segments, uint32_t rows_per_segment);
+    static int64_t fixTime(int16_t week, Float32 fixtime);
+
+    bool add(uint16_t receiver, const GPSEpoch &epoch);
+    bool add(uint16_t receiver, int16_t week, const PosFix &pfix);
+    void seal();
+
+    uint32_t query(const StoreQuery &q, StoreVisitor visit, void *ctx,
+                   uint32_t first_seg=0, uint32_t n_segs=0xFFFFFFFF) const;
+    uint32_t queryReceivers(const StoreQuery &q, uint8_t *receivers,
+                            uint32_t first_seg=0, uint32_t n_segs=0xFFFFFFFF) const;
+
+    uint32_t getSegmentCount()  const;
+    uint32_t getSegmentLimit()  const;
+    uint64_t getRowCount()      const;
+
+private:
+
+    const StoreSegment* segment(uint32_t i) const;
+    StoreSegment* beginSegment(int64_t t_base);
+    void sealSegment(StoreSegment *seg);
+    bool confirmJump(int64_t t);
+    template <typename Visit>
+    uint32_t search(const StoreQuery &q, uint32_t first_seg, uint32_t n_segs,
+                    Visit &visit) const;
+
+    StoreSegment *m_segs;
+    uint32_t  m_n_segs;    // segments available
+    uint32_t  m_head;      // oldest segment in use
+    uint32_t  m_count;     // segments in use
+    uint32_t  m_rows_per_seg;
+    uint32_t  m_partition_ms;
+    uint64_t  m_n_rows;
+    uint64_t *m_scratch;   // for sorting a segment
+    int64_t   m_jump_t;    // time of the last suspect fix
+    uint16_t  m_jump_count; // suspect fixes in a row
+};
+
+/// @} // addtogroup processing
+
+#endif	/* FIXSTORE_H */
@@ -0,0 +1,466 @@
+/*
+ * File:   geofence.cpp
+ */
+
+#include <math.h>
+
+#include "geofence.h"
+#include "fixp.h"
+
+#define EARTH_RADIUS 6371008.8f // mean radius, meters
+#define GPS_PI_F     3.14159265f
+
+static inline float wrap_angle(float a) {
+    if      (a >  GPS_PI_F) a -= 2 * GPS_PI_F;
+    else if (a < -GPS_PI_F) a += 2 * GPS_PI_F;
+    return a;
+}
+
+/***************************
+ * GeofenceSet             *
+ ***************************/
+
+/**
+ * Construct a new set of geofences. The set must be indexed with
+ * `buildIndex()` before it can be used by a `GeofenceTracker`.
+ *
+ * @param fences Array of fences.
+ * @param n_fences Number of fences, at most 65536.
+ * @param vertices Array of vertices of all the polygonal fences.
+ * @param n_vertices Number of vertices.
+ */
+GeofenceSet::GeofenceSet(const Geofence *fences, uint32_t n_fences,
+                         const GeofenceVertex *vertices, uint32_t n_vertices):
+        m_fences(fences),
+        m_n_fences(n_fences),
+        m_vertices(vertices),
+        m_n_vertices(n_vertices),
+        m_cell_offsets(0),
+        m_entries(0) {
+    m_grid.lat0   = m_grid.lng0   = 0;
+    m_grid.cell_h = m_grid.cell_w = 0;
+    m_grid.rows   = m_grid.cols   = 0;
+}
+
+// lat/lng bounds of a fence: (lat_lo, lng_lo, lat_hi, lng_hi). the
+// longitudes of a circle near the antimeridian run past +/-pi.
+void GeofenceSet::fenceBounds(const Geofence &f, float b[4]) const {
+    if (f.shape == FENCE_CIRCLE) {
+        float dlat = f.radius / EARTH_RADIUS;
+        float lat_max = fabs(f.lat) + dlat;
+        float dlng = (lat_max < GPS_PI_F / 2) ? dlat / cos(lat_max) : GPS_PI_F;
+        b[0] = f.lat - dlat;
+        b[1] = f.lng - dlng;
+        b[2] = f.lat + dlat;
+        b[3] = f.lng + dlng;
+    } else {
+        b[0] = b[1] =  GPS_PI_F;
+        b[2] = b[3] = -GPS_PI_F;
+        const GeofenceVertex *v = m_vertices + f.first_vertex;
+        for (uint32_t i = 0; i < f.n_vertices; i++) {
+            if (v[i].lat < b[0]) b[0] = v[i].lat;
+            if (v[i].lng < b[1]) b[1] = v[i].lng;
+            if (v[i].lat > b[2]) b[2] = v[i].lat;
+            if (v[i].lng > b[3]) b[3] = v[i].lng;
+        }
+    }
+}
+
+// columns of the grid overlapped by longitudes lo to hi, inclusive.
+static inline void col_range(float lo, float hi, float lng0, float cell_w,
+                             int cols, int *c_lo, int *c_hi) {
+    *c_lo = (int)((lo - lng0) / cell_w);
+    *c_hi = (int)((hi - lng0) / cell_w);
+    if (*c_lo < 0)     *c_lo = 0;
+    if (*c_hi >= cols) *c_hi = cols - 1;
+}
+
+// ranges of grid cells overlapped by a fence: (row_lo, col_lo, row_hi,
+// col_hi), inclusive. a circle across the antimeridian overlaps the columns
+// at both ends of the grid, which are given as two ranges. returns the
+// number of ranges, which is 0 if the fence is degenerate.
+int GeofenceSet::cellRanges(const Geofence &f, const Grid &g, int r[2][4]) const {
+    float b[4];
+    fenceBounds(f, b);
+    if (b[0] > b[2] or b[1] > b[3]) return 0;
+    int row_lo = (int)((b[0] - g.lat0) / g.cell_h);
+    int row_hi = (int)((b[2] - g.lat0) / g.cell_h);
+    if (row_lo < 0)       row_lo = 0;
+    if (row_hi >= g.rows) row_hi = g.rows - 1;
+    int n = 1;
+    if (b[3] - b[1] >= 2 * GPS_PI_F) {
+        b[1] = -GPS_PI_F;
+        b[3] =  GPS_PI_F;
+    } else if (b[1] < -GPS_PI_F or b[3] > GPS_PI_F) {
+        // the part past the antimeridian, on the other side.
+        float lo = (b[1] < -GPS_PI_F) ? b[1] + 2 * GPS_PI_F : -GPS_PI_F;
+        float hi = (b[1] < -GPS_PI_F) ?  GPS_PI_F : b[3] - 2 * GPS_PI_F;
+        col_range(lo, hi, g.lng0, g.cell_w, g.cols, &r[1][1], &r[1][3]);
+        n = 2;
+    }
+    col_range(b[1], b[3], g.lng0, g.cell_w, g.cols, &r[0][1], &r[0][3]);
+    if (n == 2 and r[1][1] <= r[0][3] and r[0][1] <= r[1][3]) {
+        // the two parts meet; one range covers them.
+        if (r[1][1] < r[0][1]) r[0][1] = r[1][1];
+        if (r[1][3] > r[0][3]) r[0][3] = r[1][3];
+        n = 1;
+    }
+    for (int i = 0; i < n; i++) {
+        r[i][0] = row_lo;
+        r[i][2] = row_hi;
+    }
+    return n;
+}
+
+// grid of the given size over the bounds of all the fences.
+void GeofenceSet::layoutGrid(uint16_t cols, uint16_t rows, Grid *g) const {
+    float lo[2] = {  GPS_PI_F,  GPS_PI_F };
+    float hi[2] = { -GPS_PI_F, -GPS_PI_F };
+    for (uint32_t i = 0; i < m_n_fences; i++) {
+        float b[4];
+        fenceBounds(m_fences[i], b);
+        // a fence across the antimeridian is at both ends of the grid.
+        if (b[1] < -GPS_PI_F or b[3] > GPS_PI_F) {
+            b[1] = -GPS_PI_F;
+            b[3] =  GPS_PI_F;
+        }
+        for (int k = 0; k < 2; k++) {
+            if (b[k]     < lo[k]) lo[k] = b[k];
+            if (b[k + 2] > hi[k]) hi[k] = b[k + 2];
+        }
+    }
+    if (lo[0] > hi[0]) lo[0] = hi[0] = lo[1] = hi[1] = 0;
+    g->rows   = rows;
+    g->cols   = cols;
+    g->lat0   = lo[0];
+    g->lng0   = lo[1];
+    // pad slightly, so that the upper bounds fall inside the last cell.
+    g->cell_h = (hi[0] - lo[0]) / rows * 1.0001f + 1e-9f;
+    g->cell_w = (hi[1] - lo[1]) / cols * 1.0001f + 1e-9f;
+}
+
+/**
+ * Compute the number of index entries needed to index the fences with a
+ * grid of the given size. Finer grids need more entries, but test fewer
+ * fences per fix.
+ *
+ * @param cols Number of grid columns (along longitude).
+ * @param rows Number of grid rows (along latitude).
+ * @return The number of entries needed by `buildIndex()`.
+ */
+uint32_t GeofenceSet::indexSize(uint16_t cols, uint16_t rows) const {
+    if (cols == 0 or rows == 0) return 0;
+    Grid g;
+    layoutGrid(cols, rows, &g);
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < m_n_fences; i++) {
+        int r[2][4];
+        int n_ranges = cellRanges(m_fences[i], g, r);
+        for (int k = 0; k < n_ranges; k++) {
+            n += (uint32_t)(r[k][2] - r[k][0] + 1) * (r[k][3] - r[k][1] + 1);
+        }
+    }
+    return n;
+}
+
+/**
+ * Build the spatial index of the fences.
+ *
+ * @param cols Number of grid columns (along longitude).
+ * @param rows Number of grid rows (along latitude).
+ * @param cell_offsets Storage for `cols * rows + 1` offsets into `entries`.
+ * @param entries Storage for the index entries.
+ * @param n_entries Number of index entries available in `entries`.
+ * @return `false` if `n_entries` is less than `indexSize(cols, rows)`, or
+ * there are more than `GEOFENCE_MAX_FENCES` fences; `true` otherwise.
+ */
+bool GeofenceSet::buildIndex(uint16_t cols, uint16_t rows,
+                             uint32_t *cell_offsets,
+                             GeofenceID *entries, uint32_t n_entries) {
+    m_cell_offsets = 0;
+    m_entries      = 0;
+    if (m_n_fences > GEOFENCE_MAX_FENCES) return false;
+    if (indexSize(cols, rows) > n_entries or n_entries == 0) return false;
+    layoutGrid(cols, rows, &m_grid);
+
+    uint32_t n_cells = (uint32_t)rows * cols;
+    for (uint32_t c = 0; c <= n_cells; c++) cell_offsets[c] = 0;
+
+    // count the fences in each cell...
+    for (uint32_t i = 0; i < m_n_fences; i++) {
+        int r[2][4];
+        int n_ranges = cellRanges(m_fences[i], m_grid, r);
+        for (int k = 0; k < n_ranges; k++) {
+            for (int row = r[k][0]; row <= r[k][2]; row++) {
+                for (int col = r[k][1]; col <= r[k][3]; col++) {
+                    cell_offsets[row * cols + col + 1]++;
+                }
+            }
+        }
+    }
+    for (uint32_t c = 0; c < n_cells; c++) {
+        cell_offsets[c + 1] += cell_offsets[c];
+    }
+    // ...fill them, advancing each cell's offset to the start of the next...
+    for (uint32_t i = 0; i < m_n_fences; i++) {
+        int r[2][4];
+        int n_ranges = cellRanges(m_fences[i], m_grid, r);
+        for (int k = 0; k < n_ranges; k++) {
+            for (int row = r[k][0]; row <= r[k][2]; row++) {
+                for (int col = r[k][1]; col <= r[k][3]; col++) {
+                    entries[cell_offsets[row * cols + col]++] = i;
+                }
+            }
+        }
+    }
+    // ...and move the offsets back.
+    for (uint32_t c = n_cells; c > 0; c--) {
+        cell_offsets[c] = cell_offsets[c - 1];
+    }
+    cell_offsets[0] = 0;
+
+    m_cell_offsets = cell_offsets;
+    m_entries      = entries;
+    return true;
+}
+
+/**
+ * Get the index of the grid cell containing the given point, or -1 if the
+ * point is outside the grid (and therefore outside all fences).
+ */
+int32_t GeofenceSet::cellAt(float lat, float lng) const {
+    if (m_cell_offsets == 0) return -1;
+    float row = (lat - m_grid.lat0) / m_grid.cell_h;
+    float col = (lng - m_grid.lng0) / m_grid.cell_w;
+    if (row < 0 or col < 0 or row >= m_grid.rows or col >= m_grid.cols) return -1;
+    return (int32_t)row * m_grid.cols + (int32_t)col;
+}
+
+/**
+ * Get the first of the fences overlapping the given grid cell.
+ */
+const GeofenceID* GeofenceSet::cellBegin(int32_t cell) const {
+    if (cell < 0) return m_entries;
+    return m_entries + m_cell_offsets[cell];
+}
+
+/**
+ * Get the end of the list of fences overlapping the given grid cell.
+ */
+const GeofenceID* GeofenceSet::cellEnd(int32_t cell) const {
+    if (cell < 0) return m_entries;
+    return m_entries + m_cell_offsets[cell + 1];
+}
+
+// distance from the point to the boundary of the fence, in meters.
+float GeofenceSet::margin(GeofenceID fence, float lat, float lng,
+                          float cos_lat, bool *inside) const {
+    const Geofence &f = m_fences[fence];
+    // work in a local plane about the point, in meters.
+    const float ky = EARTH_RADIUS;
+    const float kx = EARTH_RADIUS * cos_lat;
+    if (f.shape == FENCE_CIRCLE) {
+        float dy = (f.lat - lat) * ky;
+        float dx = wrap_angle(f.lng - lng) * kx;
+        float d  = sqrt(dx * dx + dy * dy);
+        *inside = d <= f.radius;
+        return fabs(d - f.radius);
+    }
+
+    const GeofenceVertex *v = m_vertices + f.first_vertex;
+    uint32_t n = f.n_vertices;
+    bool  in = false;
+    float min_d2 = 1e30f;
+    if (n == 0) {
+        *inside = false;
+        return min_d2;
+    }
+    float ax = (v[n - 1].lng - lng) * kx;
+    float ay = (v[n - 1].lat - lat) * ky;
+    for (uint32_t i = 0; i < n; i++) {
+        float bx = (v[i].lng - lng) * kx;
+        float by = (v[i].lat - lat) * ky;
+        float ex = bx - ax;
+        float ey = by - ay;
+        // crossing test, along the +x ray from the point
+        if ((ay > 0) != (by > 0) and ax - ay * ex / ey > 0) in = not in;
+        // squared distance to the edge
+        float len2 = ex * ex + ey * ey;
+        float t = (len2 > 0) ? -(ax * ex + ay * ey) / len2 : 0;
+        if (t < 0) t = 0; else if (t > 1) t = 1;
+        float px = ax + t * ex;
+        float py = ay + t * ey;
+        float d2 = px * px + py * py;
+        if (d2 < min_d2) min_d2 = d2;
+        ax = bx;
+        ay = by;
+    }
+    *inside = in;
+    return sqrt(min_d2);
+}
+
+/**
+ * Test whether the given point is inside the given fence.
+ *
+ * @param fence Fence to test.
+ * @param lat Latitude of the point, in radians.
+ * @param lng Longitude of the point, in radians.
+ */
+bool GeofenceSet::contains(GeofenceID fence, float lat, float lng) const {
+    bool inside;
+    margin(fence, lat, lng, cos(lat), &inside);
+    return inside;
+}
+
+/**
+ * Get the number of fences in the set.
+ */
+uint32_t GeofenceSet::getFenceCount() const {
+    return m_n_fences;
+}
+
+/**
+ * Get the fence with the given index.
+ */
+const Geofence& GeofenceSet::getFence(GeofenceID fence) const {
+    return m_fences[fence];
+}
+
+/***************************
+ * GeofenceTracker         *
+ ***************************/
+
+/**
+ * Construct a new `GeofenceTracker`.
+ *
+ * @param fences Indexed set of fences to track.
+ * @param inside_bits Storage for `(fences->getFenceCount() + 31) / 32`
+ * words, recording which fences the receiver is inside of.
+ * @param listener Object to notify of fence crossings, or `NULL`.
+ */
+GeofenceTracker::GeofenceTracker(const GeofenceSet *fences,
+                                 uint32_t *inside_bits,
+                                 GeofenceListener *listener):
+        m_fences(fences),
+        m_listener(listener),
+        m_inside(inside_bits) {
+    reset();
+}
+
+/**
+ * Forget the position of the receiver, and consider it to be outside of
+ * all fences. No events are sent.
+ */
+void GeofenceTracker::reset() {
+    uint32_t words = (m_fences->getFenceCount() + 31) / 32;
+    for (uint32_t i = 0; i < words; i++) m_inside[i] = 0;
+    m_valid     = false;
+    m_cell      = -1;
+    m_safe_dist = 0;
+}
+
+/**
+ * Update the tracker with a new position fix. ECEF fixes are converted to
+ * latitude and longitude.
+ *
+ * @return `false` if `fix` is not a valid fix, `true` otherwise.
+ */
+bool GeofenceTracker::update(const PosFix &fix) {
+    if (fix.type == RPT_NONE or fix.type == RPT_ERROR) return false;
+    if (fix.getFixTime().bits & 0x80000000) return false;
+
+    float lat, lng;
+    if (fix.type == RPT_FIX_POS_LLA_32) {
+        lat = fix.getLLA_32()->lat.f;
+        lng = fix.getLLA_32()->lng.f;
+    } else if (fix.type == RPT_FIX_POS_LLA_64) {
+        lat = to_fixed(fix.getLLA_64()->lat, FIXP_ANGLE_BITS) * FIXP_ANGLE_SCALE;
+        lng = to_fixed(fix.getLLA_64()->lng, FIXP_ANGLE_BITS) * FIXP_ANGLE_SCALE;
+    } else {
+        float x, y, z;
+        if (fix.type == RPT_FIX_POS_XYZ_32) {
+            x = fix.getXYZ_32()->x.f;
+            y = fix.getXYZ_32()->y.f;
+            z = fix.getXYZ_32()->z.f;
+        } else {
+            x = to_fixed(fix.getXYZ_64()->x, 8) * (1.0f / 256);
+            y = to_fixed(fix.getXYZ_64()->y, 8) * (1.0f / 256);
+            z = to_fixed(fix.getXYZ_64()->z, 8) * (1.0f / 256);
+        }
+        ecef_to_lat_lng(x, y, z, &lat, &lng);
+    }
+    update(lat, lng);
+    return true;
+}
+
+/**
+ * Update the tracker with a new position, sending events for any fences
+ * which were entered or exited since the last update.
+ *
+ * @param lat Latitude, in radians.
+ * @param lng Longitude, in radians.
+ */
+void GeofenceTracker::update(float lat, float lng) {
+    float cos_lat = cos(lat);
+    if (m_valid) {
+        float dy = (lat - m_lat) * EARTH_RADIUS;
+        float dx = wrap_angle(lng - m_lng) * EARTH_RADIUS * cos_lat;
+        // no fence boundary is this close; nothing can have changed.
+        if (dx * dx + dy * dy < m_safe_dist * m_safe_dist) return;
+    }
+    const GeofenceSet &fs = *m_fences;
+    int32_t cell = fs.cellAt(lat, lng);
+
+    // fences we may have left are listed in the old cell.
+    if (m_cell >= 0 and cell != m_cell) {
+        for (const GeofenceID *f = fs.cellBegin(m_cell); f != fs.cellEnd(m_cell); f++) {
+            if (isInside(*f) and not fs.contains(*f, lat, lng)) {
+                setInside(*f, false);
+            }
+        }
+    }
+
+    float safe = 0;
+    if (cell >= 0) {
+        // fences not listed in this cell are at least as far as its border.
+        const GeofenceSet::Grid &g = fs.m_grid;
+        float lat_lo = g.lat0 + (cell / g.cols) * g.cell_h;
+        float lng_lo = g.lng0 + (cell % g.cols) * g.cell_w;
+        float d_lat = fmin(lat - lat_lo, lat_lo + g.cell_h - lat) * EARTH_RADIUS;
+        float d_lng = fmin(lng - lng_lo, lng_lo + g.cell_w - lng) * EARTH_RADIUS * cos_lat;
+        safe = fmin(d_lat, d_lng);
+        for (const GeofenceID *f = fs.cellBegin(cell); f != fs.cellEnd(cell); f++) {
+            bool inside;
+            float d = fs.margin(*f, lat, lng, cos_lat, &inside);
+            if (d < safe) safe = d;
+            if (inside != isInside(*f)) setInside(*f, inside);
+        }
+    }
+
+    m_valid     = true;
+    m_cell      = cell;
+    m_lat       = lat;
+    m_lng       = lng;
+    m_safe_dist = safe;
+}
+
+/**
+ * Whether the receiver is currently inside the given fence.
+ */
+bool GeofenceTracker::isInside(GeofenceID fence) const {
+    return (m_inside[fence >> 5] & ((uint32_t)1 << (fence & 31))) != 0;
+}
+
+void GeofenceTracker::setInside(GeofenceID fence, bool inside) {
+    uint32_t bit = (uint32_t)1 << (fence & 31);
+    if (inside) m_inside[fence >> 5] |=  bit;
+    else        m_inside[fence >> 5] &= ~bit;
+    if (m_listener) m_listener->fenceEvent(fence, inside ? FENCE_ENTER : FENCE_EXIT);
+}
+
+/****************************
+ * geofence listener        *
+ ****************************/
+
+GeofenceListener::~GeofenceListener() {}
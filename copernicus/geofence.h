@@ -0,0 +1,179 @@
+/*
+ * File:   geofence.h
+ */
+
+#ifndef GEOFENCE_H
+#define	GEOFENCE_H
+
+#include "gpstype.h"
+
+/**
+ * @addtogroup processing
+ * @{
+ */
+
+/// Index of a geofence within a `GeofenceSet`.
+typedef uint16_t GeofenceID;
+/// Most fences a `GeofenceSet` can index; one more than the largest `GeofenceID`.
+#define GEOFENCE_MAX_FENCES 65536UL
+
+enum GeofenceShape {
+    /// Circle of a given radius about a center point.
+    FENCE_CIRCLE,
+    /// Simple polygon, defined by a run of vertices.
+    FENCE_POLYGON,
+};
+
+enum GeofenceEvent {
+    /// The receiver has entered the fence.
+    FENCE_ENTER,
+    /// The receiver has exited the fence.
+    FENCE_EXIT,
+};
+
+/// A vertex of a polygonal geofence. Angles are in radians.
+struct GeofenceVertex {
+    float lat;
+    float lng;
+};
+
+/**
+ * @brief A circular or polygonal geofence.
+ *
+ * Angles are in radians. Circles may cross the antimeridian. Polygons are
+ * treated as planar in latitude and longitude, and must not cross the
+ * antimeridian; their vertices may be given in either winding order, and are
+ * implicitly closed.
+ */
+struct Geofence {
+    GeofenceShape shape;
+    /// Center of a circular fence.
+    float lat;
+    /// Center of a circular fence.
+    float lng;
+    /// Radius of a circular fence, in meters.
+    float radius;
+    /// Index of the first vertex of a polygonal fence.
+    uint32_t first_vertex;
+    /// Number of vertices of a polygonal fence.
+    uint32_t n_vertices;
+};
+
+/**
+ * @brief A static set of geofences, with a spatial index.
+ *
+ * The fences are indexed by a uniform grid of cells covering all the
+ * fences, where each cell lists the fences whose bounds overlap it. The
+ * lists are packed into one flat array. All storage is supplied by the
+ * caller, and is not copied; it must outlive the `GeofenceSet`.
+ *
+ * Example:
+ *
+ *      GeofenceSet fences(fence_array, n_fences, vertex_array, n_vertices);
+ *      uint32_t n = fences.indexSize(COLS, ROWS);
+ *      // allocate (COLS * ROWS + 1) cell offsets, and n entries:
+ *      fences.buildIndex(COLS, ROWS, cell_offsets, entries, n);
+ *
+ * A `GeofenceSet` is not modified by queries, and may be shared by the
+ * `GeofenceTracker`s of any number of receivers.
+ */
+class GeofenceSet {
+public:
+    GeofenceSet(const Geofence *fences, uint32_t n_fences,
+                const GeofenceVertex *vertices, uint32_t n_vertices);
+
+    uint32_t indexSize(uint16_t cols, uint16_t rows) const;
+    bool buildIndex(uint16_t cols, uint16_t rows,
+                    uint32_t *cell_offsets,
+                    GeofenceID *entries, uint32_t n_entries);
+
+    bool contains(GeofenceID fence, float lat, float lng) const;
+
+    int32_t cellAt(float lat, float lng) const;
+    const GeofenceID* cellBegin(int32_t cell) const;
+    const GeofenceID* cellEnd(int32_t cell) const;
+
+    uint32_t        getFenceCount() const;
+    const Geofence& getFence(GeofenceID fence) const;
+
+private:
+
+    friend class GeofenceTracker;
+
+    struct Grid {
+        float    lat0, lng0;
+        float    cell_h, cell_w;  // radians
+        uint16_t rows, cols;
+    };
+
+    void fenceBounds(const Geofence &f, float bounds[4]) const;
+    void layoutGrid(uint16_t cols, uint16_t rows, Grid *grid) const;
+    int  cellRanges(const Geofence &f, const Grid &grid, int ranges[2][4]) const;
+    float margin(GeofenceID fence, float lat, float lng, float cos_lat, bool *inside) const;
+
+    const Geofence       *m_fences;
+    uint32_t              m_n_fences;
+    const GeofenceVertex *m_vertices;
+    uint32_t              m_n_vertices;
+
+    Grid        m_grid;
+    uint32_t   *m_cell_offsets;
+    GeofenceID *m_entries;
+};
+
+/**
+ * @brief Class for receiving geofence crossing events.
+ */
+class GeofenceListener {
+public:
+    virtual ~GeofenceListener();
+
+    /**
+     * Called when the receiver enters or exits a fence.
+     *
+     * @param fence Fence which was crossed.
+     * @param evt Whether the fence was entered or exited.
+     */
+    virtual void fenceEvent(GeofenceID fence, GeofenceEvent evt) = 0;
+};
+
+/**
+ * @brief Tracks which geofences one receiver is inside of.
+ *
+ * Each fix given to `update()` is tested against only the fences whose
+ * index cell contains the fix. Alongside the inside/outside tests, the
+ * distance to the nearest fence boundary is found; until the receiver moves
+ * farther than that from where it was tested, no fence can have been crossed
+ * and subsequent fixes are not tested at all.
+ *
+ * The caller supplies a bitset with one bit per fence, which records the
+ * fences the receiver is currently inside of.
+ */
+class GeofenceTracker {
+public:
+    GeofenceTracker(const GeofenceSet *fences, uint32_t *inside_bits,
+                    GeofenceListener *listener=0);
+
+    void reset();
+    bool update(const PosFix &fix);
+    void update(float lat, float lng);
+
+    bool isInside(GeofenceID fence) const;
+
+private:
+
+    void setInside(GeofenceID fence, bool inside);
+
+    const GeofenceSet *m_fences;
+    GeofenceListener  *m_listener;
+    uint32_t          *m_inside;
+
+    bool    m_valid;
+    int32_t m_cell;
+    float   m_lat, m_lng;
+    float   m_safe_dist; // meters the receiver may move without crossing a fence
+};
+
+/// @} // addtogroup processing
+
+#endif	/* GEOFENCE_H */
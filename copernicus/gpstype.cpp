@@ -5,6 +5,38 @@
 #define NULL (0)
 #endif
 
+/***************************
+ * Report types            *
+ ***************************/
+
+/**
+ * Get the `ReportFlag` bit corresponding to the given auto-report type, or 0
+ * if `type` is not an auto-report.
+ */
+ReportSet reportFlag(ReportType type) {
+    switch (type) {
+        case RPT_FIX_POS_LLA_32: return RPTFLAG_FIX_POS_LLA_32;
+        case RPT_FIX_POS_LLA_64: return RPTFLAG_FIX_POS_LLA_64;
+        case RPT_FIX_POS_XYZ_32: return RPTFLAG_FIX_POS_XYZ_32;
+        case RPT_FIX_POS_XYZ_64: return RPTFLAG_FIX_POS_XYZ_64;
+        case RPT_FIX_VEL_XYZ:    return RPTFLAG_FIX_VEL_XYZ;
+        case RPT_FIX_VEL_ENU:    return RPTFLAG_FIX_VEL_ENU;
+        case RPT_GPSTIME:        return RPTFLAG_GPSTIME;
+        case RPT_HEALTH:         return RPTFLAG_HEALTH;
+        case RPT_ADDL_STATUS:    return RPTFLAG_ADDL_STATUS;
+        case RPT_SATELLITES:     return RPTFLAG_SATELLITES;
+        case RPT_SBAS_MODE:      return RPTFLAG_SBAS_MODE;
+        case RPT_NMEA:
+        case RPT_NMEA_GGA:
+        case RPT_NMEA_RMC:
+        case RPT_NMEA_VTG:
+        case RPT_NMEA_GSA:
+        case RPT_NMEA_GSV:
+        case RPT_NMEA_ZDA:       return RPTFLAG_NMEA;
+        default:                 return 0;
+    }
+}
+
 /***************************
  * Fix types               *
  ***************************/
@@ -13,33 +45,104 @@ PosFix::PosFix() : type(RPT_NONE) {}
 VelFix::VelFix() : type(RPT_NONE) {}
 
 const LLA_Fix<Float32>* PosFix::getLLA_32() const {
+#if CPN_HAVE_LLA_32
     if (type == RPT_FIX_POS_LLA_32) return &lla_32;
-    else return NULL;
+#endif
+    return NULL;
 }
 
 const LLA_Fix<Float64>* PosFix::getLLA_64() const {
+#if CPN_HAVE_LLA_64
     if (type == RPT_FIX_POS_LLA_64) return &lla_64;
-    else return NULL;
+#endif
+    return NULL;
 }
 
 const XYZ_Fix<Float32>* PosFix::getXYZ_32() const {
+#if CPN_HAVE_XYZ_32
     if (type == RPT_FIX_POS_XYZ_32) return &xyz_32;
-    else return NULL;
+#endif
+    return NULL;
 }
 
 const XYZ_Fix<Float64>* PosFix::getXYZ_64() const {
+#if CPN_HAVE_XYZ_64
     if (type == RPT_FIX_POS_XYZ_64) return &xyz_64;
-    else return NULL;
+#endif
+    return NULL;
+}
+
+/**
+ * Get the fix time of the stored fix, in GPS seconds of the week. This is
+ * -1 if the fix is invalid, or if there is no stored fix.
+ */
+Float32 PosFix::getFixTime() const {
+    Float32 t;
+    switch (type) {
+#if CPN_HAVE_LLA_32
+        case RPT_FIX_POS_LLA_32: return lla_32.fixtime;
+#endif
+#if CPN_HAVE_LLA_64
+        case RPT_FIX_POS_LLA_64: return lla_64.fixtime;
+#endif
+#if CPN_HAVE_XYZ_32
+        case RPT_FIX_POS_XYZ_32: return xyz_32.fixtime;
+#endif
+#if CPN_HAVE_XYZ_64
+        case RPT_FIX_POS_XYZ_64: return xyz_64.fixtime;
+#endif
+        default:
+            t.bits = 0xBF800000; // -1
+            return t;
+    }
 }
 
 const XYZ_VFix *VelFix::getXYZ() const {
+#if CPN_HAVE_VEL_XYZ
     if (type == RPT_FIX_VEL_XYZ) return &xyz;
-    else return NULL;
+#endif
+    return NULL;
 }
 
 const ENU_VFix *VelFix::getENU() const {
+#if CPN_HAVE_VEL_ENU
     if (type == RPT_FIX_VEL_ENU) return &enu;
-    else return NULL;
+#endif
+    return NULL;
+}
+
+/***************************
+ * SatelliteView           *
+ ***************************/
+
+SatelliteView::SatelliteView():
+        fix_dim(0),
+        in_use(0),
+        tracked(0),
+        dirty(0),
+        dops_dirty(false) {
+    pdop.bits = hdop.bits = vdop.bits = tdop.bits = 0;
+    for (int i = 0; i < MAX_SATELLITES; i++) {
+        snr[i]       = 0;
+        elevation[i] = 0;
+        azimuth[i]   = 0;
+    }
+}
+
+/**
+ * Whether the satellite with the given PRN is being used in the current fix.
+ */
+bool SatelliteView::isInUse(int prn) const {
+    if (prn < 1 or prn > MAX_SATELLITES) return false;
+    return (in_use & ((uint32_t)1 << (prn - 1))) != 0;
+}
+
+/**
+ * Whether the satellite with the given PRN has been acquired by the receiver.
+ */
+bool SatelliteView::isTracked(int prn) const {
+    if (prn < 1 or prn > MAX_SATELLITES) return false;
+    return (tracked & ((uint32_t)1 << (prn - 1))) != 0;
 }
 
 /***************************
@@ -52,4 +155,5 @@ GPSStatus::GPSStatus():
         almanac_incomplete(true),
         rtclock_unavailable(true),
         sbas_enabled(false),
-        sbas_corrected(false) {}
\ No newline at end of file
+        sbas_corrected(false),
+        leap_pending(false) {}
\ No newline at end of file
@@ -11,6 +11,67 @@
 #include <stdint.h>
 #include <float.h>
 
+/***************************
+ * configuration           *
+ ***************************/
+
+// Reports decoded by `CopernicusGPS`. Define any of these as 0 (with a
+// compiler flag, or by editing this file) to leave out its decoder and the
+// storage it needs, saving flash and RAM on small boards. Reports which are
+// left out are passed on to packet processors, like any other unhandled report.
+
+#ifndef CPN_ENABLE_FIX_POS_LLA_32
+#define CPN_ENABLE_FIX_POS_LLA_32 1
+#endif
+#ifndef CPN_ENABLE_FIX_POS_LLA_64
+#define CPN_ENABLE_FIX_POS_LLA_64 1
+#endif
+#ifndef CPN_ENABLE_FIX_POS_XYZ_32
+#define CPN_ENABLE_FIX_POS_XYZ_32 1
+#endif
+#ifndef CPN_ENABLE_FIX_POS_XYZ_64
+#define CPN_ENABLE_FIX_POS_XYZ_64 1
+#endif
+#ifndef CPN_ENABLE_FIX_VEL_XYZ
+#define CPN_ENABLE_FIX_VEL_XYZ    1
+#endif
+#ifndef CPN_ENABLE_FIX_VEL_ENU
+#define CPN_ENABLE_FIX_VEL_ENU    1
+#endif
+#ifndef CPN_ENABLE_GPSTIME
+#define CPN_ENABLE_GPSTIME        1
+#endif
+/// Health (0x46), additional status (0x4B), and SBAS (0x82) reports.
+#ifndef CPN_ENABLE_STATUS
+#define CPN_ENABLE_STATUS         1
+#endif
+/// All-in-view (0x6D) and tracking status (0x5C) reports, and the `SatelliteView`.
+#ifndef CPN_ENABLE_SATELLITES
+#define CPN_ENABLE_SATELLITES     1
+#endif
+/// Fix (0x8F-20) and timing (0x8F-AB, 0x8F-AC) superpackets.
+#ifndef CPN_ENABLE_SUPERPACKETS
+#define CPN_ENABLE_SUPERPACKETS   1
+#endif
+/// NMEA 0183 sentences (GGA, RMC, VTG, GSA, GSV, ZDA); see `CopernicusGPS::setPollBuffer()`.
+#ifndef CPN_ENABLE_NMEA
+#define CPN_ENABLE_NMEA           1
+#endif
+
+// fix formats which can be stored: those enabled, and those the superpackets
+// and NMEA sentences are decoded into (64-bit LLA where `double` is 64 bits, 
+// else 32-bit LLA).
+#define CPN_SPKT_LLA_64 (CPN_ENABLE_SUPERPACKETS && CPN_ENABLE_FIX_POS_LLA_64 && DBL_MANT_DIG == 53)
+#define CPN_NMEA_LLA_64 (CPN_ENABLE_NMEA && CPN_ENABLE_FIX_POS_LLA_64 && DBL_MANT_DIG == 53)
+#define CPN_HAVE_LLA_32 (CPN_ENABLE_FIX_POS_LLA_32 || \
+                         (CPN_ENABLE_SUPERPACKETS && !CPN_SPKT_LLA_64) || \
+                         (CPN_ENABLE_NMEA && !CPN_NMEA_LLA_64))
+#define CPN_HAVE_LLA_64 CPN_ENABLE_FIX_POS_LLA_64
+#define CPN_HAVE_XYZ_32 CPN_ENABLE_FIX_POS_XYZ_32
+#define CPN_HAVE_XYZ_64 CPN_ENABLE_FIX_POS_XYZ_64
+#define CPN_HAVE_VEL_XYZ CPN_ENABLE_FIX_VEL_XYZ
+#define CPN_HAVE_VEL_ENU (CPN_ENABLE_FIX_VEL_ENU || CPN_ENABLE_SUPERPACKETS || CPN_ENABLE_NMEA)
+
 class CopernicusGPS; // fwd decl
 
 /**
@@ -28,7 +89,36 @@ class CopernicusGPS; // fwd decl
  ***************************/
 
 enum CommandID {
-    CMD_IO_OPTIONS = 0x35
+    CMD_INIT_POS_XYZ     = 0x23,
+    CMD_INIT_POS_LLA     = 0x2B,
+    CMD_SET_GPSTIME      = 0x2E,
+    CMD_ACC_INIT_POS_XYZ = 0x31,
+    CMD_ACC_INIT_POS_LLA = 0x32,
+    CMD_IO_OPTIONS       = 0x35,
+    CMD_SAT_DATA         = 0x38,
+    CMD_SAT_TRACKING     = 0x3C,
+    CMD_SUPERPACKET      = 0x8E,
+};
+
+/// Kinds of satellite system data requested and loaded with command 0x38 (report 0x58).
+enum SatDataType {
+    SATDATA_ALMANAC    = 0x02,
+    SATDATA_HEALTH     = 0x03,
+    SATDATA_IONOSPHERE = 0x04,
+    SATDATA_UTC        = 0x05,
+    SATDATA_EPHEMERIS  = 0x06,
+};
+
+/// Sub-IDs of superpacket commands (0x8E) and reports (0x8F).
+enum SuperpacketID {
+    /// Last fix with extra information (position, velocity, time, and status).
+    SPKT_FIX        = 0x20,
+    /// Primary timing packet.
+    SPKT_TIMING     = 0xAB,
+    /// Supplemental timing packet (position and receiver status).
+    SPKT_TIMING_SUPPL = 0xAC,
+    /// Packet broadcast mask.
+    SPKT_BCAST_MASK = 0xA5,
 };
 
 enum ReportType {
@@ -69,8 +159,72 @@ enum ReportType {
     
     /// GPS IO settings.
     RPT_IO_SETTINGS = 0x55,
+    /// Satellite system data (almanac, ephemeris, etc.); see `SatDataType`.
+    RPT_SAT_DATA     = 0x58,
+    /// Satellite tracking status.
+    RPT_SAT_TRACKING = 0x5C,
+    /// Superpacket; the first data byte is a `SuperpacketID`.
+    RPT_SUPERPACKET = 0x8F,
+    
+    // NMEA 0183 sentences; these are not TSIP report IDs.
+    
+    /// Any other NMEA sentence, which is checked but not decoded.
+    RPT_NMEA        = 0x100,
+    /// NMEA fix data (position, fix quality, and satellite count).
+    RPT_NMEA_GGA    = 0x101,
+    /// NMEA recommended minimum data (date, time, speed, and course).
+    RPT_NMEA_RMC    = 0x102,
+    /// NMEA course and speed over ground.
+    RPT_NMEA_VTG    = 0x103,
+    /// NMEA DOPs and satellites used in the fix.
+    RPT_NMEA_GSA    = 0x104,
+    /// NMEA satellites in view; one of a series of sentences.
+    RPT_NMEA_GSV    = 0x105,
+    /// NMEA date and time.
+    RPT_NMEA_ZDA    = 0x106,
 };
 
+/// Number of NMEA report types, `RPT_NMEA` through `RPT_NMEA_ZDA`.
+#define NMEA_REPORT_TYPES (RPT_NMEA_ZDA - RPT_NMEA + 1)
+
+/**
+ * Bits identifying the auto-reports a client is interested in.
+ * See `CopernicusGPS::subscribeReports()`.
+ */
+enum ReportFlag {
+    RPTFLAG_FIX_POS_LLA_32 = 0x0001,
+    RPTFLAG_FIX_POS_LLA_64 = 0x0002,
+    RPTFLAG_FIX_POS_XYZ_32 = 0x0004,
+    RPTFLAG_FIX_POS_XYZ_64 = 0x0008,
+    RPTFLAG_FIX_VEL_XYZ    = 0x0010,
+    RPTFLAG_FIX_VEL_ENU    = 0x0020,
+    RPTFLAG_GPSTIME        = 0x0040,
+    RPTFLAG_HEALTH         = 0x0080,
+    RPTFLAG_ADDL_STATUS    = 0x0100,
+    RPTFLAG_SATELLITES     = 0x0200,
+    RPTFLAG_SBAS_MODE      = 0x0400,
+    /// Fix superpacket (0x8F-20).
+    RPTFLAG_SPKT_FIX       = 0x0800,
+    /// Timing superpackets (0x8F-AB and 0x8F-AC).
+    RPTFLAG_SPKT_TIMING    = 0x1000,
+    /// NMEA sentences. Only selects whether they are decoded; the receiver's
+    /// output protocol is not changed.
+    RPTFLAG_NMEA           = 0x2000,
+    
+    RPTFLAG_FIX_POS = 0x000F,
+    RPTFLAG_FIX_VEL = 0x0030,
+    RPTFLAG_STATUS  = 0x0780,
+    /// All of the individual (non-superpacket) auto-reports.
+    RPTFLAG_AUTO    = 0x07FF,
+    RPTFLAG_SPKT    = 0x1800,
+    RPTFLAG_ALL     = 0x3FFF,
+};
+
+/// Set of `ReportFlag` bits.
+typedef uint16_t ReportSet;
+
+ReportSet reportFlag(ReportType type);
+
 enum GPSHealth {
     /// Set if GPS health has not been established yet.
     HLTH_UNKNOWN                   = 0xFF,
@@ -250,16 +404,29 @@ struct PosFix {
     const XYZ_Fix<Float32> *getXYZ_32() const;
     const XYZ_Fix<Float64> *getXYZ_64() const;
     
+    Float32 getFixTime() const;
+    
 protected:
     
     union {
+#if CPN_HAVE_XYZ_32
         XYZ_Fix<Float32> xyz_32;
+#endif
+#if CPN_HAVE_XYZ_64
         XYZ_Fix<Float64> xyz_64;
+#endif
+#if CPN_HAVE_LLA_32
         LLA_Fix<Float32> lla_32;
+#endif
+#if CPN_HAVE_LLA_64
         LLA_Fix<Float64> lla_64;
+#endif
+        // the start of whichever fix is stored
+        Float32 words[5];
     };
     
     friend class CopernicusGPS;
+    friend class FixLogReader;
 };
 
 /**
@@ -298,11 +465,17 @@ struct VelFix {
 protected:
     
     union {
+#if CPN_HAVE_VEL_XYZ
         XYZ_VFix xyz;
+#endif
+#if CPN_HAVE_VEL_ENU
         ENU_VFix enu;
+#endif
+        Float32 words[5];
     };
     
     friend class CopernicusGPS;
+    friend class FixLogReader;
 };
 
 struct GPSTime {
@@ -311,6 +484,62 @@ struct GPSTime {
     Float32 utc_offs;
 };
 
+// GPS PRNs are 1-32; other SVs (e.g. SBAS) are not tracked.
+#define MAX_SATELLITES 32
+
+/**
+ * @brief Table of satellites in view of the receiver.
+ * 
+ * Per-satellite data are stored in parallel arrays indexed by `PRN - 1`, 
+ * and sets of satellites are stored as bitmasks with bit `PRN - 1` 
+ * corresponding to each satellite.
+ * 
+ * The DOPs and the set of satellites in use are updated from the all-in-view
+ * satellite report (0x6D). Signal level, elevation, and azimuth are updated 
+ * from the satellite tracking status report (0x5C), which must be requested 
+ * with `CopernicusGPS::requestSatelliteStatus()`. 
+ * 
+ * Only satellites whose data have actually changed are marked in `dirty`, so
+ * that consumers can update only those satellites:
+ * 
+ *      const SatelliteView &sats = gps.getSatellites();
+ *      uint32_t changed = sats.dirty;
+ *      for (int i = 0; changed != 0; i++, changed >>= 1) {
+ *          if (changed & 1) {
+ *              // update satellite with PRN i + 1
+ *          }
+ *      }
+ *      gps.clearSatelliteChanges();
+ */
+struct SatelliteView {
+    SatelliteView();
+    
+    /// Dimension of the current fix (3 = 2D, 4 = 3D).
+    uint8_t fix_dim;
+    Float32 pdop;
+    Float32 hdop;
+    Float32 vdop;
+    Float32 tdop;
+    /// Set of satellites used in the current fix.
+    uint32_t in_use;
+    /// Set of satellites which have been acquired.
+    uint32_t tracked;
+    /// Set of satellites whose data have changed since the last call to `CopernicusGPS::clearSatelliteChanges()`.
+    uint32_t dirty;
+    /// Whether the fix dimension or DOPs have changed since the last call to `CopernicusGPS::clearSatelliteChanges()`.
+    bool dops_dirty;
+    
+    /// Signal level of each satellite, in the units configured in the receiver (AMU or dB-Hz).
+    uint8_t  snr[MAX_SATELLITES];
+    /// Elevation of each satellite above the horizon, in degrees.
+    int8_t   elevation[MAX_SATELLITES];
+    /// Azimuth of each satellite, in degrees clockwise from true north.
+    uint16_t azimuth[MAX_SATELLITES];
+    
+    bool isInUse(int prn) const;
+    bool isTracked(int prn) const;
+};
+
 struct GPSStatus {
     GPSStatus();
     
@@ -319,9 +548,35 @@ struct GPSStatus {
     bool almanac_incomplete;  // pkt 0x4b
     bool rtclock_unavailable; // pkt 0x4b
     bool sbas_enabled;        // pkt 0x82
-    bool sbas_corrected;      // pkt 0x82
+    // pkt 0x82. From NMEA, set for any differential fix (GGA quality 2),
+    // which does not name its source; the Copernicus II's only source of
+    // corrections is SBAS, but another receiver's may be an RTCM beacon.
+    bool sbas_corrected;
+    bool leap_pending;        // pkt 0x8f-ac
+};
+
+/**
+ * Bits identifying the fields of a `GPSStatus` which have changed.
+ * See `GPSStatusListener`.
+ */
+enum StatusChange {
+    /// `health` has changed.
+    STATUS_HEALTH         = 0x01,
+    /// `almanac_incomplete` has changed.
+    STATUS_ALMANAC        = 0x02,
+    /// `rtclock_unavailable` has changed.
+    STATUS_RTCLOCK        = 0x04,
+    /// `sbas_enabled` has changed.
+    STATUS_SBAS_ENABLED   = 0x08,
+    /// `sbas_corrected` has changed.
+    STATUS_SBAS_CORRECTED = 0x10,
+    /// `leap_pending` has changed.
+    STATUS_LEAP           = 0x20,
 };
 
+/// Set of `StatusChange` bits.
+typedef uint8_t StatusSet;
+
 /// @} // addtogroup datapoint
 
 #endif	/* GPSTYPE_H */
@@ -0,0 +1,566 @@
+/*
+ * File:   nmea.cpp
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "nmea.h"
+#include "copernicus.h"
+#include "timeconv.h"
+
+#define GPS_PI (3.14159265358979323846)
+#define DEG_TO_RAD_D (GPS_PI / 180.0)
+#define DEG_TO_RAD_F (0.0174532925f)
+
+#define KNOTS_TO_MPS (0.514444f)
+#define KPH_TO_MPS   (0.277778f)
+#define SECONDS_PER_DAY 86400L
+
+// the three-letter sentence formatter after the talker ID, as one integer.
+#define NMEA_FORMATTER(a, b, c) (((uint32_t)(a) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(c))
+
+#if NMEA_SWAR
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_LOW7 0x7F7F7F7F7F7F7F7FULL
+#endif
+
+static const uint32_t POW10[10] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/***************************
+ * sentences               *
+ ***************************/
+
+/**
+ * Compute the checksum of `n` characters of a sentence: the exclusive-or
+ * of all of them. The checksum of a sentence covers the characters between
+ * the `$` and the `*`.
+ */
+uint8_t nmea_checksum(const char *s, int n) {
+    uint8_t sum = 0;
+    int i = 0;
+#if NMEA_SWAR
+    // xor together whole words, then the bytes of the result.
+    uint64_t w = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x;
+        memcpy(&x, s + i, 8);
+        w ^= x;
+    }
+    w ^= w >> 32;
+    w ^= w >> 16;
+    w ^= w >> 8;
+    sum = (uint8_t)w;
+#endif
+    for (; i < n; i++) sum ^= (uint8_t)s[i];
+    return sum;
+}
+
+static inline int hex_value(char c) {
+    if (c >= '0' and c <= '9') return c - '0';
+    if (c >= 'A' and c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' and c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/**
+ * Check the checksum of a sentence. Sentences without a checksum fail.
+ *
+ * @param s The characters of the sentence following the `$`.
+ * @param len Number of characters, not counting the line ending.
+ * @param body_len Set to the number of characters before the `*`.
+ * @return Whether the sentence has a correct checksum.
+ */
+bool nmea_verify(const char *s, int len, int *body_len) {
+    if (len < 3 or s[len - 3] != '*') return false;
+    int hi = hex_value(s[len - 2]);
+    int lo = hex_value(s[len - 1]);
+    if (hi < 0 or lo < 0) return false;
+    *body_len = len - 3;
+    return nmea_checksum(s, len - 3) == ((hi << 4) | lo);
+}
+
+#if NMEA_SWAR
+// the high bit of each byte of `x` which is zero, and no other bits.
+static inline uint64_t swar_zero_bytes(uint64_t x) {
+    return ~(((x & SWAR_LOW7) + SWAR_LOW7) | x | SWAR_LOW7);
+}
+#endif
+
+// record a comma at `i`. false if it ends the last field which will fit.
+static inline bool split_at(NMEAFields *f, int i) {
+    f->start[f->n] = i + 1;
+    if (f->n == NMEA_MAX_FIELDS) return false;
+    f->n++;
+    return true;
+}
+
+/**
+ * Find the fields of a sentence, in place. Fields past `NMEA_MAX_FIELDS`
+ * are dropped.
+ *
+ * @param s The characters of the sentence following the `$`.
+ * @param len Number of characters before the `*` (see `nmea_verify()`); at
+ * most 254.
+ * @param f Set to the fields of the sentence, which refer to `s`.
+ */
+void nmea_split(const char *s, int len, NMEAFields *f) {
+    f->s = s;
+    f->n = 1;
+    f->start[0] = 0;
+    int i = 0;
+#if NMEA_SWAR
+    // find the commas of a whole word at once.
+    for (; i + 8 <= len; i += 8) {
+        uint64_t x;
+        memcpy(&x, s + i, 8);
+        uint64_t m = swar_zero_bytes(x ^ (SWAR_ONES * ','));
+        for (; m != 0; m &= m - 1) {
+            if (not split_at(f, i + (__builtin_ctzll(m) >> 3))) return;
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        if (s[i] == ',' and not split_at(f, i)) return;
+    }
+    f->start[f->n] = len + 1;
+}
+
+/**
+ * Identify a sentence by its address field, ignoring the talker ID. Returns
+ * `RPT_NMEA` for sentences which are not decoded, including proprietary ones.
+ */
+ReportType nmea_type(const char *s, int len) {
+    if (len < 5 or s[0] == 'P') return RPT_NMEA;
+    if (len > 5 and s[5] != ',' and s[5] != '*') return RPT_NMEA;
+    switch (NMEA_FORMATTER(s[2], s[3], s[4])) {
+        case NMEA_FORMATTER('G','G','A'): return RPT_NMEA_GGA;
+        case NMEA_FORMATTER('R','M','C'): return RPT_NMEA_RMC;
+        case NMEA_FORMATTER('V','T','G'): return RPT_NMEA_VTG;
+        case NMEA_FORMATTER('G','S','A'): return RPT_NMEA_GSA;
+        case NMEA_FORMATTER('G','S','V'): return RPT_NMEA_GSV;
+        case NMEA_FORMATTER('Z','D','A'): return RPT_NMEA_ZDA;
+        default:                          return RPT_NMEA;
+    }
+}
+
+/***************************
+ * fields                  *
+ ***************************/
+
+/**
+ * Parse a decimal number, such as `-12.0625`, as an integer and a power of
+ * ten: the number is `mant / 10^scale`. Digits past the ninth significant
+ * digit of the fraction are dropped.
+ *
+ * @return `false` if the field is empty, is not a number, or has more than
+ * nine integer digits.
+ */
+bool nmea_decimal(const char *s, const char *end, int32_t *mant, uint8_t *scale) {
+    bool neg = s < end and *s == '-';
+    if (neg) s++;
+    uint32_t v      = 0;
+    uint8_t  sc     = 0;
+    uint8_t  digits = 0; // significant digits kept
+    bool     frac   = false;
+    bool     any    = false;
+    for (; s < end; s++) {
+        uint8_t d = (uint8_t)*s - '0';
+        if (d > 9) {
+            if (*s != '.' or frac) return false;
+            frac = true;
+            continue;
+        }
+        any = true;
+        if (digits < 9 and sc < 9) {
+            v = v * 10 + d;
+            if (v != 0) digits++;
+            if (frac) sc++;
+        } else if (not frac) {
+            return false;
+        }
+    }
+    if (not any) return false;
+    *mant  = neg ? -(int32_t)v : (int32_t)v;
+    *scale = sc;
+    return true;
+}
+
+/**
+ * Parse an integer field. A fraction, if any, is truncated.
+ */
+bool nmea_int(const char *s, const char *end, int32_t *v) {
+    int32_t m;
+    uint8_t sc;
+    if (not nmea_decimal(s, end, &m, &sc)) return false;
+    *v = m / (int32_t)POW10[sc];
+    return true;
+}
+
+/**
+ * Parse a decimal field as a float.
+ */
+bool nmea_float(const char *s, const char *end, float *v) {
+    int32_t m;
+    uint8_t sc;
+    if (not nmea_decimal(s, end, &m, &sc)) return false;
+    *v = (float)m / POW10[sc];
+    return true;
+}
+
+/**
+ * Parse a latitude (`ddmm.mmmm`) or longitude (`dddmm.mmmm`) field and its
+ * hemisphere.
+ *
+ * @param hemi The hemisphere field: `N`, `S`, `E`, or `W`.
+ * @param rad Set to the angle in radians, negative to the south and west.
+ */
+bool nmea_angle(const char *s, const char *end, char hemi, double *rad) {
+    const char *dot = (const char*)memchr(s, '.', end - s);
+    if (dot == NULL) dot = end;
+    if (dot - s < 3) return false;
+
+    int32_t deg, min;
+    uint8_t sc;
+    if (not nmea_int(s, dot - 2, &deg) or deg < 0) return false;
+    if (not nmea_decimal(dot - 2, end, &min, &sc) or min < 0) return false;
+
+    double a = (deg + (double)min / POW10[sc] / 60.0) * DEG_TO_RAD_D;
+    switch (hemi) {
+        case 'N': case 'E': *rad =  a; return true;
+        case 'S': case 'W': *rad = -a; return true;
+        default:            return false;
+    }
+}
+
+/**
+ * Parse a UTC time field (`hhmmss.sss`) as the number of seconds since
+ * midnight.
+ */
+bool nmea_time(const char *s, const char *end, float *sec_of_day) {
+    if (end - s < 6) return false;
+    uint8_t d[6];
+    uint8_t bad = 0;
+    for (int i = 0; i < 6; i++) {
+        d[i] = (uint8_t)s[i] - '0';
+        bad |= d[i] > 9;
+    }
+    if (bad) return false;
+
+    float frac = 0;
+    if (end - s > 6) {
+        int32_t m;
+        uint8_t sc;
+        if (s[6] != '.' or not nmea_decimal(s + 6, end, &m, &sc)) return false;
+        frac = (float)m / POW10[sc];
+    }
+    int32_t sod = (d[0] * 10 + d[1]) * 3600L + (d[2] * 10 + d[3]) * 60 + d[4] * 10 + d[5];
+    *sec_of_day = sod + frac;
+    return true;
+}
+
+/**
+ * Get the number of days from the Unix epoch (1970-01-01) to a date in the
+ * Gregorian calendar.
+ *
+ * @param y Year.
+ * @param m Month, from 1 to 12.
+ * @param d Day of the month, from 1.
+ */
+int32_t days_from_civil(int32_t y, int m, int d) {
+    // count from 0000-03-01, so that the leap day ends the year.
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    int32_t yoe = y - era * 400;
+    int32_t doy = (153L * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097L + doe - 719468L;
+}
+
+#if CPN_ENABLE_NMEA
+
+/***************************
+ * Sentence processing     *
+ ***************************/
+
+// decode the sentence framed in m_frame, which has been identified as `type`.
+// the whole sentence is consumed and captured.
+bool CopernicusGPS::process_nmea(ReportType type) {
+    const char *s = reinterpret_cast<const char*>(m_frame);
+    int len = m_frame_len;
+    for (int i = 0; i < len; i++) capture(m_frame[i]);
+    m_capture_done = true;
+    m_replay_pos   = len;
+
+    int body;
+    if (len > NMEA_MAX_SENTENCE or not nmea_verify(s, len, &body)) return false;
+    m_nmea = true;
+
+    NMEAFields f;
+    nmea_split(s, body, &f);
+    switch (type) {
+        case RPT_NMEA_GGA: return process_gga(f);
+        case RPT_NMEA_RMC: return process_rmc(f);
+        case RPT_NMEA_VTG: return process_vtg(f);
+        case RPT_NMEA_ZDA: return process_zda(f);
+#if CPN_ENABLE_SATELLITES
+        case RPT_NMEA_GSA: return process_gsa(f);
+        case RPT_NMEA_GSV: return process_gsv(f);
+#endif
+        default:           return true;
+    }
+}
+
+// $--GGA: time, position, fix quality, satellites used, HDOP, altitude.
+bool CopernicusGPS::process_gga(const NMEAFields &f) {
+    int32_t quality = 0;
+    int32_t n_svs   = 0;
+    if (not nmea_int(f.begin(6), f.end(6), &quality)) return false;
+    nmea_int(f.begin(7), f.end(7), &n_svs);
+
+    float  sod;
+    double lat, lng;
+    if (quality > 0 and
+            nmea_time(f.begin(1), f.end(1), &sod) and
+            nmea_angle(f.begin(2), f.end(2), f.chr(3), &lat) and
+            nmea_angle(f.begin(4), f.end(4), f.chr(5), &lng)) {
+        // altitude is above the geoid; the separation brings it to the ellipsoid.
+        float alt = 0;
+        float sep = 0;
+        nmea_float(f.begin(9),  f.end(9),  &alt);
+        nmea_float(f.begin(11), f.end(11), &sep);
+        setNMEAFix(lat, lng, alt + sep, nmeaTimeOfWeek(sod));
+    }
+
+#if CPN_ENABLE_STATUS
+    GPSStatus old = m_status;
+#endif
+    m_status.n_satellites = n_svs;
+    if (quality > 0) {
+        m_status.health = HLTH_DOING_FIXES;
+    } else if (n_svs < 4) {
+        m_status.health = static_cast<GPSHealth>(HLTH_SATELLITES_NONE + n_svs);
+    } else {
+        m_status.health = HLTH_UNKNOWN;
+    }
+    m_status.sbas_corrected = (quality == 2); // any differential fix; see GPSStatus
+#if CPN_ENABLE_STATUS
+    // the next 0x46 or 0x82 must be decoded, even if unchanged since the last.
+    m_raw_valid &= ~(RPTFLAG_HEALTH | RPTFLAG_SBAS_MODE);
+    statusChanged(old);
+#endif
+    return true;
+}
+
+// $--RMC: time, status, position, speed, course, date.
+bool CopernicusGPS::process_rmc(const NMEAFields &f) {
+    float sod;
+    if (not nmea_time(f.begin(1), f.end(1), &sod)) return true; // no time yet
+
+    int32_t date;
+    if (f.end(9) - f.begin(9) == 6 and nmea_int(f.begin(9), f.end(9), &date)) {
+        // ddmmyy, with a two-digit year from 1980 to 2079.
+        int32_t yy = date % 100;
+        int32_t y  = yy + ((yy < 80) ? 2000 : 1900);
+        setNMEADate(days_from_civil(y, (date / 100) % 100, date / 10000), sod);
+    }
+    if (f.chr(2) != 'A') return true;
+
+    float  tow = nmeaTimeOfWeek(sod);
+    double lat, lng;
+    if (nmea_angle(f.begin(3), f.end(3), f.chr(4), &lat) and
+            nmea_angle(f.begin(5), f.end(5), f.chr(6), &lng)) {
+        // no altitude is sent; keep the last one.
+        float alt = 0;
+#if CPN_NMEA_LLA_64
+        if (m_pfix.type == RPT_FIX_POS_LLA_64) alt = m_pfix.lla_64.alt.d;
+#else
+        if (m_pfix.type == RPT_FIX_POS_LLA_32) alt = m_pfix.lla_32.alt.f;
+#endif
+        setNMEAFix(lat, lng, alt, tow);
+    }
+    float knots;
+    float course = 0;
+    if (nmea_float(f.begin(7), f.end(7), &knots)) {
+        nmea_float(f.begin(8), f.end(8), &course);
+        setNMEAVelocity(knots * KNOTS_TO_MPS, course, tow);
+    }
+    return true;
+}
+
+// $--VTG: course and speed. The sentence carries no time; it belongs to
+// the position fix of the same epoch.
+bool CopernicusGPS::process_vtg(const NMEAFields &f) {
+    if (f.chr(9) == 'N') return true; // not valid (NMEA 2.3 mode indicator)
+    float speed;
+    float course = 0;
+    if (nmea_float(f.begin(5), f.end(5), &speed)) {
+        speed *= KNOTS_TO_MPS;
+    } else if (nmea_float(f.begin(7), f.end(7), &speed)) {
+        speed *= KPH_TO_MPS;
+    } else {
+        return true;
+    }
+    nmea_float(f.begin(1), f.end(1), &course);
+    setNMEAVelocity(speed, course, m_pfix.getFixTime().f);
+    return true;
+}
+
+// $--ZDA: time, day, month, year, and the local time zone.
+bool CopernicusGPS::process_zda(const NMEAFields &f) {
+    float   sod;
+    int32_t d, m, y;
+    if (not nmea_time(f.begin(1), f.end(1), &sod) or
+            not nmea_int(f.begin(2), f.end(2), &d) or
+            not nmea_int(f.begin(3), f.end(3), &m) or
+            not nmea_int(f.begin(4), f.end(4), &y)) {
+        return true; // no time yet
+    }
+    setNMEADate(days_from_civil(y, m, d), sod);
+    return true;
+}
+
+#if CPN_ENABLE_SATELLITES
+// $--GSA: fix dimension, satellites used, and DOPs.
+bool CopernicusGPS::process_gsa(const NMEAFields &f) {
+    int32_t mode;
+    if (not nmea_int(f.begin(2), f.end(2), &mode)) return false;
+    // 2D and 3D fixes, numbered as by the all-in-view report.
+    uint8_t dim = (mode == 3) ? 4 : (mode == 2) ? 3 : 0;
+
+    uint32_t in_use = 0;
+    for (int i = 3; i <= 14; i++) {
+        int32_t prn;
+        if (nmea_int(f.begin(i), f.end(i), &prn) and prn >= 1 and prn <= MAX_SATELLITES) {
+            in_use |= (uint32_t)1 << (prn - 1);
+        }
+    }
+
+    SatelliteView &sv = m_sats;
+    Float32 dops[3] = {sv.pdop, sv.hdop, sv.vdop};
+    for (int i = 0; i < 3; i++) {
+        nmea_float(f.begin(15 + i), f.end(15 + i), &dops[i].f);
+    }
+    if (dim != sv.fix_dim or
+            dops[0].bits != sv.pdop.bits or dops[1].bits != sv.hdop.bits or
+            dops[2].bits != sv.vdop.bits) {
+        sv.fix_dim = dim;
+        sv.pdop = dops[0];
+        sv.hdop = dops[1];
+        sv.vdop = dops[2];
+        sv.dops_dirty = true;
+    }
+    sv.dirty |= sv.in_use ^ in_use;
+    sv.in_use = in_use;
+    return true;
+}
+
+// $--GSV: satellites in view, four to a sentence. The set of tracked
+// satellites is replaced once the last sentence of a series arrives.
+bool CopernicusGPS::process_gsv(const NMEAFields &f) {
+    int32_t total, num;
+    if (not nmea_int(f.begin(1), f.end(1), &total) or
+            not nmea_int(f.begin(2), f.end(2), &num)) {
+        return false;
+    }
+    if (num == 1) m_gsv_tracked = 0;
+
+    SatelliteView &sv = m_sats;
+    for (int k = 4; k < f.n; k += 4) {
+        int32_t prn;
+        if (not nmea_int(f.begin(k), f.end(k), &prn)) continue;
+        if (prn < 1 or prn > MAX_SATELLITES) continue; // not a GPS SV; ignore
+        int i = prn - 1;
+        uint32_t bit = (uint32_t)1 << i;
+
+        int32_t el  = sv.elevation[i];
+        int32_t az  = sv.azimuth[i];
+        int32_t snr = 0;
+        nmea_int(f.begin(k + 1), f.end(k + 1), &el);
+        nmea_int(f.begin(k + 2), f.end(k + 2), &az);
+        // an empty signal level means the satellite is not being tracked.
+        if (nmea_int(f.begin(k + 3), f.end(k + 3), &snr)) m_gsv_tracked |= bit;
+        if (snr < 0) snr = 0; else if (snr > 255) snr = 255;
+
+        if (sv.snr[i] != snr or sv.elevation[i] != el or sv.azimuth[i] != az) {
+            sv.snr[i]       = snr;
+            sv.elevation[i] = el;
+            sv.azimuth[i]   = az;
+            sv.dirty |= bit;
+        }
+    }
+    if (num == total) {
+        sv.dirty  |= sv.tracked ^ m_gsv_tracked;
+        sv.tracked = m_gsv_tracked;
+    }
+    return true;
+}
+#endif
+
+// replace the position fix with one from a sentence.
+void CopernicusGPS::setNMEAFix(double lat, double lng, float alt, float fixtime) {
+    PosFix pfix;
+#if CPN_NMEA_LLA_64
+    pfix.type = RPT_FIX_POS_LLA_64;
+    pfix.lla_64.lat.d  = lat;
+    pfix.lla_64.lng.d  = lng;
+    pfix.lla_64.alt.d  = alt;
+    pfix.lla_64.bias.d = 0;
+    pfix.lla_64.fixtime.f = fixtime;
+#else
+    pfix.type = RPT_FIX_POS_LLA_32;
+    pfix.lla_32.lat.f  = lat;
+    pfix.lla_32.lng.f  = lng;
+    pfix.lla_32.alt.f  = alt;
+    pfix.lla_32.bias.f = 0;
+    pfix.lla_32.fixtime.f = fixtime;
+#endif
+    m_pfix = pfix;
+}
+
+// replace the velocity fix with a ground speed (m/s) and course (degrees
+// from true north).
+void CopernicusGPS::setNMEAVelocity(float speed, float course, float fixtime) {
+    float c = course * DEG_TO_RAD_F;
+    VelFix vfix;
+    vfix.type = RPT_FIX_VEL_ENU;
+    vfix.enu.e.f = speed * sin(c);
+    vfix.enu.n.f = speed * cos(c);
+    vfix.enu.u.f = 0;
+    vfix.enu.bias.f = 0;
+    vfix.enu.fixtime.f = fixtime;
+    m_vfix = vfix;
+}
+
+// set the UTC date (days since the Unix epoch) and time of day, and the GPS
+// time from them.
+void CopernicusGPS::setNMEADate(int32_t day, float sec_of_day) {
+    m_nmea_day = day;
+    m_nmea_sod = sec_of_day;
+
+    int32_t sec    = (int32_t)sec_of_day;
+    int64_t unix_s = (int64_t)day * SECONDS_PER_DAY + sec;
+    int     leap   = leap_seconds_utc(unix_s);
+    int64_t gps_s  = unix_s - GPS_EPOCH_UNIX + leap;
+    m_time.week_no        = gps_s / GPS_WEEK_SECONDS;
+    m_time.time_of_week.f = (gps_s % GPS_WEEK_SECONDS) + (sec_of_day - sec);
+    m_time.utc_offs.f     = leap;
+}
+
+// the GPS time of week of a UTC time of day, on the date last sent. Until a
+// date has been received, this is the UTC time of day.
+float CopernicusGPS::nmeaTimeOfWeek(float sec_of_day) {
+    if (m_nmea_day < 0) return sec_of_day;
+    // a time much earlier than the last is on the following day.
+    if (sec_of_day < m_nmea_sod - SECONDS_PER_DAY / 2) m_nmea_day++;
+    m_nmea_sod = sec_of_day;
+
+    int32_t sec    = (int32_t)sec_of_day;
+    int64_t unix_s = (int64_t)m_nmea_day * SECONDS_PER_DAY + sec;
+    int64_t gps_s  = unix_s - GPS_EPOCH_UNIX + leap_seconds_utc(unix_s);
+    return (gps_s % GPS_WEEK_SECONDS) + (sec_of_day - sec);
+}
+
+#endif /* CPN_ENABLE_NMEA */
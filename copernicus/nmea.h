@@ -0,0 +1,69 @@
+/*
+ * File:   nmea.h
+ *
+ * Parsing of NMEA 0183 sentences. `CopernicusGPS` decodes sentences into
+ * the same structures as the TSIP reports; these functions are the parts
+ * which do not depend on it.
+ */
+
+#ifndef NMEA_H
+#define	NMEA_H
+
+#include "gpstype.h"
+
+/**
+ * @addtogroup processing
+ * @{
+ */
+
+/// Longest sentence, between the `$` and the CR LF, allowed by the standard.
+#define NMEA_MAX_SENTENCE 80
+/// Most fields of a sentence which are parsed; the rest are ignored.
+#define NMEA_MAX_FIELDS   24
+
+/**
+ * Whether checksums and fields are found a machine word at a time. Requires
+ * a little-endian machine with 64-bit words.
+ */
+#ifndef NMEA_SWAR
+#if defined(__GNUC__) && __SIZEOF_POINTER__ >= 8 && \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define NMEA_SWAR 1
+#else
+#define NMEA_SWAR 0
+#endif
+#endif
+
+/**
+ * @brief The fields of one sentence, found in place.
+ *
+ * Field 0 is the address (e.g. `GPGGA`). Field `i` spans
+ * `[begin(i), end(i))`; missing fields are empty.
+ */
+struct NMEAFields {
+    const char *s;
+    uint8_t     n;
+    /// Offset of the start of each field, and one past the end of the last.
+    uint8_t     start[NMEA_MAX_FIELDS + 1];
+
+    const char* begin(int i) const { return s + ((i < n) ? start[i] : 0); }
+    const char* end(int i)   const { return s + ((i < n) ? start[i + 1] - 1 : 0); }
+    bool        empty(int i) const { return i >= n or start[i + 1] - 1 == start[i]; }
+    char        chr(int i)   const { return empty(i) ? 0 : s[start[i]]; }
+};
+
+uint8_t    nmea_checksum(const char *s, int n);
+bool       nmea_verify(const char *s, int len, int *body_len);
+void       nmea_split(const char *s, int len, NMEAFields *f);
+ReportType nmea_type(const char *s, int len);
+
+bool nmea_decimal(const char *s, const char *end, int32_t *mant, uint8_t *scale);
+bool nmea_int(const char *s, const char *end, int32_t *v);
+bool nmea_float(const char *s, const char *end, float *v);
+bool nmea_angle(const char *s, const char *end, char hemi, double *rad);
+bool nmea_time(const char *s, const char *end, float *sec_of_day);
+int32_t days_from_civil(int32_t y, int m, int d);
+
+/// @} // addtogroup processing
+
+#endif	/* NMEA_H */
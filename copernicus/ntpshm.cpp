@@ -0,0 +1,262 @@
+/*
+ * File:   ntpshm.cpp
+ */
+
+#ifdef __linux__
+
+#include <math.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "ntpshm.h"
+#include "timeconv.h"
+
+// samples the daemon is told to take a median of (ntpd ignores this).
+#define NTPSHM_NSAMPLES 3
+
+static inline int64_t timespec_ns(const struct timespec &ts) {
+    return (int64_t)ts.tv_sec * NS_PER_SECOND + ts.tv_nsec;
+}
+
+// whether a UTC time falls on a day at whose end leap seconds are scheduled
+// (the last of June or December), which is the only day the daemons accept
+// a warning on.
+static bool is_leap_day(int64_t unix_ns) {
+    time_t t = unix_ns / NS_PER_SECOND;
+    struct tm tm;
+    if (gmtime_r(&t, &tm) == NULL) return false;
+    return (tm.tm_mon == 5 and tm.tm_mday == 30) or (tm.tm_mon == 11 and tm.tm_mday == 31);
+}
+
+/***************************
+ * structors               *
+ ***************************/
+
+/**
+ * Construct a new `NTPShmClock` for the time reports of `gps`.
+ *
+ * @param gps Receiver whose time is to be published.
+ * @param pps Whether samples are timed by PPS edges (see `ppsEdge()`),
+ * rather than by the arrival of time reports.
+ */
+NTPShmClock::NTPShmClock(CopernicusGPS *gps, bool pps):
+        m_gps(gps),
+        m_pps(pps),
+        m_shm_id(-1),
+        m_shm(NULL),
+        m_leap(NTP_LEAP_NONE),
+        m_label_valid(false),
+        m_label_ns(0),
+        m_label_rx_ns(0),
+        m_edge_ns(0) {
+    resetStats();
+}
+
+NTPShmClock::~NTPShmClock() {
+    close();
+}
+
+/***************************
+ * segment                 *
+ ***************************/
+
+/**
+ * Attach to the shared memory segment of an NTP SHM unit, creating it if
+ * the daemon has not.
+ *
+ * @param unit Unit number, as given in the daemon's configuration.
+ * @return `false` if the segment could not be created or attached, e.g.
+ * for want of permission, or because it exists with a different size.
+ */
+bool NTPShmClock::open(int unit) {
+    close();
+    if (unit < 0) return false;
+    int perm = (unit < 2) ? 0600 : 0666;
+    m_shm_id = shmget(NTPSHM_KEY + unit, sizeof(NTPShmTime), IPC_CREAT | perm);
+    if (m_shm_id < 0) return false;
+    void *p = shmat(m_shm_id, NULL, 0);
+    if (p == (void*)-1) {
+        m_shm_id = -1;
+        return false;
+    }
+    m_shm = static_cast<NTPShmTime*>(p);
+    memset(m_shm, 0, sizeof(NTPShmTime));
+    m_shm->mode      = 1;
+    m_shm->nsamples  = NTPSHM_NSAMPLES;
+    m_shm->precision = m_pps ? NTPSHM_PRECISION_PPS : NTPSHM_PRECISION_SERIAL;
+    m_label_valid = false;
+    m_edge_ns     = 0;
+    return true;
+}
+
+/**
+ * Detach from the segment. The segment itself is left for the daemon.
+ */
+void NTPShmClock::close() {
+    if (m_shm != NULL) shmdt(m_shm);
+    m_shm    = NULL;
+    m_shm_id = -1;
+}
+
+// write one sample, without locking: a reader which overlaps the write sees
+// `count` change, or `valid` clear, and discards what it read.
+bool NTPShmClock::publish(int64_t clock_ns, int64_t receive_ns, int precision) {
+    if (m_shm == NULL) return false;
+    const GPSStatus &status = m_gps->getStatus();
+    NTPLeap leap = m_leap;
+    if (leap == NTP_LEAP_NONE and status.leap_pending and is_leap_day(clock_ns)) {
+        leap = NTP_LEAP_INSERT;
+    }
+    // until the receiver has said it is doing fixes, its time is not trusted.
+#if CPN_ENABLE_STATUS
+    if (status.health != HLTH_DOING_FIXES) leap = NTP_LEAP_NOTINSYNC;
+#else
+    // without health reports, only a valid fix says so.
+    if (m_gps->getPositionFix().getFixTime().bits & 0x80000000) leap = NTP_LEAP_NOTINSYNC;
+#endif
+
+    NTPShmTime *shm = m_shm;
+    shm->valid = 0;
+    shm->count = shm->count + 1;
+    __sync_synchronize();
+    shm->mode         = 1;
+    shm->clock_sec    = clock_ns / NS_PER_SECOND;
+    shm->clock_nsec   = clock_ns % NS_PER_SECOND;
+    shm->clock_usec   = shm->clock_nsec / 1000;
+    shm->receive_sec  = receive_ns / NS_PER_SECOND;
+    shm->receive_nsec = receive_ns % NS_PER_SECOND;
+    shm->receive_usec = shm->receive_nsec / 1000;
+    shm->leap         = leap;
+    shm->precision    = precision;
+    shm->nsamples     = NTPSHM_NSAMPLES;
+    __sync_synchronize();
+    shm->count = shm->count + 1;
+    shm->valid = 1;
+
+    double offset = (clock_ns - receive_ns) / (double)NS_PER_SECOND;
+    if (m_stats.samples > 0) {
+        double d = offset - m_last_offset;
+        m_delta2_sum  += d * d;
+        m_stats.jitter = sqrt(m_delta2_sum / m_stats.samples);
+    }
+    m_stats.samples++;
+    m_offset_sum += offset;
+    m_stats.mean_offset = m_offset_sum / m_stats.samples;
+    m_last_offset = offset;
+    return true;
+}
+
+/***************************
+ * samples                 *
+ ***************************/
+
+/**
+ * Take the time of the report just processed (see
+ * `CopernicusGPS::getGPSTime()`). Call after each `RPT_GPSTIME`. Unless
+ * timing by PPS, a sample is published; otherwise the time labels the next
+ * PPS edge.
+ *
+ * Times before the receiver knows the UTC offset are not used.
+ *
+ * @param rx Host time (`CLOCK_REALTIME`) at which the report arrived, or
+ * `NULL` for now.
+ * @return Whether a sample was published or an edge labelled.
+ */
+bool NTPShmClock::timeReceived(const struct timespec *rx) {
+    struct timespec now;
+    if (rx == NULL) {
+        clock_gettime(CLOCK_REALTIME, &now);
+        rx = &now;
+    }
+    const GPSTime &t = m_gps->getGPSTime();
+    if ((t.time_of_week.bits & 0x80000000) or not (t.utc_offs.f >= 0.5f)) {
+        m_label_valid = false;
+        return false;
+    }
+    int64_t clock_ns = gps_to_unix_ns(t);
+    if (not m_pps) {
+        return publish(clock_ns, timespec_ns(*rx), NTPSHM_PRECISION_SERIAL);
+    }
+    // the time is that of the last pulse, which began a whole second.
+    m_label_ns    = (clock_ns + NS_PER_SECOND / 2) / NS_PER_SECOND * NS_PER_SECOND;
+    m_label_rx_ns = timespec_ns(*rx);
+    m_label_valid = true;
+    return true;
+}
+
+/**
+ * Publish a sample for a PPS edge, labelled with the second following the
+ * last time report. The report must have arrived between the previous edge
+ * and this one, and the edges must be about a second apart; otherwise the
+ * edge is dropped. Only used when timing by PPS.
+ *
+ * @param edge Host time (`CLOCK_REALTIME`) of the edge.
+ * @return Whether a sample was published.
+ */
+bool NTPShmClock::ppsEdge(const struct timespec &edge) {
+    if (not m_pps) return false;
+    int64_t edge_ns = timespec_ns(edge);
+    int64_t prev_ns = m_edge_ns;
+    bool    labeled = m_label_valid;
+    m_edge_ns     = edge_ns;
+    m_label_valid = false; // a report labels only one edge
+    if (not labeled or prev_ns == 0 or
+            m_label_rx_ns <= prev_ns or m_label_rx_ns >= edge_ns or
+            edge_ns - prev_ns > NS_PER_SECOND * 3 / 2) {
+        m_stats.rejected++;
+        return false;
+    }
+    return publish(m_label_ns + NS_PER_SECOND, edge_ns, NTPSHM_PRECISION_PPS);
+}
+
+/***************************
+ * access                  *
+ ***************************/
+
+/**
+ * Set the leap second warning sent with each sample, overriding the
+ * receiver's. The receiver flags a pending leap second in the minor alarms of
+ * its supplemental timing superpacket (0x8F-AC), without saying which way it
+ * goes; while the flag is set, and no warning has been set here, an insertion
+ * is announced on June 30 and December 31 (UTC). Set a warning here to
+ * announce a deletion, or when timing superpackets are not received; it
+ * should be cleared once the leap second has passed.
+ *
+ * Samples are sent as unsynchronized regardless, until the receiver has
+ * reported that it is doing fixes, and whenever it reports otherwise. If
+ * status reports are compiled out (`CPN_ENABLE_STATUS`), they are sent as
+ * unsynchronized unless the last position fix is valid.
+ */
+void NTPShmClock::setLeapWarning(NTPLeap leap) {
+    m_leap = leap;
+}
+
+/**
+ * Get the leap second warning set with `setLeapWarning()`.
+ */
+NTPLeap NTPShmClock::getLeapWarning() const {
+    return m_leap;
+}
+
+/**
+ * Get statistics of the samples published so far, for comparing sources.
+ */
+const NTPShmStats& NTPShmClock::getStats() const {
+    return m_stats;
+}
+
+/**
+ * Discard the statistics of the samples published so far.
+ */
+void NTPShmClock::resetStats() {
+    m_stats.samples     = 0;
+    m_stats.rejected    = 0;
+    m_stats.mean_offset = 0;
+    m_stats.jitter      = 0;
+    m_last_offset = 0;
+    m_offset_sum  = 0;
+    m_delta2_sum  = 0;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,169 @@
+/*
+ * File:   ntpshm.h
+ *
+ * Publishes the receiver's time to ntpd or chronyd through the shared
+ * memory reference clock driver. Linux only; on the host, `CopernicusGPS`
+ * needs an Arduino-compatible `HardwareSerial` shim (see copernicus.h).
+ */
+
+#ifndef NTPSHM_H
+#define	NTPSHM_H
+
+#ifdef __linux__
+
+#include <time.h>
+
+#include "copernicus.h"
+
+/**
+ * @addtogroup monitor
+ * @{
+ */
+
+/// SysV IPC key of shared memory unit 0 ("NTP0"); unit `n` is this plus `n`.
+#define NTPSHM_KEY            0x4e545030
+/// Precision of samples timed by PPS edges, as a power of two in seconds (about 1 us).
+#define NTPSHM_PRECISION_PPS  -20
+/// Precision of samples timed by the arrival of time reports (about 1 ms).
+#define NTPSHM_PRECISION_SERIAL -10
+
+/**
+ * Leap second warnings, as sent to the time daemon.
+ */
+enum NTPLeap {
+    /// No leap second is pending.
+    NTP_LEAP_NONE     = 0,
+    /// A second will be inserted at the end of the current UTC day.
+    NTP_LEAP_INSERT   = 1,
+    /// A second will be deleted at the end of the current UTC day.
+    NTP_LEAP_DELETE   = 2,
+    /// The clock is not synchronized; samples should not be used.
+    NTP_LEAP_NOTINSYNC = 3,
+};
+
+/**
+ * @brief A shared memory segment, as laid out by ntpd's `refclock_shm.c`.
+ *
+ * chronyd and gpsd use the same layout.
+ */
+struct NTPShmTime {
+    int      mode;
+    volatile int count;
+    time_t   clock_sec;
+    int      clock_usec;
+    time_t   receive_sec;
+    int      receive_usec;
+    int      leap;
+    int      precision;
+    int      nsamples;
+    volatile int valid;
+    unsigned clock_nsec;
+    unsigned receive_nsec;
+    int      dummy[8];
+};
+
+/**
+ * @brief Statistics of the samples published by an `NTPShmClock`.
+ */
+struct NTPShmStats {
+    /// Samples written to the segment.
+    uint32_t samples;
+    /// PPS edges or time reports which could not be matched, and were dropped.
+    uint32_t rejected;
+    /// Mean offset of the receiver's time from the host's, in seconds.
+    double   mean_offset;
+    /// RMS difference between successive offsets, in seconds.
+    double   jitter;
+};
+
+/**
+ * @brief Feeds the receiver's time to a local ntpd or chronyd.
+ *
+ * Each sample pairs a UTC time from the receiver with the host's clock at
+ * the same instant, and is written to an NTP shared memory segment, which
+ * the daemon polls (`refclock SHM 0` in chrony.conf, or `server
+ * 127.127.28.0` in ntp.conf).
+ *
+ * Samples may be timed in one of two ways:
+ *
+ *  - By the arrival of each time report. The host timestamps the packet
+ *    when it is read, and the receiver's time is that of its last PPS
+ *    pulse, so the samples lag by the report's latency and jitter by its
+ *    serial transfer time; the daemon should be told the mean offset (e.g.
+ *    `offset` in chrony.conf).
+ *  - By the PPS pulse. The host timestamps each pulse's edge (e.g. with the
+ *    kernel PPS API), and the edge is labelled with the whole UTC second
+ *    which follows the time in the last report. The report must have
+ *    arrived since the previous edge.
+ *
+ * Each segment is written without locks, using the "mode 1" protocol: the
+ * `count` field is incremented before and after each update, so that a
+ * reader which sees it change, or sees `valid` clear, discards the sample.
+ *
+ * Example, with one serial unit and one PPS unit:
+ *
+ *      NTPShmClock serial_clk(&gps, false);
+ *      NTPShmClock pps_clk(&gps, true);
+ *      serial_clk.open(0);
+ *      pps_clk.open(1);
+ *      while (true) {
+ *          // on a PPS edge at host time `edge`:
+ *          pps_clk.ppsEdge(edge);
+ *          // ...
+ *          ReportType rpt = gps.processOnePacket(true);
+ *          if (rpt == RPT_GPSTIME) {
+ *              serial_clk.timeReceived();
+ *              pps_clk.timeReceived();
+ *          }
+ *      }
+ *
+ * Units 0 and 1 are created readable only by their owner, as ntpd expects;
+ * units 2 and up are created world-writable.
+ *
+ * `tools/shm-compare.sh` compares the jitter of the samples, as chronyd sees
+ * it, with that of another SHM source fed by the same receiver, e.g. gpsd.
+ */
+class NTPShmClock {
+public:
+    NTPShmClock(CopernicusGPS *gps, bool pps);
+    ~NTPShmClock();
+
+    bool open(int unit);
+    void close();
+
+    bool timeReceived(const struct timespec *rx=NULL);
+    bool ppsEdge(const struct timespec &edge);
+
+    void    setLeapWarning(NTPLeap leap);
+    NTPLeap getLeapWarning() const;
+
+    const NTPShmStats& getStats() const;
+    void resetStats();
+
+private:
+
+    bool publish(int64_t clock_ns, int64_t receive_ns, int precision);
+
+    CopernicusGPS *m_gps;
+    bool     m_pps;
+    int      m_shm_id;
+    NTPShmTime *m_shm;
+    NTPLeap  m_leap;
+
+    // the last time report, for labelling the next PPS edge
+    bool     m_label_valid;
+    int64_t  m_label_ns;     // UTC of the receiver's last PPS, ns since 1970
+    int64_t  m_label_rx_ns;  // host time the report arrived
+    int64_t  m_edge_ns;      // host time of the last PPS edge, or 0
+
+    NTPShmStats m_stats;
+    double   m_last_offset;
+    double   m_offset_sum;
+    double   m_delta2_sum;   // sum of squared successive differences
+};
+
+/// @} // addtogroup monitor
+
+#endif /* __linux__ */
+
+#endif	/* NTPSHM_H */
@@ -0,0 +1,247 @@
+/*
+ * File:   predictor.cpp
+ */
+
+#include <math.h>
+
+#include "predictor.h"
+#include "fixp.h"
+
+// variance of an unknown velocity
+#define VAR_UNKNOWN 1.0e4f
+
+static inline int32_t round_to_int(float x) {
+    return (int32_t)(x < 0 ? x - 0.5f : x + 0.5f);
+}
+
+/***************************
+ * structors               *
+ ***************************/
+
+/**
+ * Construct a new `FixPredictor`.
+ *
+ * @param pos_sigma Standard deviation of the error of each position fix
+ * coordinate, in meters.
+ * @param vel_sigma Standard deviation of the error of each velocity fix
+ * coordinate, in meters per second.
+ * @param accel_sigma Standard deviation of the acceleration of the receiver,
+ * in meters per second per second. Larger values make the filter follow
+ * maneuvers more quickly, at the expense of smoothing less.
+ */
+FixPredictor::FixPredictor(float pos_sigma, float vel_sigma, float accel_sigma):
+        m_r_pos(pos_sigma * pos_sigma),
+        m_r_vel(vel_sigma * vel_sigma),
+        m_q(accel_sigma * accel_sigma),
+        m_valid(false) {}
+
+/**
+ * Discard the state of the filter. The next fix will become the new
+ * reference point.
+ */
+void FixPredictor::reset() {
+    m_valid = false;
+}
+
+/***************************
+ * filtering               *
+ ***************************/
+
+/**
+ * Update the filter with a new fix.
+ *
+ * The velocity fix is used only if it belongs to the same epoch as the
+ * position fix (i.e. their fix times are equal); otherwise only the position
+ * is used.
+ *
+ * @param pfix New position fix.
+ * @param vfix Most recent velocity fix.
+ * @param t_us Time at which the fix was valid, in microseconds.
+ * @return `false` if `pfix` is not a valid fix, `true` otherwise.
+ */
+bool FixPredictor::update(const PosFix &pfix, const VelFix &vfix, uint32_t t_us) {
+    int64_t fixed[3];
+    if (not fix_to_fixed(pfix, fixed)) return false;
+    if (not m_valid or is_lla(pfix.type) != is_lla(m_ref.type)) {
+        setReference(pfix, fixed);
+        m_valid = false;
+    }
+
+    float z[3];
+    float zv[3];
+    for (int i = 0; i < 3; i++) {
+        int64_t d = fixed[i] - m_ref_fixed[i];
+        if (i == 0 and is_lla(m_ref.type)) {
+            // longitude wraps around
+            if      (d >  FIXP_ANGLE_2PI / 2) d -= FIXP_ANGLE_2PI;
+            else if (d < -FIXP_ANGLE_2PI / 2) d += FIXP_ANGLE_2PI;
+        }
+        z[i] = (float)d;
+    }
+    if (is_lla(m_ref.type)) {
+        z[0] *= FIXP_ANGLE_SCALE * m_frame.east;
+        z[1] *= FIXP_ANGLE_SCALE * m_frame.north;
+        z[2] *= FIXP_LENGTH_SCALE;
+    } else {
+        for (int i = 0; i < 3; i++) z[i] *= FIXP_LENGTH_SCALE;
+    }
+    bool has_vel = measureVelocity(vfix, pfix.getFixTime(), zv);
+
+    if (not m_valid) {
+        for (int i = 0; i < 3; i++) {
+            m_p[i] = z[i];
+            m_v[i] = has_vel ? zv[i] : 0;
+        }
+        m_cov[0] = m_r_pos;
+        m_cov[1] = 0;
+        m_cov[2] = has_vel ? m_r_vel : VAR_UNKNOWN;
+        m_t      = t_us;
+        m_valid  = true;
+    } else {
+        float dt = (int32_t)(t_us - m_t) * 1e-6f;
+        if (dt < 0) dt = 0;
+        m_t = t_us;
+
+        // predict: constant velocity, with white noise acceleration.
+        float dt2 = dt * dt;
+        float p00 = m_cov[0] + dt * (2 * m_cov[1] + dt * m_cov[2]) + m_q * dt2 * dt / 3;
+        float p01 = m_cov[1] + dt * m_cov[2] + m_q * dt2 / 2;
+        float p11 = m_cov[2] + m_q * dt;
+        for (int i = 0; i < 3; i++) m_p[i] += m_v[i] * dt;
+
+        // correct.
+        float k00, k01, k10, k11;
+        if (has_vel) {
+            float s00 = p00 + m_r_pos;
+            float s11 = p11 + m_r_vel;
+            float det = s00 * s11 - p01 * p01;
+            k00 = (p00 * s11 - p01 * p01) / det;
+            k01 = (p01 * s00 - p00 * p01) / det;
+            k10 = (p01 * s11 - p11 * p01) / det;
+            k11 = (p11 * s00 - p01 * p01) / det;
+        } else {
+            float s00 = p00 + m_r_pos;
+            k00 = p00 / s00;
+            k10 = p01 / s00;
+            k01 = k11 = 0;
+        }
+        for (int i = 0; i < 3; i++) {
+            float rp = z[i] - m_p[i];
+            float rv = has_vel ? zv[i] - m_v[i] : 0;
+            m_p[i] += k00 * rp + k01 * rv;
+            m_v[i] += k10 * rp + k11 * rv;
+        }
+        m_cov[0] = (1 - k00) * p00 - k01 * p01;
+        m_cov[1] = (1 - k00) * p01 - k01 * p11;
+        m_cov[2] = (1 - k11) * p11 - k10 * p01;
+    }
+
+    // move the reference to this fix once the estimate strays far from it.
+    // the axes of an LLA frame turn by well under a milliradian, so the
+    // velocity is kept as it is.
+    bool far = false;
+    for (int i = 0; i < 3; i++) far |= fabsf(m_p[i]) > PREDICTOR_RECENTER_M;
+    if (far) {
+        setReference(pfix, fixed);
+        for (int i = 0; i < 3; i++) m_p[i] -= z[i];
+    }
+
+#if PREDICTOR_FIXED_POINT
+    for (int i = 0; i < 3; i++) {
+        m_p_mm[i]  = round_to_int(m_p[i] * 1000);
+        m_v_q20[i] = round_to_int(m_v[i] * (1000 * 1.048576f));
+    }
+#endif
+    return true;
+}
+
+/**
+ * Predict the position of the receiver at the given time.
+ *
+ * @param t_us Time of the prediction, in microseconds.
+ * @param out Predicted offset from the reference point, along the axes of
+ * the local frame.
+ * @return `false` if the filter has not received a valid fix yet, in which
+ * case `out` is unaltered.
+ */
+bool FixPredictor::predict(uint32_t t_us, PredScalar out[3]) const {
+    if (not m_valid) return false;
+    int32_t dt = (int32_t)(t_us - m_t);
+#if PREDICTOR_FIXED_POINT
+    for (int i = 0; i < 3; i++) {
+        out[i] = m_p_mm[i] + (int32_t)(((int64_t)m_v_q20[i] * dt) >> 20);
+    }
+#else
+    float dt_s = dt * 1e-6f;
+    for (int i = 0; i < 3; i++) {
+        out[i] = m_p[i] + m_v[i] * dt_s;
+    }
+#endif
+    return true;
+}
+
+// convert a velocity fix from the given epoch to the axes of the local frame.
+bool FixPredictor::measureVelocity(const VelFix &vfix, Float32 fixtime, float out[3]) const {
+    float e, n, u;
+    if (vfix.type == RPT_FIX_VEL_ENU) {
+        const ENU_VFix *v = vfix.getENU();
+        if (v->fixtime.bits != fixtime.bits) return false;
+        e = v->e.f;
+        n = v->n.f;
+        u = v->u.f;
+    } else if (vfix.type == RPT_FIX_VEL_XYZ) {
+        const XYZ_VFix *v = vfix.getXYZ();
+        if (v->fixtime.bits != fixtime.bits) return false;
+        if (not is_lla(m_ref.type)) {
+            out[0] = v->x.f;
+            out[1] = v->y.f;
+            out[2] = v->z.f;
+            return true;
+        }
+        frame_to_enu(m_frame, v->x.f, v->y.f, v->z.f, out);
+        return true;
+    } else {
+        return false;
+    }
+    if (is_lla(m_ref.type)) {
+        out[0] = e;
+        out[1] = n;
+        out[2] = u;
+    } else {
+        frame_to_ecef(m_frame, e, n, u, out);
+    }
+    return true;
+}
+
+void FixPredictor::setReference(const PosFix &pfix, const int64_t fixed[3]) {
+    m_ref = pfix;
+    for (int i = 0; i < 3; i++) m_ref_fixed[i] = fixed[i];
+    local_frame(fixed, is_lla(pfix.type), &m_frame);
+}
+
+/***************************
+ * access                  *
+ ***************************/
+
+/**
+ * Whether the filter has received a valid fix, and can make predictions.
+ */
+bool FixPredictor::isValid() const {
+    return m_valid;
+}
+
+/**
+ * Get the type of position fix defining the local frame; either an LLA type
+ * (east/north/up axes) or an ECEF type (X/Y/Z axes). `RPT_NONE` if the filter
+ * has no reference point yet.
+ */
+ReportType FixPredictor::getFrame() const {
+    return m_ref.type;
+}
+
+/**
+ * Get the fix which defines the reference point of the local frame.
+ */
+const PosFix& FixPredictor::getReference() const {
+    return m_ref;
+}
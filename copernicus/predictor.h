@@ -0,0 +1,125 @@
+/*
+ * File:   predictor.h
+ */
+
+#ifndef PREDICTOR_H
+#define	PREDICTOR_H
+
+#include "gpstype.h"
+#include "fixp.h"
+
+/**
+ * @defgroup processing
+ * @brief Modules for processing decoded fixes.
+ */
+
+/**
+ * @addtogroup processing
+ * @{
+ */
+
+// fixed point arithmetic is much cheaper than soft float on AVR.
+#ifndef PREDICTOR_FIXED_POINT
+#ifdef __AVR__
+#define PREDICTOR_FIXED_POINT 1
+#else
+#define PREDICTOR_FIXED_POINT 0
+#endif
+#endif
+
+/// Distance from the reference point, in meters, beyond which it is moved.
+#ifndef PREDICTOR_RECENTER_M
+#define PREDICTOR_RECENTER_M 1000.0f
+#endif
+
+#if PREDICTOR_FIXED_POINT || defined(PARSING_DOXYGEN)
+/// Predicted coordinate; millimeters in fixed point builds, meters otherwise.
+typedef int32_t PredScalar;
+#else
+typedef float   PredScalar;
+#endif
+
+/**
+ * @brief Kalman filter for predicting the position of the receiver between fixes.
+ *
+ * Position and velocity fixes are combined by a constant-velocity Kalman
+ * filter, which can then be queried for the position at any time. Queries
+ * take constant time and don't update the filter, so they may be made far
+ * more often than fixes arrive. No dynamic memory is used.
+ *
+ * Positions are predicted in a local frame, as offsets from a reference
+ * point (the first fix given to the filter). So that offsets stay small and
+ * precise, the reference point is moved to the latest fix whenever the
+ * estimate strays more than `PREDICTOR_RECENTER_M` from it along any axis;
+ * a prediction should be taken together with `getReference()`. If the
+ * position fixes are LLA,
+ * the axes of the local frame are east, north, and up. If the position fixes
+ * are ECEF, the axes are the ECEF X, Y, and Z axes. Either kind of velocity
+ * fix may be used with either kind of position fix. 32- and 64-bit fixes are
+ * both supported; no 64-bit `double` is needed for the latter.
+ *
+ * If `PREDICTOR_FIXED_POINT` is nonzero (the default on AVR), predicted
+ * offsets are in integer millimeters and `predict()` uses only integer
+ * arithmetic. Otherwise, predicted offsets are `float` meters.
+ *
+ * Times are given in microseconds on any monotonic clock, such as `micros()`.
+ * Each fix should be stamped with the time at which it was valid.
+ *
+ * Example:
+ *
+ *      FixPredictor predictor;
+ *      // ...
+ *      if (gps.processOnePacket() == RPT_FIX_POS_LLA_32) {
+ *          predictor.update(gps.getPositionFix(), gps.getVelocityFix(), micros());
+ *      }
+ *      // ...
+ *      PredScalar enu[3];
+ *      if (predictor.predict(micros(), enu)) {
+ *          // enu[0] is meters/mm east of predictor.getReference().
+ *      }
+ */
+class FixPredictor {
+public:
+    FixPredictor(float pos_sigma=4.0, float vel_sigma=0.1, float accel_sigma=2.0);
+
+    void reset();
+    bool update(const PosFix &pfix, const VelFix &vfix, uint32_t t_us);
+    bool predict(uint32_t t_us, PredScalar out[3]) const;
+
+    bool          isValid() const;
+    ReportType    getFrame() const;
+    const PosFix& getReference() const;
+
+private:
+
+    bool measureVelocity(const VelFix &vfix, Float32 fixtime, float out[3]) const;
+    void setReference(const PosFix &pfix, const int64_t fixed[3]);
+
+    // measurement and process noise variances
+    float m_r_pos;
+    float m_r_vel;
+    float m_q;
+
+    // reference point of the local frame
+    PosFix  m_ref;
+    int64_t m_ref_fixed[3];
+    LocalFrame m_frame;
+
+    // filter state, per axis. the covariance is the same for each axis,
+    // since they share measurement noise and epochs.
+    bool     m_valid;
+    uint32_t m_t;
+    float    m_p[3];
+    float    m_v[3];
+    float    m_cov[3]; // P00, P01, P11
+
+#if PREDICTOR_FIXED_POINT
+    // state for prediction: millimeters, and millimeters per 2^20 us.
+    int32_t  m_p_mm[3];
+    int32_t  m_v_q20[3];
+#endif
+};
+
+/// @} // addtogroup processing
+
+#endif	/* PREDICTOR_H */
@@ -0,0 +1,149 @@
+/*
+ * File:   profiler.cpp
+ */
+
+#include "profiler.h"
+
+#ifdef __AVR__
+// bounds of the free RAM between the static data and the stack (see the
+// avr-libc memory map)
+extern uint8_t _end;
+extern uint8_t __stack;
+
+#define STACK_PAINT  0xC5
+// bytes below the stack pointer which are left unpainted, for the
+// painting function's own use.
+#define STACK_MARGIN 16
+#endif
+
+/***************************
+ * structors               *
+ ***************************/
+
+/**
+ * Construct a new `ReportProfiler` for the reports of `gps`.
+ */
+ReportProfiler::ReportProfiler(CopernicusGPS *gps):
+        m_gps(gps) {
+    reset();
+}
+
+/**
+ * Discard all timings.
+ */
+void ReportProfiler::reset() {
+    m_n_slots     = 0;
+    m_max_latency = 0;
+    m_waiting     = false;
+    m_seen        = 0;
+}
+
+/***************************
+ * profiling               *
+ ***************************/
+
+/**
+ * Process one packet with `CopernicusGPS::processOnePacket()`, recording
+ * the time taken.
+ */
+ReportType ReportProfiler::processOnePacket(bool block) {
+    uint32_t t0 = CPN_PROFILE_CLOCK();
+    if (not m_waiting and m_gps->getSerial()->available() > 0) {
+        m_waiting = true;
+        m_seen    = t0;
+    }
+    ReportType rpt = m_gps->processOnePacket(block);
+    uint32_t t1 = CPN_PROFILE_CLOCK();
+    if (rpt == RPT_NONE) return rpt;
+
+    // a blocking call may have waited for the data to arrive.
+    if (not m_waiting) m_seen = t0;
+    record(rpt, t1 - t0, t1 - m_seen);
+    // any data left over belongs to the next packet.
+    m_waiting = m_gps->getSerial()->available() > 0;
+    m_seen    = t1;
+    return rpt;
+}
+
+void ReportProfiler::record(ReportType type, uint32_t elapsed, uint32_t latency) {
+    if (latency > m_max_latency) m_max_latency = latency;
+    ReportProfile *p = NULL;
+    for (int i = 0; i < m_n_slots; i++) {
+        if (m_slots[i].type == type) {
+            p = &m_slots[i];
+            break;
+        }
+    }
+    if (p == NULL) {
+        if (m_n_slots >= PROFILE_SLOTS) return;
+        p = &m_slots[m_n_slots++];
+        p->type  = type;
+        p->count = 0;
+        p->total = 0;
+        p->min   = elapsed;
+        p->max   = elapsed;
+        p->max_latency = latency;
+    }
+    p->count += 1;
+    p->total += elapsed;
+    if (elapsed < p->min) p->min = elapsed;
+    if (elapsed > p->max) p->max = elapsed;
+    if (latency > p->max_latency) p->max_latency = latency;
+}
+
+#ifdef __AVR__
+
+/**
+ * Fill the unused RAM below the stack with a pattern, so that the depth the
+ * stack reaches can be found later with `getStackUsage()`. Call once, early
+ * in `setup()`. Memory allocated from the heap afterward is counted as stack.
+ */
+void ReportProfiler::paintStack() {
+    uint8_t *p   = &_end;
+    uint8_t *top = reinterpret_cast<uint8_t*>(SP) - STACK_MARGIN;
+    while (p < top) *p++ = STACK_PAINT;
+}
+
+/**
+ * Get the greatest number of bytes of stack used since `paintStack()` was
+ * called.
+ */
+uint16_t ReportProfiler::getStackUsage() {
+    const uint8_t *p = &_end;
+    while (p <= &__stack and *p == STACK_PAINT) p++;
+    return (uint16_t)(&__stack - p + 1);
+}
+
+#endif
+
+/***************************
+ * access                  *
+ ***************************/
+
+/**
+ * Get the timings of one report type, or `NULL` if none has been processed.
+ */
+const ReportProfile* ReportProfiler::getProfile(ReportType type) const {
+    for (int i = 0; i < m_n_slots; i++) {
+        if (m_slots[i].type == type) return &m_slots[i];
+    }
+    return NULL;
+}
+
+/**
+ * Get the timings of all the report types processed, in the order they
+ * were first seen. At most `PROFILE_SLOTS` types are kept.
+ *
+ * @param n Set to the number of report types.
+ */
+const ReportProfile* ReportProfiler::getProfiles(int *n) const {
+    *n = m_n_slots;
+    return m_slots;
+}
+
+/**
+ * Get the greatest latency of any report, in ticks of `CPN_PROFILE_CLOCK()`.
+ */
+uint32_t ReportProfiler::getMaxLatency() const {
+    return m_max_latency;
+}
@@ -0,0 +1,113 @@
+/*
+ * File:   profiler.h
+ */
+
+#ifndef PROFILER_H
+#define	PROFILER_H
+
+#include "copernicus.h"
+
+/**
+ * @addtogroup monitor
+ * @{
+ */
+
+/// Number of report types whose timings are kept.
+#define PROFILE_SLOTS 12
+
+/**
+ * Clock used for timing; by default `micros()`. On an AVR, this may be
+ * defined as e.g. a read of a free-running timer for cycle resolution.
+ */
+#ifndef CPN_PROFILE_CLOCK
+#define CPN_PROFILE_CLOCK() micros()
+#endif
+
+/**
+ * @brief Timings of one report type, in ticks of `CPN_PROFILE_CLOCK()`.
+ */
+struct ReportProfile {
+    ReportType type;
+    /// Number of reports processed.
+    uint32_t count;
+    /// Total time spent processing the reports.
+    uint32_t total;
+    /// Least and greatest time spent processing one report.
+    uint32_t min, max;
+    /// Greatest time from the report's data being noticed to its processing
+    /// being done, including time spent outside the profiler.
+    uint32_t max_latency;
+};
+
+/**
+ * @brief Measures the time taken to process each type of report, on the
+ * target itself.
+ *
+ * Call the profiler's `processOnePacket()` in place of the receiver's. The
+ * time taken by each call is recorded for the type of report it processed,
+ * and so is its latency: the time from when the profiler first saw data
+ * waiting in the serial buffer to the end of the call which processed it.
+ * Latency thus includes the rest of the main loop, and is the better measure
+ * of how stale a fix may be when it is delivered. It is not measured from
+ * the serial interrupt which received the data, which the profiler cannot
+ * see; tools/simavr measures that latency in a simulator.
+ *
+ * A call which finds only part of a packet in the buffer waits for the rest,
+ * and that wait is counted; to measure the cost of decoding alone, call it
+ * only when there is no packet in progress, or compare `min` with `max`.
+ *
+ * On an AVR, `paintStack()` and `getStackUsage()` measure the greatest depth
+ * the stack has reached, by filling the free RAM with a pattern and later
+ * finding how much of it has been overwritten.
+ *
+ * Example:
+ *
+ *      ReportProfiler prof(&gps);
+ *
+ *      void setup() {
+ *          ReportProfiler::paintStack();
+ *      }
+ *
+ *      void loop() {
+ *          prof.processOnePacket();
+ *          if (millis() - last_print > 10000) {
+ *              int n;
+ *              const ReportProfile *p = prof.getProfiles(&n);
+ *              for (int i = 0; i < n; i++) {
+ *                  // print p[i].type, p[i].total / p[i].count, p[i].max ...
+ *              }
+ *              Serial.println(ReportProfiler::getStackUsage());
+ *          }
+ *      }
+ */
+class ReportProfiler {
+public:
+    ReportProfiler(CopernicusGPS *gps);
+
+    ReportType processOnePacket(bool block=false);
+    void reset();
+
+    const ReportProfile* getProfile(ReportType type) const;
+    const ReportProfile* getProfiles(int *n) const;
+    uint32_t getMaxLatency() const;
+
+#ifdef __AVR__
+    static void     paintStack();
+    static uint16_t getStackUsage();
+#endif
+
+private:
+
+    void record(ReportType type, uint32_t elapsed, uint32_t latency);
+
+    CopernicusGPS *m_gps;
+    ReportProfile  m_slots[PROFILE_SLOTS];
+    uint8_t        m_n_slots;
+    uint32_t       m_max_latency;
+    bool           m_waiting;   // data has been seen, and not yet processed
+    uint32_t       m_seen;      // time at which it was seen
+};
+
+/// @} // addtogroup monitor
+
+#endif	/* PROFILER_H */
@@ -0,0 +1,397 @@
+/*
+ * File:   reportserver.cpp
+ */
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "reportserver.h"
+#include "fixring.h"
+
+// epoll tags for the non-client fds
+#define TAG_LISTEN ((uint64_t)-1)
+#define TAG_GPS    ((uint64_t)-2)
+
+#define MAX_EVENTS 32
+
+/***************************
+ * structors               *
+ ***************************/
+
+/**
+ * Construct a new `ReportServer` for the given receiver. The server
+ * captures the receiver's packets (see `CopernicusGPS::setPacketCapture()`),
+ * and frames them in a poll buffer of its own (see
+ * `CopernicusGPS::setPollBuffer()`), so that a packet which has only partly
+ * arrived never holds up the clients; it should be the only caller of
+ * `gps->processOnePacket()`.
+ *
+ * @param gps Receiver whose reports are to be served.
+ */
+ReportServer::ReportServer(CopernicusGPS *gps):
+        m_gps(gps),
+        m_listen_fd(-1),
+        m_epoll_fd(-1),
+        m_gps_fd(-1),
+        m_next_seq(1) {
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) m_clients[i].fd = -1;
+    for (int i = 0; i < SERVER_FRAME_SLOTS; i++) m_frames[i].seq = 0;
+    m_gps->setPacketCapture(m_capture, SERVER_FRAME_SIZE);
+    m_gps->setPollBuffer(m_pollbuf, SERVER_FRAME_SIZE);
+}
+
+ReportServer::~ReportServer() {
+    close();
+    m_gps->setPacketCapture(NULL, 0);
+    m_gps->setPollBuffer(NULL, 0);
+}
+
+/***************************
+ * connections             *
+ ***************************/
+
+/**
+ * Begin accepting clients on a Unix domain socket. Any existing file at
+ * `path` is replaced.
+ *
+ * @param path Filesystem path of the socket.
+ * @param gps_fd File descriptor which becomes readable when the receiver has
+ * sent data, or -1 if there is none; in that case, `poll()` should be called
+ * with a short timeout, so that the receiver is serviced regularly.
+ * @return `false` if the socket could not be created.
+ */
+bool ReportServer::listen(const char *path, int gps_fd) {
+    close();
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) return false;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    m_epoll_fd  = epoll_create1(EPOLL_CLOEXEC);
+    if (m_listen_fd < 0 or m_epoll_fd < 0) {
+        close();
+        return false;
+    }
+    unlink(path);
+    if (bind(m_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 or
+            ::listen(m_listen_fd, SOMAXCONN) != 0) {
+        close();
+        return false;
+    }
+
+    struct epoll_event ev;
+    ev.events   = EPOLLIN;
+    ev.data.u64 = TAG_LISTEN;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_listen_fd, &ev);
+    m_gps_fd = gps_fd;
+    if (gps_fd >= 0) {
+        ev.data.u64 = TAG_GPS;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, gps_fd, &ev);
+    }
+    return true;
+}
+
+/**
+ * Disconnect all clients and stop listening.
+ */
+void ReportServer::close() {
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        if (m_clients[i].fd >= 0) drop(m_clients + i);
+    }
+    if (m_listen_fd >= 0) ::close(m_listen_fd);
+    if (m_epoll_fd  >= 0) ::close(m_epoll_fd);
+    m_listen_fd = -1;
+    m_epoll_fd  = -1;
+    m_gps_fd    = -1;
+}
+
+void ReportServer::accept() {
+    while (true) {
+        int fd = accept4(m_listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        Client *c = NULL;
+        for (int i = 0; i < SERVER_MAX_CLIENTS and c == NULL; i++) {
+            if (m_clients[i].fd < 0) c = m_clients + i;
+        }
+        if (c == NULL) {
+            ::close(fd); // full
+            continue;
+        }
+        c->fd         = fd;
+        c->subscribed = false;
+        c->sub_read   = 0;
+        c->q_head     = 0;
+        c->q_count    = 0;
+        c->sent       = 0;
+        c->want_write = false;
+
+        struct epoll_event ev;
+        ev.events   = EPOLLIN;
+        ev.data.u64 = c - m_clients;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void ReportServer::drop(Client *c) {
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    ::close(c->fd);
+    c->fd = -1;
+}
+
+// receive the client's subscription; anything after it is ignored.
+void ReportServer::readClient(Client *c) {
+    uint8_t buf[sizeof(ServerSubscription)];
+    while (true) {
+        ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+        if (n == 0 or (n < 0 and errno != EAGAIN and errno != EINTR)) {
+            drop(c);
+            return;
+        }
+        if (n < 0) return;
+        if (c->subscribed) continue;
+
+        size_t k = sizeof(ServerSubscription) - c->sub_read;
+        if ((size_t)n < k) k = n;
+        memcpy(reinterpret_cast<uint8_t*>(&c->sub) + c->sub_read, buf, k);
+        c->sub_read += k;
+        if (c->sub_read == sizeof(ServerSubscription)) {
+            if (c->sub.queue_len == 0 or c->sub.queue_len > SERVER_QUEUE_SIZE) {
+                c->sub.queue_len = SERVER_QUEUE_SIZE;
+            }
+            c->subscribed = true;
+        }
+    }
+}
+
+void ReportServer::watch(Client *c, bool write) {
+    if (c->want_write == write) return;
+    struct epoll_event ev;
+    ev.events   = EPOLLIN | (write ? (uint32_t)EPOLLOUT : 0);
+    ev.data.u64 = c - m_clients;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_write = write;
+}
+
+// send as much of the client's queue as the socket will take.
+// returns false if the client was dropped.
+bool ReportServer::flushClient(Client *c) {
+    while (c->q_count > 0) {
+        uint32_t seq = c->queue[c->q_head];
+        Frame &f = m_frames[seq % SERVER_FRAME_SLOTS];
+        if (f.seq != seq) {
+            if (c->sent != 0) {
+                // overwritten mid-send; the stream can't be resynchronized.
+                drop(c);
+                return false;
+            }
+            // overwritten before it could be sent; skip it.
+            c->q_head = (c->q_head + 1) % SERVER_QUEUE_SIZE;
+            c->q_count--;
+            continue;
+        }
+        const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&f.header);
+        size_t len = sizeof(FrameHeader) + f.header.length;
+        ssize_t n = send(c->fd, bytes + c->sent, len - c->sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN or errno == EINTR) {
+                watch(c, true);
+                return true;
+            }
+            drop(c);
+            return false;
+        }
+        c->sent += n;
+        if (c->sent < len) continue;
+        c->sent = 0;
+        c->q_head = (c->q_head + 1) % SERVER_QUEUE_SIZE;
+        c->q_count--;
+    }
+    watch(c, false);
+    return true;
+}
+
+/***************************
+ * reports                 *
+ ***************************/
+
+/**
+ * Wait for and handle activity on the socket and the receiver: accept
+ * clients, process available reports and publish them, and send queued frames.
+ *
+ * @param timeout_ms Maximum time to wait, or -1 to wait indefinitely.
+ * @return The number of events handled, or -1 if the server isn't listening.
+ */
+int ReportServer::poll(int timeout_ms) {
+    if (m_epoll_fd < 0) return -1;
+    if (m_gps_fd < 0) pump();
+
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(m_epoll_fd, events, MAX_EVENTS, timeout_ms);
+    for (int i = 0; i < n; i++) {
+        uint64_t tag = events[i].data.u64;
+        if (tag == TAG_LISTEN) {
+            accept();
+        } else if (tag == TAG_GPS) {
+            pump();
+        } else {
+            Client *c = m_clients + tag;
+            if (c->fd < 0) continue;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                drop(c);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) readClient(c);
+            if (c->fd >= 0 and (events[i].events & EPOLLOUT)) flushClient(c);
+        }
+    }
+    return (n < 0) ? 0 : n;
+}
+
+// process and publish everything the receiver has sent. a packet which
+// has only partly arrived stays in the poll buffer until the rest does.
+void ReportServer::pump() {
+    ReportType type;
+    while ((type = m_gps->processOnePacket(false)) != RPT_NONE) {
+        publish(type);
+    }
+}
+
+// serialize the report just processed into the next frame slot,
+// returning its frame number, or 0 if it has no such encoding.
+uint32_t ReportServer::serialize(ReportType type, uint8_t encoding) {
+    Frame &f = m_frames[m_next_seq % SERVER_FRAME_SLOTS];
+    const void *src = NULL;
+    int len = 0;
+    GPSEpoch epoch;
+
+    if (encoding == ENC_RAW) {
+        src = m_gps->getCapturedPacket(&len);
+    } else {
+        switch (type) {
+            case RPT_FIX_POS_LLA_32:
+            case RPT_FIX_POS_LLA_64:
+            case RPT_FIX_POS_XYZ_32:
+            case RPT_FIX_POS_XYZ_64:
+                src = &m_gps->getPositionFix(); len = sizeof(PosFix); break;
+            case RPT_FIX_VEL_XYZ:
+            case RPT_FIX_VEL_ENU:
+                src = &m_gps->getVelocityFix(); len = sizeof(VelFix); break;
+            case RPT_GPSTIME:
+                src = &m_gps->getGPSTime(); len = sizeof(GPSTime); break;
+            case RPT_HEALTH:
+            case RPT_ADDL_STATUS:
+            case RPT_SBAS_MODE:
+                src = &m_gps->getStatus(); len = sizeof(GPSStatus); break;
+#if CPN_ENABLE_SATELLITES
+            case RPT_SATELLITES:
+            case RPT_SAT_TRACKING:
+                src = &m_gps->getSatellites(); len = sizeof(SatelliteView); break;
+#endif
+#if CPN_ENABLE_NMEA
+            case RPT_NMEA_GGA:
+                src = &m_gps->getPositionFix(); len = sizeof(PosFix); break;
+            case RPT_NMEA_VTG:
+                src = &m_gps->getVelocityFix(); len = sizeof(VelFix); break;
+            case RPT_NMEA_ZDA:
+                src = &m_gps->getGPSTime(); len = sizeof(GPSTime); break;
+#if CPN_ENABLE_SATELLITES
+            case RPT_NMEA_GSA:
+            case RPT_NMEA_GSV:
+                src = &m_gps->getSatellites(); len = sizeof(SatelliteView); break;
+#endif
+            case RPT_NMEA_RMC: // fallthrough
+#endif
+            case RPT_SUPERPACKET:
+                epoch.pfix   = m_gps->getPositionFix();
+                epoch.vfix   = m_gps->getVelocityFix();
+                epoch.time   = m_gps->getGPSTime();
+                epoch.status = m_gps->getStatus();
+                src = &epoch; len = sizeof(GPSEpoch); break;
+            default: break;
+        }
+    }
+    if (src == NULL or len > SERVER_FRAME_SIZE) return 0;
+
+    f.seq = m_next_seq++;
+    f.header.length   = len;
+    f.header.report   = type;
+    f.header.encoding = encoding;
+    f.header.reserved = 0;
+    memcpy(f.data, src, len);
+    return f.seq;
+}
+
+/**
+ * Serialize the report most recently processed by the receiver, and queue
+ * it for each client subscribed to it. Called by `poll()` for each report
+ * it processes; call it directly only if processing the receiver's reports
+ * yourself.
+ *
+ * @param type Type of the report, as returned by `processOnePacket()`.
+ */
+void ReportServer::publish(ReportType type) {
+    if (type == RPT_NONE or type == RPT_ERROR) return;
+    // NMEA sentences have a bitset of their own, apart from the TSIP report IDs.
+    bool nmea = type >= RPT_NMEA;
+    if (nmea and type - RPT_NMEA >= NMEA_REPORT_TYPES) return;
+
+    // serialized at most once per encoding, and only if someone wants it.
+    uint32_t seq[2]  = { 0, 0 };
+    bool     done[2] = { false, false };
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        Client *c = m_clients + i;
+        if (c->fd < 0 or not c->subscribed) continue;
+        bool want = nmea ? (c->sub.nmea >> (type - RPT_NMEA)) & 1
+                         : (c->sub.reports[type / 8] >> (type % 8)) & 1;
+        if (not want or c->sub.encoding > ENC_DECODED) continue;
+        if (not done[c->sub.encoding]) {
+            seq[c->sub.encoding]  = serialize(type, c->sub.encoding);
+            done[c->sub.encoding] = true;
+        }
+        uint32_t s = seq[c->sub.encoding];
+        if (s == 0) continue;
+
+        if (c->q_count >= c->sub.queue_len) {
+            if (c->sub.policy == OVF_DISCONNECT) {
+                drop(c);
+                continue;
+            }
+            // drop the oldest frame which hasn't begun to be sent; a frame
+            // being sent must be finished, or the stream loses its framing.
+            if (c->sent == 0) {
+                c->q_head = (c->q_head + 1) % SERVER_QUEUE_SIZE;
+            } else if (c->q_count > 1) {
+                uint16_t victim = (c->q_head + 1) % SERVER_QUEUE_SIZE;
+                c->queue[victim] = c->queue[c->q_head];
+                c->q_head = victim;
+            } else {
+                continue; // only the frame being sent is queued; drop the new one.
+            }
+            c->q_count--;
+        }
+        c->queue[(c->q_head + c->q_count) % SERVER_QUEUE_SIZE] = s;
+        c->q_count++;
+        if (not c->want_write) flushClient(c);
+    }
+}
+
+/**
+ * Get the number of connected clients.
+ */
+int ReportServer::getClientCount() const {
+    int n = 0;
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        if (m_clients[i].fd >= 0) n++;
+    }
+    return n;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,151 @@
+/*
+ * File:   reportserver.h
+ *
+ * Serves the reports of one receiver to many local clients over a Unix
+ * domain socket. Linux only; on the host, `CopernicusGPS` needs an
+ * Arduino-compatible `HardwareSerial` shim (see copernicus.h).
+ */
+
+#ifndef REPORTSERVER_H
+#define	REPORTSERVER_H
+
+#ifdef __linux__
+
+#include "copernicus.h"
+
+/**
+ * @addtogroup monitor
+ * @{
+ */
+
+#define SERVER_MAX_CLIENTS  64
+// frames are shared by all clients; each client queues frame numbers.
+#define SERVER_FRAME_SLOTS  1024
+#define SERVER_FRAME_SIZE   256
+#define SERVER_QUEUE_SIZE   256
+
+enum FrameEncoding {
+    /// TSIP packet data (report ID followed by data bytes), without framing or escapes.
+    ENC_RAW     = 0x00,
+    /// The decoded datapoint updated by the report, in the server's native layout.
+    ENC_DECODED = 0x01,
+};
+
+enum OverflowPolicy {
+    /// Discard a slow client's oldest queued frames to make room for new ones.
+    OVF_DROP_OLDEST = 0x00,
+    /// Disconnect a slow client whose queue is full.
+    OVF_DISCONNECT  = 0x01,
+};
+
+/**
+ * @brief Message a client sends after connecting, to begin receiving frames.
+ */
+struct ServerSubscription {
+    /// A `FrameEncoding`.
+    uint8_t encoding;
+    /// An `OverflowPolicy`.
+    uint8_t policy;
+    /// Number of frames the client may fall behind by, up to `SERVER_QUEUE_SIZE`. 0 for the maximum.
+    uint16_t queue_len;
+    /// Bitset of TSIP report IDs to receive; bit `id % 8` of byte `id / 8`.
+    uint8_t reports[32];
+    /// Bitset of NMEA sentences to receive; bit `type - RPT_NMEA` for each
+    /// NMEA `ReportType`.
+    uint16_t nmea;
+};
+
+/**
+ * @brief Header preceding each frame sent to a client.
+ *
+ * Decoded frames carry a `PosFix`, `VelFix`, `GPSTime`, `GPSStatus`,
+ * `SatelliteView`, or (for superpackets and RMC sentences) `GPSEpoch`,
+ * depending on the report. Reports which the library does not decode are
+ * only sent raw; a raw NMEA sentence runs from after the `$` to the line
+ * ending.
+ */
+struct FrameHeader {
+    /// Length of the frame data following the header.
+    uint16_t length;
+    /// The `ReportType`: a TSIP report ID, or an NMEA sentence from `RPT_NMEA` up.
+    uint16_t report;
+    /// A `FrameEncoding`.
+    uint8_t  encoding;
+    uint8_t  reserved;
+};
+
+/**
+ * @brief Serves reports from a `CopernicusGPS` to clients on a Unix socket.
+ *
+ * The server owns the receiver's input; clients connect to the socket,
+ * send a `ServerSubscription`, and then receive a stream of frames, each a
+ * `FrameHeader` followed by its data.
+ *
+ * Each report is serialized once per encoding, into a table of frames shared
+ * by all clients; clients queue only frame numbers. A client which falls
+ * behind by more than its queue length either loses its oldest frames or is
+ * disconnected, according to its policy, so that a slow client never stalls
+ * the receiver.
+ *
+ * Example:
+ *
+ *      ReportServer server(&gps);
+ *      server.listen("/run/gps0.sock", serial_fd);
+ *      while (true) server.poll(-1);
+ */
+class ReportServer {
+public:
+    ReportServer(CopernicusGPS *gps);
+    ~ReportServer();
+
+    bool listen(const char *path, int gps_fd=-1);
+    void close();
+    int  poll(int timeout_ms);
+    void publish(ReportType type);
+
+    int getClientCount() const;
+
+private:
+
+    struct Client {
+        int      fd;
+        bool     subscribed;
+        ServerSubscription sub;
+        uint8_t  sub_read;   // bytes of the subscription received
+        uint32_t queue[SERVER_QUEUE_SIZE];
+        uint16_t q_head;
+        uint16_t q_count;
+        uint16_t sent;       // bytes of the head frame already sent
+        bool     want_write;
+    };
+
+    struct Frame {
+        uint32_t    seq;
+        FrameHeader header;
+        uint8_t     data[SERVER_FRAME_SIZE];
+    };
+
+    void pump();
+    void accept();
+    void drop(Client *c);
+    void readClient(Client *c);
+    bool flushClient(Client *c);
+    void watch(Client *c, bool write);
+    uint32_t serialize(ReportType type, uint8_t encoding);
+
+    CopernicusGPS *m_gps;
+    int      m_listen_fd;
+    int      m_epoll_fd;
+    int      m_gps_fd;
+    uint32_t m_next_seq;
+    uint8_t  m_capture[SERVER_FRAME_SIZE];
+    uint8_t  m_pollbuf[SERVER_FRAME_SIZE];
+    Client   m_clients[SERVER_MAX_CLIENTS];
+    Frame    m_frames[SERVER_FRAME_SLOTS];
+};
+
+/// @} // addtogroup monitor
+
+#endif /* __linux__ */
+
+#endif	/* REPORTSERVER_H */
@@ -0,0 +1,243 @@
+/*
+ * File:   simplifier.cpp
+ */
+
+#include <math.h>
+
+#include "simplifier.h"
+#include "fixp.h"
+
+#define SIMPLIFIER_PI   3.14159265f
+#define SECONDS_PER_WEEK 604800.0f
+
+/***************************
+ * structors               *
+ ***************************/
+
+/**
+ * Construct a new `TrackSimplifier`.
+ *
+ * @param tolerance Greatest distance, in meters, by which the simplified
+ * track may miss any fix.
+ * @param mode How the simplified track is to be reproduced.
+ * @param max_interval If positive, a point is kept at least this often, in
+ * seconds, even if the track doesn't need it.
+ */
+TrackSimplifier::TrackSimplifier(float tolerance, SimplifyMode mode, float max_interval):
+        m_tol(tolerance),
+        m_max_interval(max_interval),
+        m_mode(mode) {
+    reset();
+}
+
+/**
+ * Begin a new track. The next fix will be kept.
+ */
+void TrackSimplifier::reset() {
+    m_pt        = PosFix();
+    m_vel       = VelFix();
+    m_pending   = false;
+    m_cone_open = false;
+    m_n_in      = 0;
+    m_n_out     = 0;
+}
+
+/***************************
+ * simplification          *
+ ***************************/
+
+/**
+ * Process the next fix of the track.
+ *
+ * The velocity fix is used only if it belongs to the same epoch as the
+ * position fix (i.e. their fix times are equal); otherwise the velocity of
+ * the fix is taken to be zero.
+ *
+ * @param pfix New position fix.
+ * @param vfix Most recent velocity fix.
+ * @return `true` if a point was kept, in which case it is available from
+ * `getPoint()` and `getVelocity()`. In `SIMPLIFY_CORRIDOR` mode, the point
+ * kept is usually the previous fix, rather than this one.
+ */
+bool TrackSimplifier::update(const PosFix &pfix, const VelFix &vfix) {
+    int64_t fixed[3];
+    if (not fix_to_fixed(pfix, fixed)) return false;
+    m_n_in++;
+    if (m_pt.type == RPT_NONE or is_lla(pfix.type) != is_lla(m_pt.type)) {
+        emit(pfix, vfix, fixed);
+        return true;
+    }
+
+    float dt = pfix.getFixTime().f - m_pt_time;
+    if (dt < -SECONDS_PER_WEEK / 2) dt += SECONDS_PER_WEEK;
+    bool expired = m_max_interval > 0 and dt >= m_max_interval;
+    float p[2];
+    toLocal(fixed, p);
+
+    if (m_mode == SIMPLIFY_DEAD_RECKONING) {
+        float de = p[0] - m_pt_v[0] * dt;
+        float dn = p[1] - m_pt_v[1] * dt;
+        if (expired or de * de + dn * dn > m_tol * m_tol) {
+            emit(pfix, vfix, fixed);
+            return true;
+        }
+        return false;
+    }
+
+    if (extendCorridor(p)) {
+        if (expired) {
+            emit(pfix, vfix, fixed);
+            return true;
+        }
+        m_pending  = true;
+        m_prev     = pfix;
+        m_prev_vel = vfix;
+        for (int i = 0; i < 3; i++) m_prev_fixed[i] = fixed[i];
+        return false;
+    }
+
+    // this fix leaves the corridor; the previous one ends the segment,
+    // and begins the next.
+    if (not m_pending) {
+        emit(pfix, vfix, fixed);
+        return true;
+    }
+    emit(m_prev, m_prev_vel, m_prev_fixed);
+    toLocal(fixed, p);
+    extendCorridor(p);
+    m_pending  = true;
+    m_prev     = pfix;
+    m_prev_vel = vfix;
+    for (int i = 0; i < 3; i++) m_prev_fixed[i] = fixed[i];
+    return true;
+}
+
+/**
+ * Keep the last fix of the track, if it hasn't been kept already. Call at
+ * the end of a track in `SIMPLIFY_CORRIDOR` mode.
+ *
+ * @return `true` if a point was kept.
+ */
+bool TrackSimplifier::flush() {
+    if (not m_pending) return false;
+    emit(m_prev, m_prev_vel, m_prev_fixed);
+    return true;
+}
+
+// whether the segment from the last point to p passes within tolerance of
+// every fix since; if so, narrow the cone of directions to include p.
+bool TrackSimplifier::extendCorridor(const float p[2]) {
+    float d = sqrt(p[0] * p[0] + p[1] * p[1]);
+    if (d <= m_tol) {
+        // fine if every fix so far has been close to the point, too.
+        return not m_cone_open;
+    }
+    float theta = atan2(p[1], p[0]);
+    float delta = asin(m_tol / d);
+    if (not m_cone_open) {
+        m_dir       = theta;
+        m_lo        = -delta;
+        m_hi        =  delta;
+        m_max_dist  = d;
+        m_cone_open = true;
+        return true;
+    }
+    float rel = theta - m_dir;
+    if      (rel >  SIMPLIFIER_PI) rel -= 2 * SIMPLIFIER_PI;
+    else if (rel < -SIMPLIFIER_PI) rel += 2 * SIMPLIFIER_PI;
+    // the segment must point into the cone, and reach as far as the fixes
+    // before it, so that they don't lie beyond its end.
+    if (rel < m_lo or rel > m_hi or d < m_max_dist) return false;
+    if (rel - delta > m_lo) m_lo = rel - delta;
+    if (rel + delta < m_hi) m_hi = rel + delta;
+    m_max_dist = d;
+    return true;
+}
+
+// keep a point, and make it the origin of the local frame.
+void TrackSimplifier::emit(const PosFix &pfix, const VelFix &vfix, const int64_t fixed[3]) {
+    m_pt  = pfix;
+    m_vel = vfix;
+    for (int i = 0; i < 3; i++) m_pt_fixed[i] = fixed[i];
+    m_pt_time   = pfix.getFixTime().f;
+    m_pending   = false;
+    m_cone_open = false;
+    m_n_out++;
+    local_frame(fixed, is_lla(pfix.type), &m_frame);
+
+    if (not velocity(vfix, pfix.getFixTime(), m_pt_v)) {
+        m_pt_v[0] = m_pt_v[1] = 0;
+    }
+}
+
+// horizontal offset (east, north) of a fix from the last point, in meters.
+void TrackSimplifier::toLocal(const int64_t fixed[3], float out[2]) const {
+    int64_t d[3];
+    for (int i = 0; i < 3; i++) d[i] = fixed[i] - m_pt_fixed[i];
+    if (is_lla(m_pt.type)) {
+        // longitude wraps around
+        if      (d[0] >  FIXP_ANGLE_2PI / 2) d[0] -= FIXP_ANGLE_2PI;
+        else if (d[0] < -FIXP_ANGLE_2PI / 2) d[0] += FIXP_ANGLE_2PI;
+        out[0] = d[0] * (FIXP_ANGLE_SCALE * m_frame.east);
+        out[1] = d[1] * (FIXP_ANGLE_SCALE * m_frame.north);
+    } else {
+        float enu[3];
+        frame_to_enu(m_frame, d[0] * FIXP_LENGTH_SCALE, d[1] * FIXP_LENGTH_SCALE,
+                     d[2] * FIXP_LENGTH_SCALE, enu);
+        out[0] = enu[0];
+        out[1] = enu[1];
+    }
+}
+
+// horizontal velocity (east, north) of a fix from the given epoch.
+bool TrackSimplifier::velocity(const VelFix &vfix, Float32 fixtime, float out[2]) const {
+    if (vfix.type == RPT_FIX_VEL_ENU) {
+        const ENU_VFix *v = vfix.getENU();
+        if (v->fixtime.bits != fixtime.bits) return false;
+        out[0] = v->e.f;
+        out[1] = v->n.f;
+    } else if (vfix.type == RPT_FIX_VEL_XYZ) {
+        const XYZ_VFix *v = vfix.getXYZ();
+        if (v->fixtime.bits != fixtime.bits) return false;
+        float enu[3];
+        frame_to_enu(m_frame, v->x.f, v->y.f, v->z.f, enu);
+        out[0] = enu[0];
+        out[1] = enu[1];
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/***************************
+ * access                  *
+ ***************************/
+
+/**
+ * Get the point most recently kept.
+ */
+const PosFix& TrackSimplifier::getPoint() const {
+    return m_pt;
+}
+
+/**
+ * Get the velocity fix accompanying the point most recently kept. Its epoch
+ * may not match that of the point, if the fixes given to `update()` did not.
+ */
+const VelFix& TrackSimplifier::getVelocity() const {
+    return m_vel;
+}
+
+/**
+ * Get the number of valid fixes processed since the track began.
+ */
+uint32_t TrackSimplifier::getInputCount() const {
+    return m_n_in;
+}
+
+/**
+ * Get the number of points kept since the track began.
+ */
+uint32_t TrackSimplifier::getOutputCount() const {
+    return m_n_out;
+}
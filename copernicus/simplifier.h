@@ -0,0 +1,107 @@
+/*
+ * File:   simplifier.h
+ */
+
+#ifndef SIMPLIFIER_H
+#define	SIMPLIFIER_H
+
+#include "gpstype.h"
+#include "fixp.h"
+
+/**
+ * @addtogroup processing
+ * @{
+ */
+
+enum SimplifyMode {
+    /**
+     * Keep the points needed for straight lines between them to pass within
+     * the tolerance of every fix. Each point is emitted one fix late.
+     */
+    SIMPLIFY_CORRIDOR,
+    /**
+     * Keep the points needed for extrapolating from each point along its
+     * velocity to stay within the tolerance of every fix. Each point is
+     * emitted as soon as it arrives.
+     */
+    SIMPLIFY_DEAD_RECKONING,
+};
+
+/**
+ * @brief Discards the fixes of a track which are not needed to reproduce it
+ * within a given tolerance.
+ *
+ * Fixes are passed in as they arrive, and the simplifier decides whether each
+ * is needed. In `SIMPLIFY_CORRIDOR` mode, the kept points form a polyline
+ * passing within the tolerance of every fix, found by narrowing a cone of
+ * directions from the last kept point (the Sklansky-Gonzalez algorithm).
+ * In `SIMPLIFY_DEAD_RECKONING` mode, each kept point carries its velocity,
+ * and a new point is kept when the fix drifts out of tolerance of the
+ * position extrapolated from the last one; this suits tracks which are
+ * followed live, and keeps very few points on straight roads at steady speed.
+ *
+ * Distances are measured horizontally. Memory use and the cost of each fix
+ * are constant.
+ *
+ * Example:
+ *
+ *      TrackSimplifier simplifier(5.0);
+ *      // ...
+ *      if (gps.processOnePacket() == RPT_FIX_POS_LLA_32) {
+ *          if (simplifier.update(gps.getPositionFix(), gps.getVelocityFix())) {
+ *              upload(simplifier.getPoint());
+ *          }
+ *      }
+ */
+class TrackSimplifier {
+public:
+    TrackSimplifier(float tolerance=5.0, SimplifyMode mode=SIMPLIFY_CORRIDOR,
+                    float max_interval=0);
+
+    void reset();
+    bool update(const PosFix &pfix, const VelFix &vfix);
+    bool flush();
+
+    const PosFix& getPoint()       const;
+    const VelFix& getVelocity()    const;
+    uint32_t      getInputCount()  const;
+    uint32_t      getOutputCount() const;
+
+private:
+
+    void emit(const PosFix &pfix, const VelFix &vfix, const int64_t fixed[3]);
+    void toLocal(const int64_t fixed[3], float out[2]) const;
+    bool velocity(const VelFix &vfix, Float32 fixtime, float out[2]) const;
+    bool extendCorridor(const float p[2]);
+
+    float        m_tol;
+    float        m_max_interval;
+    SimplifyMode m_mode;
+
+    // last point emitted, which is the origin of the local frame
+    PosFix  m_pt;
+    VelFix  m_vel;
+    int64_t m_pt_fixed[3];
+    float   m_pt_v[2];     // east, north velocity of the point
+    float   m_pt_time;
+    LocalFrame m_frame;
+
+    // last fix, not yet emitted
+    bool    m_pending;
+    PosFix  m_prev;
+    VelFix  m_prev_vel;
+    int64_t m_prev_fixed[3];
+
+    // cone of directions, relative to m_dir, for the corridor
+    bool    m_cone_open;
+    float   m_dir;
+    float   m_lo, m_hi;
+    float   m_max_dist;
+
+    uint32_t m_n_in;
+    uint32_t m_n_out;
+};
+
+/// @} // addtogroup processing
+
+#endif	/* SIMPLIFIER_H */
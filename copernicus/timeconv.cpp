@@ -0,0 +1,211 @@
+/*
+ * File:   timeconv.cpp
+ */
+
+#include "timeconv.h"
+
+#define INT64_LOWEST  ((int64_t)(-0x7FFFFFFFFFFFFFFFLL - 1))
+#define INT64_HIGHEST ((int64_t)0x7FFFFFFFFFFFFFFFLL)
+
+// GPS time (seconds since the GPS epoch) at which each leap second took
+// effect; GPS - UTC is `i + 1` from entry `i` onward. The inserted second
+// (23:59:60 UTC) is given the same Unix time as the midnight after it.
+static const uint32_t LEAP_GPS_S[] = {
+     46828801, //  1  1981-07-01
+     78364802, //  2  1982-07-01
+    109900803, //  3  1983-07-01
+    173059204, //  4  1985-07-01
+    252028805, //  5  1988-01-01
+    315187206, //  6  1990-01-01
+    346723207, //  7  1991-01-01
+    393984008, //  8  1992-07-01
+    425520009, //  9  1993-07-01
+    457056010, // 10  1994-07-01
+    504489611, // 11  1996-01-01
+    551750412, // 12  1997-07-01
+    599184013, // 13  1999-01-01
+    820108814, // 14  2006-01-01
+    914803215, // 15  2009-01-01
+   1025136016, // 16  2012-07-01
+   1119744017, // 17  2015-07-01
+   1167264018, // 18  2017-01-01
+};
+
+#define N_LEAPS ((int)(sizeof(LEAP_GPS_S) / sizeof(LEAP_GPS_S[0])))
+
+// GPS - UTC at `t`, which is in nanoseconds since the GPS epoch if `utc` is
+// false, or since the Unix epoch if it is true. Present-day times are found
+// with one comparison.
+static int leaps_at(int64_t t, bool utc) {
+    for (int i = N_LEAPS - 1; i >= 0; i--) {
+        int64_t s = LEAP_GPS_S[i];
+        if (utc) s += GPS_EPOCH_UNIX - (i + 1);
+        if (t >= s * NS_PER_SECOND) return i + 1;
+    }
+    return 0;
+}
+
+/***************************
+ * scalar                  *
+ ***************************/
+
+/**
+ * Find the full GPS week number of a week number which may have rolled over
+ * (i.e. is known only modulo 1024). A week number less than 1024 is taken
+ * to be 10-bit, and resolved to the first such week on or after `ref_week`,
+ * so times are correct for 1024 weeks (about 19.6 years) from it. A larger
+ * week number is already full, and is returned unchanged, even if it is
+ * before `ref_week`.
+ *
+ * @param week Week number, either 10-bit or full.
+ * @param ref_week Earliest full week number expected.
+ */
+int32_t resolve_week(int32_t week, int32_t ref_week) {
+    if (week >= 1024) return week;
+    int32_t d = (week - ref_week) % 1024;
+    if (d < 0) d += 1024;
+    return ref_week + d;
+}
+
+/**
+ * Get the number of leap seconds (GPS - UTC) in effect at the given GPS time.
+ *
+ * @param gps_s Seconds since the GPS epoch.
+ */
+int leap_seconds(int64_t gps_s) {
+    return leaps_at(gps_s * NS_PER_SECOND, false);
+}
+
+/**
+ * Get the number of leap seconds (GPS - UTC) in effect at the given UTC time.
+ *
+ * @param unix_s Seconds since the Unix epoch.
+ */
+int leap_seconds_utc(int64_t unix_s) {
+    return leaps_at(unix_s * NS_PER_SECOND, true);
+}
+
+/**
+ * Convert a GPS time to UTC, as nanoseconds since the Unix epoch, using the
+ * leap second table.
+ *
+ * @param week Full GPS week number (see `resolve_week()`).
+ * @param tow_ns Time of week, in nanoseconds (see `tow_to_ns()`).
+ */
+int64_t gps_to_unix_ns(int32_t week, int64_t tow_ns) {
+    int64_t g = week * NS_PER_WEEK + tow_ns;
+    return g + (GPS_EPOCH_UNIX - leaps_at(g, false)) * NS_PER_SECOND;
+}
+
+/**
+ * Convert a GPS time report to UTC, as nanoseconds since the Unix epoch.
+ *
+ * The receiver's UTC offset is used if it has one, so that leap seconds
+ * newer than the table are accounted for; otherwise the table is used.
+ *
+ * @param time GPS time, as given by `CopernicusGPS::getGPSTime()`.
+ * @param ref_week Earliest full week number expected.
+ */
+int64_t gps_to_unix_ns(const GPSTime &time, int32_t ref_week) {
+    int64_t g = resolve_week(time.week_no, ref_week) * NS_PER_WEEK +
+                tow_to_ns(time.time_of_week);
+    int leaps;
+    if ((time.utc_offs.bits & 0x80000000) == 0 and time.utc_offs.f >= 0.5f) {
+        leaps = (int)(time.utc_offs.f + 0.5f);
+    } else {
+        leaps = leaps_at(g, false);
+    }
+    return g + (GPS_EPOCH_UNIX - leaps) * NS_PER_SECOND;
+}
+
+/**
+ * Convert UTC, as nanoseconds since the Unix epoch, to GPS time, using the
+ * leap second table. Times during an inserted leap second are ambiguous in
+ * UTC; they are taken to be after it.
+ *
+ * @param unix_ns UTC, in nanoseconds since the Unix epoch.
+ * @param week Full GPS week number.
+ * @param tow_ns Time of week, in nanoseconds.
+ */
+void unix_ns_to_gps(int64_t unix_ns, int32_t *week, int64_t *tow_ns) {
+    int64_t g = unix_ns + (leaps_at(unix_ns, true) - GPS_EPOCH_UNIX) * NS_PER_SECOND;
+    int64_t w = g / NS_PER_WEEK;
+    if (g % NS_PER_WEEK < 0) w -= 1;
+    *week   = (int32_t)w;
+    *tow_ns = g - w * NS_PER_WEEK;
+}
+
+/***************************
+ * batch                   *
+ ***************************/
+
+// add the GPS to Unix offset to GPS times in nanoseconds. the leap second
+// span of the last time is kept, so that sorted (or nearly sorted) times
+// each cost one pair of comparisons.
+static void apply_leaps(int64_t *t, uint32_t n) {
+    int64_t lo  = INT64_HIGHEST;
+    int64_t hi  = INT64_LOWEST;
+    int64_t adj = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        int64_t g = t[i];
+        if (g < lo or g >= hi) {
+            int k = leaps_at(g, false);
+            lo  = k > 0       ? LEAP_GPS_S[k - 1] * NS_PER_SECOND : INT64_LOWEST;
+            hi  = k < N_LEAPS ? LEAP_GPS_S[k]     * NS_PER_SECOND : INT64_HIGHEST;
+            adj = (GPS_EPOCH_UNIX - k) * NS_PER_SECOND;
+        }
+        t[i] = g + adj;
+    }
+}
+
+/**
+ * Convert columns of GPS times to UTC, as nanoseconds since the Unix epoch.
+ * Equivalent to calling `gps_to_unix_ns()` with each week (resolved with
+ * `resolve_week()`) and time of week, but faster.
+ *
+ * @param week Week numbers, either 10-bit or full.
+ * @param tow Times of week, in seconds. Must not be negative.
+ * @param unix_ns Destination for the `n` converted times.
+ * @param n Number of times to convert.
+ * @param ref_week Earliest full week number expected.
+ */
+void gps_to_unix_ns(const int16_t *week, const Float32 *tow, int64_t *unix_ns,
+                    uint32_t n, int32_t ref_week) {
+    int32_t last_week = -1;
+    int64_t week_ns   = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (week[i] != last_week) {
+            last_week = week[i];
+            week_ns   = resolve_week(last_week, ref_week) * NS_PER_WEEK;
+        }
+        unix_ns[i] = week_ns + tow_to_ns(tow[i]);
+    }
+    apply_leaps(unix_ns, n);
+}
+
+/**
+ * Convert a column of GPS times of week, such as the fix times of a
+ * `FixLogReader`, to UTC, as nanoseconds since the Unix epoch.
+ *
+ * The times are taken to follow one another in order, beginning in the given
+ * week; if the time of week falls by more than half a week from one time to
+ * the next, the week is taken to have ended.
+ *
+ * @param week Week number of the first time, either 10-bit or full.
+ * @param tow Times of week, in seconds. Must not be negative.
+ * @param unix_ns Destination for the `n` converted times.
+ * @param n Number of times to convert.
+ * @param ref_week Earliest full week number expected.
+ */
+void gps_to_unix_ns(int16_t week, const Float32 *tow, int64_t *unix_ns,
+                    uint32_t n, int32_t ref_week) {
+    int64_t week_ns = resolve_week(week, ref_week) * NS_PER_WEEK;
+    int64_t prev    = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        int64_t t = tow_to_ns(tow[i]);
+        if (t < prev - NS_PER_WEEK / 2) week_ns += NS_PER_WEEK;
+        prev = t;
+        unix_ns[i] = week_ns + t;
+    }
+    apply_leaps(unix_ns, n);
+}
@@ -0,0 +1,62 @@
+/*
+ * File:   timeconv.h
+ *
+ * Conversion of GPS week and time of week to UTC, as nanoseconds since the
+ * Unix epoch.
+ */
+
+#ifndef TIMECONV_H
+#define	TIMECONV_H
+
+#include "gpstype.h"
+
+/**
+ * @addtogroup processing
+ * @{
+ */
+
+/// Unix time of the GPS epoch (1980-01-06 00:00:00 UTC), in seconds.
+#define GPS_EPOCH_UNIX   315964800LL
+#define NS_PER_SECOND    1000000000LL
+#define GPS_WEEK_SECONDS 604800LL
+#define NS_PER_WEEK      (GPS_WEEK_SECONDS * NS_PER_SECOND)
+
+/**
+ * Default reference for resolving week number rollover: no 10-bit week
+ * number is expected to denote a time before this GPS week (October 2026).
+ */
+#define TIME_REF_WEEK    2441
+
+/**
+ * Convert a time of week, in seconds, to nanoseconds. The result is the
+ * value of the float rounded to the nearest nanosecond, found exactly using
+ * only integer operations.
+ */
+inline int64_t tow_to_ns(Float32 tow) {
+    int exp = (int)((tow.bits >> 23) & 0xFF);
+    uint64_t mant = (tow.bits & 0x007FFFFF) | (exp != 0 ? 0x00800000 : 0);
+    // value is mant * 2^(exp - 150). times of week are less than 2^23 s, so
+    // the shift is always positive; larger values are not converted correctly.
+    int shift = 150 - exp;
+    if (shift > 63) shift = 63;
+    if (shift < 1)  shift = 1;
+    int64_t ns = (int64_t)((mant * NS_PER_SECOND + ((uint64_t)1 << (shift - 1))) >> shift);
+    return (tow.bits & 0x80000000) ? -ns : ns;
+}
+
+int32_t resolve_week(int32_t week, int32_t ref_week=TIME_REF_WEEK);
+int     leap_seconds(int64_t gps_s);
+int     leap_seconds_utc(int64_t unix_s);
+
+int64_t gps_to_unix_ns(int32_t week, int64_t tow_ns);
+int64_t gps_to_unix_ns(const GPSTime &time, int32_t ref_week=TIME_REF_WEEK);
+void    unix_ns_to_gps(int64_t unix_ns, int32_t *week, int64_t *tow_ns);
+
+void gps_to_unix_ns(const int16_t *week, const Float32 *tow, int64_t *unix_ns,
+                    uint32_t n, int32_t ref_week=TIME_REF_WEEK);
+void gps_to_unix_ns(int16_t week, const Float32 *tow, int64_t *unix_ns,
+                    uint32_t n, int32_t ref_week=TIME_REF_WEEK);
+
+/// @} // addtogroup processing
+
+#endif	/* TIMECONV_H */
@@ -0,0 +1,526 @@
+/*
+ * File:   warmstart.cpp
+ */
+
+#include "warmstart.h"
+#include "chunk.h"
+
+#ifdef __AVR__
+#include <avr/eeprom.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define WARM_MAGIC_0   'W'
+#define WARM_MAGIC_1   'S'
+#define WARM_VERSION   1
+
+// header layout
+#define HDR_POS_CMD    3
+#define HDR_POS_LEN    4
+#define HDR_POS        5
+#define HDR_TOW        29
+#define HDR_WEEK       33
+#define HDR_UTC_OFFS   35
+#define HDR_FLAGS      39
+#define HDR_N_PAGES    40
+#define HDR_PAGE_BYTES 42
+#define HDR_DATA_WEEK  46
+#define HDR_DATA_TOW   48
+#define HDR_CHECKSUM   52
+
+#define HDR_FLAG_TIME  0x01
+
+// operations of command 0x38 / report 0x58
+#define SATDATA_OP_REQUEST 0x01
+#define SATDATA_OP_LOAD    0x02
+#define SATDATA_OP_DATA    0x02
+
+// pages are requested in this order: the small pages first, then the
+// almanac of each satellite, then the ephemeris of each tracked satellite.
+#define REQ_ALMANAC    3
+#define REQ_EPHEMERIS  (REQ_ALMANAC + MAX_SATELLITES)
+#define REQ_END        (REQ_EPHEMERIS + MAX_SATELLITES)
+
+#define SECONDS_PER_WEEK 604800.0f
+
+static uint16_t fletcher16(const uint8_t *bytes, int n) {
+    uint16_t a = 0;
+    uint16_t b = 0;
+    for (int i = 0; i < n; i++) {
+        a = (a + bytes[i]) % 255;
+        b = (b + a) % 255;
+    }
+    return (b << 8) | a;
+}
+
+/***************************
+ * stores                  *
+ ***************************/
+
+WarmStartStore::~WarmStartStore() {}
+
+bool WarmStartStore::commit() {
+    return true;
+}
+
+#ifdef __AVR__
+
+/**
+ * Construct a new `EEPROMWarmStore`.
+ *
+ * @param base Address of the first byte of EEPROM to use.
+ * @param size Number of bytes to use, or 0 to use all of the EEPROM
+ * after `base`.
+ */
+EEPROMWarmStore::EEPROMWarmStore(uint16_t base, uint16_t size):
+        m_base(base),
+        m_size(size) {
+    if (m_size == 0 and m_base <= E2END) m_size = E2END + 1 - m_base;
+}
+
+uint32_t EEPROMWarmStore::capacity() const {
+    return m_size;
+}
+
+bool EEPROMWarmStore::read(uint32_t offs, uint8_t *dst, uint32_t n) {
+    if (offs + n > m_size) return false;
+    eeprom_read_block(dst, (const void*)(m_base + offs), n);
+    return true;
+}
+
+bool EEPROMWarmStore::write(uint32_t offs, const uint8_t *src, uint32_t n) {
+    if (offs + n > m_size) return false;
+    eeprom_update_block(src, (void*)(m_base + offs), n);
+    return true;
+}
+
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+
+/**
+ * Construct a new `FileWarmStore`, creating the file if it doesn't exist.
+ *
+ * @param path Path of the file.
+ * @param size Largest size to which the file may grow.
+ */
+FileWarmStore::FileWarmStore(const char *path, uint32_t size):
+        m_fd(open(path, O_RDWR | O_CREAT, 0644)),
+        m_size(size) {}
+
+FileWarmStore::~FileWarmStore() {
+    if (m_fd >= 0) close(m_fd);
+}
+
+/**
+ * Whether the file was opened successfully.
+ */
+bool FileWarmStore::isOpen() const {
+    return m_fd >= 0;
+}
+
+uint32_t FileWarmStore::capacity() const {
+    return m_size;
+}
+
+bool FileWarmStore::read(uint32_t offs, uint8_t *dst, uint32_t n) {
+    if (m_fd < 0 or offs + n > m_size) return false;
+    return pread(m_fd, dst, n, offs) == (ssize_t)n;
+}
+
+bool FileWarmStore::write(uint32_t offs, const uint8_t *src, uint32_t n) {
+    if (m_fd < 0 or offs + n > m_size) return false;
+    return pwrite(m_fd, src, n, offs) == (ssize_t)n;
+}
+
+bool FileWarmStore::commit() {
+    return m_fd >= 0 and fsync(m_fd) == 0;
+}
+
+#endif
+
+/***************************
+ * structors               *
+ ***************************/
+
+/**
+ * Construct a new `WarmStart`. Call `begin()` before use.
+ *
+ * @param gps Receiver whose data are to be saved and restored.
+ * @param store Where the data are kept.
+ */
+WarmStart::WarmStart(CopernicusGPS *gps, WarmStartStore *store):
+        m_gps(gps),
+        m_store(store),
+        m_registered(false),
+        m_pos_cmd(0),
+        m_pos_len(0),
+        m_time_valid(false),
+        m_n_pages(0),
+        m_page_bytes(0),
+        m_data_week(0),
+        m_saving(false),
+        m_req(0),
+        m_req_tracked(0) {
+    m_time.time_of_week.bits = 0xBF800000; // -1
+    m_time.week_no       = 0;
+    m_time.utc_offs.bits = 0;
+    m_data_tow.bits      = 0;
+}
+
+WarmStart::~WarmStart() {
+    if (m_registered) m_gps->removePacketProcessor(this);
+}
+
+/**
+ * Load the saved data from the store, and begin listening for the receiver's
+ * satellite data reports.
+ *
+ * @return `false` if the packet processor could not be added. A store without
+ * valid data is not an error; it is treated as empty.
+ */
+bool WarmStart::begin() {
+    if (not readHeader()) {
+        m_pos_cmd    = 0;
+        m_time_valid = false;
+        m_n_pages    = 0;
+        m_page_bytes = 0;
+    }
+    if (not m_registered) m_registered = m_gps->addPacketProcessor(this);
+    return m_registered;
+}
+
+/***************************
+ * restoring               *
+ ***************************/
+
+/**
+ * Upload the saved data to the receiver. Call soon after it powers up.
+ *
+ * @param now The current GPS time, if known (e.g. from a real-time clock).
+ * If `NULL`, the time is not sent, and ephemerides are not uploaded, since
+ * their age can't be known.
+ * @return `false` if the saved pages could not be read, or pages are being
+ * saved.
+ */
+bool WarmStart::restore(const GPSTime *now) {
+    if (m_saving) return false;
+    bool have_now = now != NULL and now->time_of_week.f >= 0;
+    if (have_now) {
+        uint8_t bytes[6];
+        put_network_order(bytes,     now->time_of_week.bits);
+        put_network_order(bytes + 4, (uint16_t)now->week_no);
+        m_gps->beginCommand(CMD_SET_GPSTIME);
+        m_gps->writeDataBytes(bytes, 6);
+        m_gps->endCommand();
+    }
+    if (m_pos_cmd != 0) {
+        m_gps->beginCommand(static_cast<CommandID>(m_pos_cmd));
+        m_gps->writeDataBytes(m_pos, m_pos_len);
+        m_gps->endCommand();
+    }
+
+    bool eph_ok = false;
+    if (have_now) {
+        float age = (now->week_no - m_data_week) * SECONDS_PER_WEEK +
+                    (now->time_of_week.f - m_data_tow.f);
+        eph_ok = age >= 0 and age < WARM_EPHEMERIS_AGE;
+    }
+    uint32_t offs = WARM_HEADER_SIZE;
+    for (uint16_t i = 0; i < m_n_pages; i++) {
+        // pages are stored as <type> <prn> <length> <data ...>
+        uint8_t *page = m_page + 1;
+        if (not m_store->read(offs, page, 3)) return false;
+        uint8_t len = page[2];
+        if (len > WARM_MAX_PAGE or not m_store->read(offs + 3, page + 3, len)) {
+            return false;
+        }
+        offs += 3 + len;
+        if (page[0] == SATDATA_EPHEMERIS and not eph_ok) continue;
+        m_page[0] = SATDATA_OP_LOAD;
+        m_gps->beginCommand(CMD_SAT_DATA);
+        m_gps->writeDataBytes(m_page, 4 + len);
+        m_gps->endCommand();
+    }
+    return true;
+}
+
+/***************************
+ * saving                  *
+ ***************************/
+
+/**
+ * Save the receiver's current position fix and GPS time, if the receiver is
+ * doing fixes.
+ *
+ * @return `false` if there is no good fix, or the store could not be written.
+ */
+bool WarmStart::saveFix() {
+    const GPSStatus &status = m_gps->getStatus();
+    const PosFix    &pfix   = m_gps->getPositionFix();
+    if (status.health != HLTH_DOING_FIXES or pfix.getFixTime().f < 0) return false;
+
+    // keep the fix as the body of the initial position command which
+    // matches its format.
+    switch (pfix.type) {
+        case RPT_FIX_POS_LLA_32: {
+            const LLA_Fix<Float32> *fix = pfix.getLLA_32();
+            put_network_order(m_pos,     fix->lat.bits);
+            put_network_order(m_pos + 4, fix->lng.bits);
+            put_network_order(m_pos + 8, fix->alt.bits);
+            m_pos_cmd = CMD_INIT_POS_LLA;
+            m_pos_len = 12;
+        } break;
+        case RPT_FIX_POS_LLA_64: {
+            const LLA_Fix<Float64> *fix = pfix.getLLA_64();
+            put_network_order(m_pos,      fix->lat.bits);
+            put_network_order(m_pos +  8, fix->lng.bits);
+            put_network_order(m_pos + 16, fix->alt.bits);
+            m_pos_cmd = CMD_ACC_INIT_POS_LLA;
+            m_pos_len = 24;
+        } break;
+        case RPT_FIX_POS_XYZ_32: {
+            const XYZ_Fix<Float32> *fix = pfix.getXYZ_32();
+            put_network_order(m_pos,     fix->x.bits);
+            put_network_order(m_pos + 4, fix->y.bits);
+            put_network_order(m_pos + 8, fix->z.bits);
+            m_pos_cmd = CMD_INIT_POS_XYZ;
+            m_pos_len = 12;
+        } break;
+        case RPT_FIX_POS_XYZ_64: {
+            const XYZ_Fix<Float64> *fix = pfix.getXYZ_64();
+            put_network_order(m_pos,      fix->x.bits);
+            put_network_order(m_pos +  8, fix->y.bits);
+            put_network_order(m_pos + 16, fix->z.bits);
+            m_pos_cmd = CMD_ACC_INIT_POS_XYZ;
+            m_pos_len = 24;
+        } break;
+        default:
+            return false;
+    }
+
+    const GPSTime &time = m_gps->getGPSTime();
+    if (time.time_of_week.f >= 0) {
+        m_time       = time;
+        m_time_valid = true;
+    }
+    return writeHeader() and m_store->commit();
+}
+
+/**
+ * Begin saving the receiver's satellite system data, replacing any pages
+ * saved before. Each page is requested once the last has arrived, so packets
+ * must continue to be processed until `isSaving()` returns `false`.
+ *
+ * The ephemerides saved are those of the satellites tracked when this is
+ * called (none, if `CPN_ENABLE_SATELLITES` is 0), so it is best called once
+ * the receiver has a fix.
+ *
+ * @return `false` if the store could not be written.
+ */
+bool WarmStart::saveSystemData() {
+    const GPSTime &time = m_gps->getGPSTime();
+    m_n_pages     = 0;
+    m_page_bytes  = 0;
+    m_data_week   = time.week_no;
+    m_data_tow    = time.time_of_week;
+#if CPN_ENABLE_SATELLITES
+    m_req_tracked = m_gps->getSatellites().tracked;
+#else
+    m_req_tracked = 0;
+#endif
+    m_req         = 0;
+    if (not writeHeader()) return false;
+    m_saving = true;
+    sendRequest();
+    return true;
+}
+
+/**
+ * Send the outstanding page request again. Call if no reply has arrived
+ * in a while (a few seconds), since a request or its reply may be lost.
+ *
+ * @return `false` if no pages are being saved.
+ */
+bool WarmStart::resendRequest() {
+    if (not m_saving) return false;
+    sendRequest();
+    return true;
+}
+
+/**
+ * Whether pages are still being requested.
+ */
+bool WarmStart::isSaving() const {
+    return m_saving;
+}
+
+// type and prn of page request number `req`.
+static void request_page(uint8_t req, uint8_t *type, uint8_t *prn) {
+    static const uint8_t small_pages[REQ_ALMANAC] = {
+        SATDATA_UTC, SATDATA_IONOSPHERE, SATDATA_HEALTH
+    };
+    if (req < REQ_ALMANAC) {
+        *type = small_pages[req];
+        *prn  = 0;
+    } else if (req < REQ_EPHEMERIS) {
+        *type = SATDATA_ALMANAC;
+        *prn  = req - REQ_ALMANAC + 1;
+    } else {
+        *type = SATDATA_EPHEMERIS;
+        *prn  = req - REQ_EPHEMERIS + 1;
+    }
+}
+
+void WarmStart::sendRequest() {
+    uint8_t bytes[3];
+    bytes[0] = SATDATA_OP_REQUEST;
+    request_page(m_req, bytes + 1, bytes + 2);
+    m_gps->beginCommand(CMD_SAT_DATA);
+    m_gps->writeDataBytes(bytes, 3);
+    m_gps->endCommand();
+}
+
+// advance to the next page wanted. return false if there are no more.
+bool WarmStart::nextRequest() {
+    while (++m_req < REQ_END) {
+        if (m_req < REQ_EPHEMERIS) return true;
+        uint32_t sv = (uint32_t)1 << (m_req - REQ_EPHEMERIS);
+        if (m_req_tracked & sv) return true;
+    }
+    return false;
+}
+
+// append a page, given as <type> <prn> <length> <data ...>.
+bool WarmStart::storePage(const uint8_t *page) {
+    uint32_t n = 3 + page[2];
+    uint32_t offs = WARM_HEADER_SIZE + m_page_bytes;
+    if (offs + n > m_store->capacity()) return false;
+    if (not m_store->write(offs, page, n)) return false;
+    m_n_pages    += 1;
+    m_page_bytes += n;
+    return writeHeader();
+}
+
+/**
+ * Intercept the satellite data reports requested by `saveSystemData()`.
+ */
+PacketStatus WarmStart::gpsPacket(ReportType type, CopernicusGPS *gps) {
+    if (type != RPT_SAT_DATA or not m_saving) return PKT_IGNORE;
+
+    // report is <operation> <type> <prn> <length> <data ...>
+    if (gps->readDataBytes(m_page, 4) != 4) return PKT_ERROR;
+    uint8_t want_type, want_prn;
+    request_page(m_req, &want_type, &want_prn);
+    if (m_page[1] != want_type or m_page[2] != want_prn) {
+        // not the page we asked for; the reply to an earlier request,
+        // perhaps. keep waiting.
+        return PKT_PARTIAL;
+    }
+
+    PacketStatus st = PKT_PARTIAL;
+    uint8_t len = m_page[3];
+    if (m_page[0] == SATDATA_OP_DATA and len <= WARM_MAX_PAGE) {
+        if (gps->readDataBytes(m_page + 4, len) != len) return PKT_ERROR;
+        // the page is complete only if the packet ends here.
+        uint8_t extra;
+        if (gps->readDataBytes(&extra, 1) == 0) {
+            st = PKT_CONSUMED;
+            storePage(m_page + 1);
+        }
+    }
+    // pages which are missing, too long, or don't fit are skipped.
+    if (nextRequest()) {
+        sendRequest();
+    } else {
+        m_saving = false;
+        m_store->commit();
+    }
+    return st;
+}
+
+/***************************
+ * header                  *
+ ***************************/
+
+bool WarmStart::writeHeader() {
+    uint8_t hdr[WARM_HEADER_SIZE] = {0};
+    hdr[0] = WARM_MAGIC_0;
+    hdr[1] = WARM_MAGIC_1;
+    hdr[2] = WARM_VERSION;
+    hdr[HDR_POS_CMD] = m_pos_cmd;
+    hdr[HDR_POS_LEN] = m_pos_len;
+    for (int i = 0; i < m_pos_len; i++) hdr[HDR_POS + i] = m_pos[i];
+    put_network_order(hdr + HDR_TOW,        m_time.time_of_week.bits);
+    put_network_order(hdr + HDR_WEEK,       (uint16_t)m_time.week_no);
+    put_network_order(hdr + HDR_UTC_OFFS,   m_time.utc_offs.bits);
+    hdr[HDR_FLAGS] = m_time_valid ? HDR_FLAG_TIME : 0;
+    put_network_order(hdr + HDR_N_PAGES,    m_n_pages);
+    put_network_order(hdr + HDR_PAGE_BYTES, m_page_bytes);
+    put_network_order(hdr + HDR_DATA_WEEK,  (uint16_t)m_data_week);
+    put_network_order(hdr + HDR_DATA_TOW,   m_data_tow.bits);
+    put_network_order(hdr + HDR_CHECKSUM,   fletcher16(hdr, HDR_CHECKSUM));
+    return m_store->write(0, hdr, WARM_HEADER_SIZE);
+}
+
+bool WarmStart::readHeader() {
+    uint8_t hdr[WARM_HEADER_SIZE];
+    uint16_t sum;
+    if (m_store->capacity() < WARM_HEADER_SIZE) return false;
+    if (not m_store->read(0, hdr, WARM_HEADER_SIZE)) return false;
+    copy_network_order(&sum, hdr + HDR_CHECKSUM);
+    if (hdr[0] != WARM_MAGIC_0 or hdr[1] != WARM_MAGIC_1 or
+            hdr[2] != WARM_VERSION or sum != fletcher16(hdr, HDR_CHECKSUM)) {
+        return false;
+    }
+    m_pos_cmd = hdr[HDR_POS_CMD];
+    m_pos_len = hdr[HDR_POS_LEN];
+    if (m_pos_len > sizeof(m_pos)) return false;
+    for (int i = 0; i < m_pos_len; i++) m_pos[i] = hdr[HDR_POS + i];
+    copy_network_order(&m_time.time_of_week, hdr + HDR_TOW);
+    copy_network_order(&m_time.week_no,      hdr + HDR_WEEK);
+    copy_network_order(&m_time.utc_offs,     hdr + HDR_UTC_OFFS);
+    m_time_valid = (hdr[HDR_FLAGS] & HDR_FLAG_TIME) != 0;
+    copy_network_order(&m_n_pages,           hdr + HDR_N_PAGES);
+    copy_network_order(&m_page_bytes,        hdr + HDR_PAGE_BYTES);
+    copy_network_order(&m_data_week,         hdr + HDR_DATA_WEEK);
+    copy_network_order(&m_data_tow,          hdr + HDR_DATA_TOW);
+    return true;
+}
+
+/***************************
+ * access                  *
+ ***************************/
+
+/**
+ * Whether a position has been saved.
+ */
+bool WarmStart::hasFix() const {
+    return m_pos_cmd != 0;
+}
+
+/**
+ * Whether a GPS time has been saved.
+ */
+bool WarmStart::hasTime() const {
+    return m_time_valid;
+}
+
+/**
+ * Get the GPS time saved with the last fix. Valid only if `hasTime()`.
+ * Its UTC offset may be used to find the current GPS time from a UTC clock.
+ */
+const GPSTime& WarmStart::getSavedTime() const {
+    return m_time;
+}
+
+/**
+ * Get the number of satellite data pages saved.
+ */
+uint16_t WarmStart::getPageCount() const {
+    return m_n_pages;
+}
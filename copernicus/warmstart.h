@@ -0,0 +1,178 @@
+/*
+ * File:   warmstart.h
+ */
+
+#ifndef WARMSTART_H
+#define	WARMSTART_H
+
+#include "copernicus.h"
+
+/**
+ * @addtogroup monitor
+ * @{
+ */
+
+/// Largest satellite data page which will be saved; longer pages are skipped.
+#define WARM_MAX_PAGE       192
+/// Bytes of the store used by the saved fix and time, ahead of the pages.
+#define WARM_HEADER_SIZE    56
+/// Ephemerides older than this (in seconds) are not uploaded.
+#define WARM_EPHEMERIS_AGE  14400
+
+/**
+ * @brief Nonvolatile storage for a `WarmStart`.
+ *
+ * Implement this to keep the warm start data somewhere other than the
+ * stores provided (a file on POSIX hosts, or the EEPROM of an AVR).
+ */
+class WarmStartStore {
+public:
+    virtual ~WarmStartStore();
+
+    /// Number of bytes which may be stored.
+    virtual uint32_t capacity() const = 0;
+    /// Read `n` bytes at `offs` into `dst`. Return `false` on failure.
+    virtual bool read(uint32_t offs, uint8_t *dst, uint32_t n) = 0;
+    /// Write `n` bytes from `src` at `offs`. Return `false` on failure.
+    virtual bool write(uint32_t offs, const uint8_t *src, uint32_t n) = 0;
+    /// Make the writes so far durable. Return `false` on failure.
+    virtual bool commit();
+};
+
+#ifdef __AVR__
+
+/**
+ * @brief Warm start storage in the on-chip EEPROM of an AVR.
+ *
+ * Only bytes which have changed are written, to spare the EEPROM.
+ */
+class EEPROMWarmStore : public WarmStartStore {
+public:
+    EEPROMWarmStore(uint16_t base=0, uint16_t size=0);
+
+    uint32_t capacity() const;
+    bool read(uint32_t offs, uint8_t *dst, uint32_t n);
+    bool write(uint32_t offs, const uint8_t *src, uint32_t n);
+
+private:
+    uint16_t m_base;
+    uint16_t m_size;
+};
+
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+
+/**
+ * @brief Warm start storage in a file.
+ */
+class FileWarmStore : public WarmStartStore {
+public:
+    FileWarmStore(const char *path, uint32_t size=16384);
+    ~FileWarmStore();
+
+    bool isOpen() const;
+    uint32_t capacity() const;
+    bool read(uint32_t offs, uint8_t *dst, uint32_t n);
+    bool write(uint32_t offs, const uint8_t *src, uint32_t n);
+    bool commit();
+
+private:
+    int      m_fd;
+    uint32_t m_size;
+};
+
+#endif
+
+/**
+ * @brief Saves what the receiver knows about the sky, and gives it back at
+ * the next power-up, so that it can find satellites sooner.
+ *
+ * The last good position fix and GPS time are saved with `saveFix()`, which
+ * may be called as often as is convenient (e.g. once a minute, or on
+ * shutdown). The receiver's satellite system data (UTC parameters, ionosphere
+ * model, health, almanac, and the ephemerides of the satellites being tracked)
+ * are saved by `saveSystemData()`, which requests the pages with TSIP command
+ * 0x38 one at a time and stores each as it arrives (report 0x58), while packets
+ * are processed as usual. The almanac changes slowly, so this need only be
+ * done occasionally, once the receiver has a fix.
+ *
+ * At startup, `restore()` uploads the saved position with the initial position
+ * command (0x2B or 0x23, or 0x32 or 0x31 for double-precision fixes), the
+ * current GPS time with command 0x2E, if it is known, and the saved pages with
+ * command 0x38. Ephemerides are uploaded only if the current time is known
+ * and they were saved within the last `WARM_EPHEMERIS_AGE` seconds.
+ *
+ * Pages which don't fit in the store are skipped; the small pages are saved
+ * first, then the almanac, then the ephemerides.
+ *
+ * Example:
+ *
+ *      EEPROMWarmStore store;
+ *      WarmStart warm(&gps, &store);
+ *
+ *      void setup() {
+ *          warm.begin();
+ *          warm.restore();
+ *      }
+ *
+ *      void loop() {
+ *          if (gps.processOnePacket() == RPT_FIX_POS_LLA_32) {
+ *              if (++n_fixes % 600 == 0) warm.saveFix();
+ *              if (n_fixes == 60) warm.saveSystemData();
+ *          }
+ *      }
+ */
+class WarmStart : public GPSPacketProcessor {
+public:
+    WarmStart(CopernicusGPS *gps, WarmStartStore *store);
+    ~WarmStart();
+
+    bool begin();
+    bool restore(const GPSTime *now=NULL);
+
+    bool saveFix();
+    bool saveSystemData();
+    bool resendRequest();
+    bool isSaving() const;
+
+    bool hasFix() const;
+    bool hasTime() const;
+    const GPSTime& getSavedTime() const;
+    uint16_t getPageCount() const;
+
+    PacketStatus gpsPacket(ReportType type, CopernicusGPS *gps);
+
+private:
+
+    bool nextRequest();
+    void sendRequest();
+    bool storePage(const uint8_t *page);
+    bool writeHeader();
+    bool readHeader();
+
+    CopernicusGPS  *m_gps;
+    WarmStartStore *m_store;
+    bool            m_registered;
+
+    // saved initial position command
+    uint8_t  m_pos_cmd;
+    uint8_t  m_pos_len;
+    uint8_t  m_pos[24];
+    bool     m_time_valid;
+    GPSTime  m_time;
+    uint16_t m_n_pages;
+    uint32_t m_page_bytes;
+    int16_t  m_data_week;    // GPS time at which the pages were saved
+    Float32  m_data_tow;
+
+    // page request in progress
+    bool     m_saving;
+    uint8_t  m_req;          // index into the request sequence
+    uint32_t m_req_tracked;  // satellites whose ephemerides are wanted
+    uint8_t  m_page[4 + WARM_MAX_PAGE];
+};
+
+/// @} // addtogroup monitor
+
+#endif	/* WARMSTART_H */
@@ -0,0 +1,528 @@
+/*
+ * File:   waypoint.cpp
+ */
+
+#include <math.h>
+#include <float.h>
+
+#include "waypoint.h"
+
+#define EARTH_RADIUS 6371008.8f // mean radius, meters
+#define GPS_PI_F     3.14159265f
+
+// WGS-84 ellipsoid
+#define WGS84_A      6378137.0
+#define WGS84_F      (1 / 298.257223563)
+
+// convergence of Vincenty's iteration, in radians of longitude on the
+// auxiliary sphere; ~0.06 mm, or less than a meter in single precision.
+#if DBL_MANT_DIG >= 53
+#define GEO_TOLERANCE 1e-11
+#else
+#define GEO_TOLERANCE 1e-6
+#endif
+#define GEO_MAX_ITERATIONS 200
+
+// state of one scan of the grid
+struct WaypointScan {
+    float        p[3];   // unit vector of the query
+    float        limit2; // squared chord beyond which nothing is kept
+    bool         nearest;
+    WaypointHit *out;    // hits; distances are squared chords
+    uint32_t     cap;
+    uint32_t     n;      // hits found, which may exceed `cap` if not `nearest`
+};
+
+static inline void unit_vector(float lat, float lng, float v[3]) {
+    float c = cos(lat);
+    v[0] = c * cos(lng);
+    v[1] = c * sin(lng);
+    v[2] = sin(lat);
+}
+
+// distance in meters along a great circle with the given chord (unit sphere).
+static inline float chord_to_distance(float chord) {
+    if (chord > 2) chord = 2;
+    return 2 * EARTH_RADIUS * asin(chord / 2);
+}
+
+static void sift_down(WaypointHit *heap, uint32_t n, uint32_t i) {
+    WaypointHit h = heap[i];
+    while (true) {
+        uint32_t c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n and heap[c + 1].distance > heap[c].distance) c++;
+        if (heap[c].distance <= h.distance) break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = h;
+}
+
+static void sift_up(WaypointHit *heap, uint32_t i) {
+    WaypointHit h = heap[i];
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (heap[parent].distance >= h.distance) break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = h;
+}
+
+// keep a waypoint found by a scan. `nearest` scans keep the `cap` nearest
+// in a max-heap, and tighten the limit to the farthest of them once full.
+static inline void keep(WaypointScan *s, uint32_t i, float d2) {
+    if (not s->nearest) {
+        if (s->n < s->cap) {
+            s->out[s->n].index    = i;
+            s->out[s->n].distance = d2;
+        }
+        s->n++;
+    } else if (s->n < s->cap) {
+        s->out[s->n].index    = i;
+        s->out[s->n].distance = d2;
+        sift_up(s->out, s->n++);
+        if (s->n == s->cap) s->limit2 = s->out[0].distance;
+    } else {
+        s->out[0].index    = i;
+        s->out[0].distance = d2;
+        sift_down(s->out, s->n, 0);
+        s->limit2 = s->out[0].distance;
+    }
+}
+
+// rank the stored waypoints [i, end) by squared chord to the query.
+static void scan_waypoints(const float *x, const float *y, const float *z,
+                           uint32_t i, uint32_t end, WaypointScan *s) {
+    float d2[WAYPOINT_CHUNK];
+    const float px = s->p[0];
+    const float py = s->p[1];
+    const float pz = s->p[2];
+    while (i < end) {
+        uint32_t m = end - i;
+        if (m > WAYPOINT_CHUNK) m = WAYPOINT_CHUNK;
+        // the distances of a chunk are found together, which vectorizes...
+        for (uint32_t j = 0; j < m; j++) {
+            float dx = x[i + j] - px;
+            float dy = y[i + j] - py;
+            float dz = z[i + j] - pz;
+            d2[j] = dx * dx + dy * dy + dz * dz;
+        }
+        // ...and only the few within the limit are kept.
+        for (uint32_t j = 0; j < m; j++) {
+            if (d2[j] <= s->limit2) keep(s, i + j, d2[j]);
+        }
+        i += m;
+    }
+}
+
+/***************************
+ * free functions          *
+ ***************************/
+
+/**
+ * Compute the great-circle distance between two points on a sphere of the
+ * Earth's mean radius, with the haversine formula. Angles are in radians.
+ *
+ * @return The distance in meters, within 0.56% of the distance along the
+ * WGS-84 ellipsoid.
+ */
+float sphere_distance(float lat1, float lng1, float lat2, float lng2) {
+    float s_lat = sin((lat2 - lat1) / 2);
+    float s_lng = sin((lng2 - lng1) / 2);
+    float h = s_lat * s_lat + cos(lat1) * cos(lat2) * s_lng * s_lng;
+    if (h > 1) h = 1;
+    return 2 * EARTH_RADIUS * asin(sqrt(h));
+}
+
+/**
+ * Compute the initial bearing of the great circle from the first point to
+ * the second, in radians clockwise from north, from 0 to 2pi.
+ */
+float sphere_bearing(float lat1, float lng1, float lat2, float lng2) {
+    float dlng = lng2 - lng1;
+    float c2 = cos(lat2);
+    float b = atan2(sin(dlng) * c2,
+                    cos(lat1) * sin(lat2) - sin(lat1) * c2 * cos(dlng));
+    return (b < 0) ? b + 2 * GPS_PI_F : b;
+}
+
+/**
+ * Compute the distance and initial bearing from the first point to the
+ * second along the WGS-84 ellipsoid, with Vincenty's inverse formula.
+ * Angles are in radians.
+ *
+ * The result is accurate to within a millimeter where `double` has double
+ * precision. Vincenty's iteration does not converge for some points which
+ * are nearly antipodal; for those, use `sphere_distance()` instead.
+ *
+ * @param distance Set to the distance, in meters.
+ * @param bearing Set to the initial bearing, in radians clockwise from
+ * north, from 0 to 2pi.
+ * @return `false` if the iteration did not converge, `true` otherwise.
+ */
+bool geodesic_inverse(double lat1, double lng1, double lat2, double lng2,
+                      double *distance, double *bearing) {
+    const double f = WGS84_F;
+    const double a = WGS84_A;
+    const double b = a * (1 - f);
+    double L = lng2 - lng1;
+    if      (L >  M_PI) L -= 2 * M_PI;
+    else if (L < -M_PI) L += 2 * M_PI;
+
+    // reduced latitudes
+    double tan_u1 = (1 - f) * tan(lat1);
+    double tan_u2 = (1 - f) * tan(lat2);
+    double cos_u1 = 1 / sqrt(1 + tan_u1 * tan_u1);
+    double cos_u2 = 1 / sqrt(1 + tan_u2 * tan_u2);
+    double sin_u1 = tan_u1 * cos_u1;
+    double sin_u2 = tan_u2 * cos_u2;
+
+    double lambda = L;
+    double sin_lambda, cos_lambda;
+    double sin_sigma, cos_sigma, sigma;
+    double cos2_alpha, cos_2sigma_m;
+    int i;
+    for (i = 0; i < GEO_MAX_ITERATIONS; i++) {
+        sin_lambda = sin(lambda);
+        cos_lambda = cos(lambda);
+        double t0 = cos_u2 * sin_lambda;
+        double t1 = cos_u1 * sin_u2 - sin_u1 * cos_u2 * cos_lambda;
+        sin_sigma = sqrt(t0 * t0 + t1 * t1);
+        if (sin_sigma == 0) {
+            // coincident points
+            *distance = 0;
+            *bearing  = 0;
+            return true;
+        }
+        cos_sigma = sin_u1 * sin_u2 + cos_u1 * cos_u2 * cos_lambda;
+        sigma     = atan2(sin_sigma, cos_sigma);
+        double sin_alpha = cos_u1 * cos_u2 * sin_lambda / sin_sigma;
+        cos2_alpha = 1 - sin_alpha * sin_alpha;
+        // zero on the equator
+        cos_2sigma_m = (cos2_alpha != 0) ?
+                cos_sigma - 2 * sin_u1 * sin_u2 / cos2_alpha : 0;
+        double C = f / 16 * cos2_alpha * (4 + f * (4 - 3 * cos2_alpha));
+        double prev = lambda;
+        lambda = L + (1 - C) * f * sin_alpha * (sigma + C * sin_sigma *
+                (cos_2sigma_m + C * cos_sigma * (-1 + 2 * cos_2sigma_m * cos_2sigma_m)));
+        if (fabs(lambda - prev) < GEO_TOLERANCE) break;
+    }
+    if (i == GEO_MAX_ITERATIONS) return false;
+
+    double u2 = cos2_alpha * (a * a - b * b) / (b * b);
+    double A  = 1 + u2 / 16384 * (4096 + u2 * (-768 + u2 * (320 - 175 * u2)));
+    double B  = u2 / 1024 * (256 + u2 * (-128 + u2 * (74 - 47 * u2)));
+    double c2sm2 = cos_2sigma_m * cos_2sigma_m;
+    double d_sigma = B * sin_sigma * (cos_2sigma_m + B / 4 *
+            (cos_sigma * (-1 + 2 * c2sm2) - B / 6 * cos_2sigma_m *
+             (-3 + 4 * sin_sigma * sin_sigma) * (-3 + 4 * c2sm2)));
+    *distance = b * A * (sigma - d_sigma);
+
+    double alpha1 = atan2(cos_u2 * sin_lambda,
+                          cos_u1 * sin_u2 - sin_u1 * cos_u2 * cos_lambda);
+    *bearing = (alpha1 < 0) ? alpha1 + 2 * M_PI : alpha1;
+    return true;
+}
+
+/***************************
+ * structors               *
+ ***************************/
+
+/**
+ * Construct a new set of waypoints. The set must be indexed with
+ * `buildIndex()` before it can be queried.
+ *
+ * @param lat Latitudes of the waypoints, in radians.
+ * @param lng Longitudes of the waypoints, in radians, from -pi to pi.
+ * @param n Number of waypoints.
+ */
+WaypointSet::WaypointSet(const float *lat, const float *lng, uint32_t n):
+        m_lat(lat),
+        m_lng(lng),
+        m_n(n),
+        m_lat0(0), m_lng0(0), m_lng1(0),
+        m_cell_h(0), m_cell_w(0),
+        m_cos_max(1),
+        m_rows(0), m_cols(0),
+        m_cell_offsets(0),
+        m_order(0),
+        m_xyz(0) {}
+
+/***************************
+ * indexing                *
+ ***************************/
+
+int WaypointSet::cellRow(float lat) const {
+    float row = floor((lat - m_lat0) / m_cell_h);
+    if (row < 0) return 0;
+    if (row >= m_rows) return m_rows - 1;
+    return (int)row;
+}
+
+int WaypointSet::cellCol(float lng) const {
+    float col = floor((lng - m_lng0) / m_cell_w);
+    if (col < 0) return 0;
+    if (col >= m_cols) return m_cols - 1;
+    return (int)col;
+}
+
+/**
+ * Build the spatial index of the waypoints. A finer grid scans fewer
+ * waypoints per query, but more cells; a few waypoints per cell is best.
+ *
+ * @param cols Number of grid columns (along longitude).
+ * @param rows Number of grid rows (along latitude).
+ * @param cell_offsets Storage for `cols * rows + 1` offsets.
+ * @param order Storage for one index per waypoint.
+ * @param xyz Storage for three floats per waypoint.
+ * @return `false` if the grid is empty, `true` otherwise.
+ */
+bool WaypointSet::buildIndex(uint16_t cols, uint16_t rows,
+                             uint32_t *cell_offsets, uint32_t *order,
+                             float *xyz) {
+    m_cell_offsets = 0;
+    m_order        = 0;
+    m_xyz          = 0;
+    if (cols == 0 or rows == 0) return false;
+
+    // the grid covers the bounds of all the waypoints.
+    float lo[2] = {  GPS_PI_F,  GPS_PI_F };
+    float hi[2] = { -GPS_PI_F, -GPS_PI_F };
+    float lat_max = 0;
+    for (uint32_t i = 0; i < m_n; i++) {
+        if (m_lat[i] < lo[0]) lo[0] = m_lat[i];
+        if (m_lng[i] < lo[1]) lo[1] = m_lng[i];
+        if (m_lat[i] > hi[0]) hi[0] = m_lat[i];
+        if (m_lng[i] > hi[1]) hi[1] = m_lng[i];
+        if (fabs(m_lat[i]) > lat_max) lat_max = fabs(m_lat[i]);
+    }
+    if (lo[0] > hi[0]) lo[0] = hi[0] = lo[1] = hi[1] = 0;
+    m_rows    = rows;
+    m_cols    = cols;
+    m_lat0    = lo[0];
+    m_lng0    = lo[1];
+    m_lng1    = hi[1];
+    m_cos_max = cos(lat_max);
+    // pad slightly, so that the upper bounds fall inside the last cell.
+    m_cell_h  = (hi[0] - lo[0]) / rows * 1.0001f + 1e-9f;
+    m_cell_w  = (hi[1] - lo[1]) / cols * 1.0001f + 1e-9f;
+
+    // count the waypoints in each cell...
+    uint32_t n_cells = (uint32_t)rows * cols;
+    for (uint32_t c = 0; c <= n_cells; c++) cell_offsets[c] = 0;
+    for (uint32_t i = 0; i < m_n; i++) {
+        cell_offsets[cellRow(m_lat[i]) * cols + cellCol(m_lng[i]) + 1]++;
+    }
+    for (uint32_t c = 0; c < n_cells; c++) {
+        cell_offsets[c + 1] += cell_offsets[c];
+    }
+    // ...store them, advancing each cell's offset to the start of the next...
+    float *x = xyz;
+    float *y = xyz + m_n;
+    float *z = xyz + 2 * m_n;
+    for (uint32_t i = 0; i < m_n; i++) {
+        uint32_t j = cell_offsets[cellRow(m_lat[i]) * cols + cellCol(m_lng[i])]++;
+        float v[3];
+        unit_vector(m_lat[i], m_lng[i], v);
+        x[j] = v[0];
+        y[j] = v[1];
+        z[j] = v[2];
+        order[j] = i;
+    }
+    // ...and move the offsets back.
+    for (uint32_t c = n_cells; c > 0; c--) {
+        cell_offsets[c] = cell_offsets[c - 1];
+    }
+    cell_offsets[0] = 0;
+
+    m_cell_offsets = cell_offsets;
+    m_order        = order;
+    m_xyz          = xyz;
+    return true;
+}
+
+/***************************
+ * queries                 *
+ ***************************/
+
+// scan the rings of cells about the query until no unscanned cell can hold
+// a waypoint within the limit. returns the number of hits found, with their
+// squared chords as distances and their storage indices as indices.
+uint32_t WaypointSet::scan(float lat, float lng, float limit2, bool nearest,
+                           WaypointHit *out, uint32_t cap) const {
+    if (m_cell_offsets == 0 or cap == 0) return 0;
+    WaypointScan s;
+    unit_vector(lat, lng, s.p);
+    s.limit2  = limit2;
+    s.nearest = nearest;
+    s.out     = out;
+    s.cap     = cap;
+    s.n       = 0;
+
+    const float *x = m_xyz;
+    const float *y = m_xyz + m_n;
+    const float *z = m_xyz + 2 * m_n;
+    const int rows = m_rows;
+    const int cols = m_cols;
+    const int qr = cellRow(lat);
+    const int qc = cellCol(lng);
+    // (cos lat * cos lat') bounds the chord across a difference in longitude.
+    const float k_lng = 2 * sqrt(fmax(cos(lat), 0.0f) * m_cos_max);
+
+    for (int r = 0; ; r++) {
+        int r0 = qr - r;
+        int r1 = qr + r;
+        int c0 = qc - r;
+        int c1 = qc + r;
+        for (int row = (r0 < 0 ? 0 : r0); row <= r1 and row < rows; row++) {
+            const uint32_t *offs = m_cell_offsets + row * cols;
+            if (row == r0 or row == r1) {
+                int col0 = (c0 < 0) ? 0 : c0;
+                int col1 = (c1 >= cols) ? cols - 1 : c1;
+                // the cells of a row are stored together.
+                if (col0 <= col1) {
+                    scan_waypoints(x, y, z, offs[col0], offs[col1 + 1], &s);
+                }
+            } else {
+                if (c0 >= 0)   scan_waypoints(x, y, z, offs[c0], offs[c0 + 1], &s);
+                if (c1 < cols) scan_waypoints(x, y, z, offs[c1], offs[c1 + 1], &s);
+            }
+        }
+        if (r0 <= 0 and r1 >= rows - 1 and c0 <= 0 and c1 >= cols - 1) break;
+
+        // nearest difference in latitude of any unscanned row...
+        float d_lat = GPS_PI_F;
+        if (r0 > 0)        d_lat = fmin(d_lat, lat - (m_lat0 + r0 * m_cell_h));
+        if (r1 < rows - 1) d_lat = fmin(d_lat, m_lat0 + (r1 + 1) * m_cell_h - lat);
+        // ...and in longitude of any unscanned column, either way around.
+        float d_lng = GPS_PI_F;
+        if (c0 > 0) {
+            d_lng = fmin(d_lng, fmax(lng - (m_lng0 + c0 * m_cell_w),
+                                     0.0f));
+            d_lng = fmin(d_lng, 2 * GPS_PI_F - (lng - m_lng0));
+        }
+        if (c1 < cols - 1) {
+            d_lng = fmin(d_lng, fmax(m_lng0 + (c1 + 1) * m_cell_w - lng,
+                                     0.0f));
+            d_lng = fmin(d_lng, 2 * GPS_PI_F - (m_lng1 - lng));
+        }
+        d_lat = fmax(d_lat, 0.0f);
+        d_lng = fmin(fmax(d_lng, 0.0f), GPS_PI_F);
+        // shortest chord to any unscanned waypoint
+        // (less the error of the ranking in single precision)
+        float bound = fmin(2 * sin(d_lat / 2), k_lng * sin(d_lng / 2)) - 1e-6f;
+        if (bound > 0 and bound * bound > s.limit2) break;
+    }
+    return s.n;
+}
+
+/**
+ * Find the `k` waypoints nearest to a point, ranked by great-circle
+ * distance, and compute their distances and bearings along the ellipsoid.
+ *
+ * @param lat Latitude of the point, in radians.
+ * @param lng Longitude of the point, in radians.
+ * @param out Storage for `k` results, which are ordered from nearest to
+ * farthest.
+ * @param k Number of waypoints to find.
+ * @param max_distance Greatest distance of any waypoint found, in meters,
+ * or 0 for no limit.
+ * @return The number of waypoints found, at most `k`.
+ */
+uint32_t WaypointSet::nearest(float lat, float lng, WaypointHit *out,
+                              uint32_t k, float max_distance) const {
+    float limit = 2;
+    if (max_distance > 0 and max_distance < GPS_PI_F * EARTH_RADIUS) {
+        limit = 2 * sin(max_distance / (2 * EARTH_RADIUS));
+    }
+    // include the waypoints exactly at the limit despite rounding.
+    uint32_t n = scan(lat, lng, limit * limit * 1.0001f, true, out, k);
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t idx = m_order[out[i].index];
+        double d, b;
+        if (geodesic_inverse(lat, lng, m_lat[idx], m_lng[idx], &d, &b)) {
+            out[i].distance = d;
+            out[i].bearing  = b;
+        } else {
+            out[i].distance = chord_to_distance(sqrt(out[i].distance));
+            out[i].bearing  = sphere_bearing(lat, lng, m_lat[idx], m_lng[idx]);
+        }
+        out[i].index = idx;
+    }
+    // order by the refined distances; k is small.
+    for (uint32_t i = 1; i < n; i++) {
+        WaypointHit h = out[i];
+        uint32_t j = i;
+        for (; j > 0 and out[j - 1].distance > h.distance; j--) {
+            out[j] = out[j - 1];
+        }
+        out[j] = h;
+    }
+    return n;
+}
+
+/**
+ * Find the `k` waypoints nearest to each of a column of points. The results
+ * for each point are stored in turn, `k` per point, ordered from nearest to
+ * farthest; where fewer than `k` waypoints exist, the rest have the index
+ * `WAYPOINT_NONE`.
+ *
+ * @param lat Latitudes of the points, in radians.
+ * @param lng Longitudes of the points, in radians.
+ * @param n_queries Number of points.
+ * @param out Storage for `n_queries * k` results.
+ * @param k Number of waypoints to find for each point.
+ */
+void WaypointSet::nearest(const float *lat, const float *lng, uint32_t n_queries,
+                          WaypointHit *out, uint32_t k) const {
+    for (uint32_t q = 0; q < n_queries; q++, out += k) {
+        uint32_t n = nearest(lat[q], lng[q], out, k);
+        for (uint32_t i = n; i < k; i++) {
+            out[i].index    = WAYPOINT_NONE;
+            out[i].distance = 0;
+            out[i].bearing  = 0;
+        }
+    }
+}
+
+/**
+ * Find all the waypoints within a great-circle distance of a point, in no
+ * particular order. Distances and bearings are along the sphere.
+ *
+ * @param lat Latitude of the point, in radians.
+ * @param lng Longitude of the point, in radians.
+ * @param radius Greatest distance, in meters.
+ * @param out Storage for `max_out` results.
+ * @param max_out Most results to store.
+ * @return The number of waypoints within the distance, which may be more
+ * than `max_out`.
+ */
+uint32_t WaypointSet::within(float lat, float lng, float radius,
+                             WaypointHit *out, uint32_t max_out) const {
+    if (radius <= 0 or max_out == 0) return 0;
+    float limit = (radius < GPS_PI_F * EARTH_RADIUS) ?
+            2 * sin(radius / (2 * EARTH_RADIUS)) : 2;
+    uint32_t n = scan(lat, lng, limit * limit, false, out, max_out);
+    uint32_t stored = (n < max_out) ? n : max_out;
+    for (uint32_t i = 0; i < stored; i++) {
+        uint32_t idx = m_order[out[i].index];
+        out[i].index    = idx;
+        out[i].distance = chord_to_distance(sqrt(out[i].distance));
+        out[i].bearing  = sphere_bearing(lat, lng, m_lat[idx], m_lng[idx]);
+    }
+    return n;
+}
+
+/***************************
+ * access                  *
+ ***************************/
+
+/**
+ * Get the number of waypoints in the set.
+ */
+uint32_t WaypointSet::getWaypointCount() const {
+    return m_n;
+}
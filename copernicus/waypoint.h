@@ -0,0 +1,116 @@
+/*
+ * File:   waypoint.h
+ */
+
+#ifndef WAYPOINT_H
+#define	WAYPOINT_H
+
+#include "gpstype.h"
+
+/**
+ * @addtogroup processing
+ * @{
+ */
+
+/// Index of a missing result.
+#define WAYPOINT_NONE 0xFFFFFFFF
+
+/// Waypoints whose distances are computed together in one pass of a scan.
+#define WAYPOINT_CHUNK 64
+
+/**
+ * @brief The distance and bearing to one waypoint.
+ */
+struct WaypointHit {
+    /// Index of the waypoint in the table, or `WAYPOINT_NONE`.
+    uint32_t index;
+    /// Distance to the waypoint, in meters.
+    float distance;
+    /// Initial bearing to the waypoint, in radians clockwise from north,
+    /// from 0 to 2pi.
+    float bearing;
+};
+
+float sphere_distance(float lat1, float lng1, float lat2, float lng2);
+float sphere_bearing(float lat1, float lng1, float lat2, float lng2);
+bool  geodesic_inverse(double lat1, double lng1, double lat2, double lng2,
+                       double *distance, double *bearing);
+
+/**
+ * @brief A static table of waypoints, indexed for distance queries.
+ *
+ * The waypoints are given as separate arrays of latitude and longitude, in
+ * radians. They are indexed by a uniform grid of cells covering all the
+ * waypoints, and each waypoint's position is kept as a unit vector, stored
+ * in columns and ordered by cell, so that the waypoints of a cell can be
+ * ranked by chord length with a few multiply-adds apiece, in loops which
+ * the compiler can vectorize. Only the cells near a query are scanned: the
+ * scan widens ring by ring about the query's cell until no unscanned cell
+ * can hold a nearer waypoint. Waypoints across the antimeridian are found.
+ *
+ * Ranking is by great-circle distance on a sphere of the Earth's mean
+ * radius, which differs from the distance along the WGS-84 ellipsoid by at
+ * most about 0.56%; waypoints nearly tied at the edge of the `k` nearest
+ * may therefore be chosen differently than by ellipsoidal distance. The
+ * distances and bearings returned by `nearest()` are then found on the
+ * ellipsoid with `geodesic_inverse()`, to within about half a meter (the
+ * resolution of a float angle), or tens of meters on boards whose `double`
+ * has only single precision. `within()` returns spherical distances and
+ * bearings, accurate to within 0.56% plus a meter.
+ *
+ * All storage is supplied by the caller, and is not copied; it must outlive
+ * the `WaypointSet`.
+ *
+ * Example:
+ *
+ *      WaypointSet wpts(lat_array, lng_array, n);
+ *      // allocate (COLS * ROWS + 1) cell offsets, n indices, and 3 * n floats:
+ *      wpts.buildIndex(COLS, ROWS, cell_offsets, order, xyz);
+ *
+ *      WaypointHit hits[8];
+ *      uint32_t n_hits = wpts.nearest(lat, lng, hits, 8);
+ *
+ * A `WaypointSet` is not modified by queries, and may be shared by any
+ * number of threads.
+ */
+class WaypointSet {
+public:
+    WaypointSet(const float *lat, const float *lng, uint32_t n);
+
+    bool buildIndex(uint16_t cols, uint16_t rows,
+                    uint32_t *cell_offsets, uint32_t *order, float *xyz);
+
+    uint32_t nearest(float lat, float lng, WaypointHit *out, uint32_t k,
+                     float max_distance=0) const;
+    void     nearest(const float *lat, const float *lng, uint32_t n_queries,
+                     WaypointHit *out, uint32_t k) const;
+    uint32_t within(float lat, float lng, float radius,
+                    WaypointHit *out, uint32_t max_out) const;
+
+    uint32_t getWaypointCount() const;
+
+private:
+
+    uint32_t scan(float lat, float lng, float limit2, bool nearest,
+                  WaypointHit *out, uint32_t cap) const;
+    int cellRow(float lat) const;
+    int cellCol(float lng) const;
+
+    const float *m_lat;
+    const float *m_lng;
+    uint32_t     m_n;
+
+    // grid
+    float     m_lat0, m_lng0;
+    float     m_lng1;            // greatest longitude of any waypoint
+    float     m_cell_h, m_cell_w; // radians
+    float     m_cos_max;         // cosine of the greatest |latitude|
+    uint16_t  m_rows, m_cols;
+    uint32_t *m_cell_offsets;
+    uint32_t *m_order;           // table index of each stored waypoint
+    float    *m_xyz;             // unit vectors, as columns of x, y, and z
+};
+
+/// @} // addtogroup processing
+
+#endif	/* WAYPOINT_H */
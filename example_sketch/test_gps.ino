@@ -48,6 +48,7 @@ void loop() {
        case RPT_ADDL_STATUS:    Serial.print("receiver additional status\n"); break;
        case RPT_SATELLITES:     Serial.print("satellite report\n"); break;
        case RPT_SBAS_MODE:      Serial.print("satellite based augmentation report\n"); break;
+       case RPT_SUPERPACKET:    Serial.print("superpacket\n"); break;
        default: 
          Serial.print("unknown packet ");
          Serial.print(rpt);
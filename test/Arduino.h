@@ -0,0 +1,59 @@
+/*
+ * File:   Arduino.h
+ *
+ * Just enough of the Arduino core to build the library on a Linux host, for
+ * the tests. Bytes the receiver "sends" are queued in `in`; bytes the
+ * library writes to it are collected in `out`.
+ */
+
+#ifndef ARDUINO_H
+#define	ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#include <deque>
+#include <vector>
+
+typedef uint8_t byte;
+
+// the library picks its serial ports by these.
+#define UBRR0H 1
+#define UBRR1H 1
+
+unsigned long micros();
+unsigned long millis();
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t *b, size_t n) {
+        for (size_t i = 0; i < n; i++) write(b[i]);
+        return n;
+    }
+};
+
+class HardwareSerial : public Print {
+public:
+    std::deque<uint8_t>  in;
+    std::vector<uint8_t> out;
+
+    void begin(long) {}
+    int  available() { return (int)in.size(); }
+    int  peek() { return in.empty() ? -1 : in.front(); }
+    int  read() {
+        if (in.empty()) return -1;
+        int b = in.front();
+        in.pop_front();
+        return b;
+    }
+    using Print::write;
+    size_t write(uint8_t b) { out.push_back(b); return 1; }
+};
+
+extern HardwareSerial Serial, Serial1;
+
+#endif	/* ARDUINO_H */
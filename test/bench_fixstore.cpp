@@ -0,0 +1,149 @@
+/*
+ * File:   bench_fixstore.cpp
+ *
+ * Host timings of adding fixes to a `FixStore`, sealing included, and of
+ * searching it for small boxes over short times, against a scan of every
+ * row. `make bench` runs it; the numbers are for comparing changes on one
+ * machine, not for predicting an AVR's.
+ */
+
+#include <stdlib.h>
+#include <chrono>
+
+#include "host.h"
+#include "fixstore.h"
+
+#define N_RECEIVERS 500
+#define INTERVAL_MS 5000
+#define HOURS       4
+#define SEG_ROWS    65536
+#define N_QUERIES   500
+
+#define WEEK_MS 604800000LL
+
+static volatile uint32_t sink;
+
+typedef std::chrono::steady_clock Clock;
+
+static double ns_per(Clock::time_point t0, long n) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+}
+
+static float frand(float lo, float hi) {
+    return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+struct BenchPosFix : public PosFix {
+    void set(float lat, float lng, float time) {
+        type = RPT_FIX_POS_LLA_32;
+        lla_32.lat.f = lat;
+        lla_32.lng.f = lng;
+        lla_32.alt.f = 100;
+        lla_32.bias.f = 0;
+        lla_32.fixtime.f = time;
+    }
+};
+
+static bool matches(const StoreQuery &q, const StoreRow &r) {
+    return r.time_ms >= q.t0 and r.time_ms <= q.t1 and
+           r.lat >= q.lat_min and r.lat <= q.lat_max and
+           r.lng >= q.lng_min and r.lng <= q.lng_max;
+}
+
+static void count_row(void *ctx, const StoreRow &) {
+    ++*static_cast<uint32_t*>(ctx);
+}
+
+static void keep_row(void *ctx, const StoreRow &row) {
+    static_cast<std::vector<StoreRow>*>(ctx)->push_back(row);
+}
+
+int main() {
+    // receivers wandering at up to 25 m/s over a region about 50 km across,
+    // turning now and then.
+    const long n_fixes = (long)N_RECEIVERS * HOURS * 3600000 / INTERVAL_MS;
+    std::vector<BenchPosFix> fixes(n_fixes);
+    std::vector<float> lat(N_RECEIVERS), lng(N_RECEIVERS), dlat(N_RECEIVERS), dlng(N_RECEIVERS);
+    srand(37);
+    for (int r = 0; r < N_RECEIVERS; r++) {
+        lat[r]  = frand(0.700f, 0.708f);
+        lng[r]  = frand(-0.005f, 0.005f);
+        dlat[r] = frand(-1.5e-5f, 1.5e-5f);
+        dlng[r] = frand(-2.0e-5f, 2.0e-5f);
+    }
+    const float tow0 = 200000;
+    for (long i = 0; i < n_fixes; i++) {
+        int r = i % N_RECEIVERS;
+        if (r == 0 and rand() % 8 == 0) dlat[rand() % N_RECEIVERS] *= -1;
+        lat[r] += dlat[r];
+        lng[r] += dlng[r];
+        if (lat[r] < 0.700f or lat[r] > 0.708f) dlat[r] *= -1;
+        if (lng[r] < -0.005f or lng[r] > 0.005f) dlng[r] *= -1;
+        float t = tow0 + (i / N_RECEIVERS) * (INTERVAL_MS / 1000.0f);
+        fixes[i].set(lat[r], lng[r], t);
+    }
+
+    uint32_t n_segs = (uint32_t)(n_fixes / SEG_ROWS + HOURS + 2);
+    std::vector<uint64_t> mem(FixStore::bytesNeeded(n_segs, SEG_ROWS) / 8 + 1);
+    FixStore store(&mem[0], mem.size() * 8, SEG_ROWS);
+    Clock::time_point t0 = Clock::now();
+    for (long i = 0; i < n_fixes; i++) store.add(i % N_RECEIVERS, 2000, fixes[i]);
+    store.seal();
+    double add_ns = ns_per(t0, n_fixes);
+    CHECK(store.getRowCount() == (uint64_t)n_fixes);
+    printf("add              %6.1f ns/fix (%ld fixes, %u segments)\n",
+           add_ns, n_fixes, store.getSegmentCount());
+
+    // boxes about 1 km across, over 10 minutes.
+    std::vector<StoreQuery> qs(N_QUERIES);
+    for (int k = 0; k < N_QUERIES; k++) {
+        StoreQuery &q = qs[k];
+        float la = frand(0.700f, 0.708f), ln = frand(-0.005f, 0.005f);
+        q.lat_min = STORE_ANGLE(la);
+        q.lat_max = STORE_ANGLE(la + 1.6e-4f);
+        q.lng_min = STORE_ANGLE(ln);
+        q.lng_max = STORE_ANGLE(ln + 2.1e-4f);
+        q.t0 = 2000 * WEEK_MS + (int64_t)tow0 * 1000 + (int64_t)frand(0, HOURS * 3600 - 600) * 1000;
+        q.t1 = q.t0 + 600000;
+    }
+
+    // every row, for scanning
+    std::vector<StoreRow> rows;
+    StoreQuery all;
+    all.t0 = 0;
+    all.t1 = 0x7FFFFFFFFFFFFFFFLL;
+    all.lat_min = all.lng_min = -0x7FFFFFFF;
+    all.lat_max = all.lng_max =  0x7FFFFFFF;
+    store.query(all, keep_row, &rows);
+    CHECK(rows.size() == (size_t)n_fixes);
+
+    std::vector<uint32_t> expect(N_QUERIES, 0);
+    t0 = Clock::now();
+    for (int k = 0; k < N_QUERIES; k++) {
+        for (size_t i = 0; i < rows.size(); i++) expect[k] += matches(qs[k], rows[i]);
+    }
+    double scan_us = ns_per(t0, N_QUERIES) / 1000;
+
+    uint32_t total = 0;
+    t0 = Clock::now();
+    for (int k = 0; k < N_QUERIES; k++) {
+        uint32_t n = 0;
+        uint32_t found = store.query(qs[k], count_row, &n);
+        CHECK(found == n and found == expect[k]);
+        total += found;
+    }
+    double query_us = ns_per(t0, N_QUERIES) / 1000;
+
+    t0 = Clock::now();
+    for (int k = 0; k < N_QUERIES; k++) {
+        uint8_t who[STORE_MAX_RECEIVERS / 8] = {0};
+        sink += store.queryReceivers(qs[k], who);
+        sink += who[k % sizeof(who)];
+    }
+    double recv_us = ns_per(t0, N_QUERIES) / 1000;
+
+    printf("scan             %8.1f us/query (%.1f matches)\n", scan_us, total / (double)N_QUERIES);
+    printf("query            %8.1f us/query  %5.1fx\n", query_us, scan_us / query_us);
+    printf("queryReceivers   %8.1f us/query  %5.1fx\n", recv_us, scan_us / recv_us);
+    return host_result("bench_fixstore");
+}
@@ -0,0 +1,113 @@
+/*
+ * File:   bench_geofence.cpp
+ *
+ * Host timings of point-in-fence tests, one fence at a time, and of a
+ * tracker following fixes through thousands of indexed fences. `make bench`
+ * runs it; the numbers are for comparing changes on one machine, not for
+ * predicting an AVR's.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "host.h"
+#include "geofence.h"
+
+#define N_CIRCLES 3000
+#define N_POLYS   2000
+#define POLY_N    8
+#define N_POINTS  200000
+
+#define PI_F 3.14159265f
+
+static volatile uint32_t sink;
+
+typedef std::chrono::steady_clock Clock;
+
+static double ns_per(Clock::time_point t0, long n) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+}
+
+static float frand(float lo, float hi) {
+    return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+int main() {
+    // fences scattered over a region about 1000 km across.
+    std::vector<Geofence>       fences;
+    std::vector<GeofenceVertex> verts;
+    srand(31);
+    for (int i = 0; i < N_CIRCLES; i++) {
+        Geofence f;
+        f.shape  = FENCE_CIRCLE;
+        f.lat    = frand(0.60f, 0.75f);
+        f.lng    = frand(-0.10f, 0.10f);
+        f.radius = frand(100, 5000);
+        f.first_vertex = f.n_vertices = 0;
+        fences.push_back(f);
+    }
+    for (int i = 0; i < N_POLYS; i++) {
+        Geofence f;
+        f.shape = FENCE_POLYGON;
+        f.lat = f.lng = f.radius = 0;
+        f.first_vertex = verts.size();
+        f.n_vertices   = POLY_N;
+        float lat = frand(0.60f, 0.75f), lng = frand(-0.10f, 0.10f), r = frand(2e-5f, 8e-4f);
+        for (int k = 0; k < POLY_N; k++) {
+            float a = 2 * PI_F * k / POLY_N;
+            GeofenceVertex v = { lat + r * sinf(a), lng + r * cosf(a) };
+            verts.push_back(v);
+        }
+        fences.push_back(f);
+    }
+    GeofenceSet set(fences.data(), fences.size(), verts.data(), verts.size());
+    const uint16_t cols = 256, rows = 256;
+    std::vector<uint32_t>   offsets(cols * rows + 1);
+    std::vector<GeofenceID> entries(set.indexSize(cols, rows));
+    CHECK(set.buildIndex(cols, rows, offsets.data(), entries.data(), entries.size()));
+
+    // fixes along a track, about 20 m apart, and scattered points.
+    std::vector<float> lat(N_POINTS), lng(N_POINTS);
+    float la = 0.67f, ln = 0;
+    for (int i = 0; i < N_POINTS; i++) {
+        la += frand(-3e-6f, 3e-6f);
+        ln += frand(-4e-6f, 4e-6f);
+        lat[i] = la;
+        lng[i] = ln;
+    }
+
+    // one fence per test, as a linear scan would.
+    const int n_scan = 200;
+    Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < n_scan; i++) {
+        for (uint32_t f = 0; f < fences.size(); f++) sink += set.contains(f, lat[i], lng[i]);
+    }
+    double per = ns_per(t0, (long)n_scan * fences.size());
+    printf("contains        %7.1f ns/check, %5.1f M checks/s\n", per, 1e3 / per);
+
+    std::vector<uint32_t> bits((fences.size() + 31) / 32);
+    GeofenceTracker t(&set, bits.data());
+    t0 = Clock::now();
+    for (int i = 0; i < N_POINTS; i++) t.update(lat[i], lng[i]);
+    per = ns_per(t0, N_POINTS);
+    printf("tracker, track  %7.1f ns/fix vs. %zu fences, %5.1f M fixes/s\n",
+           per, fences.size(), 1e3 / per);
+
+    for (int i = 0; i < N_POINTS; i++) {
+        lat[i] = frand(0.60f, 0.75f);
+        lng[i] = frand(-0.10f, 0.10f);
+    }
+    t.reset();
+    t0 = Clock::now();
+    for (int i = 0; i < N_POINTS; i++) t.update(lat[i], lng[i]);
+    per = ns_per(t0, N_POINTS);
+    printf("tracker, random %7.1f ns/fix vs. %zu fences, %5.1f M fixes/s\n",
+           per, fences.size(), 1e3 / per);
+
+    // the tracker's answer for the last point is the brute force one.
+    for (uint32_t f = 0; f < fences.size(); f++) {
+        CHECK(t.isInside(f) == set.contains(f, lat[N_POINTS - 1], lng[N_POINTS - 1]));
+    }
+    return host_result("bench_geofence");
+}
@@ -0,0 +1,84 @@
+/*
+ * File:   bench_nmea.cpp
+ *
+ * Host timings of the NMEA helpers, and of whole sentences through
+ * `processOnePacket()`. `make bench` runs it; the numbers are for comparing
+ * changes on one machine, not for predicting an AVR's.
+ */
+
+#include <string.h>
+#include <chrono>
+#include <string>
+
+#include "host.h"
+#include "copernicus.h"
+#include "nmea.h"
+
+#define ROUNDS 200000
+
+static const char *sentences[] = {
+    "GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,",
+    "GPRMC,123519.00,A,4807.038,N,01131.000,E,022.4,084.4,181026,003.1,W",
+    "GPVTG,054.7,T,034.4,M,005.5,N,010.2,K,A",
+    "GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1",
+    "GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45",
+    "GPZDA,123519.00,18,10,2026,00,00",
+};
+#define N_SENTENCES (sizeof(sentences) / sizeof(sentences[0]))
+
+static volatile uint32_t sink;
+
+typedef std::chrono::steady_clock Clock;
+
+static double ns_per(Clock::time_point t0, long n) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+}
+
+int main() {
+    int lens[N_SENTENCES];
+    for (size_t i = 0; i < N_SENTENCES; i++) lens[i] = strlen(sentences[i]);
+
+    Clock::time_point t0 = Clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < N_SENTENCES; i++) sink += nmea_checksum(sentences[i], lens[i]);
+    }
+    printf("nmea_checksum   %7.1f ns/sentence\n", ns_per(t0, (long)ROUNDS * N_SENTENCES));
+
+    NMEAFields f;
+    t0 = Clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < N_SENTENCES; i++) {
+            nmea_split(sentences[i], lens[i], &f);
+            sink += f.n;
+        }
+    }
+    printf("nmea_split      %7.1f ns/sentence\n", ns_per(t0, (long)ROUNDS * N_SENTENCES));
+
+    // whole sentences, framed and decoded from the serial shim.
+    std::string stream;
+    for (size_t i = 0; i < N_SENTENCES; i++) {
+        char cksum[8];
+        snprintf(cksum, sizeof(cksum), "*%02X\r\n", nmea_checksum(sentences[i], lens[i]));
+        stream += std::string("$") + sentences[i] + cksum;
+    }
+    CopernicusGPS gps(0);
+    uint8_t frame[96];
+    gps.setPollBuffer(frame, sizeof(frame));
+    const int rounds = ROUNDS / 10;
+    long n = 0;
+    double total = 0;
+    for (int r = 0; r < rounds; r++) {
+        feed_bytes(Serial, stream.c_str());
+        t0 = Clock::now();
+        ReportType rpt;
+        while ((rpt = gps.processOnePacket(false)) != RPT_NONE) {
+            if (rpt == RPT_ERROR) host_failures++;
+            n++;
+        }
+        total += ns_per(t0, 1);
+    }
+    printf("process_nmea    %7.1f ns/sentence (processOnePacket, with framing)\n", total / n);
+    CHECK(n == (long)rounds * (long)N_SENTENCES);
+
+    return host_result("bench_nmea");
+}
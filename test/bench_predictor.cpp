@@ -0,0 +1,82 @@
+/*
+ * File:   bench_predictor.cpp
+ *
+ * Host timings of `FixPredictor::update()` and `predict()`. Built twice, in
+ * float and with PREDICTOR_FIXED_POINT (the AVR default); `make bench` runs
+ * both. The numbers are for comparing changes on one machine, not for
+ * predicting an AVR's.
+ */
+
+#include <chrono>
+
+#include "host.h"
+#include "predictor.h"
+
+#define N_FIXES  100000
+#define PREDICTS 10
+
+#if PREDICTOR_FIXED_POINT
+#define BUILD "fixed point"
+#else
+#define BUILD "float"
+#endif
+
+static volatile int32_t sink;
+
+typedef std::chrono::steady_clock Clock;
+
+static double ns_per(Clock::time_point t0, long n) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+}
+
+struct BenchPosFix : public PosFix {
+    void set(double lat, double lng, float time) {
+        type = RPT_FIX_POS_LLA_64;
+        lla_64.lat.d = lat;
+        lla_64.lng.d = lng;
+        lla_64.alt.d = 100;
+        lla_64.bias.d = 0;
+        lla_64.fixtime.f = time;
+    }
+};
+
+struct BenchVelFix : public VelFix {
+    void set(float e, float n, float time) {
+        type = RPT_FIX_VEL_ENU;
+        enu.e.f = e;
+        enu.n.f = n;
+        enu.u.f = 0;
+        enu.bias.f = 0;
+        enu.fixtime.f = time;
+    }
+};
+
+int main() {
+    // 30 m/s east-northeast, 1 Hz.
+    std::vector<BenchPosFix> pf(N_FIXES);
+    std::vector<BenchVelFix> vf(N_FIXES);
+    for (int i = 0; i < N_FIXES; i++) {
+        float t = 100000.0f + i;
+        pf[i].set(0.7 + i * 15 / 6.37e6, -1.3 + i * 26 / 4.87e6, t);
+        vf[i].set(26, 15, t);
+    }
+
+    FixPredictor pred;
+    Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < N_FIXES; i++) pred.update(pf[i], vf[i], 1000000u * i);
+    double upd = ns_per(t0, N_FIXES);
+
+    PredScalar out[3];
+    t0 = Clock::now();
+    for (int i = 0; i < N_FIXES; i++) {
+        for (int k = 0; k < PREDICTS; k++) {
+            pred.predict(1000000u * i + 100000u * k, out);
+            sink += (int32_t)out[0];
+        }
+    }
+    double prd = ns_per(t0, (long)N_FIXES * PREDICTS);
+
+    printf("predictor, %-11s  update %6.1f ns  predict %5.1f ns\n", BUILD, upd, prd);
+    CHECK(pred.isValid());
+    return host_result("bench_predictor (" BUILD ")");
+}
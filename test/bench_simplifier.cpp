@@ -0,0 +1,91 @@
+/*
+ * File:   bench_simplifier.cpp
+ *
+ * Host timings of `TrackSimplifier::update()` on a winding road, in each mode
+ * and in LLA and ECEF fixes, with the share of fixes kept. The numbers are
+ * for comparing changes on one machine, not for predicting an AVR's.
+ */
+
+#include <math.h>
+#include <chrono>
+
+#include "host.h"
+#include "simplifier.h"
+
+#define N_FIXES 100000
+
+typedef std::chrono::steady_clock Clock;
+
+static double ns_per(Clock::time_point t0, long n) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+}
+
+struct BenchPosFix : public PosFix {
+    void setLLA(double lat, double lng, float time) {
+        type = RPT_FIX_POS_LLA_64;
+        lla_64.lat.d = lat;
+        lla_64.lng.d = lng;
+        lla_64.alt.d = 100;
+        lla_64.bias.d = 0;
+        lla_64.fixtime.f = time;
+    }
+    void setXYZ(double lat, double lng, float time) {
+        // on a sphere; near enough to the ellipsoid for timing.
+        type = RPT_FIX_POS_XYZ_64;
+        xyz_64.x.d = 6371000 * cos(lat) * cos(lng);
+        xyz_64.y.d = 6371000 * cos(lat) * sin(lng);
+        xyz_64.z.d = 6371000 * sin(lat);
+        xyz_64.bias.d = 0;
+        xyz_64.fixtime.f = time;
+    }
+};
+
+struct BenchVelFix : public VelFix {
+    void set(float e, float n, float time) {
+        type = RPT_FIX_VEL_ENU;
+        enu.e.f = e;
+        enu.n.f = n;
+        enu.u.f = 0;
+        enu.bias.f = 0;
+        enu.fixtime.f = time;
+    }
+};
+
+static void run(const char *name, SimplifyMode mode,
+                const std::vector<BenchPosFix> &pf, const std::vector<BenchVelFix> &vf) {
+    TrackSimplifier simp(5.0f, mode);
+    Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < N_FIXES; i++) simp.update(pf[i], vf[i]);
+    double ns = ns_per(t0, N_FIXES);
+    simp.flush();
+    printf("simplifier, %-22s %6.1f ns/fix  %5.2f%% kept\n",
+           name, ns, 100.0 * simp.getOutputCount() / simp.getInputCount());
+    CHECK(simp.getInputCount() == N_FIXES);
+    CHECK(simp.getOutputCount() > 1 and simp.getOutputCount() < N_FIXES / 2);
+}
+
+int main() {
+    // 20 m/s heading northeast, weaving 50 m either side of the line every
+    // 2 km, 1 Hz.
+    std::vector<BenchPosFix> lla(N_FIXES), xyz(N_FIXES);
+    std::vector<BenchVelFix> vf(N_FIXES);
+    const double lat0 = 0.7, lng0 = -1.3, r = 6371000;
+    for (int i = 0; i < N_FIXES; i++) {
+        float  t = 100000.0f + i;
+        double s = 20.0 * i;
+        double w = 50 * sin(s * 2 * M_PI / 2000);
+        double dw = 50 * 2 * M_PI / 2000 * cos(s * 2 * M_PI / 2000) * 20;
+        double e = (s - w) / sqrt(2.0), n = (s + w) / sqrt(2.0);
+        double lat = lat0 + n / r;
+        double lng = lng0 + e / (r * cos(lat0));
+        lla[i].setLLA(lat, lng, t);
+        xyz[i].setXYZ(lat, lng, t);
+        vf[i].set((20 - dw) / sqrt(2.0), (20 + dw) / sqrt(2.0), t);
+    }
+
+    run("corridor, LLA",        SIMPLIFY_CORRIDOR,       lla, vf);
+    run("corridor, ECEF",       SIMPLIFY_CORRIDOR,       xyz, vf);
+    run("dead reckoning, LLA",  SIMPLIFY_DEAD_RECKONING, lla, vf);
+    run("dead reckoning, ECEF", SIMPLIFY_DEAD_RECKONING, xyz, vf);
+    return host_result("bench_simplifier");
+}
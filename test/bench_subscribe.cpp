@@ -0,0 +1,148 @@
+/*
+ * File:   bench_subscribe.cpp
+ *
+ * Bytes per second on the link, and host time spent per one-second epoch,
+ * before and after `subscribeReports()`. The receiver is modelled: each
+ * epoch it sends the reports its IO options (0x35) and broadcast mask
+ * (0x8E-A5) enable, which are read back from the commands the library
+ * sends. `make bench` runs it; the numbers are for comparing changes on one
+ * machine, not for predicting an AVR's.
+ */
+
+#include <chrono>
+
+#include "host.h"
+#include "copernicus.h"
+
+#define EPOCHS 20000
+#define BAUD   38400
+
+static volatile uint32_t sink;
+
+typedef std::chrono::steady_clock Clock;
+
+static double ns_per(Clock::time_point t0, long n) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+}
+
+struct Settings {
+    uint8_t  pos, vel;  // IO options, bytes 0 and 1
+    uint16_t mask;      // broadcast mask
+};
+
+static void packet(std::vector<uint8_t> *out, uint8_t id, uint8_t sub, size_t len) {
+    HardwareSerial port;
+    std::vector<uint8_t> pkt(len, 0);
+    pkt[0] = id;
+    if (sub) pkt[1] = sub;
+    if (id == 0x6D) {
+        pkt[1] = 0x04 | ((len - 18) << 4);       // 3-D, SVs in the fix
+        for (size_t i = 18; i < len; i++) pkt[i] = i - 17;
+    }
+    feed_tsip(port, pkt);
+    out->insert(out->end(), port.in.begin(), port.in.end());
+}
+
+// one epoch of reports from a receiver with the given settings.
+static std::vector<uint8_t> epoch(const Settings &s) {
+    std::vector<uint8_t> e;
+    if (s.mask & BCAST_AUTO_REPORTS) {
+        bool dbl = s.pos & 0x10;
+        if (s.pos & 0x01) packet(&e, dbl ? 0x83 : 0x42, 0, dbl ? 37 : 17);
+        if (s.pos & 0x02) packet(&e, dbl ? 0x84 : 0x4A, 0, dbl ? 37 : 21);
+        if (s.vel & 0x01) packet(&e, 0x43, 0, 21);
+        if (s.vel & 0x02) packet(&e, 0x56, 0, 21);
+        packet(&e, 0x41, 0, 11);
+        packet(&e, 0x46, 0, 3);
+        packet(&e, 0x4B, 0, 4);
+        packet(&e, 0x6D, 0, 18 + 8);
+        packet(&e, 0x82, 0, 2);
+    }
+    if (s.mask & BCAST_SPKT_FIX)          packet(&e, 0x8F, 0x20, 57);
+    if (s.mask & BCAST_SPKT_TIMING)       packet(&e, 0x8F, 0xAB, 18);
+    if (s.mask & BCAST_SPKT_TIMING_SUPPL) packet(&e, 0x8F, 0xAC, 69);
+    return e;
+}
+
+// apply the configuration commands written to the receiver to `s`.
+static void receive_commands(Settings *s) {
+    std::vector<uint8_t> &out = Serial.out;
+    std::vector<uint8_t> cur;
+    for (size_t i = 0; i + 1 < out.size(); i++) {
+        if (out[i] != 0x10) {
+            cur.push_back(out[i]);
+            continue;
+        }
+        uint8_t next = out[++i];
+        if (next == 0x10) {
+            cur.push_back(0x10);
+        } else if (next == 0x03) {
+            if (cur.size() == 5 and cur[0] == 0x35) {
+                s->pos = cur[1];
+                s->vel = cur[2];
+            } else if (cur.size() == 5 and cur[0] == 0x8E and cur[1] == 0xA5) {
+                s->mask = (cur[2] << 8) | cur[3];
+            }
+            cur.clear();
+        } else {
+            cur.assign(1, next);
+        }
+    }
+    out.clear();
+}
+
+// host time to process one epoch, in microseconds.
+static double cpu_per_epoch(CopernicusGPS &gps, const std::vector<uint8_t> &e) {
+    double total = 0;
+    const int batch = 1000;
+    for (int b = 0; b < EPOCHS / batch; b++) {
+        for (int i = 0; i < batch; i++) Serial.in.insert(Serial.in.end(), e.begin(), e.end());
+        Clock::time_point t0 = Clock::now();
+        ReportType rpt;
+        while ((rpt = gps.processOnePacket(false)) != RPT_NONE) {
+            if (rpt == RPT_ERROR) host_failures++;
+            sink += rpt;
+        }
+        total += ns_per(t0, batch);
+    }
+    return total / (EPOCHS / batch) / 1000;
+}
+
+static void run(const char *name, ReportSet reports, const Settings &initial) {
+    CopernicusGPS gps(0);
+    const std::vector<uint8_t> before = epoch(initial);
+    double cpu_before = cpu_per_epoch(gps, before);
+
+    // the receiver's replies to the queries of its settings.
+    std::vector<uint8_t> io = { 0x55, initial.pos, initial.vel, 0x00, 0x00 };
+    std::vector<uint8_t> mask = { 0x8F, 0xA5, (uint8_t)(initial.mask >> 8), (uint8_t)initial.mask, 0, 0 };
+    feed_tsip(Serial, io);
+    feed_tsip(Serial, mask);
+    CHECK(gps.subscribeReports(reports, false));
+    Settings now = initial;
+    receive_commands(&now);
+    const std::vector<uint8_t> after = epoch(now);
+
+    // as if the receiver ignored the commands: unsubscribed reports are
+    // still discarded without decoding.
+    double cpu_ignored = cpu_per_epoch(gps, before);
+    double cpu_after   = cpu_per_epoch(gps, after);
+
+    printf("%s\n", name);
+    printf("  before     %5zu B/s (%4.1f%% of %d baud)  %6.2f us/epoch\n",
+           before.size(), before.size() * 1000.0 / BAUD, BAUD, cpu_before);
+    printf("  unchanged  %5zu B/s                      %6.2f us/epoch (reports sent anyway)\n",
+           before.size(), cpu_ignored);
+    printf("  after      %5zu B/s (%4.1f%% of %d baud)  %6.2f us/epoch\n",
+           after.size(), after.size() * 1000.0 / BAUD, BAUD, cpu_after);
+    CHECK(after.size() < before.size());
+}
+
+int main() {
+    // LLA and ENU velocity, with auto-reports and the timing superpackets.
+    Settings initial = { 0x02, 0x02,
+        BCAST_AUTO_REPORTS | BCAST_SPKT_TIMING | BCAST_SPKT_TIMING_SUPPL };
+    run("navigation: LLA_32 | GPSTIME", RPTFLAG_FIX_POS_LLA_32 | RPTFLAG_GPSTIME, initial);
+    run("timing: SPKT_TIMING", RPTFLAG_SPKT_TIMING, initial);
+    return host_result("bench_subscribe");
+}
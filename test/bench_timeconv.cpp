@@ -0,0 +1,75 @@
+/*
+ * File:   bench_timeconv.cpp
+ *
+ * Host timings of GPS to UTC conversion, one time at a time and in columns.
+ * `make bench` runs it; the numbers are for comparing changes on one
+ * machine, not for predicting an AVR's.
+ */
+
+#include <chrono>
+
+#include "host.h"
+#include "timeconv.h"
+
+#define N      100000
+#define ROUNDS 50
+
+static volatile int64_t sink;
+
+typedef std::chrono::steady_clock Clock;
+
+static double ns_per(Clock::time_point t0, long n) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+}
+
+int main() {
+    // one fix a second, from the middle of a week, in 10-bit weeks.
+    std::vector<int16_t> week(N);
+    std::vector<Float32> tow(N);
+    std::vector<int64_t> out(N);
+    for (uint32_t i = 0; i < N; i++) {
+        uint32_t s = 300000 + i;
+        week[i]  = (int16_t)((2441 + s / GPS_WEEK_SECONDS) % 1024);
+        tow[i].f = (float)(s % GPS_WEEK_SECONDS);
+    }
+
+    Clock::time_point t0 = Clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (uint32_t i = 0; i < N; i++) {
+            sink += gps_to_unix_ns(resolve_week(week[i]), tow_to_ns(tow[i]));
+        }
+    }
+    printf("scalar          %7.2f ns/time\n", ns_per(t0, (long)ROUNDS * N));
+
+    GPSTime t;
+    t.utc_offs.f = 18;
+    t0 = Clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (uint32_t i = 0; i < N; i++) {
+            t.week_no      = week[i];
+            t.time_of_week = tow[i];
+            sink += gps_to_unix_ns(t);
+        }
+    }
+    printf("scalar GPSTime  %7.2f ns/time\n", ns_per(t0, (long)ROUNDS * N));
+
+    t0 = Clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        gps_to_unix_ns(week.data(), tow.data(), out.data(), N);
+        sink += out[N - 1];
+    }
+    printf("batch weeks     %7.2f ns/time\n", ns_per(t0, (long)ROUNDS * N));
+
+    t0 = Clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        gps_to_unix_ns(week[0], tow.data(), out.data(), N);
+        sink += out[N - 1];
+    }
+    printf("batch one week  %7.2f ns/time\n", ns_per(t0, (long)ROUNDS * N));
+
+    for (uint32_t i = 0; i < N; i++) {
+        CHECK(out[i] == gps_to_unix_ns(resolve_week(week[i]), tow_to_ns(tow[i])));
+        if (host_failures) break;
+    }
+    return host_result("bench_timeconv");
+}
@@ -0,0 +1,45 @@
+/*
+ * File:   host.cpp
+ */
+
+#include <chrono>
+
+#include "host.h"
+
+HardwareSerial Serial, Serial1;
+
+int host_failures = 0;
+
+static const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+unsigned long micros() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - t0).count();
+}
+
+unsigned long millis() {
+    return micros() / 1000;
+}
+
+void feed_tsip(HardwareSerial &port, const std::vector<uint8_t> &pkt) {
+    port.in.push_back(0x10);
+    for (size_t i = 0; i < pkt.size(); i++) {
+        port.in.push_back(pkt[i]);
+        if (pkt[i] == 0x10) port.in.push_back(0x10);
+    }
+    port.in.push_back(0x10);
+    port.in.push_back(0x03);
+}
+
+void feed_bytes(HardwareSerial &port, const char *bytes) {
+    while (*bytes) port.in.push_back((uint8_t)*bytes++);
+}
+
+int host_result(const char *test) {
+    if (host_failures == 0) {
+        printf("%s: ok\n", test);
+        return 0;
+    }
+    printf("%s: %d failure(s)\n", test, host_failures);
+    return 1;
+}
@@ -0,0 +1,36 @@
+/*
+ * File:   host.h
+ *
+ * Helpers shared by the host tests.
+ */
+
+#ifndef HOST_H
+#define	HOST_H
+
+#include <stdio.h>
+#include <vector>
+
+#include "Arduino.h"
+
+extern int host_failures;
+
+/// Record (and print) a failure if `cond` is false, and carry on.
+#define CHECK(cond) \
+    do { \
+        if (not (cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            host_failures++; \
+        } \
+    } while (0)
+
+/// Queue a TSIP packet (report ID and data) for the library to read, with
+/// its framing and escapes.
+void feed_tsip(HardwareSerial &port, const std::vector<uint8_t> &pkt);
+
+/// Queue raw bytes for the library to read.
+void feed_bytes(HardwareSerial &port, const char *bytes);
+
+/// Exit status for `main()`, after reporting the number of failures.
+int host_result(const char *test);
+
+#endif	/* HOST_H */
@@ -0,0 +1,124 @@
+/*
+ * File:   test_asyncgps.cpp
+ *
+ * Coroutines waiting on an AsyncGPS are resumed by the reports they wait
+ * for, as poll() processes them: by report ID, with NMEA sentences apart
+ * from the TSIP IDs, and for fixes from any source. Built as C++20.
+ */
+
+#include <exception>
+#include <string>
+
+#include "host.h"
+#include "asyncgps.h"
+#include "nmea.h"
+
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return Task(); }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// wait for each of `n` reports, recording them.
+static Task wait_report(AsyncGPS &agps, ReportType type, std::vector<ReportType> *got, int n=1) {
+    for (int i = 0; i < n; i++) got->push_back(co_await agps.nextReport(type));
+}
+
+static Task wait_fix(AsyncGPS &agps, std::vector<ReportType> *got, int n=1) {
+    for (int i = 0; i < n; i++) got->push_back(co_await agps.nextFix());
+}
+
+static void feed_nmea(const char *body) {
+    char cksum[8];
+    snprintf(cksum, sizeof(cksum), "*%02X\r\n", nmea_checksum(body, strlen(body)));
+    std::string s = std::string("$") + body + cksum;
+    feed_bytes(Serial, s.c_str());
+}
+
+// 0x4A, with the given fix time.
+static void feed_lla32(float fixtime) {
+    std::vector<uint8_t> pkt(1, 0x4A);
+    uint32_t bits;
+    memcpy(&bits, &fixtime, 4);
+    for (int i = 0; i < 16; i++) pkt.push_back(0);
+    for (int i = 0; i < 4; i++) pkt.push_back(bits >> (24 - 8 * i));
+    feed_tsip(Serial, pkt);
+}
+
+// 0x8F-AC, doing fixes.
+static void feed_timing_suppl() {
+    std::vector<uint8_t> pkt(2 + 67, 0);
+    pkt[0] = 0x8F;
+    pkt[1] = 0xAC;
+    feed_tsip(Serial, pkt);
+}
+
+// 0x8F-AB, at the given time of week.
+static void feed_timing(uint32_t tow) {
+    std::vector<uint8_t> pkt(2 + 16, 0);
+    pkt[0] = 0x8F;
+    pkt[1] = 0xAB;
+    for (int i = 0; i < 4; i++) pkt[2 + i] = tow >> (24 - 8 * i);
+    feed_tsip(Serial, pkt);
+}
+
+int main() {
+    CopernicusGPS gps(0);
+    uint8_t frame[96];
+    gps.setPollBuffer(frame, sizeof(frame));
+    AsyncGPS agps(&gps);
+
+    // by report ID: a GGA does not wake a waiter for TSIP ID 0x01, which
+    // shares its low byte.
+    std::vector<ReportType> tsip01, gga, any;
+    wait_report(agps, (ReportType)0x01, &tsip01);
+    wait_report(agps, RPT_NMEA_GGA, &gga);
+    wait_report(agps, RPT_NONE, &any);
+    CHECK(agps.getWaitingCount() == 3);
+    feed_nmea("GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+    CHECK(agps.poll() == 1);
+    CHECK(tsip01.empty());
+    CHECK(gga.size() == 1 and gga[0] == RPT_NMEA_GGA);
+    CHECK(any.size() == 1 and any[0] == RPT_NMEA_GGA);
+    std::vector<uint8_t> unknown = { 0x01, 0x00 };
+    feed_tsip(Serial, unknown);
+    agps.poll();
+    CHECK(tsip01.size() == 1 and tsip01[0] == 0x01);
+    CHECK(agps.getWaitingCount() == 0);
+
+    // fixes from TSIP, NMEA, and timing superpackets, one wake each.
+    std::vector<ReportType> fixes;
+    wait_fix(agps, &fixes, 4);
+    feed_lla32(100);
+    feed_nmea("GPGGA,123520,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+    feed_nmea("GPRMC,123521,A,4807.038,N,01131.000,E,022.4,084.4,181026,003.1,W");
+    feed_timing(200000);
+    feed_timing_suppl();
+    agps.poll();
+    CHECK(fixes.size() == 4);
+    if (fixes.size() == 4) {
+        CHECK(fixes[0] == RPT_FIX_POS_LLA_32);
+        CHECK(fixes[1] == RPT_NMEA_GGA);
+        CHECK(fixes[2] == RPT_NMEA_RMC);
+        CHECK(fixes[3] == RPT_SUPERPACKET);
+    }
+
+    // reports which leave the fix alone don't wake fix waiters.
+    fixes.clear();
+    wait_fix(agps, &fixes);
+    feed_timing(200001);
+    feed_nmea("GPVTG,054.7,T,034.4,M,005.5,N,010.2,K,A");
+    agps.poll();
+    CHECK(fixes.empty());
+
+    // cancelled waits finish with RPT_NONE.
+    agps.cancelAll();
+    CHECK(fixes.size() == 1 and fixes[0] == RPT_NONE);
+    CHECK(agps.getWaitingCount() == 0);
+
+    return host_result("asyncgps");
+}
@@ -0,0 +1,122 @@
+/*
+ * File:   test_config.cpp
+ *
+ * The shadow copies of the receiver's IO options (0x35/0x55) and broadcast
+ * mask (0x8E-A5/0x8F-A5): settings are queried once, a group is sent only
+ * if it has changed, changes made between beginConfig() and commitConfig()
+ * are sent as one command per group, and a lost reply fails after
+ * CPN_CONFIG_TIMEOUT_MS instead of hanging.
+ */
+
+#include "host.h"
+#include "copernicus.h"
+
+// the TSIP packets written to the receiver since the last call, unstuffed.
+static std::vector<std::vector<uint8_t> > sent_packets() {
+    std::vector<std::vector<uint8_t> > pkts;
+    std::vector<uint8_t> &out = Serial.out;
+    std::vector<uint8_t> cur;
+    bool in_pkt = false;
+    for (size_t i = 0; i < out.size(); i++) {
+        if (out[i] != 0x10) {
+            if (in_pkt) cur.push_back(out[i]);
+            continue;
+        }
+        uint8_t next = (i + 1 < out.size()) ? out[i + 1] : 0;
+        i++;
+        if (next == 0x10) {
+            cur.push_back(0x10);
+        } else if (next == 0x03) {
+            pkts.push_back(cur);
+            in_pkt = false;
+        } else {
+            cur.assign(1, next);
+            in_pkt = true;
+        }
+    }
+    out.clear();
+    return pkts;
+}
+
+static int count_id(const std::vector<std::vector<uint8_t> > &pkts, uint8_t id) {
+    int n = 0;
+    for (size_t i = 0; i < pkts.size(); i++) n += pkts[i][0] == id;
+    return n;
+}
+
+static void feed_io_settings(uint8_t pos, uint8_t vel) {
+    std::vector<uint8_t> pkt = { 0x55, pos, vel, 0x00, 0x00 };
+    feed_tsip(Serial, pkt);
+}
+
+static void feed_bcast_mask(uint16_t mask) {
+    std::vector<uint8_t> pkt = { 0x8F, 0xA5, (uint8_t)(mask >> 8), (uint8_t)mask, 0, 0 };
+    feed_tsip(Serial, pkt);
+}
+
+int main() {
+    CopernicusGPS gps(0);
+
+    // the first subscription reads both groups of settings, with an
+    // unrelated report in the way of each reply.
+    std::vector<uint8_t> health = { 0x46, 0x00, 0x00 };
+    feed_tsip(Serial, health);
+    feed_io_settings(0x02, 0x02);
+    feed_tsip(Serial, health);
+    feed_bcast_mask(BCAST_AUTO_REPORTS);
+    CHECK(gps.subscribeReports(RPTFLAG_FIX_POS_LLA_32 | RPTFLAG_GPSTIME));
+    std::vector<std::vector<uint8_t> > pkts = sent_packets();
+    // a query of each; a command only for the IO options, since the
+    // broadcast mask already has the auto-reports on.
+    CHECK(count_id(pkts, 0x35) == 2);
+    CHECK(count_id(pkts, 0x8E) == 1);
+    CHECK(Serial.in.empty());
+
+    // cached: no more queries, only the command.
+    CHECK(gps.subscribeReports(RPTFLAG_FIX_POS_LLA_64 | RPTFLAG_GPSTIME));
+    pkts = sent_packets();
+    CHECK(count_id(pkts, 0x35) == 1 and pkts.size() == 1);
+    CHECK(pkts.size() == 1 and pkts[0].size() == 5 and pkts[0][1] == 0x12);
+    CHECK(gps.getSubscribedReports() == (RPTFLAG_FIX_POS_LLA_64 | RPTFLAG_GPSTIME));
+
+    // coalesced: several changes, one command per group.
+    gps.beginConfig();
+    CHECK(gps.setFixMode(RPT_FIX_POS_LLA_32, RPT_FIX_VEL_ENU, ALT_NOCHANGE));
+    CHECK(gps.setFixMode(RPT_FIX_POS_XYZ_32, RPT_NONE, ALT_NOCHANGE));
+    CHECK(gps.subscribeReports(RPTFLAG_FIX_POS_LLA_32 | RPTFLAG_SPKT_FIX));
+    CHECK(sent_packets().empty());
+    CHECK(gps.commitConfig());
+    pkts = sent_packets();
+    CHECK(pkts.size() == 2);
+    CHECK(count_id(pkts, 0x35) == 1 and count_id(pkts, 0x8E) == 1);
+    // nothing changed: nothing sent.
+    CHECK(gps.commitConfig());
+    CHECK(sent_packets().empty());
+
+    // the echo replaces the shadow copy...
+    gps.beginConfig();
+    CHECK(gps.setFixMode(RPT_FIX_POS_LLA_64, RPT_NONE, ALT_NOCHANGE));
+    feed_io_settings(0x02, 0x00);
+    CHECK(gps.commitConfig(true));
+    CHECK(gps.getSubscribedReports() & RPTFLAG_FIX_POS_LLA_32);
+    sent_packets();
+
+    // ...and a lost one fails, after the timeout.
+    gps.beginConfig();
+    CHECK(gps.setFixMode(RPT_FIX_POS_XYZ_64, RPT_NONE, ALT_NOCHANGE));
+    unsigned long t0 = millis();
+    CHECK(not gps.commitConfig(true));
+    unsigned long waited = millis() - t0;
+    CHECK(waited >= CPN_CONFIG_TIMEOUT_MS and waited < CPN_CONFIG_TIMEOUT_MS + 1000);
+
+    // likewise a lost reply to the query of a forgotten shadow copy.
+    gps.invalidateConfig();
+    sent_packets();
+    t0 = millis();
+    CHECK(not gps.subscribeReports(RPTFLAG_GPSTIME));
+    waited = millis() - t0;
+    CHECK(waited >= CPN_CONFIG_TIMEOUT_MS and waited < CPN_CONFIG_TIMEOUT_MS + 1000);
+    CHECK(count_id(sent_packets(), 0x35) == 1);
+
+    return host_result("config");
+}
@@ -0,0 +1,214 @@
+/*
+ * File:   test_fixlog.cpp
+ *
+ * Fix blocks read back bit for bit, one fix at a time and as columns, for
+ * each fix type and across sign and exponent changes; a truncated block
+ * yields only the fixes it wholly holds; a full block refuses more fixes.
+ */
+
+#include <string.h>
+
+#include "host.h"
+#include "fixlog.h"
+
+struct TestPosFix : public PosFix {
+    // fill the fields from a run of bits, whatever the type.
+    void set(ReportType t, const uint64_t v[4], uint32_t time) {
+        type = t;
+        uint8_t *rec = reinterpret_cast<uint8_t*>(words);
+        bool dbl = t == RPT_FIX_POS_LLA_64 or t == RPT_FIX_POS_XYZ_64;
+        for (int i = 0; i < 4; i++) {
+            if (dbl) memcpy(rec + 8 * i, &v[i], 8);
+            else {
+                uint32_t v32 = (uint32_t)v[i];
+                memcpy(rec + 4 * i, &v32, 4);
+            }
+        }
+        memcpy(rec + (dbl ? 32 : 16), &time, 4);
+    }
+};
+
+struct TestVelFix : public VelFix {
+    void set(ReportType t, const uint64_t v[4], uint32_t time) {
+        type = t;
+        for (int i = 0; i < 4; i++) words[i].bits = (uint32_t)v[i];
+        words[4].bits = time;
+    }
+};
+
+static bool same(const PosFix &a, const PosFix &b) {
+    if (a.type != b.type or a.getFixTime().bits != b.getFixTime().bits) return false;
+    switch (a.type) {
+        case RPT_FIX_POS_LLA_32: return memcmp(a.getLLA_32(), b.getLLA_32(), sizeof(LLA_Fix<Float32>)) == 0;
+        case RPT_FIX_POS_LLA_64: return memcmp(a.getLLA_64(), b.getLLA_64(), sizeof(LLA_Fix<Float64>)) == 0;
+        case RPT_FIX_POS_XYZ_32: return memcmp(a.getXYZ_32(), b.getXYZ_32(), sizeof(XYZ_Fix<Float32>)) == 0;
+        case RPT_FIX_POS_XYZ_64: return memcmp(a.getXYZ_64(), b.getXYZ_64(), sizeof(XYZ_Fix<Float64>)) == 0;
+        default: return false;
+    }
+}
+
+static uint64_t lcg(uint64_t *s) {
+    *s = *s * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *s;
+}
+
+// fixes which drift, step, change sign and exponent, and repeat; and time
+// which mostly advances by one second.
+static void fields(int i, bool dbl, uint64_t *seed, uint64_t v[4], uint32_t *time) {
+    double x[4] = {
+        0.7 + i * 1e-6,                   // slow drift
+        -1e-4 + i * 3e-7,                 // through zero
+        (i % 50 < 25) ? 1.5 : 3.0 + i,    // exponent changes
+        (double)(lcg(seed) >> 40),        // noise
+    };
+    for (int k = 0; k < 4; k++) {
+        if (dbl) memcpy(&v[k], &x[k], 8);
+        else {
+            float f = (float)x[k];
+            uint32_t b;
+            memcpy(&b, &f, 4);
+            v[k] = b;
+        }
+    }
+    if (i % 97 == 5) v[0] = dbl ? 0x7FF8000000000001ULL : 0x7FC00001; // a NaN
+    float t = 302400.0f + i + ((i % 40 == 7) ? 0.5f : 0.0f);
+    memcpy(time, &t, 4);
+}
+
+static void test_pos(ReportType type) {
+    const bool dbl = type == RPT_FIX_POS_LLA_64 or type == RPT_FIX_POS_XYZ_64;
+    const int n = 300;
+    std::vector<TestPosFix> in(n);
+    uint64_t seed = type;
+    for (int i = 0; i < n; i++) {
+        uint64_t v[4];
+        uint32_t t;
+        fields(i, dbl, &seed, v, &t);
+        in[i].set(type, v, t);
+    }
+    uint8_t block[16384];
+    FixLogWriter w;
+    w.begin(block, sizeof(block), type);
+    for (int i = 0; i < n; i++) CHECK(w.append(in[i]));
+    CHECK(w.getCount() == n);
+
+    // one at a time.
+    FixLogReader r;
+    CHECK(r.begin(block, w.size()));
+    CHECK(r.getType() == type and r.getCount() == n);
+    int bad = 0;
+    PosFix out;
+    for (int i = 0; i < n; i++) {
+        if (not r.next(&out) or not same(out, in[i])) bad++;
+    }
+    CHECK(bad == 0);
+    CHECK(not r.next(&out) and r.getRemaining() == 0);
+    VelFix vout;
+    CHECK(not r.next(&vout));
+
+    // as columns, of the block's width only.
+    std::vector<Float32> t(n), a32(n), d32(n);
+    std::vector<Float64> a64(n), d64(n);
+    r.begin(block, w.size());
+    CHECK((dbl ? r.readColumns(&t[0], &a32[0], NULL, NULL, &d32[0], n) : 
+                 r.readColumns(&t[0], &a64[0], NULL, NULL, &d64[0], n)) == 0);
+    uint16_t got = dbl ? r.readColumns(&t[0], &a64[0], NULL, NULL, &d64[0], n)
+                       : r.readColumns(&t[0], &a32[0], NULL, NULL, &d32[0], n);
+    CHECK(got == n);
+    bad = 0;
+    for (int i = 0; i < got; i++) {
+        const uint8_t *rec = reinterpret_cast<const uint8_t*>(dbl ?
+            (const void*)in[i].getLLA_64() : (const void*)in[i].getLLA_32());
+        if (type == RPT_FIX_POS_XYZ_32 or type == RPT_FIX_POS_XYZ_64) {
+            rec = reinterpret_cast<const uint8_t*>(dbl ?
+                (const void*)in[i].getXYZ_64() : (const void*)in[i].getXYZ_32());
+        }
+        bool ok = t[i].bits == in[i].getFixTime().bits;
+        if (dbl) ok = ok and memcmp(rec, &a64[i], 8) == 0 and memcmp(rec + 24, &d64[i], 8) == 0;
+        else     ok = ok and memcmp(rec, &a32[i], 4) == 0 and memcmp(rec + 12, &d32[i], 4) == 0;
+        if (not ok) bad++;
+    }
+    CHECK(bad == 0);
+
+    // truncated anywhere, the fixes read are a correct prefix; a block
+    // holding all but the end of the last fix loses only that fix.
+    bad = 0;
+    for (uint16_t len = 0; len < w.size(); len++) {
+        if (not r.begin(block, len)) {
+            if (len >= FIXLOG_HEADER_SIZE) bad++;
+            continue;
+        }
+        int k = 0;
+        while (r.next(&out)) {
+            if (k >= n or not same(out, in[k])) bad++;
+            k++;
+        }
+        if (r.getCount() != k or (len == w.size() - 1 and k != n - 1)) bad++;
+    }
+    CHECK(bad == 0);
+}
+
+static void test_vel(ReportType type) {
+    const int n = 100;
+    std::vector<TestVelFix> in(n);
+    uint64_t seed = type;
+    for (int i = 0; i < n; i++) {
+        uint64_t v[4];
+        uint32_t t;
+        fields(i, false, &seed, v, &t);
+        in[i].set(type, v, t);
+    }
+    uint8_t block[4096];
+    FixLogWriter w;
+    w.begin(block, sizeof(block), type);
+    for (int i = 0; i < n; i++) CHECK(w.append(in[i]));
+    PosFix pfix;
+    CHECK(not w.append(pfix));
+
+    FixLogReader r;
+    CHECK(r.begin(block, w.size()));
+    VelFix out;
+    int bad = 0;
+    for (int i = 0; i < n; i++) {
+        if (not r.next(&out) or out.type != type or
+                memcmp(&out, &in[i], sizeof(VelFix)) != 0) bad++;
+    }
+    CHECK(bad == 0);
+    CHECK(not r.next(&pfix));
+}
+
+static void test_full() {
+    uint8_t block[128];
+    FixLogWriter w;
+    w.begin(block, sizeof(block), RPT_FIX_POS_LLA_32);
+    TestPosFix f;
+    uint64_t seed = 1;
+    int n = 0;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t v[4];
+        uint32_t t;
+        fields(i, false, &seed, v, &t);
+        f.set(RPT_FIX_POS_LLA_32, v, t);
+        if (not w.append(f)) break;
+        n++;
+    }
+    CHECK(n > 2 and n < 1000);
+    CHECK(w.size() <= sizeof(block) and w.getCount() == n);
+    FixLogReader r;
+    CHECK(r.begin(block, w.size()) and r.getCount() == n);
+
+    // blocks of another version are not read.
+    block[1]++;
+    CHECK(not r.begin(block, w.size()));
+}
+
+int main() {
+    test_pos(RPT_FIX_POS_LLA_32);
+    test_pos(RPT_FIX_POS_LLA_64);
+    test_pos(RPT_FIX_POS_XYZ_32);
+    test_pos(RPT_FIX_POS_XYZ_64);
+    test_vel(RPT_FIX_VEL_ENU);
+    test_vel(RPT_FIX_VEL_XYZ);
+    test_full();
+    return host_result("fixlog");
+}
@@ -0,0 +1,119 @@
+/*
+ * File:   test_fixstore.cpp
+ *
+ * A fix from far before or after the segment being filled is refused, so
+ * that one corrupt time cannot discard history. A jump ahead is believed
+ * only after `STORE_JUMP_CONFIRM` fixes in a row bear it out.
+ */
+
+#include <vector>
+
+#include "host.h"
+#include "fixstore.h"
+
+#define ROWS   1024
+#define HOUR   3600000LL
+#define DAY    86400000LL
+#define WEEK   604800000LL
+
+struct TestPosFix : public PosFix {
+    void set(int64_t tow_ms) {
+        type = RPT_FIX_POS_LLA_32;
+        lla_32.lat.f = 0.7f;
+        lla_32.lng.f = -1.3f;
+        lla_32.alt.f = 100;
+        lla_32.bias.f = 0;
+        lla_32.fixtime.f = tow_ms / 1000.0f;
+    }
+};
+
+// add a fix at `ms` past the start of week 2000 (or into the next weeks).
+static bool add_at(FixStore &store, int64_t ms) {
+    TestPosFix f;
+    f.set(ms % WEEK);
+    return store.add(7, 2000 + ms / WEEK, f);
+}
+
+static void count_row(void *ctx, const StoreRow &) {
+    ++*static_cast<int*>(ctx);
+}
+
+static uint32_t rows_between(const FixStore &store, int64_t t0, int64_t t1) {
+    StoreQuery q;
+    q.t0 = 2000 * WEEK + t0;
+    q.t1 = 2000 * WEEK + t1;
+    q.lat_min = q.lng_min = -0x7FFFFFFF;
+    q.lat_max = q.lng_max =  0x7FFFFFFF;
+    int n = 0;
+    uint32_t found = store.query(q, count_row, &n);
+    CHECK((int)found == n);
+    return found;
+}
+
+int main() {
+    std::vector<uint64_t> mem(FixStore::bytesNeeded(4, ROWS) / 8 + 1);
+    FixStore store(&mem[0], mem.size() * 8, ROWS);
+    CHECK(store.getSegmentLimit() == 4);
+
+    const int64_t t = 3 * DAY + 10 * HOUR; // a partition boundary
+    CHECK(add_at(store, t));
+    CHECK(add_at(store, t + 1000));
+    CHECK(store.getSegmentCount() == 1);
+
+    // late fixes are kept with the active segment, but not ones from long
+    // before it.
+    CHECK(add_at(store, t - 5 * HOUR));
+    CHECK(add_at(store, t - DAY));
+    CHECK(not add_at(store, t - DAY - 1000));
+    CHECK(not add_at(store, t - 2 * WEEK));
+    CHECK(store.getSegmentCount() == 1);
+    CHECK(store.getRowCount() == 4);
+
+    // the next partitions begin new segments.
+    CHECK(add_at(store, t + HOUR));
+    CHECK(add_at(store, t + 2 * HOUR + 500));
+    CHECK(store.getSegmentCount() == 3);
+    const int64_t now = t + 2 * HOUR + 500;
+
+    // one corrupt time, a week ahead, is refused, and time carries on.
+    CHECK(not add_at(store, now + WEEK));
+    CHECK(add_at(store, now + 1000));
+    CHECK(store.getSegmentCount() == 3);
+
+    // a run of jumped fixes one short of confirming, broken by a good one,
+    // starts over.
+    for (int i = 0; i < STORE_JUMP_CONFIRM - 1; i++) {
+        CHECK(not add_at(store, now + WEEK + i * 1000));
+    }
+    CHECK(add_at(store, now + 2000));
+    CHECK(not add_at(store, now + WEEK + 20000));
+    CHECK(store.getSegmentCount() == 3);
+
+    // jumped fixes which disagree with each other don't confirm a jump.
+    for (int i = 0; i < 3 * STORE_JUMP_CONFIRM; i++) {
+        CHECK(not add_at(store, now + ((i % 2) ? 3 * WEEK : WEEK) + i * 1000));
+    }
+    CHECK(add_at(store, now + 3000));
+    CHECK(store.getRowCount() == 9);
+
+    // a run of close fixes confirms it; only the last of them is stored,
+    // and it begins a segment without discarding one.
+    const int64_t later = now + 2 * WEEK;
+    for (int i = 0; i < STORE_JUMP_CONFIRM - 1; i++) {
+        CHECK(not add_at(store, later + i * 1000));
+    }
+    CHECK(add_at(store, later + STORE_JUMP_CONFIRM * 1000));
+    CHECK(store.getSegmentCount() == 4);
+    CHECK(store.getRowCount() == 10);
+    CHECK(rows_between(store, later, later + HOUR) == 1);
+
+    // time carries on from there; the old times are now too early.
+    CHECK(add_at(store, later + HOUR));
+    CHECK(store.getSegmentCount() == 4); // the oldest was discarded
+    CHECK(not add_at(store, now + 4000));
+    CHECK(rows_between(store, t - DAY, t + 3 * HOUR) == 5);
+    CHECK(rows_between(store, later, later + 2 * HOUR) == 2);
+    CHECK(store.getRowCount() == 7);
+
+    return host_result("fixstore");
+}
@@ -0,0 +1,126 @@
+/*
+ * File:   test_geofence.cpp
+ *
+ * A tracker following random walks agrees, fix by fix, with testing every
+ * fence by brute force, including circles across the antimeridian, and
+ * sends an event for each change.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "geofence.h"
+
+#define PI_F 3.14159265f
+
+class Counter : public GeofenceListener {
+public:
+    Counter(): events(0) {}
+    void fenceEvent(GeofenceID, GeofenceEvent) { events++; }
+    int events;
+};
+
+static float frand(float lo, float hi) {
+    return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+static float wrap(float a) {
+    if      (a >  PI_F) a -= 2 * PI_F;
+    else if (a < -PI_F) a += 2 * PI_F;
+    return a;
+}
+
+// a 20 km circle just east of the antimeridian contains a point just west
+// of it, and the tracker agrees.
+static void test_antimeridian() {
+    Geofence f;
+    f.shape  = FENCE_CIRCLE;
+    f.lat    = 0.5f;
+    f.lng    = 3.1414f;
+    f.radius = 20000;
+    GeofenceSet set(&f, 1, 0, 0);
+    uint32_t       offsets[16 * 8 + 1];
+    GeofenceID     entries[64];
+    CHECK(set.indexSize(16, 8) <= 64);
+    CHECK(set.buildIndex(16, 8, offsets, entries, 64));
+    CHECK(set.contains(0, 0.5f, -3.1414f));
+
+    uint32_t bits[1];
+    GeofenceTracker t(&set, bits);
+    t.update(0.5f, -3.1414f);
+    CHECK(t.isInside(0));
+    t.update(0.5f, 3.1414f);
+    CHECK(t.isInside(0));
+    t.update(0.5f, -3.1f);
+    CHECK(not t.isInside(0));
+}
+
+// random fences, with many circles about the antimeridian, and random walks
+// through them.
+static void test_brute_force() {
+    const int n_circles = 300, n_polys = 100, poly_n = 6;
+    std::vector<Geofence>       fences;
+    std::vector<GeofenceVertex> verts;
+    srand(31);
+    for (int i = 0; i < n_circles; i++) {
+        Geofence f;
+        f.shape  = FENCE_CIRCLE;
+        f.lat    = frand(-1.2f, 1.2f);
+        f.lng    = (i % 3 == 0) ? wrap(PI_F + frand(-0.05f, 0.05f)) : frand(-PI_F, PI_F);
+        f.radius = frand(1000, 200000);
+        f.first_vertex = f.n_vertices = 0;
+        fences.push_back(f);
+    }
+    for (int i = 0; i < n_polys; i++) {
+        Geofence f;
+        f.shape = FENCE_POLYGON;
+        f.lat = f.lng = f.radius = 0;
+        f.first_vertex = verts.size();
+        f.n_vertices   = poly_n;
+        float lat = frand(-1.2f, 1.2f), lng = frand(-3.0f, 3.0f), r = frand(0.001f, 0.05f);
+        for (int k = 0; k < poly_n; k++) {
+            float a = 2 * PI_F * k / poly_n;
+            GeofenceVertex v = { lat + r * sinf(a) * frand(0.5f, 1), lng + r * cosf(a) * frand(0.5f, 1) };
+            verts.push_back(v);
+        }
+        fences.push_back(f);
+    }
+    GeofenceSet set(fences.data(), fences.size(), verts.data(), verts.size());
+    const uint16_t cols = 64, rows = 32;
+    std::vector<uint32_t>   offsets(cols * rows + 1);
+    std::vector<GeofenceID> entries(set.indexSize(cols, rows));
+    CHECK(set.buildIndex(cols, rows, offsets.data(), entries.data(), entries.size()));
+
+    std::vector<uint32_t> bits((fences.size() + 31) / 32);
+    Counter counter;
+    GeofenceTracker t(&set, bits.data(), &counter);
+    int mismatches = 0, insides = 0, changes = 0;
+    std::vector<bool> prev(fences.size(), false);
+    for (int walk = 0; walk < 40; walk++) {
+        // half the walks start near the antimeridian.
+        float lat = frand(-1.2f, 1.2f);
+        float lng = (walk % 2) ? wrap(PI_F + frand(-0.03f, 0.03f)) : frand(-PI_F, PI_F);
+        for (int step = 0; step < 2000; step++) {
+            lat += frand(-2e-4f, 2e-4f);
+            lng  = wrap(lng + frand(-4e-4f, 4e-4f));
+            t.update(lat, lng);
+            for (uint32_t i = 0; i < fences.size(); i++) {
+                bool in = set.contains(i, lat, lng);
+                if (in != t.isInside(i)) mismatches++;
+                if (in) insides++;
+                if (t.isInside(i) != prev[i]) changes++;
+                prev[i] = t.isInside(i);
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(insides > 1000);  // the walks do visit fences
+    CHECK(counter.events == changes);
+}
+
+int main() {
+    test_antimeridian();
+    test_brute_force();
+    return host_result("geofence");
+}
@@ -0,0 +1,232 @@
+/*
+ * File:   test_ntpshm.cpp
+ *
+ * Samples published by NTPShmClock, as read back by a reader following
+ * ntpd's refclock_shm.c: their times, and their leap and sync flags. Also
+ * built against a library without status reports (`CPN_ENABLE_STATUS` 0),
+ * where the sync flag follows the validity of the position fix.
+ */
+
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "host.h"
+#include "nmea.h"
+#include "ntpshm.h"
+#include "timeconv.h"
+
+// units well clear of those a daemon on this host might use.
+#define UNIT_SERIAL 14
+#define UNIT_PPS    15
+
+static void put_be32(std::vector<uint8_t> &pkt, uint32_t x) {
+    for (int i = 0; i < 4; i++) pkt.push_back(x >> (24 - 8 * i));
+}
+
+static void put_be32f(std::vector<uint8_t> &pkt, float f) {
+    uint32_t x;
+    memcpy(&x, &f, 4);
+    put_be32(pkt, x);
+}
+
+// 0x41, for the GPS time `unix_ns`.
+static void feed_gpstime(int64_t unix_ns) {
+    int32_t week;
+    int64_t tow_ns;
+    unix_ns_to_gps(unix_ns, &week, &tow_ns);
+    std::vector<uint8_t> pkt(1, 0x41);
+    put_be32f(pkt, tow_ns / NS_PER_SECOND);
+    pkt.push_back(week >> 8);
+    pkt.push_back(week & 0xFF);
+    put_be32f(pkt, 18);
+    feed_tsip(Serial, pkt);
+}
+
+// 0x46, with a 0x4A fix which is valid if the health is doing fixes.
+static void feed_health(GPSHealth health) {
+    std::vector<uint8_t> pkt = { 0x46, (uint8_t)health, 0x00 };
+    feed_tsip(Serial, pkt);
+    pkt.assign(1, 0x4A);
+    for (int i = 0; i < 4; i++) put_be32f(pkt, 0);
+    put_be32f(pkt, (health == HLTH_DOING_FIXES) ? 3600 : -1);
+    feed_tsip(Serial, pkt);
+}
+
+// 0x8F-AC, doing fixes, with the given minor alarms.
+static void feed_timing_suppl(uint16_t minor_alarms) {
+    std::vector<uint8_t> pkt(2 + 67, 0);
+    pkt[0] = 0x8F;
+    pkt[1] = 0xAC;
+    pkt[2 + 9]  = minor_alarms >> 8;
+    pkt[2 + 10] = minor_alarms & 0xFF;
+    pkt[2 + 11] = HLTH_DOING_FIXES;
+    feed_tsip(Serial, pkt);
+}
+
+static void drain(CopernicusGPS &gps) {
+    while (gps.processOnePacket(false) != RPT_NONE) {}
+}
+
+static NTPShmTime* attach(int unit) {
+    int id = shmget(NTPSHM_KEY + unit, sizeof(NTPShmTime), 0);
+    if (id < 0) return NULL;
+    void *p = shmat(id, NULL, 0);
+    return (p == (void*)-1) ? NULL : static_cast<NTPShmTime*>(p);
+}
+
+static void remove(int unit) {
+    int id = shmget(NTPSHM_KEY + unit, 0, 0);
+    if (id >= 0) shmctl(id, IPC_RMID, NULL);
+}
+
+// read a sample as ntpd does in mode 1: discard it if `count` changed
+// while reading, and clear `valid` once it is taken.
+static bool read_sample(NTPShmTime *shm, NTPShmTime *out) {
+    int count = shm->count;
+    if (not shm->valid) return false;
+    __sync_synchronize();
+    *out = *shm;
+    __sync_synchronize();
+    if (count != shm->count) return false;
+    shm->valid = 0;
+    return true;
+}
+
+static int64_t clock_ns(const NTPShmTime &s) {
+    return (int64_t)s.clock_sec * NS_PER_SECOND + s.clock_nsec;
+}
+
+static int64_t receive_ns(const NTPShmTime &s) {
+    return (int64_t)s.receive_sec * NS_PER_SECOND + s.receive_nsec;
+}
+
+static struct timespec to_timespec(int64_t ns) {
+    struct timespec ts;
+    ts.tv_sec  = ns / NS_PER_SECOND;
+    ts.tv_nsec = ns % NS_PER_SECOND;
+    return ts;
+}
+
+static void test_serial(CopernicusGPS &gps, NTPShmClock &clk, NTPShmTime *shm) {
+    int64_t t  = (int64_t)days_from_civil(2026, 10, 18) * 86400 * NS_PER_SECOND;
+    int64_t rx = t + 120 * 1000000LL;
+    NTPShmTime s;
+
+    // the receiver has not said it is doing fixes, nor sent a fix.
+    feed_gpstime(t);
+    drain(gps);
+    struct timespec ts = to_timespec(rx);
+    CHECK(clk.timeReceived(&ts));
+    CHECK(read_sample(shm, &s));
+    CHECK(s.leap == NTP_LEAP_NOTINSYNC);
+    CHECK(not read_sample(shm, &s)); // taken
+
+    feed_health(HLTH_DOING_FIXES);
+    feed_gpstime(t + NS_PER_SECOND);
+    drain(gps);
+    ts = to_timespec(rx + NS_PER_SECOND);
+    CHECK(clk.timeReceived(&ts));
+    CHECK(read_sample(shm, &s));
+    CHECK(s.leap == NTP_LEAP_NONE);
+    CHECK(clock_ns(s) == t + NS_PER_SECOND);
+    CHECK(receive_ns(s) == rx + NS_PER_SECOND);
+    CHECK(s.clock_usec == 0 and s.receive_usec == 120000);
+    CHECK(s.precision == NTPSHM_PRECISION_SERIAL);
+
+    // a pending leap second is not announced before its day...
+    feed_timing_suppl(0x0080);
+    feed_gpstime(t + 2 * NS_PER_SECOND);
+    drain(gps);
+    CHECK(gps.getStatus().leap_pending);
+    CHECK(clk.timeReceived(&ts));
+    CHECK(read_sample(shm, &s) and s.leap == NTP_LEAP_NONE);
+
+    // ...but is on it, unless overridden.
+    int64_t dec31 = (int64_t)days_from_civil(2026, 12, 31) * 86400 * NS_PER_SECOND;
+    feed_gpstime(dec31);
+    drain(gps);
+    CHECK(clk.timeReceived(&ts));
+    CHECK(read_sample(shm, &s) and s.leap == NTP_LEAP_INSERT);
+    clk.setLeapWarning(NTP_LEAP_DELETE);
+    CHECK(clk.timeReceived(&ts));
+    CHECK(read_sample(shm, &s) and s.leap == NTP_LEAP_DELETE);
+    clk.setLeapWarning(NTP_LEAP_NONE);
+
+    // a health report other than doing fixes (or an invalid fix)
+    // unsynchronizes the samples.
+    feed_health(HLTH_SATELLITES_NONE);
+    drain(gps);
+    CHECK(clk.timeReceived(&ts));
+    CHECK(read_sample(shm, &s) and s.leap == NTP_LEAP_NOTINSYNC);
+    feed_timing_suppl(0);
+    drain(gps);
+}
+
+static void test_pps(CopernicusGPS &gps, NTPShmClock &clk, NTPShmTime *shm) {
+    int64_t t = (int64_t)days_from_civil(2026, 10, 18) * 86400 * NS_PER_SECOND;
+    NTPShmTime s;
+    int published = 0;
+    for (int k = 0; k < 5; k++) {
+        // the host's clock runs 37 us ahead, and the edges are timed with
+        // 1 us of jitter.
+        int64_t edge = t + k * NS_PER_SECOND + 37000 + (k % 2) * 1000;
+        struct timespec ts = to_timespec(edge);
+        bool ok = clk.ppsEdge(ts);
+        // the first edge has no report before it to label it.
+        CHECK(ok == (k > 0));
+        if (ok) {
+            published++;
+            CHECK(read_sample(shm, &s));
+            CHECK(clock_ns(s) == t + k * NS_PER_SECOND);
+            CHECK(receive_ns(s) == edge);
+            CHECK(s.precision == NTPSHM_PRECISION_PPS);
+            CHECK(s.leap == NTP_LEAP_NONE);
+        }
+        // the report of the edge's time arrives 120 ms after it.
+        feed_gpstime(t + k * NS_PER_SECOND);
+        drain(gps);
+        ts = to_timespec(edge + 120 * 1000000LL);
+        CHECK(clk.timeReceived(&ts));
+    }
+    // an edge with no report since the last is dropped.
+    struct timespec ts = to_timespec(t + 5 * NS_PER_SECOND + 38000);
+    CHECK(clk.ppsEdge(ts));
+    ts = to_timespec(t + 6 * NS_PER_SECOND + 37000);
+    CHECK(not clk.ppsEdge(ts));
+
+    const NTPShmStats &st = clk.getStats();
+    CHECK(st.samples == (uint32_t)published + 1);
+    CHECK(st.rejected == 2);
+    CHECK(st.mean_offset < -36e-6 and st.mean_offset > -39e-6);
+    CHECK(st.jitter > 0.9e-6 and st.jitter < 1.1e-6);
+}
+
+int main() {
+    CopernicusGPS gps(0);
+    NTPShmClock serial(&gps, false);
+    NTPShmClock pps(&gps, true);
+    if (not serial.open(UNIT_SERIAL) or not pps.open(UNIT_PPS)) {
+        // no SysV shared memory here; nothing to test.
+        printf("ntpshm: skipped\n");
+        return 0;
+    }
+    NTPShmTime *shm_serial = attach(UNIT_SERIAL);
+    NTPShmTime *shm_pps    = attach(UNIT_PPS);
+    CHECK(shm_serial != NULL and shm_pps != NULL);
+    if (shm_serial != NULL and shm_pps != NULL) {
+        test_serial(gps, serial, shm_serial);
+        test_pps(gps, pps, shm_pps);
+    }
+    if (shm_serial != NULL) shmdt(shm_serial);
+    if (shm_pps != NULL)    shmdt(shm_pps);
+    serial.close();
+    pps.close();
+    remove(UNIT_SERIAL);
+    remove(UNIT_PPS);
+#if CPN_ENABLE_STATUS
+    return host_result("ntpshm");
+#else
+    return host_result("ntpshm (no status)");
+#endif
+}
@@ -0,0 +1,145 @@
+/*
+ * File:   test_poll.cpp
+ *
+ * `poll()` decodes a stream split at every byte boundary, including between
+ * a DLE and the DLE or ETX after it, as `processOnePacket(true)` decodes it
+ * whole; and counts a packet too long for the poll buffer as an error.
+ */
+
+#include <string.h>
+
+#include "host.h"
+#include "copernicus.h"
+
+// state decoded from the test stream.
+struct Decoded {
+    GPSTime   time;
+    PosFix    fix;
+    GPSHealth health;
+};
+
+static Decoded decoded(const CopernicusGPS &gps) {
+    Decoded d;
+    d.time   = gps.getGPSTime();
+    d.fix    = gps.getPositionFix();
+    d.health = gps.getStatus().health;
+    return d;
+}
+
+static bool same(const Decoded &a, const Decoded &b) {
+    const LLA_Fix<Float32> *fa = a.fix.getLLA_32(), *fb = b.fix.getLLA_32();
+    return a.time.time_of_week.bits == b.time.time_of_week.bits and
+           a.time.week_no == b.time.week_no and
+           a.time.utc_offs.bits == b.time.utc_offs.bits and
+           fa != NULL and fb != NULL and
+           fa->lat.bits == fb->lat.bits and fa->lng.bits == fb->lng.bits and
+           fa->alt.bits == fb->alt.bits and fa->bias.bits == fb->bias.bits and
+           fa->fixtime.bits == fb->fixtime.bits and
+           a.health == b.health;
+}
+
+static void put32(std::vector<uint8_t> &pkt, uint32_t v) {
+    for (int i = 0; i < 4; i++) pkt.push_back(v >> (24 - 8 * i));
+}
+
+// packets with DLEs (and DLE ETX) among their data, around one too long for
+// the poll buffer.
+static std::vector<uint8_t> stream(size_t *n_packets) {
+    HardwareSerial port;
+    std::vector<uint8_t> time = { 0x41 };
+    put32(time, 0x48100310);              // time of week
+    time.push_back(0x10); time.push_back(0x10); // week
+    put32(time, 0x41900000);              // UTC offset, 18
+    std::vector<uint8_t> lla = { 0x4A };
+    put32(lla, 0x3F101003);
+    put32(lla, 0x10100310);
+    put32(lla, 0x44100000);
+    put32(lla, 0x00000010);
+    put32(lla, 0x48100310);
+    std::vector<uint8_t> health = { 0x46, HLTH_DOING_FIXES, 0x10 };
+    std::vector<uint8_t> oversize(200, 0x10);
+    oversize[0] = 0x01;
+    oversize[1] = 0x03;
+    feed_tsip(port, health);
+    feed_tsip(port, time);
+    feed_tsip(port, oversize);
+    feed_tsip(port, lla);
+    *n_packets = 4;
+    return std::vector<uint8_t>(port.in.begin(), port.in.end());
+}
+
+static void feed(const std::vector<uint8_t> &bytes, size_t from, size_t to) {
+    Serial.in.insert(Serial.in.end(), bytes.begin() + from, bytes.begin() + to);
+}
+
+int main() {
+    size_t n_packets;
+    const std::vector<uint8_t> bytes = stream(&n_packets);
+
+    // the whole stream, read directly.
+    std::vector<ReportType> expect;
+    Decoded ref;
+    {
+        CopernicusGPS gps(0);
+        feed(bytes, 0, bytes.size());
+        for (size_t i = 0; i < n_packets; i++) expect.push_back(gps.processOnePacket(true));
+        CHECK(Serial.in.empty());
+        ref = decoded(gps);
+    }
+    CHECK(expect.size() == 4 and expect[2] == 0x01);
+    // a poll buffer can't hold the long packet.
+    expect[2] = RPT_ERROR;
+
+    uint8_t frame[72];
+
+    // split at each byte, one byte per poll().
+    int bad_split = 0;
+    for (size_t s = 0; s <= bytes.size(); s++) {
+        CopernicusGPS gps(0);
+        gps.setPollBuffer(frame, sizeof(frame));
+        std::vector<ReportType> got;
+        int errors = 0;
+        for (int part = 0; part < 2; part++) {
+            if (part == 0) feed(bytes, 0, s);
+            else           feed(bytes, s, bytes.size());
+            PollStatus st;
+            do {
+                st = gps.poll(1);
+                if (st.packets > 0) got.push_back(st.last);
+                errors += st.errors;
+            } while (st.bytes > 0);
+            if (part == 1 and st.partial) bad_split++;
+        }
+        if (got != expect or errors != 1 or not same(decoded(gps), ref)) {
+            if (bad_split++ == 0) fprintf(stderr, "split at byte %zu differs\n", s);
+        }
+    }
+    CHECK(bad_split == 0);
+
+    // in chunks of every size.
+    int bad_chunk = 0;
+    for (size_t c = 1; c <= bytes.size(); c++) {
+        CopernicusGPS gps(0);
+        gps.setPollBuffer(frame, sizeof(frame));
+        feed(bytes, 0, bytes.size());
+        int packets = 0, errors = 0, total = 0;
+        ReportSet reports = 0;
+        PollStatus st;
+        do {
+            st = gps.poll(c);
+            packets += st.packets;
+            errors  += st.errors;
+            reports |= st.reports;
+            total   += st.bytes;
+            if (st.bytes > (int)c or st.backlog != (int)(bytes.size() - total)) bad_chunk++;
+        } while (st.bytes > 0);
+        if (packets != 4 or errors != 1 or total != (int)bytes.size() or
+                reports != (RPTFLAG_HEALTH | RPTFLAG_GPSTIME | RPTFLAG_FIX_POS_LLA_32) or
+                not same(decoded(gps), ref)) {
+            if (bad_chunk++ == 0) fprintf(stderr, "chunks of %zu bytes differ\n", c);
+        }
+    }
+    CHECK(bad_chunk == 0);
+
+    return host_result("poll");
+}
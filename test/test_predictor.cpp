@@ -0,0 +1,187 @@
+/*
+ * File:   test_predictor.cpp
+ *
+ * A predictor following a 2250 km flight, across the antimeridian, keeps
+ * moving its reference point, and its predictions between fixes stay on the
+ * track throughout, in LLA and ECEF frames. Also built with
+ * PREDICTOR_FIXED_POINT.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "host.h"
+#include "predictor.h"
+
+// the WGS-84 ellipsoid in double, for the true track
+#define TRUE_A  6378137.0
+#define TRUE_E2 6.69437999014e-3
+
+struct TestPosFix : public PosFix {
+    void setLLA(ReportType t, double lat, double lng, double alt, float time) {
+        type = t;
+        if (t == RPT_FIX_POS_LLA_64) {
+            lla_64.lat.d = lat;
+            lla_64.lng.d = lng;
+            lla_64.alt.d = alt;
+            lla_64.bias.d = 0;
+            lla_64.fixtime.f = time;
+        } else {
+            lla_32.lat.f = lat;
+            lla_32.lng.f = lng;
+            lla_32.alt.f = alt;
+            lla_32.bias.f = 0;
+            lla_32.fixtime.f = time;
+        }
+    }
+    void setXYZ(const double p[3], float time) {
+        type = RPT_FIX_POS_XYZ_64;
+        xyz_64.x.d = p[0];
+        xyz_64.y.d = p[1];
+        xyz_64.z.d = p[2];
+        xyz_64.bias.d = 0;
+        xyz_64.fixtime.f = time;
+    }
+};
+
+struct TestVelFix : public VelFix {
+    void setENU(float e, float n, float u, float time) {
+        type = RPT_FIX_VEL_ENU;
+        enu.e.f = e;
+        enu.n.f = n;
+        enu.u.f = u;
+        enu.bias.f = 0;
+        enu.fixtime.f = time;
+    }
+};
+
+static double to_m(PredScalar x) {
+#if PREDICTOR_FIXED_POINT
+    return x / 1000.0;
+#else
+    return x;
+#endif
+}
+
+static double wrap(double a) {
+    if      (a >  M_PI) a -= 2 * M_PI;
+    else if (a < -M_PI) a += 2 * M_PI;
+    return a;
+}
+
+static void radii(double lat, double alt, double *m_north, double *m_east) {
+    double s = sin(lat);
+    double w = 1 - TRUE_E2 * s * s;
+    double n = TRUE_A / sqrt(w);
+    *m_north = n * (1 - TRUE_E2) / w + alt;
+    *m_east  = (n + alt) * cos(lat);
+}
+
+static void to_ecef(double lat, double lng, double alt, double p[3]) {
+    double s = sin(lat);
+    double n = TRUE_A / sqrt(1 - TRUE_E2 * s * s);
+    p[0] = (n + alt) * cos(lat) * cos(lng);
+    p[1] = (n + alt) * cos(lat) * sin(lng);
+    p[2] = (n * (1 - TRUE_E2) + alt) * s;
+}
+
+// the reference point, as (lat, lng, alt) or ECEF.
+static void reference(const FixPredictor &p, double r[3]) {
+    const PosFix &ref = p.getReference();
+    if (ref.type == RPT_FIX_POS_LLA_64) {
+        r[0] = ref.getLLA_64()->lat.d;
+        r[1] = ref.getLLA_64()->lng.d;
+        r[2] = ref.getLLA_64()->alt.d;
+    } else if (ref.type == RPT_FIX_POS_LLA_32) {
+        r[0] = ref.getLLA_32()->lat.f;
+        r[1] = ref.getLLA_32()->lng.f;
+        r[2] = ref.getLLA_32()->alt.f;
+    } else {
+        r[0] = ref.getXYZ_64()->x.d;
+        r[1] = ref.getXYZ_64()->y.d;
+        r[2] = ref.getXYZ_64()->z.d;
+    }
+}
+
+// fly east-northeast at 250 m/s and 10 km for 9000 s, from just west of
+// the antimeridian; predict half way between fixes.
+static void fly(ReportType type, double tolerance) {
+    const double ve = 216.5, vn = 125, dt = 1;
+    const int    n_fixes = 9000;
+    FixPredictor pred(1.0f, 0.05f, 0.5f);
+    double lat = 0.6, lng = 3.10, alt = 10000;
+    double worst = 0, worst_offset = 0, lng_min = 0, lng_max = 0;
+    int recenters = 0;
+    double last_ref[3] = { 0, 0, 0 };
+    for (int i = 0; i < n_fixes; i++) {
+        float time = 302400.0f + i;
+        TestPosFix pf;
+        TestVelFix vf;
+        if (type == RPT_FIX_POS_XYZ_64) {
+            double p[3];
+            to_ecef(lat, lng, alt, p);
+            pf.setXYZ(p, time);
+        } else {
+            pf.setLLA(type, lat, lng, alt, time);
+        }
+        vf.setENU(ve, vn, 0, time);
+        uint32_t t_us = 1000000u * i;
+        CHECK(pred.update(pf, vf, t_us));
+
+        // where it will be half a fix later.
+        double m_north, m_east;
+        radii(lat, alt, &m_north, &m_east);
+        double lat_h = lat + vn * dt / 2 / m_north;
+        double lng_h = wrap(lng + ve * dt / 2 / m_east);
+        PredScalar out[3];
+        CHECK(pred.predict(t_us + 500000, out));
+        double r[3];
+        reference(pred, r);
+        if (memcmp(r, last_ref, sizeof(r)) != 0) recenters++;
+        memcpy(last_ref, r, sizeof(r));
+
+        double err;
+        if (type == RPT_FIX_POS_XYZ_64) {
+            double p[3];
+            to_ecef(lat_h, lng_h, alt, p);
+            double dx = r[0] + to_m(out[0]) - p[0];
+            double dy = r[1] + to_m(out[1]) - p[1];
+            double dz = r[2] + to_m(out[2]) - p[2];
+            err = sqrt(dx * dx + dy * dy + dz * dz);
+        } else {
+            double rn, re;
+            radii(r[0], r[2], &rn, &re);
+            double de = (wrap(r[1] + to_m(out[0]) / re - lng_h)) * m_east;
+            double dn = (r[0] + to_m(out[1]) / rn - lat_h) * m_north;
+            double du = r[2] + to_m(out[2]) - alt;
+            err = sqrt(de * de + dn * dn + du * du);
+        }
+        // the filter needs a few fixes to settle.
+        if (i >= 10 and err > worst) worst = err;
+        for (int k = 0; k < 3; k++) {
+            if (fabs(to_m(out[k])) > worst_offset) worst_offset = fabs(to_m(out[k]));
+        }
+
+        lat += vn * dt / m_north;
+        lng  = wrap(lng + ve * dt / m_east);
+        if (lng < lng_min) lng_min = lng;
+        if (lng > lng_max) lng_max = lng;
+    }
+    if (worst > tolerance) fprintf(stderr, "type 0x%02X: off the track by %.2f m\n", type, worst);
+    CHECK(worst <= tolerance);
+    // crossed the antimeridian, and moved the reference every few seconds.
+    CHECK(lng_min < -3.0 and lng_max > 3.0);
+    CHECK(recenters > 1500);
+    CHECK(worst_offset < PREDICTOR_RECENTER_M + 300);
+}
+
+int main() {
+    fly(RPT_FIX_POS_LLA_64, 0.2);
+    fly(RPT_FIX_POS_LLA_32, 1.0);
+    fly(RPT_FIX_POS_XYZ_64, 0.5);
+#if PREDICTOR_FIXED_POINT
+    return host_result("predictor (fixed point)");
+#else
+    return host_result("predictor");
+#endif
+}
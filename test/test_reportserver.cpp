@@ -0,0 +1,234 @@
+/*
+ * File:   test_reportserver.cpp
+ *
+ * A slow client overflows its queue while a frame is partly sent; the
+ * stream it receives must still be whole frames. A packet which has only
+ * partly arrived does not hold the server up. NMEA sentences go only to
+ * clients subscribed to them, and not to those of a TSIP report which
+ * shares their low byte.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "host.h"
+#include "nmea.h"
+#include "reportserver.h"
+
+#define SOCK_PATH "/tmp/cpn_test_reportserver.sock"
+
+// bytes the server's next sends may write in all; -1 for no limit. stands in
+// for a client which reads slowly.
+static long send_budget = -1;
+
+extern "C" ssize_t send(int fd, const void *buf, size_t len, int flags) {
+    if (send_budget == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (send_budget > 0 and len > (size_t)send_budget) len = send_budget;
+    ssize_t n = sendto(fd, buf, len, flags, NULL, 0);
+    if (n > 0 and send_budget > 0) send_budget -= n;
+    return n;
+}
+
+// connect a client for the TSIP report `id`, or the NMEA sentences `nmea`.
+static int connect_client(uint16_t queue_len, int id=RPT_GPSTIME, uint16_t nmea=0) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SOCK_PATH);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) return -1;
+
+    ServerSubscription sub;
+    memset(&sub, 0, sizeof(sub));
+    sub.encoding  = ENC_RAW;
+    sub.policy    = OVF_DROP_OLDEST;
+    sub.queue_len = queue_len;
+    if (id >= 0) sub.reports[id / 8] |= 1 << (id % 8);
+    sub.nmea      = nmea;
+    sendto(fd, &sub, sizeof(sub), 0, NULL, 0);
+    return fd;
+}
+
+// a GPS time report, marked with `n`.
+static void feed_time(uint8_t n) {
+    std::vector<uint8_t> pkt(11, 0);
+    pkt[0] = 0x41;
+    pkt[10] = n;
+    pkt[5] = 0x07;
+    pkt[6] = 0xD0;
+    feed_tsip(Serial1, pkt);
+}
+
+// the marks of the frames received, or -1 where the stream is broken.
+static std::vector<int> receive_marks(int fd) {
+    std::vector<uint8_t> bytes;
+    uint8_t buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        bytes.insert(bytes.end(), buf, buf + n);
+    }
+    std::vector<int> marks;
+    size_t i = 0;
+    while (i < bytes.size()) {
+        FrameHeader h;
+        if (bytes.size() - i < sizeof(h)) {
+            marks.push_back(-1);
+            break;
+        }
+        memcpy(&h, &bytes[i], sizeof(h));
+        i += sizeof(h);
+        if (h.report != RPT_GPSTIME or h.length != 11 or bytes.size() - i < h.length
+                or bytes[i] != 0x41) {
+            marks.push_back(-1);
+            break;
+        }
+        marks.push_back(bytes[i + 10]);
+        i += h.length;
+    }
+    return marks;
+}
+
+static void settle(ReportServer &srv) {
+    for (int i = 0; i < 8; i++) srv.poll(1);
+}
+
+// a frame is in flight when `overflow` more reports arrive; the client then
+// catches up, and one more report arrives.
+static std::vector<int> overflow_mid_frame(uint16_t queue_len, int overflow) {
+    CopernicusGPS gps(1);
+    ReportServer srv(&gps);
+    std::vector<int> marks;
+    if (not srv.listen(SOCK_PATH)) return marks;
+    int fd = connect_client(queue_len);
+    settle(srv);
+
+    send_budget = 7;
+    feed_time(0);
+    srv.poll(0);
+    send_budget = 0;
+    for (int k = 1; k <= overflow; k++) {
+        feed_time(k);
+        srv.poll(0);
+    }
+    send_budget = -1;
+    settle(srv);
+    feed_time(100);
+    settle(srv);
+
+    marks = receive_marks(fd);
+    close(fd);
+    return marks;
+}
+
+// the headers of the frames received.
+static std::vector<FrameHeader> receive_headers(int fd) {
+    std::vector<uint8_t> bytes;
+    uint8_t buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        bytes.insert(bytes.end(), buf, buf + n);
+    }
+    std::vector<FrameHeader> headers;
+    size_t i = 0;
+    while (bytes.size() - i >= sizeof(FrameHeader)) {
+        FrameHeader h;
+        memcpy(&h, &bytes[i], sizeof(h));
+        headers.push_back(h);
+        i += sizeof(h) + h.length;
+    }
+    return headers;
+}
+
+// half a packet, then the rest: the server must not wait for the rest.
+static void test_partial() {
+    CopernicusGPS gps(1);
+    ReportServer srv(&gps);
+    if (not srv.listen(SOCK_PATH)) {
+        CHECK(false);
+        return;
+    }
+    int fd = connect_client(8);
+    settle(srv);
+
+    HardwareSerial staging;
+    std::vector<uint8_t> pkt(11, 0);
+    pkt[0]  = 0x41;
+    pkt[10] = 7;
+    feed_tsip(staging, pkt);
+    size_t half = staging.in.size() / 2;
+    for (size_t i = 0; i < half; i++) Serial1.in.push_back(staging.read());
+
+    alarm(5); // a server blocked on the receiver never returns
+    settle(srv);
+    alarm(0);
+    CHECK(receive_marks(fd).empty());
+
+    while (staging.available() > 0) Serial1.in.push_back(staging.read());
+    settle(srv);
+    std::vector<int> m = receive_marks(fd);
+    CHECK(m.size() == 1 and m[0] == 7);
+    close(fd);
+}
+
+static void test_nmea() {
+    CopernicusGPS gps(1);
+    ReportServer srv(&gps);
+    if (not srv.listen(SOCK_PATH)) {
+        CHECK(false);
+        return;
+    }
+    // RPT_NMEA_GGA is 0x101.
+    int tsip = connect_client(8, 0x01);
+    int gga  = connect_client(8, -1, 1 << (RPT_NMEA_GGA - RPT_NMEA));
+    int rmc  = connect_client(8, -1, 1 << (RPT_NMEA_RMC - RPT_NMEA));
+    settle(srv);
+
+    const char *body = "GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,";
+    char cksum[8];
+    snprintf(cksum, sizeof(cksum), "*%02X\r\n", nmea_checksum(body, strlen(body)));
+    feed_bytes(Serial1, "$");
+    feed_bytes(Serial1, body);
+    feed_bytes(Serial1, cksum);
+    settle(srv);
+
+    CHECK(receive_headers(tsip).empty());
+    CHECK(receive_headers(rmc).empty());
+    std::vector<FrameHeader> h = receive_headers(gga);
+    CHECK(h.size() == 1);
+    if (h.size() == 1) {
+        CHECK(h[0].report == RPT_NMEA_GGA);
+        // from after the `$` to the line ending.
+        CHECK(h[0].length == strlen(body) + 3);
+    }
+    close(tsip);
+    close(gga);
+    close(rmc);
+}
+
+int main() {
+    std::vector<int> m = overflow_mid_frame(4, 10);
+    // the frame in flight, the newest three, then the next.
+    int want4[] = { 0, 8, 9, 10, 100 };
+    CHECK(m == std::vector<int>(want4, want4 + 5));
+
+    m = overflow_mid_frame(1, 3);
+    // nothing can be dropped while the only queued frame is in flight.
+    int want1[] = { 0, 100 };
+    CHECK(m == std::vector<int>(want1, want1 + 2));
+
+    // queue not full: nothing is lost.
+    m = overflow_mid_frame(8, 3);
+    int want8[] = { 0, 1, 2, 3, 100 };
+    CHECK(m == std::vector<int>(want8, want8 + 5));
+
+    test_partial();
+    test_nmea();
+
+    unlink(SOCK_PATH);
+    return host_result("reportserver");
+}
@@ -0,0 +1,112 @@
+/*
+ * File:   test_status.cpp
+ *
+ * Status written from superpackets and NMEA sentences is reported to the
+ * listener, and does not stop the next health report from being decoded.
+ * An invalid fix superpacket overrides the health only when it knows better.
+ */
+
+#include <string.h>
+#include <string>
+
+#include "host.h"
+#include "copernicus.h"
+#include "nmea.h"
+
+class Recorder : public GPSStatusListener {
+public:
+    Recorder(): calls(0) {}
+    void statusChanged(const GPSStatus &, const GPSStatus &, StatusSet changes) {
+        calls++;
+        last = changes;
+    }
+    int       calls;
+    StatusSet last;
+};
+
+static void feed_nmea(HardwareSerial &port, const char *body) {
+    char cksum[8];
+    snprintf(cksum, sizeof(cksum), "*%02X\r\n", nmea_checksum(body, strlen(body)));
+    std::string s = std::string("$") + body + cksum;
+    feed_bytes(port, s.c_str());
+}
+
+// 0x8F-AC, with the given decoding status and minor alarms.
+static std::vector<uint8_t> timing_suppl(uint8_t decode_status, uint16_t minor_alarms) {
+    std::vector<uint8_t> pkt(2 + 67, 0);
+    pkt[0] = 0x8F;
+    pkt[1] = 0xAC;
+    pkt[2 + 9]  = minor_alarms >> 8;
+    pkt[2 + 10] = minor_alarms & 0xFF;
+    pkt[2 + 11] = decode_status;
+    return pkt;
+}
+
+// 0x8F-20, with an invalid fix from `n_svs` satellites.
+static std::vector<uint8_t> invalid_fix(uint8_t n_svs) {
+    std::vector<uint8_t> pkt(2 + 55, 0);
+    pkt[0] = 0x8F;
+    pkt[1] = 0x20;
+    pkt[2 + 26] = 0x01; // fix not available
+    pkt[2 + 27] = n_svs;
+    return pkt;
+}
+
+static void drain(CopernicusGPS &gps) {
+    while (gps.processOnePacket(false) != RPT_NONE) {}
+}
+
+int main() {
+    CopernicusGPS gps(0);
+    uint8_t frame[96];
+    gps.setPollBuffer(frame, sizeof(frame));
+    Recorder rec;
+    gps.setStatusListener(&rec);
+    const std::vector<uint8_t> doing_fixes = { 0x46, HLTH_DOING_FIXES, 0x00 };
+
+    feed_tsip(Serial, doing_fixes);
+    drain(gps);
+    CHECK(gps.getStatus().health == HLTH_DOING_FIXES);
+
+    // a sentence without a fix changes the health, and says so.
+    int calls = rec.calls;
+    feed_nmea(Serial, "GPGGA,123519,,,,,0,02,,,M,,M,,");
+    drain(gps);
+    CHECK(gps.getStatus().health == HLTH_SATELLITES_NONE + 2);
+    CHECK(rec.calls == calls + 1 and (rec.last & STATUS_HEALTH));
+
+    // the same health report as before is decoded again.
+    feed_tsip(Serial, doing_fixes);
+    drain(gps);
+    CHECK(gps.getStatus().health == HLTH_DOING_FIXES);
+
+    // likewise the supplemental timing packet.
+    calls = rec.calls;
+    feed_tsip(Serial, timing_suppl(HLTH_SATELLITES_NONE, 0x0000));
+    drain(gps);
+    CHECK(gps.getStatus().health == HLTH_SATELLITES_NONE);
+    CHECK(not gps.getStatus().almanac_incomplete);
+    CHECK(rec.calls == calls + 1);
+    CHECK((rec.last & (STATUS_HEALTH | STATUS_ALMANAC)) == (STATUS_HEALTH | STATUS_ALMANAC));
+
+    feed_tsip(Serial, doing_fixes);
+    drain(gps);
+    CHECK(gps.getStatus().health == HLTH_DOING_FIXES);
+
+    // an invalid fix with enough satellites keeps the reported health...
+    const std::vector<uint8_t> pdop_high = { 0x46, HLTH_PDOP_TOO_HIGH, 0x00 };
+    feed_tsip(Serial, pdop_high);
+    feed_tsip(Serial, invalid_fix(6));
+    drain(gps);
+    CHECK(gps.getStatus().health == HLTH_PDOP_TOO_HIGH);
+    CHECK(gps.getStatus().n_satellites == 6);
+    // ...and with too few, says how many.
+    feed_tsip(Serial, invalid_fix(2));
+    drain(gps);
+    CHECK(gps.getStatus().health == HLTH_SATELLITES_NONE + 2);
+    feed_tsip(Serial, pdop_high);
+    drain(gps);
+    CHECK(gps.getStatus().health == HLTH_PDOP_TOO_HIGH);
+
+    return host_result("status");
+}
@@ -0,0 +1,128 @@
+/*
+ * File:   test_timeconv.cpp
+ *
+ * Week numbers resolve across each 1024-week rollover, and full week numbers
+ * are left alone (week 2000 once became 3024). Times around inserted leap
+ * seconds convert as the table says, and the batch conversions agree with
+ * the scalar one.
+ */
+
+#include <stdlib.h>
+
+#include "host.h"
+#include "timeconv.h"
+
+static Float32 f32(float f) {
+    Float32 x;
+    x.f = f;
+    return x;
+}
+
+// UTC, in Unix seconds, of a GPS week and whole time of week.
+static int64_t unix_s(int32_t week, int32_t tow) {
+    return gps_to_unix_ns(week, (int64_t)tow * NS_PER_SECOND) / NS_PER_SECOND;
+}
+
+static void test_weeks() {
+    // either side of each rollover, with the reference just before it.
+    CHECK(resolve_week(1023, 1000) == 1023);
+    CHECK(resolve_week(0,    1000) == 1024);
+    CHECK(resolve_week(999,  1000) == 2023);
+    CHECK(resolve_week(1000, 1000) == 1000);
+    CHECK(resolve_week(1023, 2000) == 2047);
+    CHECK(resolve_week(0,    2000) == 2048);
+    CHECK(resolve_week(975,  2000) == 3023);
+    CHECK(resolve_week(976,  2000) == 2000);
+    CHECK(resolve_week(1023, TIME_REF_WEEK) == 3071);
+    CHECK(resolve_week(0,    TIME_REF_WEEK) == 3072);
+    // the reference itself, and the week before it, 1024 weeks on.
+    CHECK(resolve_week(TIME_REF_WEEK % 1024, TIME_REF_WEEK) == TIME_REF_WEEK);
+    CHECK(resolve_week(TIME_REF_WEEK % 1024 - 1, TIME_REF_WEEK) == TIME_REF_WEEK + 1023);
+
+    // full weeks, before or after the reference, are unchanged.
+    const int32_t full[] = { 1024, 1930, 2000, 2047, 2048, TIME_REF_WEEK, 3024, 4000 };
+    for (size_t i = 0; i < sizeof(full) / sizeof(full[0]); i++) {
+        CHECK(resolve_week(full[i]) == full[i]);
+    }
+
+    // through a whole time report: week 2000 began 2018-05-06.
+    GPSTime t;
+    t.week_no      = 2000;
+    t.time_of_week = f32(0);
+    t.utc_offs     = f32(18);
+    CHECK(gps_to_unix_ns(t) == 1525564782LL * NS_PER_SECOND);
+    t.utc_offs.bits = 0; // no offset yet: from the table
+    CHECK(gps_to_unix_ns(t) == 1525564782LL * NS_PER_SECOND);
+}
+
+static void test_leaps() {
+    // 2016-12-31T23:59:60 is week 1930, 17 s. the inserted second shares
+    // the Unix time of the midnight after it.
+    CHECK(unix_s(1930, 16) == 1483228799);
+    CHECK(unix_s(1930, 17) == 1483228800);
+    CHECK(unix_s(1930, 18) == 1483228800);
+    CHECK(unix_s(1930, 19) == 1483228801);
+    CHECK(leap_seconds(1930 * GPS_WEEK_SECONDS + 17) == 17);
+    CHECK(leap_seconds(1930 * GPS_WEEK_SECONDS + 18) == 18);
+    CHECK(leap_seconds_utc(1483228799) == 17);
+    CHECK(leap_seconds_utc(1483228800) == 18);
+
+    // the first, 1981-06-30T23:59:60, is week 77, 259200 s.
+    CHECK(unix_s(77, 259199) == 362793599);
+    CHECK(unix_s(77, 259200) == 362793600);
+    CHECK(unix_s(77, 259201) == 362793600);
+    CHECK(unix_s(77, 259202) == 362793601);
+    CHECK(leap_seconds(77 * GPS_WEEK_SECONDS + 259200) == 0);
+    CHECK(leap_seconds(77 * GPS_WEEK_SECONDS + 259201) == 1);
+
+    // and back, taking the ambiguous second to be after the leap.
+    int32_t week;
+    int64_t tow_ns;
+    unix_ns_to_gps(1483228799 * NS_PER_SECOND, &week, &tow_ns);
+    CHECK(week == 1930 and tow_ns == 16 * NS_PER_SECOND);
+    unix_ns_to_gps(1483228800 * NS_PER_SECOND, &week, &tow_ns);
+    CHECK(week == 1930 and tow_ns == 18 * NS_PER_SECOND);
+    unix_ns_to_gps(362793600 * NS_PER_SECOND, &week, &tow_ns);
+    CHECK(week == 77 and tow_ns == 259201 * NS_PER_SECOND);
+}
+
+static void test_batch() {
+    const uint32_t n = 4096;
+    std::vector<int16_t> week(n);
+    std::vector<Float32> tow(n);
+    std::vector<int64_t> out(n);
+    srand(1);
+    // weeks either side of the leap seconds and rollovers, in 10 or 16 bits.
+    const int16_t weeks[] = { 76, 77, 1023, 1024, 1929, 1930, 2047, 2048, 0, 392, 393 };
+    for (uint32_t i = 0; i < n; i++) {
+        week[i] = weeks[(i / 64 + rand() % 2) % (sizeof(weeks) / sizeof(weeks[0]))];
+        tow[i]  = f32((float)(rand() % GPS_WEEK_SECONDS) + (rand() % 8) / 8.0f);
+    }
+    // a few exactly on the leaps.
+    week[10] = 1930; tow[10] = f32(17);
+    week[11] = 1930; tow[11] = f32(18);
+    week[12] = 77;   tow[12] = f32(259201);
+    gps_to_unix_ns(week.data(), tow.data(), out.data(), n);
+    int bad = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (out[i] != gps_to_unix_ns(resolve_week(week[i]), tow_to_ns(tow[i]))) bad++;
+    }
+    CHECK(bad == 0);
+
+    // one week column: ascending times, running into the following week.
+    for (uint32_t i = 0; i < n; i++) tow[i] = f32((float)((i * 300 + 590000) % GPS_WEEK_SECONDS));
+    gps_to_unix_ns((int16_t)1929, tow.data(), out.data(), n);
+    bad = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t w = 1929 + (i * 300 + 590000) / GPS_WEEK_SECONDS;
+        if (out[i] != gps_to_unix_ns(w, tow_to_ns(tow[i]))) bad++;
+    }
+    CHECK(bad == 0);
+}
+
+int main() {
+    test_weeks();
+    test_leaps();
+    test_batch();
+    return host_result("timeconv");
+}
@@ -0,0 +1,142 @@
+/*
+ * File:   test_waypoint.cpp
+ *
+ * WaypointSet's grid search against a brute force search of the same table,
+ * with a cluster of waypoints straddling the antimeridian; and
+ * geodesic_inverse() against published distances and bearings on the
+ * WGS-84 ellipsoid.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <utility>
+
+#include "host.h"
+#include "waypoint.h"
+
+#define N_WAYPOINTS 20000
+#define N_CLUSTER   200
+#define N_QUERIES   2000
+#define K           8
+#define RADIUS      200000.0f
+#define MAX_WITHIN  4000
+
+#define DEG (M_PI / 180)
+
+static uint32_t rng_state = 1;
+
+// uniform in [a, b]; deterministic, so that failures can be reproduced.
+static float uniform(float a, float b) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return a + (b - a) * ((rng_state >> 8) / 16777216.0f);
+}
+
+// a point of the antimeridian cluster, on either side of it.
+static void cluster_point(int i, float *lat, float *lng) {
+    *lat = uniform(0.50f, 0.52f);
+    *lng = (i & 1) ? uniform(3.13f, 3.14159f) : uniform(-3.14159f, -3.13f);
+}
+
+static void test_search() {
+    std::vector<float> lat(N_WAYPOINTS), lng(N_WAYPOINTS);
+    for (int i = 0; i < N_WAYPOINTS; i++) {
+        if (i < N_CLUSTER) {
+            cluster_point(i, &lat[i], &lng[i]);
+        } else {
+            lat[i] = uniform(-1.2f, 1.2f);
+            lng[i] = uniform(-M_PI, M_PI);
+        }
+    }
+    WaypointSet wpts(&lat[0], &lng[0], N_WAYPOINTS);
+    std::vector<uint32_t> offsets(64 * 64 + 1), order(N_WAYPOINTS);
+    std::vector<float> xyz(3 * N_WAYPOINTS);
+    CHECK(wpts.buildIndex(64, 64, &offsets[0], &order[0], &xyz[0]));
+
+    int missed = 0, within_wrong = 0, straddled = 0;
+    std::vector<std::pair<float, uint32_t> > all(N_WAYPOINTS);
+    std::vector<WaypointHit> found(MAX_WITHIN);
+    for (int q = 0; q < N_QUERIES; q++) {
+        float qlat, qlng;
+        if (q < N_CLUSTER) {
+            // queries on both sides of the antimeridian, within the cluster.
+            qlat = uniform(0.50f, 0.52f);
+            qlng = (q & 1) ? 3.1415f : -3.1415f;
+        } else {
+            qlat = uniform(-1.3f, 1.3f);
+            qlng = uniform(-M_PI, M_PI);
+        }
+        for (uint32_t i = 0; i < N_WAYPOINTS; i++) {
+            all[i] = std::make_pair(sphere_distance(qlat, qlng, lat[i], lng[i]), i);
+        }
+        std::partial_sort(all.begin(), all.begin() + K, all.end());
+
+        // every one of the true K nearest is found, except those tied with
+        // the K-th to within the rounding of the ranking.
+        WaypointHit hits[K];
+        uint32_t n = wpts.nearest(qlat, qlng, hits, K);
+        CHECK(n == K);
+        for (int j = 0; j < K; j++) {
+            bool hit = false;
+            for (uint32_t m = 0; m < n; m++) hit |= hits[m].index == all[j].second;
+            if (not hit and all[j].first < all[K - 1].first * 0.999f) missed++;
+        }
+        if (q < N_CLUSTER) {
+            int east = 0;
+            for (uint32_t m = 0; m < n; m++) east += lng[hits[m].index] > 0;
+            if (east > 0 and east < (int)n) straddled++;
+        }
+
+        // within() finds all those inside the radius, and no more.
+        uint32_t n_within = wpts.within(qlat, qlng, RADIUS, &found[0], MAX_WITHIN);
+        uint32_t lo = 0, hi = 0;
+        for (uint32_t i = 0; i < N_WAYPOINTS; i++) {
+            if (all[i].first <= RADIUS * 0.9999f) lo++;
+            if (all[i].first <= RADIUS * 1.0001f) hi++;
+        }
+        if (n_within < lo or n_within > hi) within_wrong++;
+    }
+    CHECK(missed == 0);
+    CHECK(within_wrong == 0);
+    // most of the cluster's queries find neighbours on both sides of the
+    // antimeridian, so the comparison above covers the wrap.
+    CHECK(straddled > N_CLUSTER / 2);
+}
+
+struct GeodesicCase {
+    const char *name;
+    double lat1, lng1, lat2, lng2; // degrees
+    double distance;               // meters
+    double bearing;                // degrees, or < 0 if not checked
+};
+
+static void test_geodesic() {
+    static const GeodesicCase cases[] = {
+        // Flinders Peak to Buninyong (Geoscience Australia's example for
+        // Vincenty's formulae; GRS80 and WGS-84 agree here to 0.1 mm).
+        { "flinders", -37.95103342, 144.42486789, -37.65282114, 143.92649554,
+          54972.271, 306.868159 },
+        // one degree along the equator: a * pi / 180.
+        { "equator",  0, 0, 0, 1, 111319.4908, 90 },
+        // one degree, and a quarter, of the meridian.
+        { "meridian", 0, 0, 1, 0, 110574.3886, 0 },
+        { "quadrant", 0, 0, 90, 0, 10001965.7293, -1 },
+        // the same degree of meridian, southward from the far side.
+        { "south",    1, 180, 0, 180, 110574.3886, 180 },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const GeodesicCase &c = cases[i];
+        double d, b;
+        bool ok = geodesic_inverse(c.lat1 * DEG, c.lng1 * DEG, c.lat2 * DEG, c.lng2 * DEG, &d, &b);
+        if (not ok or fabs(d - c.distance) > 0.005 or
+                (c.bearing >= 0 and fabs(b / DEG - c.bearing) > 1e-5)) {
+            fprintf(stderr, "%s: %.4f m, %.6f deg\n", c.name, d, b / DEG);
+            host_failures++;
+        }
+    }
+}
+
+int main() {
+    test_search();
+    test_geodesic();
+    return host_result("waypoint");
+}
@@ -0,0 +1,98 @@
+#!/bin/sh
+#
+# Build the library for an AVR board in each of the configurations below,
+# with arduino-cli (and so avr-g++), and report the flash and RAM each uses
+# according to avr-size.
+#
+# usage: tools/avr-size.sh [--update | --check]
+#
+#   --update  write the sizes to tools/avr-size.baseline
+#   --check   fail if any configuration has grown by more than $TOLERANCE
+#             bytes of flash or RAM over the baseline, or is missing from it
+#
+# Needs arduino-cli with the arduino:avr core installed:
+#   arduino-cli core install arduino:avr
+
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+FQBN=${FQBN:-arduino:avr:mega}
+BUILD=${BUILD:-$ROOT/_avr_build}
+TOLERANCE=${TOLERANCE:-32}
+BASELINE=$ROOT/tools/avr-size.baseline
+
+MODE=${1:-}
+case "$MODE" in
+    ""|--update|--check) ;;
+    *) echo "usage: $0 [--update | --check]" >&2; exit 2 ;;
+esac
+# fail before the builds, rather than after
+if [ "$MODE" = --check ] && [ ! -f "$BASELINE" ]; then
+    echo "no baseline; run $0 --update and commit $BASELINE" >&2
+    exit 1
+fi
+
+# name, then the compiler flags of the configuration. "core" leaves the
+# library out, for reference.
+CONFIGS='
+core        -DSIZE_SKETCH_EMPTY
+default
+lla32_time  -DCPN_ENABLE_FIX_POS_LLA_64=0 -DCPN_ENABLE_FIX_POS_XYZ_32=0 -DCPN_ENABLE_FIX_POS_XYZ_64=0 -DCPN_ENABLE_FIX_VEL_XYZ=0 -DCPN_ENABLE_FIX_VEL_ENU=0 -DCPN_ENABLE_STATUS=0 -DCPN_ENABLE_SATELLITES=0 -DCPN_ENABLE_SUPERPACKETS=0 -DCPN_ENABLE_NMEA=0 -DMAX_PKT_PROCESSORS=0
+no_sats     -DCPN_ENABLE_SATELLITES=0
+no_spkt     -DCPN_ENABLE_SUPERPACKETS=0
+no_nmea     -DCPN_ENABLE_NMEA=0
+nmea_only   -DCPN_ENABLE_FIX_POS_LLA_64=0 -DCPN_ENABLE_FIX_POS_XYZ_32=0 -DCPN_ENABLE_FIX_POS_XYZ_64=0 -DCPN_ENABLE_FIX_VEL_XYZ=0 -DCPN_ENABLE_SUPERPACKETS=0
+'
+
+AVR_SIZE=$(command -v avr-size || true)
+if [ -z "$AVR_SIZE" ]; then
+    AVR_SIZE=$(find "${ARDUINO_DATA:-$HOME/.arduino15}/packages/arduino/tools/avr-gcc" \
+                    -name avr-size -type f 2>/dev/null | sort | tail -n 1)
+fi
+if [ -z "$AVR_SIZE" ]; then
+    echo "avr-size not found; install the arduino:avr core" >&2
+    exit 1
+fi
+
+# arduino-cli wants the sketch in a directory of its own name.
+SKETCH=$BUILD/size_sketch
+mkdir -p "$SKETCH"
+cp "$ROOT/tools/size_sketch/size_sketch.ino" "$SKETCH/"
+
+RESULTS=$BUILD/sizes.txt
+: > "$RESULTS"
+echo "$CONFIGS" | while read -r name flags; do
+    [ -n "$name" ] || continue
+    out=$BUILD/$name
+    arduino-cli compile --fqbn "$FQBN" \
+        --library "$ROOT/copernicus" \
+        --build-property "compiler.cpp.extra_flags=$flags" \
+        --build-property "compiler.c.extra_flags=$flags" \
+        --output-dir "$out" --quiet "$SKETCH" >&2
+    # berkeley format: text data bss dec hex filename
+    "$AVR_SIZE" "$out/size_sketch.ino.elf" | awk -v n="$name" \
+        'NR == 2 { printf "%-12s %7d %6d\n", n, $1 + $2, $2 + $3 }' >> "$RESULTS"
+done
+
+printf '%-12s %7s %6s\n' config flash ram
+cat "$RESULTS"
+
+case "$MODE" in
+    --update)
+        cp "$RESULTS" "$BASELINE"
+        echo "wrote $BASELINE" ;;
+    --check)
+        awk -v tol="$TOLERANCE" '
+            NR == FNR { flash[$1] = $2; ram[$1] = $3; next }
+            !($1 in flash) {
+                printf "%-12s not in the baseline\n", $1
+                bad = 1
+                next
+            }
+            {
+                df = $2 - flash[$1]; dr = $3 - ram[$1]
+                printf "%-12s flash %+6d  ram %+5d\n", $1, df, dr
+                if (df > tol || dr > tol) bad = 1
+            }
+            END { exit bad }' "$BASELINE" "$RESULTS" ;;
+esac
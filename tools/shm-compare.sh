@@ -0,0 +1,62 @@
+#!/bin/sh
+#
+# Compare the jitter of two SHM reference clocks under chronyd: typically
+# this library's NTPShmClock and gpsd, fed by the same receiver (gpsd on one
+# of its ports, TSIP on the other) and, for PPS units, the same pulse.
+#
+# usage: tools/shm-compare.sh REFID_A REFID_B [SECONDS [INTERVAL]]
+#
+# The two sources are named by their refids in chrony.conf, e.g.
+#
+#   refclock SHM 2 refid CPN  precision 1e-6 noselect
+#   refclock SHM 0 refid GPSD precision 1e-6 noselect
+#
+# (`noselect` keeps both out of the clock's control, so that neither is
+# judged against a clock the other is steering.) Every INTERVAL seconds
+# (default 16) for SECONDS (default 3600), chronyc's estimates of each
+# source's offset and standard deviation are sampled. Then the median of
+# each source's standard deviation is printed, with the mean and RMS of the
+# difference between their offsets.
+
+set -eu
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 REFID_A REFID_B [SECONDS [INTERVAL]]" >&2
+    exit 2
+fi
+A=$1
+B=$2
+SECONDS_TOTAL=${3:-3600}
+INTERVAL=${4:-16}
+
+command -v chronyc >/dev/null || { echo "chronyc not found" >&2; exit 1; }
+
+SAMPLES=$(mktemp)
+trap 'rm -f "$SAMPLES"' EXIT
+
+# chronyc -c sourcestats: name,np,nr,span,freq,skew,offset,stddev (seconds).
+elapsed=0
+while [ "$elapsed" -lt "$SECONDS_TOTAL" ]; do
+    chronyc -c sourcestats | awk -F, -v a="$A" -v b="$B" '
+        $1 == a { oa = $7; sa = $8 }
+        $1 == b { ob = $7; sb = $8 }
+        END { if (sa != "" && sb != "") print oa, sa, ob, sb }' >> "$SAMPLES"
+    sleep "$INTERVAL"
+    elapsed=$((elapsed + INTERVAL))
+done
+
+if [ ! -s "$SAMPLES" ]; then
+    echo "no samples of both $A and $B; check their refids with 'chronyc sources'" >&2
+    exit 1
+fi
+
+median() {
+    sort -g | awk '{ v[NR] = $1 } END { print (NR % 2) ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2 }'
+}
+
+printf '%-8s %14s\n' source 'std dev (us)'
+printf '%-8s %14.3f\n' "$A" "$(awk '{ print $2 * 1e6 }' "$SAMPLES" | median)"
+printf '%-8s %14.3f\n' "$B" "$(awk '{ print $4 * 1e6 }' "$SAMPLES" | median)"
+awk -v a="$A" -v b="$B" '
+    { d = ($1 - $3) * 1e6; sum += d; sq += d * d; n++ }
+    END { printf "%s - %s: mean %.3f us, rms %.3f us, %d samples\n", a, b, sum / n, sqrt(sq / n), n }' "$SAMPLES"
@@ -0,0 +1,55 @@
+/**
+ * bench_sketch.ino
+ *
+ * Firmware for the simavr benchmark (see runner.c). Reports arrive on
+ * Serial1 from the simulated receiver; the sketch marks the start and end
+ * of each call that processes one, for the simulator to time, and prints
+ * the stack high-water mark once the stream has ended.
+ *
+ * The markers are writes to general purpose I/O registers, which cost one
+ * cycle each and touch nothing else:
+ *
+ *   GPIOR2  (written by the simulator) number of whole packets received,
+ *           modulo 256; a packet is processed only once all of it is
+ *           buffered, so that the timings are of decoding, not waiting.
+ *   GPIOR1  flags and the high byte of the report type, set before GPIOR0.
+ *   GPIOR0  written to mark an event; the low byte of the report type.
+ *
+ * Pin 53 (PB0) is driven high by the simulator at the end of the stream.
+ */
+
+#include <copernicus.h>
+#include <profiler.h>
+
+#define MARK_START 0x80
+#define MARK_DONE  0x81
+#define END_PIN    53
+
+CopernicusGPS gps(1);
+uint8_t processed = 0;
+
+static inline void mark(uint8_t flags, uint8_t value) {
+  GPIOR1 = flags;
+  GPIOR0 = value;
+}
+
+void setup() {
+  ReportProfiler::paintStack();
+  Serial.begin(115200);
+  pinMode(END_PIN, INPUT);
+}
+
+void loop() {
+  if (GPIOR2 != processed) {
+    mark(MARK_START, 0);
+    int rpt = gps.processOnePacket();
+    mark((rpt >> 8) & 0x7F, rpt & 0xFF);
+    processed++;
+  } else if (digitalRead(END_PIN) == HIGH) {
+    Serial.print("stack ");
+    Serial.println(ReportProfiler::getStackUsage());
+    Serial.flush();
+    mark(MARK_DONE, 0);
+    while (true) {}
+  }
+}
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""
+Write TSIP streams for the simavr benchmark, one file per argument:
+
+    make_fixtures.py OUTDIR
+
+Each stream is a minute of reports at one epoch per second, as a Copernicus
+II sends them in its default configuration (standard), with the 64-bit and
+ECEF formats and tracking reports (full), or as superpackets (spkt). The
+receiver moves, so that successive reports differ and are decoded in full.
+
+These are synthesized, not captured. A capture from a receiver (the raw
+bytes of its serial port) can be dropped into OUTDIR alongside them, with a
+.tsip extension, and is replayed the same way.
+"""
+
+import math
+import os
+import struct
+import sys
+
+DLE, ETX = 0x10, 0x03
+EPOCHS = 60
+WEEK = 2441
+LEAP = 18
+SVS = [2, 5, 7, 13, 15, 18, 24, 29]
+
+
+def packet(data):
+    out = bytearray([DLE])
+    for b in data:
+        out.append(b)
+        if b == DLE:
+            out.append(DLE)
+    out += bytes([DLE, ETX])
+    return bytes(out)
+
+
+def f32(*v):
+    return struct.pack('>%df' % len(v), *v)
+
+
+def f64(*v):
+    return struct.pack('>%dd' % len(v), *v)
+
+
+def where(t):
+    """position (rad, rad, m) and ENU velocity (m/s) at second t."""
+    lat = 0.6538 + 2.0e-6 * t
+    lng = -2.1366 + 3.0e-6 * math.sin(t / 20.0)
+    alt = 12.5 + 0.1 * t
+    return lat, lng, alt, (11.0, 13.0, 0.1)
+
+
+def ecef(lat, lng, alt):
+    a, e2 = 6378137.0, 6.69437999014e-3
+    n = a / math.sqrt(1 - e2 * math.sin(lat) ** 2)
+    return ((n + alt) * math.cos(lat) * math.cos(lng),
+            (n + alt) * math.cos(lat) * math.sin(lng),
+            (n * (1 - e2) + alt) * math.sin(lat))
+
+
+def standard(t, tow):
+    lat, lng, alt, v = where(t)
+    return [
+        packet(bytes([0x4A]) + f32(lat, lng, alt, 1.5e-4, tow)),
+        packet(bytes([0x56]) + f32(v[0], v[1], v[2], 1.0e-7, tow)),
+        packet(bytes([0x41]) + f32(tow) + struct.pack('>h', WEEK) + f32(LEAP)),
+        packet(bytes([0x46, 0x00, 0x00])),
+        packet(bytes([0x4B, 0x5A, 0x00, 0x01])),
+        packet(bytes([0x6D, (len(SVS) << 4) | 0x04]) +
+               f32(1.6 + 0.01 * (t % 5), 0.9, 1.3, 1.0) + bytes(SVS)),
+        packet(bytes([0x82, 0x02])),
+    ]
+
+
+def full(t, tow):
+    lat, lng, alt, v = where(t)
+    x, y, z = ecef(lat, lng, alt)
+    pkts = [
+        packet(bytes([0x84]) + f64(lat, lng, alt, 45.0) + f32(tow)),
+        packet(bytes([0x83]) + f64(x, y, z, 45.0) + f32(tow)),
+        packet(bytes([0x42]) + f32(x, y, z, 45.0, tow)),
+        packet(bytes([0x43]) + f32(v[0], v[1], v[2], 1.0e-7, tow)),
+        packet(bytes([0x41]) + f32(tow) + struct.pack('>h', WEEK) + f32(LEAP)),
+    ]
+    for i, prn in enumerate(SVS):
+        snr = 38.0 + ((t + i) % 7)
+        elev = math.radians(10 + 9 * i + (t % 3))
+        azim = math.radians(40 * i + t % 11)
+        pkts.append(packet(bytes([0x5C, prn, 0x21, 0x08, 0x00]) +
+                           f32(snr, tow - 0.1, elev, azim) +
+                           bytes([0x01, 0x00, 0x00, 0x00])))
+    return pkts
+
+
+def spkt(t, tow):
+    lat, lng, alt, v = where(t)
+    semi = 2147483648.0 / math.pi
+    tow_ms = int(round(tow * 1000))
+    fix = struct.pack('>Bhhh', 0x00,
+                      int(v[0] / 0.005), int(v[1] / 0.005), int(v[2] / 0.005))
+    fix += struct.pack('>IiIi', tow_ms, int(lat * semi),
+                       int(lng * semi) & 0xFFFFFFFF, int(alt * 1000))
+    fix += bytes([0x00, 0x00, 0x00, 0x00, len(SVS), LEAP])
+    fix += struct.pack('>h', WEEK)
+    fix += bytes(SPKT_FIX_LEN - len(fix))
+
+    timing = struct.pack('>IhhBBBBBBH', int(tow), WEEK, LEAP, 0x03,
+                         0, 0, 0, 0, 0, 0)
+    timing = timing[:SPKT_TIMING_LEN].ljust(SPKT_TIMING_LEN, b'\0')
+
+    suppl = bytearray(SPKT_TIMING_SUPPL_LEN)
+    suppl[0] = 0x06              # receiver mode: overdetermined clock
+    struct.pack_into('>H', suppl, 9, 0x0000)   # minor alarms
+    suppl[11] = 0x00             # decoding status: doing fixes
+    struct.pack_into('>ddd', suppl, 35, lat, lng, alt)
+    return [
+        packet(bytes([0x8F, 0x20]) + fix),
+        packet(bytes([0x8F, 0xAB]) + timing),
+        packet(bytes([0x8F, 0xAC]) + bytes(suppl)),
+    ]
+
+
+# superpacket lengths after the sub-ID, as the library reads them.
+SPKT_FIX_LEN = 55
+SPKT_TIMING_LEN = 16
+SPKT_TIMING_SUPPL_LEN = 67
+
+STREAMS = {
+    'standard': standard,
+    'full': full,
+    'spkt': spkt,
+}
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    outdir = sys.argv[1]
+    os.makedirs(outdir, exist_ok=True)
+    for name, epoch in STREAMS.items():
+        with open(os.path.join(outdir, name + '.tsip'), 'wb') as f:
+            for t in range(EPOCHS):
+                tow = 302400.0 + t
+                for p in epoch(t, tow):
+                    f.write(p)
+
+
+if __name__ == '__main__':
+    main()
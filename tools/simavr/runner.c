@@ -0,0 +1,247 @@
+/*
+ * File:   runner.c
+ *
+ * Runs bench_sketch under simavr, on a simulated ATmega2560 at 16 MHz,
+ * feeding a TSIP stream into USART1 at the receiver's line rate, and reports
+ * for each type of report:
+ *
+ *  - the cycles taken by the call to `processOnePacket()` which decoded it,
+ *    with the packet already buffered;
+ *  - the worst latency from the USART1 receive interrupt for the packet's
+ *    last byte to that call returning (ISR-to-fix latency).
+ *
+ * usage: runner FIRMWARE.elf STREAM.tsip
+ *
+ * Output is one line per report type, for comparison with a baseline:
+ *
+ *     type count cycles_mean cycles_max latency_max
+ *
+ * followed by the stack high-water mark printed by the sketch.
+ */
+
+#include <iso646.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_io.h>
+#include <sim_irq.h>
+#include <sim_interrupts.h>
+#include <sim_cycle_timers.h>
+#include <avr_uart.h>
+#include <avr_ioport.h>
+
+#define F_CPU        16000000UL
+/* TSIP is 38400 baud, 8 data bits, odd parity, 1 stop bit: 11 bits a byte. */
+#define BYTE_CYCLES  (F_CPU * 11 / 38400)
+/* data space addresses of the ATmega2560's general purpose I/O registers */
+#define GPIOR0_ADDR  0x3E
+#define GPIOR1_ADDR  0x4A
+#define GPIOR2_ADDR  0x4B
+/* USART1 receive complete, counting RESET as 0 */
+#define USART1_RX_VECTOR 36
+
+#define MARK_START   0x80
+#define MARK_DONE    0x81
+/* cycles to run after the stream ends, before giving up on the sketch */
+#define DRAIN_CYCLES (F_CPU * 2)
+
+#define DLE 0x10
+#define ETX 0x03
+
+#define N_TYPES 0x200
+/* where RPT_ERROR (-1, marked as 0x7FFF) is counted */
+#define TYPE_ERROR (N_TYPES - 1)
+
+typedef struct {
+    unsigned long count;
+    unsigned long long cycles;
+    unsigned long cycles_max;
+    unsigned long latency_max;
+} Stats;
+
+static avr_t   *avr;
+static uint8_t *stream;
+static size_t   stream_len;
+static size_t   fed;             /* bytes raised on the USART */
+static size_t   rx_isrs;         /* receive interrupts entered */
+static int      xoff;
+
+/* index in the stream of the last byte of each packet */
+static size_t  *pkt_end;
+static size_t   n_pkts;
+static size_t   pkts_received;   /* whole packets whose last ISR has run */
+static size_t   pkts_done;       /* packets processed by the sketch */
+static avr_cycle_count_t *pkt_isr; /* cycle of each packet's last RX ISR */
+
+static avr_cycle_count_t start_cycle;
+static int      done;
+static avr_cycle_count_t end_cycle;
+static Stats    stats[N_TYPES];
+
+static avr_irq_t *uart_in;
+static avr_irq_t *end_pin;
+
+static char     console[256];
+static size_t   console_len;
+static unsigned stack_bytes;
+
+/* find the packet boundaries, skipping stuffed DLEs. */
+static void scan_packets(void) {
+    int in_pkt = 0;
+    pkt_end = calloc(stream_len, sizeof(size_t));
+    pkt_isr = calloc(stream_len, sizeof(avr_cycle_count_t));
+    for (size_t i = 0; i < stream_len; i++) {
+        if (stream[i] != DLE) continue;
+        if (i + 1 < stream_len and stream[i + 1] == DLE) {
+            i++;
+        } else if (in_pkt and i + 1 < stream_len and stream[i + 1] == ETX) {
+            pkt_end[n_pkts++] = ++i;
+            in_pkt = 0;
+        } else {
+            in_pkt = 1;
+        }
+    }
+}
+
+static avr_cycle_count_t feed_byte(avr_t *a, avr_cycle_count_t when, void *param) {
+    (void)a; (void)param;
+    if (fed >= stream_len) {
+        end_cycle = when;
+        avr_raise_irq(end_pin, 1);
+        return 0;
+    }
+    if (not xoff) avr_raise_irq(uart_in, stream[fed++]);
+    return when + BYTE_CYCLES;
+}
+
+static void uart_xon(avr_irq_t *irq, uint32_t value, void *param) {
+    (void)irq; (void)value; (void)param;
+    xoff = 0;
+}
+
+static void uart_xoff(avr_irq_t *irq, uint32_t value, void *param) {
+    (void)irq; (void)value; (void)param;
+    xoff = 1;
+}
+
+/* the sketch's console, on USART0 */
+static void uart_out(avr_irq_t *irq, uint32_t value, void *param) {
+    (void)irq; (void)param;
+    if (value == '\n' or console_len == sizeof(console) - 1) {
+        console[console_len] = 0;
+        sscanf(console, "stack %u", &stack_bytes);
+        console_len = 0;
+    } else if (value != '\r') {
+        console[console_len++] = (char)value;
+    }
+}
+
+static void rx_isr(avr_irq_t *irq, uint32_t value, void *param) {
+    (void)irq; (void)param;
+    if (not value) return;
+    size_t byte = rx_isrs++;
+    if (pkts_received < n_pkts and byte == pkt_end[pkts_received]) {
+        pkt_isr[pkts_received++] = avr->cycle;
+        avr->data[GPIOR2_ADDR] = (uint8_t)pkts_received;
+    }
+}
+
+static void marker(avr_t *a, avr_io_addr_t addr, uint8_t v, void *param) {
+    (void)param;
+    a->data[addr] = v;
+    uint8_t flags = a->data[GPIOR1_ADDR];
+    if (flags == MARK_START) {
+        start_cycle = a->cycle;
+    } else if (flags == MARK_DONE) {
+        done = 1;
+    } else if (pkts_done < pkts_received) {
+        int type = ((flags & 0x7F) << 8) | v;
+        Stats *s = stats + (type == 0x7FFF ? TYPE_ERROR : type % N_TYPES);
+        unsigned long cycles  = (unsigned long)(a->cycle - start_cycle);
+        unsigned long latency = (unsigned long)(a->cycle - pkt_isr[pkts_done]);
+        pkts_done++;
+        s->count++;
+        s->cycles += cycles;
+        if (cycles  > s->cycles_max)  s->cycles_max  = cycles;
+        if (latency > s->latency_max) s->latency_max = latency;
+    }
+}
+
+static int load_stream(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return 0;
+    fseek(f, 0, SEEK_END);
+    stream_len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    stream = malloc(stream_len ? stream_len : 1);
+    size_t n = fread(stream, 1, stream_len, f);
+    fclose(f);
+    return n == stream_len;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s FIRMWARE.elf STREAM.tsip\n", argv[0]);
+        return 2;
+    }
+    elf_firmware_t fw;
+    memset(&fw, 0, sizeof(fw));
+    if (elf_read_firmware(argv[1], &fw) != 0) {
+        fprintf(stderr, "%s: can't read firmware\n", argv[1]);
+        return 1;
+    }
+    if (not load_stream(argv[2])) {
+        fprintf(stderr, "%s: can't read stream\n", argv[2]);
+        return 1;
+    }
+    scan_packets();
+
+    avr = avr_make_mcu_by_name("atmega2560");
+    if (avr == NULL) return 1;
+    avr_init(avr);
+    avr_load_firmware(avr, &fw);
+    avr->frequency = F_CPU;
+    avr->log = 0;
+
+    uart_in = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_INPUT);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_OUT_XON),
+                            uart_xon, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_OUT_XOFF),
+                            uart_xoff, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+                            uart_out, NULL);
+    avr_irq_register_notify(avr_get_interrupt_irq(avr, USART1_RX_VECTOR) + AVR_INT_IRQ_RUNNING,
+                            rx_isr, NULL);
+    end_pin = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 0);
+    avr_register_io_write(avr, GPIOR0_ADDR, marker, NULL);
+
+    /* let the sketch start up before the receiver begins talking. */
+    avr_cycle_timer_register(avr, F_CPU / 10, feed_byte, NULL);
+
+    int state = cpu_Running;
+    while (not done and state != cpu_Done and state != cpu_Crashed) {
+        state = avr_run(avr);
+        if (end_cycle != 0 and avr->cycle - end_cycle > DRAIN_CYCLES) break;
+    }
+
+    for (int t = 0; t < N_TYPES; t++) {
+        Stats *s = stats + t;
+        if (s->count == 0) continue;
+        char label[8];
+        if (t == TYPE_ERROR) strcpy(label, "err");
+        else snprintf(label, sizeof(label), "%x", t);
+        printf("%-4s %6lu %8llu %8lu %8lu\n", label, s->count,
+               s->cycles / s->count, s->cycles_max, s->latency_max);
+    }
+    printf("stack %u\n", stack_bytes);
+
+    int ok = done and pkts_done == n_pkts;
+    if (not ok) {
+        fprintf(stderr, "%s: %zu of %zu packets processed%s\n", argv[2],
+                pkts_done, n_pkts, done ? "" : "; the sketch did not finish");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,28 @@
+/**
+ * size_sketch.ino
+ *
+ * Smallest sketch which keeps the report decoders: reads reports from
+ * Serial1 and echoes their types. Built by avr-size.sh in each library
+ * configuration; with SIZE_SKETCH_EMPTY defined it leaves the library out,
+ * giving the size of the Arduino core alone.
+ */
+
+#ifndef SIZE_SKETCH_EMPTY
+#include <copernicus.h>
+
+CopernicusGPS gps(1);
+#endif
+
+void setup() {
+  Serial.begin(115200);
+}
+
+void loop() {
+#ifndef SIZE_SKETCH_EMPTY
+  ReportType rpt = gps.processOnePacket();
+  if (rpt != RPT_NONE) Serial.write((uint8_t)rpt);
+#else
+  Serial1.begin(38400);
+  if (Serial1.available()) Serial.write(Serial1.read());
+#endif
+}